@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Records the decoder calls and the video surfaces they use into the
+ * trace described in capture.h. Nothing is opened unless VDPAU_CAPTURE
+ * names a file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include "vdpau_private.h"
+#include "capture.h"
+
+#define CAPTURE_IOV_MAX 64
+
+static pthread_once_t capture_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t capture_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int capture_fd = -1;
+
+static const uint8_t padding[8];
+
+static void capture_init(void)
+{
+	char *env_capture = getenv("VDPAU_CAPTURE");
+	if (!env_capture)
+		return;
+
+	int fd = open(env_capture, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1)
+	{
+		printf("could not open capture file %s\n", env_capture);
+		return;
+	}
+
+	capture_header_t header = { .magic = CAPTURE_MAGIC, .version = CAPTURE_VERSION };
+	if (write(fd, &header, sizeof(header)) != sizeof(header))
+	{
+		close(fd);
+		return;
+	}
+
+	capture_fd = fd;
+}
+
+static int capture_enabled(void)
+{
+	pthread_once(&capture_once, capture_init);
+	return capture_fd != -1;
+}
+
+// iov[0] is left for the record header, every part gets padded
+static void capture_write(enum capture_type type, struct iovec *iov, int count)
+{
+	struct iovec out[CAPTURE_IOV_MAX * 2];
+	capture_record_t record = { .type = type, .size = 0 };
+	int i, n = 1;
+
+	for (i = 1; i < count; i++)
+	{
+		out[n++] = iov[i];
+		record.size += CAPTURE_ALIGN(iov[i].iov_len);
+		if (iov[i].iov_len & 7)
+		{
+			out[n].iov_base = (void *)padding;
+			out[n++].iov_len = 8 - (iov[i].iov_len & 7);
+		}
+	}
+	out[0].iov_base = &record;
+	out[0].iov_len = sizeof(record);
+
+	// records from several threads must not interleave
+	pthread_mutex_lock(&capture_mutex);
+	if (capture_fd != -1 && writev(capture_fd, out, n) != (ssize_t)(sizeof(record) + record.size))
+	{
+		printf("capture write failed, stopping capture\n");
+		close(capture_fd);
+		capture_fd = -1;
+	}
+	pthread_mutex_unlock(&capture_mutex);
+}
+
+void capture_surface_create(VdpVideoSurface surface, VdpChromaType chroma_type, uint32_t width, uint32_t height)
+{
+	if (!capture_enabled())
+		return;
+
+	capture_surface_t s = { .surface = surface, .chroma_type = chroma_type, .width = width, .height = height };
+	struct iovec iov[2] = { { 0 }, { &s, sizeof(s) } };
+	capture_write(CAPTURE_SURFACE_CREATE, iov, 2);
+}
+
+void capture_surface_destroy(VdpVideoSurface surface)
+{
+	if (!capture_enabled())
+		return;
+
+	capture_surface_t s = { .surface = surface };
+	struct iovec iov[2] = { { 0 }, { &s, sizeof(s) } };
+	capture_write(CAPTURE_SURFACE_DESTROY, iov, 2);
+}
+
+void capture_decoder_create(VdpDecoder decoder, VdpDecoderProfile profile, uint32_t width, uint32_t height, uint32_t max_references)
+{
+	if (!capture_enabled())
+		return;
+
+	capture_decoder_t d = { .decoder = decoder, .profile = profile, .width = width, .height = height, .max_references = max_references };
+	struct iovec iov[2] = { { 0 }, { &d, sizeof(d) } };
+	capture_write(CAPTURE_DECODER_CREATE, iov, 2);
+}
+
+void capture_decoder_destroy(VdpDecoder decoder)
+{
+	if (!capture_enabled())
+		return;
+
+	capture_decoder_t d = { .decoder = decoder };
+	struct iovec iov[2] = { { 0 }, { &d, sizeof(d) } };
+	capture_write(CAPTURE_DECODER_DESTROY, iov, 2);
+}
+
+void capture_decoder_flush(VdpDecoder decoder)
+{
+	if (!capture_enabled())
+		return;
+
+	capture_decoder_t d = { .decoder = decoder };
+	struct iovec iov[2] = { { 0 }, { &d, sizeof(d) } };
+	capture_write(CAPTURE_DECODER_FLUSH, iov, 2);
+}
+
+void capture_decoder_reconfigure(VdpDecoder decoder, uint32_t width, uint32_t height)
+{
+	if (!capture_enabled())
+		return;
+
+	capture_decoder_t d = { .decoder = decoder, .width = width, .height = height };
+	struct iovec iov[2] = { { 0 }, { &d, sizeof(d) } };
+	capture_write(CAPTURE_DECODER_RECONFIGURE, iov, 2);
+}
+
+void capture_decoder_render(VdpDecoder decoder, VdpDecoderProfile profile, VdpVideoSurface target, VdpPictureInfo const *picture_info, uint32_t bitstream_buffer_count, VdpBitstreamBuffer const *bitstream_buffers)
+{
+	if (!capture_enabled())
+		return;
+
+	if (bitstream_buffer_count > CAPTURE_IOV_MAX / 2 - 2)
+	{
+		VDPAU_DBG_ONCE("too many bitstream buffers to capture");
+		return;
+	}
+
+	capture_render_t r = { .decoder = decoder, .target = target, .info_size = capture_info_size(profile), .buffer_count = bitstream_buffer_count };
+	if (!picture_info)
+		r.info_size = 0;
+
+	struct iovec iov[CAPTURE_IOV_MAX];
+	uint32_t lengths[CAPTURE_IOV_MAX / 2];
+	unsigned int i;
+	int n = 1;
+
+	iov[n].iov_base = &r;
+	iov[n++].iov_len = sizeof(r);
+	iov[n].iov_base = (void *)picture_info;
+	iov[n++].iov_len = r.info_size;
+	for (i = 0; i < bitstream_buffer_count; i++)
+	{
+		lengths[i] = bitstream_buffers[i].bitstream_bytes;
+		iov[n].iov_base = &lengths[i];
+		iov[n++].iov_len = sizeof(lengths[i]);
+		iov[n].iov_base = (void *)bitstream_buffers[i].bitstream;
+		iov[n++].iov_len = lengths[i];
+	}
+
+	capture_write(CAPTURE_DECODER_RENDER, iov, n);
+}
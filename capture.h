@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include <stdint.h>
+#include <vdpau/vdpau.h>
+
+/*
+ * Trace of the decoder calls, written with VDPAU_CAPTURE=<file> and read
+ * back by vdpau_replay. A capture_header_t is followed by records, each a
+ * capture_record_t and its payload padded to 8 bytes, so a mapped trace
+ * can be walked in place.
+ *
+ * A render payload is a capture_render_t, info_size bytes of the
+ * VdpPictureInfo and buffer_count times a uint32_t length followed by
+ * the bitstream, each padded to 8 bytes.
+ */
+
+#define CAPTURE_MAGIC 0x50414356 // "VCAP"
+#define CAPTURE_VERSION 1
+
+#define CAPTURE_ALIGN(x) (((x) + 7) & ~7)
+
+enum capture_type
+{
+	CAPTURE_SURFACE_CREATE = 1,
+	CAPTURE_SURFACE_DESTROY,
+	CAPTURE_DECODER_CREATE,
+	CAPTURE_DECODER_DESTROY,
+	CAPTURE_DECODER_RENDER,
+	// a capture_decoder_t, the reconfiguration with width and height
+	CAPTURE_DECODER_FLUSH,
+	CAPTURE_DECODER_RECONFIGURE,
+};
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+} capture_header_t;
+
+typedef struct
+{
+	uint32_t type;
+	uint32_t size;
+} capture_record_t;
+
+typedef struct
+{
+	uint32_t surface;
+	uint32_t chroma_type;
+	uint32_t width, height;
+} capture_surface_t;
+
+typedef struct
+{
+	uint32_t decoder;
+	uint32_t profile;
+	uint32_t width, height;
+	uint32_t max_references;
+} capture_decoder_t;
+
+typedef struct
+{
+	uint32_t decoder;
+	uint32_t target;
+	uint32_t info_size;
+	uint32_t buffer_count;
+} capture_render_t;
+
+// size of the VdpPictureInfo a profile gets, JPEG and VP8 don't use one
+static inline uint32_t capture_info_size(VdpDecoderProfile profile)
+{
+	switch (profile)
+	{
+	case VDP_DECODER_PROFILE_MPEG1:
+	case VDP_DECODER_PROFILE_MPEG2_SIMPLE:
+	case VDP_DECODER_PROFILE_MPEG2_MAIN:
+		return sizeof(VdpPictureInfoMPEG1Or2);
+
+	case VDP_DECODER_PROFILE_H264_BASELINE:
+	case VDP_DECODER_PROFILE_H264_MAIN:
+	case VDP_DECODER_PROFILE_H264_HIGH:
+		return sizeof(VdpPictureInfoH264);
+
+	case VDP_DECODER_PROFILE_MPEG4_PART2_SP:
+	case VDP_DECODER_PROFILE_MPEG4_PART2_ASP:
+	case VDP_DECODER_PROFILE_DIVX4_QMOBILE:
+	case VDP_DECODER_PROFILE_DIVX4_MOBILE:
+	case VDP_DECODER_PROFILE_DIVX4_HOME_THEATER:
+	case VDP_DECODER_PROFILE_DIVX4_HD_1080P:
+	case VDP_DECODER_PROFILE_DIVX5_QMOBILE:
+	case VDP_DECODER_PROFILE_DIVX5_MOBILE:
+	case VDP_DECODER_PROFILE_DIVX5_HOME_THEATER:
+	case VDP_DECODER_PROFILE_DIVX5_HD_1080P:
+	case VDP_DECODER_PROFILE_DIVX3_QMOBILE:
+	case VDP_DECODER_PROFILE_DIVX3_MOBILE:
+	case VDP_DECODER_PROFILE_DIVX3_HOME_THEATER:
+	case VDP_DECODER_PROFILE_DIVX3_HD_1080P:
+		return sizeof(VdpPictureInfoMPEG4Part2);
+
+	case VDP_DECODER_PROFILE_HEVC_MAIN:
+		return sizeof(VdpPictureInfoHEVC);
+
+	case VDP_DECODER_PROFILE_VC1_SIMPLE:
+	case VDP_DECODER_PROFILE_VC1_MAIN:
+	case VDP_DECODER_PROFILE_VC1_ADVANCED:
+		return sizeof(VdpPictureInfoVC1);
+
+	default:
+		return 0;
+	}
+}
+
+#endif
@@ -73,6 +73,8 @@ void glVDPAUInitCedar(const void *vdpDevice, const void *getProcAddress,
                    void (*_Log)(int loglevel, const char *format, ...))
 {
    Log = _Log;
+   if (Log)
+      logger_set_callback(Log);
 
   cedarv_disp_init();
 }
@@ -263,9 +265,14 @@ VdpStatus glVDPAUGetVideoFrameConfig(vdpauSurfaceCedar surface, struct videoFram
     return VDP_STATUS_INVALID_HANDLE;
   }
 
+  // the rotated copy if the decoder wrote one
+  CEDARV_MEMORY dataY, dataU;
+  uint32_t width, height;
+  video_surface_get_display(vs, &dataY, &dataU, &width, &height);
+
   config->srcFormat = vs->source_format;
-  config->addr[0] = (void*)cedarv_virt2phys(vs->dataY);
-  config->addr[1] = (void*)cedarv_virt2phys(vs->dataU);
+  config->addr[0] = (void*)cedarv_virt2phys(dataY);
+  config->addr[1] = (void*)cedarv_virt2phys(dataU);
   config->align[0] = 32;
   config->align[1] = 16;
   if( cedarv_isValid(vs->dataV))
@@ -279,8 +286,8 @@ VdpStatus glVDPAUGetVideoFrameConfig(vdpauSurfaceCedar surface, struct videoFram
     config->align[2] = 0;
   }
 
-  config->height = vs->height;
-  config->width = vs->width;
+  config->height = height;
+  config->width = width;
 
 #if DEBUG_IMAGE_DATA == 1
   static int first=1;
@@ -336,9 +343,9 @@ VdpStatus glVDPAUCreateSurfaceCedar(VdpChromaType chroma_type, VdpYCbCrFormat fo
       {
         case VDP_CHROMA_TYPE_444:
           //vs->data = cedarv_malloc(vs->plane_size * 3);
-          vs->dataY = cedarv_malloc(vs->plane_size);
-          vs->dataU = cedarv_malloc(vs->plane_size);
-          vs->dataV = cedarv_malloc(vs->plane_size);
+          vs->dataY = cedarv_malloc_type(vs->plane_size, CEDARV_MEM_VIDEO_SURFACE);
+          vs->dataU = cedarv_malloc_type(vs->plane_size, CEDARV_MEM_VIDEO_SURFACE);
+          vs->dataV = cedarv_malloc_type(vs->plane_size, CEDARV_MEM_VIDEO_SURFACE);
           if (! cedarv_isValid(vs->dataY) || ! cedarv_isValid(vs->dataU) || ! cedarv_isValid(vs->dataV))
           {
             printf("vdpau video surface=%d create, failure\n", *surface);
@@ -349,9 +356,9 @@ VdpStatus glVDPAUCreateSurfaceCedar(VdpChromaType chroma_type, VdpYCbCrFormat fo
           break;
         case VDP_CHROMA_TYPE_422:
           //vs->data = cedarv_malloc(vs->plane_size * 2);
-          vs->dataY = cedarv_malloc(vs->plane_size);
-          vs->dataU = cedarv_malloc(vs->plane_size/2);
-          vs->dataV = cedarv_malloc(vs->plane_size/2);
+          vs->dataY = cedarv_malloc_type(vs->plane_size, CEDARV_MEM_VIDEO_SURFACE);
+          vs->dataU = cedarv_malloc_type(vs->plane_size/2, CEDARV_MEM_VIDEO_SURFACE);
+          vs->dataV = cedarv_malloc_type(vs->plane_size/2, CEDARV_MEM_VIDEO_SURFACE);
           if (! cedarv_isValid(vs->dataY) || ! cedarv_isValid(vs->dataU) || ! cedarv_isValid(vs->dataV))
           {
             printf("vdpau video surface=%d create, failure\n", *surface);
@@ -362,8 +369,8 @@ VdpStatus glVDPAUCreateSurfaceCedar(VdpChromaType chroma_type, VdpYCbCrFormat fo
           break;
         case VDP_CHROMA_TYPE_420:
           //vs->data = cedarv_malloc(vs->plane_size + (vs->plane_size / 2));
-          vs->dataY = cedarv_malloc(vs->plane_size);
-          vs->dataU = cedarv_malloc(vs->plane_size/2);
+          vs->dataY = cedarv_malloc_type(vs->plane_size, CEDARV_MEM_VIDEO_SURFACE);
+          vs->dataU = cedarv_malloc_type(vs->plane_size/2, CEDARV_MEM_VIDEO_SURFACE);
           if (! cedarv_isValid(vs->dataY) || ! cedarv_isValid(vs->dataU))
           {
             printf("vdpau video surface=%d create, failure\n", *surface);
@@ -383,9 +390,9 @@ VdpStatus glVDPAUCreateSurfaceCedar(VdpChromaType chroma_type, VdpYCbCrFormat fo
       {
         case VDP_CHROMA_TYPE_444:
           //vs->data = cedarv_malloc(vs->plane_size * 3);
-          vs->dataY = cedarv_malloc(vs->plane_size);
-          vs->dataU = cedarv_malloc(vs->plane_size);
-          vs->dataV = cedarv_malloc(vs->plane_size);
+          vs->dataY = cedarv_malloc_type(vs->plane_size, CEDARV_MEM_VIDEO_SURFACE);
+          vs->dataU = cedarv_malloc_type(vs->plane_size, CEDARV_MEM_VIDEO_SURFACE);
+          vs->dataV = cedarv_malloc_type(vs->plane_size, CEDARV_MEM_VIDEO_SURFACE);
           if (! cedarv_isValid(vs->dataY) || ! cedarv_isValid(vs->dataU) || ! cedarv_isValid(vs->dataV))
           {
             printf("vdpau video surface=%d create, failure\n", *surface);
@@ -396,9 +403,9 @@ VdpStatus glVDPAUCreateSurfaceCedar(VdpChromaType chroma_type, VdpYCbCrFormat fo
           break;
         case VDP_CHROMA_TYPE_422:
               //vs->data = cedarv_malloc(vs->plane_size * 2);
-          vs->dataY = cedarv_malloc(vs->plane_size);
-          vs->dataU = cedarv_malloc(vs->plane_size/2);
-          vs->dataV = cedarv_malloc(vs->plane_size/2);
+          vs->dataY = cedarv_malloc_type(vs->plane_size, CEDARV_MEM_VIDEO_SURFACE);
+          vs->dataU = cedarv_malloc_type(vs->plane_size/2, CEDARV_MEM_VIDEO_SURFACE);
+          vs->dataV = cedarv_malloc_type(vs->plane_size/2, CEDARV_MEM_VIDEO_SURFACE);
           if (! cedarv_isValid(vs->dataY) || ! cedarv_isValid(vs->dataU) || ! cedarv_isValid(vs->dataV))
           {
             printf("vdpau video surface=%d create, failure\n", *surface);
@@ -409,9 +416,9 @@ VdpStatus glVDPAUCreateSurfaceCedar(VdpChromaType chroma_type, VdpYCbCrFormat fo
           break;
         case VDP_CHROMA_TYPE_420:
               //vs->data = cedarv_malloc(vs->plane_size + (vs->plane_size / 2));
-          vs->dataY = cedarv_malloc(vs->plane_size);
-          vs->dataU = cedarv_malloc(vs->plane_size/2);
-          vs->dataV = cedarv_malloc(vs->plane_size/2);
+          vs->dataY = cedarv_malloc_type(vs->plane_size, CEDARV_MEM_VIDEO_SURFACE);
+          vs->dataU = cedarv_malloc_type(vs->plane_size/2, CEDARV_MEM_VIDEO_SURFACE);
+          vs->dataV = cedarv_malloc_type(vs->plane_size/2, CEDARV_MEM_VIDEO_SURFACE);
           if (! cedarv_isValid(vs->dataY) || ! cedarv_isValid(vs->dataU) || ! cedarv_isValid(vs->dataV))
           {
             printf("vdpau video surface=%d create, failure\n", *surface);
@@ -439,16 +446,9 @@ VdpStatus glVDPAUDestroySurfaceCedar(vdpauSurfaceCedar surface)
 
   if (vs->decoder_private_free)
     vs->decoder_private_free(vs);
-  if( cedarv_isValid(vs->dataY) )
-    cedarv_free(vs->dataY);
-  if( cedarv_isValid(vs->dataU) )
-    cedarv_free(vs->dataU);
-  if (cedarv_isValid(vs->dataV) )
-    cedarv_free(vs->dataV);
 
-  cedarv_setBufferInvalid(vs->dataY);
-  cedarv_setBufferInvalid(vs->dataU);
-  cedarv_setBufferInvalid(vs->dataV);
+  // the last export release of vdpau frees exported planes
+  video_surface_free_planes(vs);
         
   VDPAU_DBG("vdpau video surface=%d destroyed", surface);
         
@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Completions for event loops. Asynchronous renders are copied into a
+ * job and decoded in order by a worker of the device, finished decodes
+ * and displayed surfaces go into a ring that an eventfd signals. The
+ * worker and the eventfd are created on first use.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include "vdpau_private.h"
+#include "capture.h"
+
+// submitted and not collected yet, the ring always has room for them
+#define COMPLETION_JOBS_MAX 32
+#define COMPLETION_RING 64
+
+extern uint64_t get_time(void);
+
+typedef struct completion_job
+{
+	struct completion_job *next;
+	VdpDecoder decoder;
+	VdpVideoSurface target;
+	VdpPictureInfo *info;
+	VdpBitstreamBuffer bitstream;
+	uint8_t data[];
+} completion_job_t;
+
+struct completion_queue
+{
+	pthread_t worker;
+	int worker_started;
+	pthread_mutex_t mutex;
+	pthread_cond_t start;
+	pthread_cond_t idle;
+	int quit;
+	int fd;
+	completion_job_t *head, *tail;
+	int running;
+	int jobs;
+	VdpCompletionSunxi ring[COMPLETION_RING];
+	uint32_t ring_head, ring_tail;
+	uint32_t dropped;
+};
+
+static void post(struct completion_queue *c, uint32_t type, VdpHandle surface, VdpStatus status)
+{
+	VdpCompletionSunxi *e = &c->ring[c->ring_head % COMPLETION_RING];
+	e->type = type;
+	e->status = status;
+	e->surface = surface;
+	e->time = get_time();
+	c->ring_head++;
+
+	uint64_t one = 1;
+	if (write(c->fd, &one, sizeof(one)) != sizeof(one))
+		VDPAU_DBG_ONCE("eventfd write failed");
+}
+
+static void *completion_thread(void *arg)
+{
+	struct completion_queue *c = arg;
+
+	pthread_mutex_lock(&c->mutex);
+	while (1)
+	{
+		while (!c->quit && !c->head)
+			pthread_cond_wait(&c->start, &c->mutex);
+		if (!c->head)
+			break;
+
+		completion_job_t *job = c->head;
+		c->head = job->next;
+		if (!c->head)
+			c->tail = NULL;
+		c->running = 1;
+		pthread_mutex_unlock(&c->mutex);
+
+		VdpStatus status = decoder_render(job->decoder, job->target, job->info, 1, &job->bitstream);
+		handle_release(job->target);
+		handle_release(job->decoder);
+
+		pthread_mutex_lock(&c->mutex);
+		post(c, VDP_SUNXI_COMPLETION_DECODED, job->target, status);
+		free(job);
+		c->running = 0;
+		if (!c->head)
+			pthread_cond_broadcast(&c->idle);
+	}
+	pthread_mutex_unlock(&c->mutex);
+	return NULL;
+}
+
+static struct completion_queue *completion_new(void)
+{
+	struct completion_queue *c = calloc(1, sizeof(*c));
+	if (!c)
+		return NULL;
+
+	c->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (c->fd == -1)
+	{
+		free(c);
+		return NULL;
+	}
+
+	pthread_mutex_init(&c->mutex, NULL);
+	pthread_cond_init(&c->start, NULL);
+	pthread_cond_init(&c->idle, NULL);
+
+	return c;
+}
+
+// callers race for the first one, the device mutex picks who creates it
+static struct completion_queue *completion_get(device_ctx_t *dev)
+{
+	struct completion_queue *c = __atomic_load_n(&dev->completion, __ATOMIC_ACQUIRE);
+	if (c)
+		return c;
+
+	pthread_mutex_lock(&dev->mutex);
+	c = dev->completion;
+	if (!c)
+	{
+		c = completion_new();
+		__atomic_store_n(&dev->completion, c, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&dev->mutex);
+	return c;
+}
+
+void completion_free(device_ctx_t *dev)
+{
+	struct completion_queue *c = dev->completion;
+	if (!c)
+		return;
+
+	// the worker decodes what is queued before it exits
+	pthread_mutex_lock(&c->mutex);
+	c->quit = 1;
+	pthread_cond_broadcast(&c->start);
+	pthread_mutex_unlock(&c->mutex);
+	if (c->worker_started)
+		pthread_join(c->worker, NULL);
+
+	close(c->fd);
+	pthread_cond_destroy(&c->idle);
+	pthread_cond_destroy(&c->start);
+	pthread_mutex_destroy(&c->mutex);
+	free(c);
+	dev->completion = NULL;
+}
+
+void completion_sync(device_ctx_t *dev)
+{
+	struct completion_queue *c = dev ? __atomic_load_n(&dev->completion, __ATOMIC_ACQUIRE) : NULL;
+	if (!c)
+		return;
+
+	pthread_mutex_lock(&c->mutex);
+	while (c->head || c->running)
+		pthread_cond_wait(&c->idle, &c->mutex);
+	pthread_mutex_unlock(&c->mutex);
+}
+
+void completion_displayed(device_ctx_t *dev, VdpOutputSurface surface)
+{
+	struct completion_queue *c = __atomic_load_n(&dev->completion, __ATOMIC_ACQUIRE);
+	if (!c)
+		return;
+
+	// decodes keep their room, flips are dropped if nobody collects
+	pthread_mutex_lock(&c->mutex);
+	if (c->ring_head - c->ring_tail + COMPLETION_JOBS_MAX < COMPLETION_RING)
+		post(c, VDP_SUNXI_COMPLETION_DISPLAYED, surface, VDP_STATUS_OK);
+	else
+		c->dropped++;
+	pthread_mutex_unlock(&c->mutex);
+}
+
+VdpStatus vdp_decoder_render_async_sunxi(VdpDecoder decoder, VdpVideoSurface target, VdpPictureInfo const *picture_info, uint32_t bitstream_buffer_count, VdpBitstreamBuffer const *bitstream_buffers)
+{
+	if (!bitstream_buffers && bitstream_buffer_count)
+		return VDP_STATUS_INVALID_POINTER;
+
+	decoder_ctx_t *dec = handle_get(decoder);
+	if (!dec)
+		return VDP_STATUS_INVALID_HANDLE;
+
+	if (!handle_get(target))
+	{
+		handle_release(decoder);
+		return VDP_STATUS_INVALID_HANDLE;
+	}
+
+	struct completion_queue *c = completion_get(dec->device);
+	uint32_t info_size = picture_info ? capture_info_size(dec->profile) : 0;
+	uint32_t i, bytes = 0;
+	for (i = 0; i < bitstream_buffer_count; i++)
+		bytes += bitstream_buffers[i].bitstream_bytes;
+
+	completion_job_t *job = c ? malloc(sizeof(*job) + ALIGN(info_size, 8) + bytes) : NULL;
+	if (!job)
+	{
+		handle_release(target);
+		handle_release(decoder);
+		return VDP_STATUS_RESOURCES;
+	}
+
+	// the caller may reuse its buffers as soon as this returns
+	job->next = NULL;
+	job->decoder = decoder;
+	job->target = target;
+	job->info = NULL;
+	if (info_size)
+	{
+		job->info = (VdpPictureInfo *)job->data;
+		memcpy(job->data, picture_info, info_size);
+	}
+	uint8_t *p = job->data + ALIGN(info_size, 8);
+	job->bitstream.struct_version = VDP_BITSTREAM_BUFFER_VERSION;
+	job->bitstream.bitstream = p;
+	job->bitstream.bitstream_bytes = bytes;
+	for (i = 0; i < bitstream_buffer_count; i++)
+	{
+		memcpy(p, bitstream_buffers[i].bitstream, bitstream_buffers[i].bitstream_bytes);
+		p += bitstream_buffers[i].bitstream_bytes;
+	}
+
+	pthread_mutex_lock(&c->mutex);
+	if (c->jobs >= COMPLETION_JOBS_MAX)
+	{
+		pthread_mutex_unlock(&c->mutex);
+		free(job);
+		handle_release(target);
+		handle_release(decoder);
+		return VDP_STATUS_RESOURCES;
+	}
+
+	if (!c->worker_started)
+		c->worker_started = (pthread_create(&c->worker, NULL, completion_thread, c) == 0);
+	if (!c->worker_started)
+	{
+		pthread_mutex_unlock(&c->mutex);
+		free(job);
+		handle_release(target);
+		handle_release(decoder);
+		return VDP_STATUS_RESOURCES;
+	}
+
+	if (c->tail)
+		c->tail->next = job;
+	else
+		c->head = job;
+	c->tail = job;
+	c->jobs++;
+	pthread_cond_signal(&c->start);
+	pthread_mutex_unlock(&c->mutex);
+
+	// the job holds the target and decoder references
+	return VDP_STATUS_OK;
+}
+
+VdpStatus vdp_device_completion_fd_sunxi(VdpDevice device, int *fd)
+{
+	if (!fd)
+		return VDP_STATUS_INVALID_POINTER;
+
+	device_ctx_t *dev = handle_get(device);
+	if (!dev)
+		return VDP_STATUS_INVALID_HANDLE;
+
+	struct completion_queue *c = completion_get(dev);
+	*fd = c ? c->fd : -1;
+
+	handle_release(device);
+	return c ? VDP_STATUS_OK : VDP_STATUS_RESOURCES;
+}
+
+VdpStatus vdp_device_collect_completions_sunxi(VdpDevice device, VdpCompletionSunxi *completions, uint32_t max, uint32_t *count)
+{
+	if (!completions || !count)
+		return VDP_STATUS_INVALID_POINTER;
+
+	device_ctx_t *dev = handle_get(device);
+	if (!dev)
+		return VDP_STATUS_INVALID_HANDLE;
+
+	struct completion_queue *c = __atomic_load_n(&dev->completion, __ATOMIC_ACQUIRE);
+	*count = 0;
+	if (c)
+	{
+		pthread_mutex_lock(&c->mutex);
+		while (*count < max && c->ring_tail != c->ring_head)
+		{
+			VdpCompletionSunxi *e = &c->ring[c->ring_tail++ % COMPLETION_RING];
+			if (e->type == VDP_SUNXI_COMPLETION_DECODED)
+				c->jobs--;
+			completions[(*count)++] = *e;
+		}
+
+		// readable again with the next completion
+		uint64_t value;
+		if (c->ring_tail == c->ring_head && read(c->fd, &value, sizeof(value)) < 0)
+			value = 0;
+
+		if (c->dropped)
+		{
+			VDPAU_DBG("%u display completions dropped", c->dropped);
+			c->dropped = 0;
+		}
+		pthread_mutex_unlock(&c->mutex);
+	}
+
+	handle_release(device);
+	return VDP_STATUS_OK;
+}
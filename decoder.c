@@ -20,38 +20,16 @@
 #include <string.h>
 #include "vdpau_private.h"
 #include "ve.h"
+#include "timeline.h"
 #include <stdio.h>
 
 #define TIMEMEAS 0
 
-VdpStatus vdp_decoder_create(VdpDevice device, VdpDecoderProfile profile, uint32_t width, uint32_t height, uint32_t max_references, VdpDecoder *decoder)
+// sets up the codec of dec->profile for dec->width x dec->height
+static VdpStatus decoder_new_private(decoder_ctx_t *dec)
 {
-    device_ctx_t *dev = handle_get(device);
-    if (!dev)
-        return VDP_STATUS_INVALID_HANDLE;
-
-    if (max_references > 16)
-        return VDP_STATUS_ERROR;
-
-    decoder_ctx_t *dec = handle_create(sizeof(*dec), decoder, htype_decoder);
-    if (!dec)
-        goto err_ctx;
-    
-    VDPAU_DBG("vdpau decoder=%d created", *decoder);
-
-    memset(dec, 0, sizeof(*dec));
-    dec->device = dev;
-    dec->profile = profile;
-    dec->width = width;
-    dec->height = height;
-
-    dec->data = cedarv_malloc(VBV_SIZE);
-    if (! cedarv_isValid(dec->data))
-        goto err_data;
-    dec->data_pos = 0;
-
     VdpStatus ret;
-    switch (profile)
+    switch (dec->profile)
     {
     case VDP_DECODER_PROFILE_MPEG1:
     case VDP_DECODER_PROFILE_MPEG2_SIMPLE:
@@ -103,14 +81,65 @@ VdpStatus vdp_decoder_create(VdpDevice device, VdpDecoderProfile profile, uint32
            ret = VDP_STATUS_INVALID_DECODER_PROFILE;
         break;
 
+#if USE_VC1
+    case VDP_DECODER_PROFILE_VC1_SIMPLE:
+    case VDP_DECODER_PROFILE_VC1_MAIN:
+    case VDP_DECODER_PROFILE_VC1_ADVANCED:
+        cedarv_allocateEngine(CEDARV_ENGINE_MPEG);
+        ret = new_decoder_vc1(dec);
+        break;
+#endif
+
+    case VDP_DECODER_PROFILE_SUNXI_MJPEG:
+        cedarv_allocateEngine(CEDARV_ENGINE_MPEG);
+        ret = new_decoder_jpeg(dec);
+        break;
+
+#if USE_VP8
+    case VDP_DECODER_PROFILE_SUNXI_VP8:
+        cedarv_allocateEngine(CEDARV_ENGINE_H264);
+        ret = new_decoder_vp8(dec);
+        break;
+#endif
+
     default:
         ret = VDP_STATUS_INVALID_DECODER_PROFILE;
         break;
     }
 
-    if (ret != VDP_STATUS_OK)
+    return ret;
+}
+
+VdpStatus vdp_decoder_create(VdpDevice device, VdpDecoderProfile profile, uint32_t width, uint32_t height, uint32_t max_references, VdpDecoder *decoder)
+{
+    device_ctx_t *dev = handle_get(device);
+    if (!dev)
+        return VDP_STATUS_INVALID_HANDLE;
+
+    if (max_references > 16)
+        return VDP_STATUS_ERROR;
+
+    decoder_ctx_t *dec = handle_create(sizeof(*dec), decoder, htype_decoder);
+    if (!dec)
+        goto err_ctx;
+    
+    VDPAU_DBG("vdpau decoder=%d created", *decoder);
+
+    memset(dec, 0, sizeof(*dec));
+    dec->device = dev;
+    dec->profile = profile;
+    dec->width = width;
+    dec->height = height;
+
+    dec->data = cedarv_malloc_type(VBV_SIZE, CEDARV_MEM_VBV);
+    if (! cedarv_isValid(dec->data))
+        goto err_data;
+    dec->data_pos = 0;
+
+    if (decoder_new_private(dec) != VDP_STATUS_OK)
         goto err_decoder;
 
+    capture_decoder_create(*decoder, profile, width, height, max_references);
     handle_release(device);
     return VDP_STATUS_OK;
 
@@ -134,6 +163,9 @@ VdpStatus vdp_decoder_destroy(VdpDecoder decoder)
     if (!dec)
         return VDP_STATUS_INVALID_HANDLE;
 
+    // asynchronous renders may still use it
+    completion_sync(dec->device);
+    capture_decoder_destroy(decoder);
     if (dec->private_free)
         dec->private_free(dec);
 
@@ -146,6 +178,74 @@ VdpStatus vdp_decoder_destroy(VdpDecoder decoder)
     return VDP_STATUS_OK;
 }
 
+VdpStatus vdp_decoder_flush_sunxi(VdpDecoder decoder)
+{
+    decoder_ctx_t *dec = handle_get(decoder);
+    if (!dec)
+        return VDP_STATUS_INVALID_HANDLE;
+
+    completion_sync(dec->device);
+    capture_decoder_flush(decoder);
+    if (dec->private_flush)
+        dec->private_flush(dec);
+    dec->data_pos = 0;
+
+    handle_release(decoder);
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus decode_unavailable(decoder_ctx_t *decoder, VdpPictureInfo const *info, const int len, video_surface_ctx_t *output)
+{
+    return VDP_STATUS_RESOURCES;
+}
+
+static VdpStatus decoder_renew_private(decoder_ctx_t *dec, uint32_t width, uint32_t height)
+{
+    if (dec->private_free)
+        dec->private_free(dec);
+    dec->private = NULL;
+    dec->private_free = NULL;
+    dec->private_flush = NULL;
+    dec->private_fits = NULL;
+
+    dec->width = width;
+    dec->height = height;
+    return decoder_new_private(dec);
+}
+
+VdpStatus vdp_decoder_reconfigure_sunxi(VdpDecoder decoder, uint32_t width, uint32_t height)
+{
+    VdpStatus status = VDP_STATUS_OK;
+    decoder_ctx_t *dec = handle_get(decoder);
+    if (!dec)
+        return VDP_STATUS_INVALID_HANDLE;
+
+    uint32_t old_width = dec->width, old_height = dec->height;
+    completion_sync(dec->device);
+    capture_decoder_reconfigure(decoder, width, height);
+
+    // the VBV and the engine don't depend on the size, only the codec buffers may
+    if (dec->private_fits && dec->private_fits(dec, width, height))
+    {
+        dec->width = width;
+        dec->height = height;
+        if (dec->private_flush)
+            dec->private_flush(dec);
+    }
+    else if (decoder_renew_private(dec, width, height) != VDP_STATUS_OK)
+    {
+        log_warning("decoder=%d no memory for %ux%u", decoder, width, height);
+        if (decoder_renew_private(dec, old_width, old_height) != VDP_STATUS_OK)
+            dec->decode = decode_unavailable;
+        status = VDP_STATUS_RESOURCES;
+    }
+    dec->data_pos = 0;
+
+    VDPAU_DBG("vdpau decoder=%d reconfigured to %ux%u", decoder, dec->width, dec->height);
+    handle_release(decoder);
+    return status;
+}
+
 VdpStatus vdp_decoder_get_parameters(VdpDecoder decoder, VdpDecoderProfile *profile, uint32_t *width, uint32_t *height)
 {
     decoder_ctx_t *dec = handle_get(decoder);
@@ -167,6 +267,20 @@ VdpStatus vdp_decoder_get_parameters(VdpDecoder decoder, VdpDecoderProfile *prof
 }
 
 VdpStatus vdp_decoder_render(VdpDecoder decoder, VdpVideoSurface target, VdpPictureInfo const *picture_info, uint32_t bitstream_buffer_count, VdpBitstreamBuffer const *bitstream_buffers)
+{
+    decoder_ctx_t *dec = handle_get(decoder);
+    if (!dec)
+        return VDP_STATUS_INVALID_HANDLE;
+
+    // asynchronous renders queued before go first, they share the decoder's state
+    completion_sync(dec->device);
+    handle_release(decoder);
+
+    return decoder_render(decoder, target, picture_info, bitstream_buffer_count, bitstream_buffers);
+}
+
+// the worker of asynchronous renders decodes through here
+VdpStatus decoder_render(VdpDecoder decoder, VdpVideoSurface target, VdpPictureInfo const *picture_info, uint32_t bitstream_buffer_count, VdpBitstreamBuffer const *bitstream_buffers)
 {
     VdpStatus status = VDP_STATUS_INVALID_HANDLE;
     decoder_ctx_t *dec = handle_get(decoder);
@@ -180,9 +294,30 @@ VdpStatus vdp_decoder_render(VdpDecoder decoder, VdpVideoSurface target, VdpPict
         return VDP_STATUS_INVALID_HANDLE;
     }
 
-    vid->source_format = INTERNAL_YCBCR_FORMAT;
+    capture_decoder_render(decoder, dec->profile, target, picture_info, bitstream_buffer_count, bitstream_buffers);
+
     unsigned int i, pos = 0;
 
+    // everything goes into the VBV at once
+    for (i = 0; i < bitstream_buffer_count; i++)
+    {
+        if (bitstream_buffers[i].bitstream_bytes > VBV_SIZE - pos)
+        {
+            log_warning("decoder=%d bitstream doesn't fit the %u bytes VBV", decoder, VBV_SIZE);
+            handle_release(target);
+            handle_release(decoder);
+            return VDP_STATUS_ERROR;
+        }
+        pos += bitstream_buffers[i].bitstream_bytes;
+    }
+    pos = 0;
+
+    TIMELINE_BEGIN("decoder_render");
+    vid->source_format = INTERNAL_YCBCR_FORMAT;
+    // decoders that write the rotated copy set it again, the others show the frame unrotated
+    vid->rotated = 0;
+
+    TIMELINE_BEGIN("bitstream_copy");
     for (i = 0; i < bitstream_buffer_count; i++)
     {
         cedarv_memcpy(dec->data, pos, bitstream_buffers[i].bitstream, bitstream_buffers[i].bitstream_bytes);
@@ -190,6 +325,7 @@ VdpStatus vdp_decoder_render(VdpDecoder decoder, VdpVideoSurface target, VdpPict
     }
     //memory is mapped unchached, therefore no flush necessary. hopefully ;)
     cedarv_flush_cache(dec->data, pos);
+    TIMELINE_END("bitstream_copy");
 #if TIMEMEAS
     static int num_pics=0;
     static int num_longs=0;
@@ -197,13 +333,30 @@ VdpStatus vdp_decoder_render(VdpDecoder decoder, VdpVideoSurface target, VdpPict
     uint64_t tv, tv2;
     tv = get_time();
 #endif
+    TIMELINE_BEGIN("decode");
+    cedarv_take_hang();
     status = dec->decode(dec, picture_info, pos, vid);
+    if (cedarv_take_hang())
+    {
+        log_error("decoder=%d frame failed, the engine was reset", decoder);
+        status = VDP_STATUS_ERROR;
+    }
+    TIMELINE_END("decode");
 #if TIMEMEAS                
     tv2 = get_time();
     if (tv2-tv > 10000000) {
       printf("codec decode, longer than 10ms:%lld, pics=%ld, longs=%ld\n", tv2-tv, num_pics, ++num_longs);
     }
 #endif
+    vid->generation++;
+    int ratio;
+    video_surface_ctx_t *scaled = video_surface_get_scaled(vid, &ratio);
+    if (scaled)
+    {
+        scaled->generation++;
+        handle_release(vid->scaled);
+    }
+    TIMELINE_END("decoder_render");
 
     handle_release(target);
     handle_release(decoder);
@@ -241,6 +394,15 @@ VdpStatus vdp_decoder_query_capabilities(VdpDevice device, VdpDecoderProfile pro
     case VDP_DECODER_PROFILE_DIVX4_HD_1080P:
       *is_supported = VDP_TRUE;
       break;
+
+#if USE_VC1
+    // picture layer parsed in software, progressive frames only
+    case VDP_DECODER_PROFILE_VC1_SIMPLE:
+    case VDP_DECODER_PROFILE_VC1_MAIN:
+    case VDP_DECODER_PROFILE_VC1_ADVANCED:
+      *is_supported = VDP_TRUE;
+      break;
+#endif
       
       case VDP_DECODER_PROFILE_DIVX3_HOME_THEATER:
       case VDP_DECODER_PROFILE_DIVX3_QMOBILE:
@@ -260,6 +422,22 @@ VdpStatus vdp_decoder_query_capabilities(VdpDevice device, VdpDecoderProfile pro
            *is_supported = VDP_FALSE;
         break;
 
+    case VDP_DECODER_PROFILE_SUNXI_MJPEG:
+        *max_width = 8192;
+        *max_height = 8192;
+        *max_macroblocks = (*max_width * *max_height) / (16 * 16);
+        *is_supported = VDP_TRUE;
+        break;
+
+#if USE_VP8
+    case VDP_DECODER_PROFILE_SUNXI_VP8:
+        *max_width = 2048;
+        *max_height = 2048;
+        *max_macroblocks = (*max_width * *max_height) / (16 * 16);
+        *is_supported = VDP_TRUE;
+        break;
+#endif
+
     default:
         *is_supported = VDP_FALSE;
         break;
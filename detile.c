@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * MB32 detiling and chroma shuffling kernels. Every set handles full
+ * 32 byte chunks itself and leaves the tail of a row to the C kernels,
+ * so all of them give the same bytes. The set is picked once from the
+ * cpu features.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "detile.h"
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#define HAVE_NEON 1
+#include <arm_neon.h>
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+#if defined(__i386__) || defined(__x86_64__)
+#define HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+static void copy_c(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+	memcpy(dst, src, n);
+}
+
+static void split_c(uint8_t *a, uint8_t *b, const uint8_t *src, uint32_t n)
+{
+	uint32_t i;
+	for (i = 0; i < n / 2; i++)
+	{
+		a[i] = src[2 * i];
+		b[i] = src[2 * i + 1];
+	}
+}
+
+static void swap_c(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+	uint32_t i;
+	for (i = 0; i < n / 2; i++)
+	{
+		dst[2 * i] = src[2 * i + 1];
+		dst[2 * i + 1] = src[2 * i];
+	}
+}
+
+static void pack_c(uint8_t *dst, const uint8_t *y, const uint8_t *uv, uint32_t n, int uyvy)
+{
+	const uint8_t *first = uyvy ? uv : y;
+	const uint8_t *second = uyvy ? y : uv;
+	uint32_t i;
+	for (i = 0; i < n; i++)
+	{
+		dst[2 * i] = first[i];
+		dst[2 * i + 1] = second[i];
+	}
+}
+
+static const detile_kernels_t kernels_c =
+{
+	.name = "c",
+	.copy = copy_c,
+	.split = split_c,
+	.swap = swap_c,
+	.pack = pack_c,
+};
+
+#ifdef HAVE_NEON
+static void copy_neon(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+	if (n != 32)
+	{
+		copy_c(dst, src, n);
+		return;
+	}
+
+	uint8x16_t a = vld1q_u8(src), b = vld1q_u8(src + 16);
+	vst1q_u8(dst, a);
+	vst1q_u8(dst + 16, b);
+}
+
+static void split_neon(uint8_t *a, uint8_t *b, const uint8_t *src, uint32_t n)
+{
+	if (n != 32)
+	{
+		split_c(a, b, src, n);
+		return;
+	}
+
+	uint8x16x2_t v = vld2q_u8(src);
+	vst1q_u8(a, v.val[0]);
+	vst1q_u8(b, v.val[1]);
+}
+
+static void swap_neon(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+	if (n != 32)
+	{
+		swap_c(dst, src, n);
+		return;
+	}
+
+	vst1q_u8(dst, vrev16q_u8(vld1q_u8(src)));
+	vst1q_u8(dst + 16, vrev16q_u8(vld1q_u8(src + 16)));
+}
+
+static void pack_neon(uint8_t *dst, const uint8_t *y, const uint8_t *uv, uint32_t n, int uyvy)
+{
+	if (n != 32)
+	{
+		pack_c(dst, y, uv, n, uyvy);
+		return;
+	}
+
+	const uint8_t *first = uyvy ? uv : y;
+	const uint8_t *second = uyvy ? y : uv;
+	uint8x16x2_t lo = { { vld1q_u8(first), vld1q_u8(second) } };
+	uint8x16x2_t hi = { { vld1q_u8(first + 16), vld1q_u8(second + 16) } };
+	vst2q_u8(dst, lo);
+	vst2q_u8(dst + 32, hi);
+}
+
+static const detile_kernels_t kernels_neon =
+{
+	.name = "neon",
+	.copy = copy_neon,
+	.split = split_neon,
+	.swap = swap_neon,
+	.pack = pack_neon,
+};
+
+static int have_neon(void)
+{
+#if defined(__aarch64__)
+	return 1;
+#elif defined(HWCAP_NEON)
+	return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#else
+	// built for neon, trust the compiler flags
+	return 1;
+#endif
+}
+#endif
+
+#ifdef HAVE_X86
+__attribute__((target("sse2")))
+static void copy_sse2(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+	if (n != 32)
+	{
+		copy_c(dst, src, n);
+		return;
+	}
+
+	__m128i a = _mm_loadu_si128((const __m128i *)src);
+	__m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+	_mm_storeu_si128((__m128i *)dst, a);
+	_mm_storeu_si128((__m128i *)(dst + 16), b);
+}
+
+__attribute__((target("sse2")))
+static void split_sse2(uint8_t *a, uint8_t *b, const uint8_t *src, uint32_t n)
+{
+	if (n != 32)
+	{
+		split_c(a, b, src, n);
+		return;
+	}
+
+	__m128i lo = _mm_loadu_si128((const __m128i *)src);
+	__m128i hi = _mm_loadu_si128((const __m128i *)(src + 16));
+	__m128i mask = _mm_set1_epi16(0x00ff);
+	_mm_storeu_si128((__m128i *)a, _mm_packus_epi16(_mm_and_si128(lo, mask), _mm_and_si128(hi, mask)));
+	_mm_storeu_si128((__m128i *)b, _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+}
+
+__attribute__((target("sse2")))
+static void swap_sse2(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+	if (n != 32)
+	{
+		swap_c(dst, src, n);
+		return;
+	}
+
+	__m128i lo = _mm_loadu_si128((const __m128i *)src);
+	__m128i hi = _mm_loadu_si128((const __m128i *)(src + 16));
+	_mm_storeu_si128((__m128i *)dst, _mm_or_si128(_mm_slli_epi16(lo, 8), _mm_srli_epi16(lo, 8)));
+	_mm_storeu_si128((__m128i *)(dst + 16), _mm_or_si128(_mm_slli_epi16(hi, 8), _mm_srli_epi16(hi, 8)));
+}
+
+__attribute__((target("sse2")))
+static void pack_sse2(uint8_t *dst, const uint8_t *y, const uint8_t *uv, uint32_t n, int uyvy)
+{
+	if (n != 32)
+	{
+		pack_c(dst, y, uv, n, uyvy);
+		return;
+	}
+
+	const uint8_t *first = uyvy ? uv : y;
+	const uint8_t *second = uyvy ? y : uv;
+	int i;
+	for (i = 0; i < 32; i += 16)
+	{
+		__m128i f = _mm_loadu_si128((const __m128i *)(first + i));
+		__m128i s = _mm_loadu_si128((const __m128i *)(second + i));
+		_mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(f, s));
+		_mm_storeu_si128((__m128i *)(dst + 2 * i + 16), _mm_unpackhi_epi8(f, s));
+	}
+}
+
+static const detile_kernels_t kernels_sse2 =
+{
+	.name = "sse2",
+	.copy = copy_sse2,
+	.split = split_sse2,
+	.swap = swap_sse2,
+	.pack = pack_sse2,
+};
+
+// a tile line is one 256 bit register, the lane crossing shuffles don't pay off
+__attribute__((target("avx2")))
+static void copy_avx2(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+	if (n != 32)
+	{
+		copy_c(dst, src, n);
+		return;
+	}
+
+	_mm256_storeu_si256((__m256i *)dst, _mm256_loadu_si256((const __m256i *)src));
+}
+
+__attribute__((target("avx2")))
+static void swap_avx2(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+	if (n != 32)
+	{
+		swap_c(dst, src, n);
+		return;
+	}
+
+	__m256i v = _mm256_loadu_si256((const __m256i *)src);
+	_mm256_storeu_si256((__m256i *)dst, _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8)));
+}
+
+static const detile_kernels_t kernels_avx2 =
+{
+	.name = "avx2",
+	.copy = copy_avx2,
+	.split = split_sse2,
+	.swap = swap_avx2,
+	.pack = pack_sse2,
+};
+#endif
+
+static const detile_kernels_t *available[5];
+static const detile_kernels_t *selected;
+static pthread_once_t detected = PTHREAD_ONCE_INIT;
+
+static void detect(void)
+{
+	int count = 0;
+
+#ifdef HAVE_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		available[count++] = &kernels_avx2;
+	if (__builtin_cpu_supports("sse2"))
+		available[count++] = &kernels_sse2;
+#endif
+#ifdef HAVE_NEON
+	if (have_neon())
+		available[count++] = &kernels_neon;
+#endif
+	available[count] = &kernels_c;
+
+	const detile_kernels_t *choice = available[0];
+	char *env_simd = getenv("VDPAU_SIMD");
+	int i;
+	for (i = 0; env_simd && available[i]; i++)
+		if (strcmp(env_simd, available[i]->name) == 0)
+			choice = available[i];
+
+	selected = choice;
+}
+
+const detile_kernels_t *detile_kernels(void)
+{
+	pthread_once(&detected, detect);
+	return selected;
+}
+
+const detile_kernels_t *const *detile_kernels_available(void)
+{
+	pthread_once(&detected, detect);
+	return available;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __DETILE_H__
+#define __DETILE_H__
+
+#include <stdint.h>
+
+/*
+ * Kernels for one line of an MB32 tile or 32 bytes of a linear row,
+ * n is the number of source bytes and at most 32.
+ */
+typedef struct
+{
+	const char *name;
+	void (*copy)(uint8_t *dst, const uint8_t *src, uint32_t n);
+	// even bytes to a, odd bytes to b
+	void (*split)(uint8_t *a, uint8_t *b, const uint8_t *src, uint32_t n);
+	// swaps the bytes of each pair, UV to VU
+	void (*swap)(uint8_t *dst, const uint8_t *src, uint32_t n);
+	// n luma and n chroma bytes to 2n bytes of YUYV or UYVY
+	void (*pack)(uint8_t *dst, const uint8_t *y, const uint8_t *uv, uint32_t n, int uyvy);
+} detile_kernels_t;
+
+// the best kernels for this cpu, VDPAU_SIMD=<name> picks another one
+const detile_kernels_t *detile_kernels(void);
+
+// all kernels this cpu can run, terminated by NULL
+const detile_kernels_t *const *detile_kernels_available(void);
+
+static inline const uint8_t *detile_line(const uint8_t *src, uint32_t tiles, uint32_t y, uint32_t x)
+{
+	return src + ((y / 32) * tiles + x / 32) * 1024 + (y % 32) * 32;
+}
+
+#endif
@@ -19,14 +19,16 @@
 
 #include "vdpau_private.h"
 #include "ve.h"
+#include "timeline.h"
 #include <vdpau/vdpau_x11.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <unistd.h>
 
-VdpStatus vdp_imp_device_create_x11(Display *display, int screen, VdpDevice *device, VdpGetProcAddress **get_proc_address)
+static VdpStatus device_create(int screen, int headless, VdpDevice *device, VdpGetProcAddress **get_proc_address)
 {
 	if (!device || !get_proc_address) {
 		VDPAU_DBG_ONCE("device=NULL || get_proc_address");
@@ -39,37 +41,64 @@ VdpStatus vdp_imp_device_create_x11(Display *display, int screen, VdpDevice *dev
 
 	//dev->display = XOpenDisplay(XDisplayString(display));
 	dev->screen = screen;
+	pthread_mutex_init(&dev->mutex, NULL);
         dev->fb_id = 0;
+	dev->fb_fd = -1;
 
 	if (!cedarv_open())
 	{
 		VDPAU_DBG_ONCE("cedarv_open failed");
+		pthread_mutex_destroy(&dev->mutex);
 		handle_destroy(*device);
 		return VDP_STATUS_ERROR;
 	}
 
+	dev->g2d_fd = -1;
+	dev->pip_layers = OUTPUT_PIP_MAX;
 	char *env_vdpau_osd = getenv("VDPAU_OSD");
 	if (env_vdpau_osd && strncmp(env_vdpau_osd, "1", 1) == 0)
 	{
+		dev->osd_enabled = 1;
 		dev->g2d_fd = open("/dev/g2d", O_RDWR);
 		if (dev->g2d_fd != -1)
-			dev->osd_enabled = 1;
+			dev->rgba_engine = &rgba_engine_g2d;
 		else
-			VDPAU_DBG("Failed to open /dev/g2d! OSD disabled.");
+		{
+			VDPAU_DBG("Failed to open /dev/g2d! OSD rendered by the CPU.");
+			dev->rgba_engine = &rgba_engine_sw;
+		}
 	}
 
-        VDPAU_DBG("VE version 0x%04x opened", cedarv_get_version());
+        VDPAU_DBG("VE version 0x%04x opened%s", cedarv_get_version(), headless ? " headless" : "");
 	*get_proc_address = &vdp_get_proc_address;
         
 	return VDP_STATUS_OK;
 }
 
+VdpStatus vdp_imp_device_create_x11(Display *display, int screen, VdpDevice *device, VdpGetProcAddress **get_proc_address)
+{
+	return device_create(screen, 0, device, get_proc_address);
+}
+
+// only the VE is opened, /dev/disp and /dev/fb0 wait for a presentation queue target
+VdpStatus vdp_imp_device_create_sunxi(VdpDevice *device, VdpGetProcAddress **get_proc_address)
+{
+	return device_create(0, 1, device, get_proc_address);
+}
+
 VdpStatus vdp_device_destroy(VdpDevice device)
 {
 	device_ctx_t *dev = handle_get(device);
 	if (!dev)
 		return VDP_STATUS_INVALID_HANDLE;
 
+	if (dev->g2d_fd != -1)
+		close(dev->g2d_fd);
+	if (dev->fb_fd != -1)
+		close(dev->fb_fd);
+	completion_free(dev);
+	readback_free(dev);
+	pthread_mutex_destroy(&dev->mutex);
 	cedarv_close();
 	//XCloseDisplay(dev->display);
 
@@ -79,6 +108,20 @@ VdpStatus vdp_device_destroy(VdpDevice device)
 	return VDP_STATUS_OK;
 }
 
+VdpStatus vdp_device_timeline_flush_sunxi(VdpDevice device)
+{
+	device_ctx_t *dev = handle_get(device);
+	if (!dev)
+		return VDP_STATUS_INVALID_HANDLE;
+
+	VdpStatus status = VDP_STATUS_OK;
+	if (timeline_enabled && !timeline_flush())
+		status = VDP_STATUS_ERROR;
+
+	handle_release(device);
+	return status;
+}
+
 VdpStatus vdp_preemption_callback_register(VdpDevice device, VdpPreemptionCallback callback, void *context)
 {
 	if (!callback)
@@ -185,6 +228,66 @@ VdpStatus vdp_get_proc_address(VdpDevice device_handle, VdpFuncId function_id, v
 
 		status = VDP_STATUS_OK;
 	}
+	else if (function_id == VDP_FUNC_ID_VIDEO_SURFACE_ATTACH_SCALED_SUNXI)
+	{
+		*function_pointer = &vdp_video_surface_attach_scaled_sunxi;
+
+		status = VDP_STATUS_OK;
+	}
+	else if (function_id == VDP_FUNC_ID_VIDEO_SURFACE_SET_ROTATION_SUNXI)
+	{
+		*function_pointer = &vdp_video_surface_set_rotation_sunxi;
+
+		status = VDP_STATUS_OK;
+	}
+	else if (function_id == VDP_FUNC_ID_VIDEO_SURFACE_EXPORT_SUNXI)
+	{
+		*function_pointer = &vdp_video_surface_export_sunxi;
+
+		status = VDP_STATUS_OK;
+	}
+	else if (function_id == VDP_FUNC_ID_VIDEO_SURFACE_EXPORT_RELEASE_SUNXI)
+	{
+		*function_pointer = &vdp_video_surface_export_release_sunxi;
+
+		status = VDP_STATUS_OK;
+	}
+	else if (function_id == VDP_FUNC_ID_DECODER_RENDER_ASYNC_SUNXI)
+	{
+		*function_pointer = &vdp_decoder_render_async_sunxi;
+
+		status = VDP_STATUS_OK;
+	}
+	else if (function_id == VDP_FUNC_ID_DEVICE_COMPLETION_FD_SUNXI)
+	{
+		*function_pointer = &vdp_device_completion_fd_sunxi;
+
+		status = VDP_STATUS_OK;
+	}
+	else if (function_id == VDP_FUNC_ID_DEVICE_COLLECT_COMPLETIONS_SUNXI)
+	{
+		*function_pointer = &vdp_device_collect_completions_sunxi;
+
+		status = VDP_STATUS_OK;
+	}
+	else if (function_id == VDP_FUNC_ID_DECODER_FLUSH_SUNXI)
+	{
+		*function_pointer = &vdp_decoder_flush_sunxi;
+
+		status = VDP_STATUS_OK;
+	}
+	else if (function_id == VDP_FUNC_ID_DECODER_RECONFIGURE_SUNXI)
+	{
+		*function_pointer = &vdp_decoder_reconfigure_sunxi;
+
+		status = VDP_STATUS_OK;
+	}
+	else if (function_id == VDP_FUNC_ID_DEVICE_TIMELINE_FLUSH_SUNXI)
+	{
+		*function_pointer = &vdp_device_timeline_flush_sunxi;
+
+		status = VDP_STATUS_OK;
+	}
         else
            status = VDP_STATUS_INVALID_FUNC_ID;
 
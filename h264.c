@@ -22,6 +22,7 @@
 #include <unistd.h>
 #include "vdpau_private.h"
 #include "ve.h"
+#include "timeline.h"
 #include <time.h>
 #include <stdio.h>
 
@@ -54,9 +55,13 @@ static uint32_t getVlcData(uint32_t triggerValue, void* regs)
 {
   volatile uint32_t status;
   char done = 0;
-  uint32_t value;
+  uint32_t value = 0;
   uint32_t round = 0;
   
+  // the rest of the frame is skipped once the engine was reset
+  if (cedarv_job_hung())
+    return 0;
+
   writel(triggerValue, regs + CEDARV_H264_TRIGGER);
   while (! done && round++ < 1000000)
   {
@@ -76,6 +81,9 @@ static uint32_t getVlcData(uint32_t triggerValue, void* regs)
     }
   };
 
+  if (!done)
+    cedarv_hang("getVlcData");
+
   return value;
 }
 
@@ -199,6 +207,19 @@ static void h264_private_free(decoder_ctx_t *decoder)
 	free(decoder_p);
 }
 
+static int h264_private_fits(decoder_ctx_t *decoder, uint32_t width, uint32_t height)
+{
+	h264_private_t *decoder_p = (h264_private_t *)decoder->private;
+
+	// only the deblocking and intra prediction buffers depend on the size
+	if (cedarv_get_version() != 0x1625 && width < 2048)
+		return 1;
+
+	return cedarv_isValid(decoder_p->deBlkDramBuf) &&
+		cedarv_getSize(decoder_p->deBlkDramBuf) >= ((width + 15) / 16 + 31) * 16 * 12 &&
+		cedarv_getSize(decoder_p->intraPredDramBuf) >= ((width + 15) / 16 + 63) * 16 * 5;
+}
+
 #define PIC_TYPE_FRAME	0x0
 #define PIC_TYPE_FIELD	0x1
 #define PIC_TYPE_MBAFF	0x2
@@ -690,7 +711,7 @@ static void fill_frame_lists(h264_context_t *c)
 
 					surface_p->extra_data_len = (c->picture_width_in_mbs_minus1 + 1) * 
 									(c->picture_height_in_mbs_minus1 + 1) * 32;
-					surface_p->extra_data = cedarv_malloc(surface_p->extra_data_len);
+					surface_p->extra_data = cedarv_malloc_type(surface_p->extra_data_len, CEDARV_MEM_MV);
 					surface_p->pos = 0;
 
 					surface->decoder_private = surface_p;
@@ -790,6 +811,8 @@ static VdpStatus h264_decode(decoder_ctx_t *decoder, VdpPictureInfo const *_info
         output->source_format = INTERNAL_YCBCR_FORMAT;
     
 	h264_context_t *c = calloc(1, sizeof(h264_context_t));
+	if (!c)
+		return VDP_STATUS_RESOURCES;
 	c->picture_width_in_mbs_minus1 = (decoder->width - 1) / 16;
 	if (!info->frame_mbs_only_flag)
 		c->picture_height_in_mbs_minus1 = ((decoder->height / 2) - 1) / 16;
@@ -798,23 +821,51 @@ static VdpStatus h264_decode(decoder_ctx_t *decoder, VdpPictureInfo const *_info
 	c->info = info;
 	c->output = output;
 
+    int MvColBufSize = (c->picture_height_in_mbs_minus1 + 1)*(2 - c->info->frame_mbs_only_flag);
+    MvColBufSize = (MvColBufSize+1)/2;
+    int extra_data_len = (c->picture_width_in_mbs_minus1 + 1) * MvColBufSize * 32 * 2;
+
 	if (!c->output->decoder_private)
 	{
 		output_p = calloc(1, sizeof(h264_video_private_t));
 		if (!output_p)
+		{
+			free(c);
 			return VDP_STATUS_RESOURCES;
+		}
 
 		// create extra buffer
-        int MvColBufSize = (c->picture_height_in_mbs_minus1 + 1)*(2 - c->info->frame_mbs_only_flag);
-        MvColBufSize = (MvColBufSize+1)/2;
-        output_p->extra_data_len = (c->picture_width_in_mbs_minus1 + 1) * MvColBufSize * 32 * 2;
-		output_p->extra_data = cedarv_malloc(output_p->extra_data_len);
+        output_p->extra_data_len = extra_data_len;
+		output_p->extra_data = cedarv_malloc_type(output_p->extra_data_len, CEDARV_MEM_MV);
+		if (!cedarv_isValid(output_p->extra_data))
+		{
+			free(output_p);
+			free(c);
+			return VDP_STATUS_RESOURCES;
+		}
         
         c->output->decoder_private = output_p;
         c->output->decoder_private_free = h264_video_private_free;
 	}
 	else
+	{
 		output_p = c->output->decoder_private;
+		// the decoder may have been reconfigured to a bigger size since
+		if (output_p->extra_data_len < extra_data_len)
+		{
+			cedarv_free(output_p->extra_data);
+			output_p->extra_data_len = extra_data_len;
+			output_p->extra_data = cedarv_malloc_type(output_p->extra_data_len, CEDARV_MEM_MV);
+			if (!cedarv_isValid(output_p->extra_data))
+			{
+				c->output->decoder_private = NULL;
+				c->output->decoder_private_free = NULL;
+				free(output_p);
+				free(c);
+				return VDP_STATUS_RESOURCES;
+			}
+		}
+	}
 
     if (info->field_pic_flag)
       output_p->pic_type = PIC_TYPE_FIELD;
@@ -858,21 +909,45 @@ static VdpStatus h264_decode(decoder_ctx_t *decoder, VdpPictureInfo const *_info
 			writel(sl4[i], cedarv_regs + CEDARV_H264_RAM_WRITE_DATA);
 	}
 
-	// sdctrl
-	writel(0x00000000, cedarv_regs + CEDARV_H264_SDROT_CTRL);
+	// sdctrl, optional scaled or else rotated copy of the frame
+	int scale_ratio;
+	video_surface_ctx_t *scaled = video_surface_get_scaled(output, &scale_ratio);
+	int rotate = !scaled && output->rotation != VDP_SUNXI_ROTATION_NONE;
+	if (scaled)
+	{
+		if (output->rotation != VDP_SUNXI_ROTATION_NONE)
+			VDPAU_DBG_ONCE("scaled surface attached, not rotating");
+		writel(SDROT_CTRL_HORIZ_SCALE(scale_ratio) | SDROT_CTRL_VERT_SCALE(scale_ratio) | SDROT_CTRL_SCALE_EN, cedarv_regs + CEDARV_H264_SDROT_CTRL);
+		writel(cedarv_virt2phys(scaled->dataY), cedarv_regs + CEDARV_H264_SDROT_LUMA);
+		writel(cedarv_virt2phys(scaled->dataU), cedarv_regs + CEDARV_H264_SDROT_CHROMA);
+		scaled->source_format = INTERNAL_YCBCR_FORMAT;
+	}
+	else if (rotate)
+	{
+		writel(SDROT_CTRL_ROTATE(output->rotation), cedarv_regs + CEDARV_H264_SDROT_CTRL);
+		writel(cedarv_virt2phys(output->rotY), cedarv_regs + CEDARV_H264_SDROT_LUMA);
+		writel(cedarv_virt2phys(output->rotU), cedarv_regs + CEDARV_H264_SDROT_CHROMA);
+	}
+	else
+		writel(0x00000000, cedarv_regs + CEDARV_H264_SDROT_CTRL);
+	output->rotated = 0;
     if (cedarv_get_version() >= 0x1680)
 	{
-		writel(OUTPUT_FORMAT_NV12, cedarv_regs + CEDARV_OUTPUT_FORMAT);
+		writel(OUTPUT_FORMAT_NV12 | ((scaled || rotate) ? EXTRA_OUTPUT_FORMAT_NV12 : 0), cedarv_regs + CEDARV_OUTPUT_FORMAT);
 		output->source_format = VDP_YCBCR_FORMAT_NV12;
+		if (scaled)
+		{
+			writel((0x1 << 30) | (0x1 << 28), cedarv_regs + CEDARV_EXTRA_OUT_FMT_OFFSET);
+			writel((ALIGN(scaled->width, 16) / 2 << 16) | ALIGN(scaled->width, 32), cedarv_regs + CEDARV_EXTRA_OUT_STRIDE);
+			scaled->source_format = VDP_YCBCR_FORMAT_NV12;
+		}
+		else if (rotate)
+		{
+			uint32_t rot_width = video_surface_rotated_width(output);
+			writel((0x1 << 30) | (0x1 << 28), cedarv_regs + CEDARV_EXTRA_OUT_FMT_OFFSET);
+			writel((ALIGN(rot_width, 16) / 2 << 16) | ALIGN(rot_width, 32), cedarv_regs + CEDARV_EXTRA_OUT_STRIDE);
+		}
 	}
-/*
-        if (cedarv_get_version() >= 0x1680)
-        {
-                writel(cedarv_virt2phys(c->output->dataY), c->regs + CEDARV_H264_SDROT_LUMA);
-                writel(cedarv_virt2phys(c->output->dataU), c->regs + CEDARV_H264_SDROT_CHROMA);
-                writel((0x2 << 30) | (0x1 << 28) | (cedarv_getSize(c->output->dataU) / 2), c->regs + CEDARV_EXTRA_OUT_FMT_OFFSET);
-        }
-*/
 
 	fill_frame_lists(c);
     
@@ -893,6 +968,8 @@ static VdpStatus h264_decode(decoder_ctx_t *decoder, VdpPictureInfo const *_info
 		{
 			free(c);
 			cedarv_put();
+			if (scaled)
+				handle_release(output->scaled);
 			return VDP_STATUS_ERROR;
 		}
 
@@ -910,7 +987,9 @@ static VdpStatus h264_decode(decoder_ctx_t *decoder, VdpPictureInfo const *_info
 
 		int i;
 
+		TIMELINE_BEGIN("h264_slice_header");
 		decode_slice_header(c);
+		TIMELINE_END("h264_slice_header");
 
 #if 1 
 		// write RefPicLists
@@ -1021,11 +1100,14 @@ uint64_t tv, tv2;
 			printf("cedarv_wait, longer than 20ms:%lld, pics=%ld, longs=%ld\n", tv2-tv, num_pics, ++num_longs);
 		}
 #endif
+		// the engine was reset, the rest of the slices are skipped
+		if (cedarv_job_hung())
+			break;
 
 		// clear status flags
         unsigned long status = readl(cedarv_regs + CEDARV_H264_STATUS);
         if(status & 0x2)
-          printf("h264 status=0x%X\n", status);
+          log_warning("h264 status=0x%lX", status);
 		writel(status, cedarv_regs + CEDARV_H264_STATUS);
         int error = readl(cedarv_regs + CEDARV_H264_ERROR);
         //if(error)
@@ -1041,6 +1123,12 @@ uint64_t tv, tv2;
         cedarv_put();
 #endif
         c->output->frame_decoded = 1;
+	c->output->rotated = rotate;
+	if (scaled)
+	{
+		scaled->frame_decoded = 1;
+		handle_release(output->scaled);
+	}
 	free(c);
 	return VDP_STATUS_OK;
 }
@@ -1055,7 +1143,7 @@ VdpStatus new_decoder_h264(decoder_ctx_t *decoder)
 	if (cedarv_get_version() == 0x1625 || decoder->width >= 2048)
 	{
       size_t len = ((decoder->width + 15) / 16 + 31) * 16 * 12;
-      decoder_p->deBlkDramBuf = cedarv_malloc(len);
+      decoder_p->deBlkDramBuf = cedarv_malloc_type(len, CEDARV_MEM_SCRATCH);
       if(! cedarv_isValid(decoder_p->deBlkDramBuf))
       {
         free(decoder_p);
@@ -1065,7 +1153,7 @@ VdpStatus new_decoder_h264(decoder_ctx_t *decoder)
       cedarv_flush_cache(decoder_p->deBlkDramBuf, len);
 
       len = ((decoder->width + 15) / 16 + 63) * 16 * 5;
-      decoder_p->intraPredDramBuf = cedarv_malloc(len);
+      decoder_p->intraPredDramBuf = cedarv_malloc_type(len, CEDARV_MEM_SCRATCH);
       if(! cedarv_isValid(decoder_p->intraPredDramBuf))
       {
         cedarv_free(decoder_p->deBlkDramBuf);
@@ -1076,13 +1164,13 @@ VdpStatus new_decoder_h264(decoder_ctx_t *decoder)
       cedarv_flush_cache(decoder_p->intraPredDramBuf, len);
 	}
 
-	decoder_p->extra_data = cedarv_malloc(extra_data_size);
+	decoder_p->extra_data = cedarv_malloc_type(extra_data_size, CEDARV_MEM_SCRATCH);
 	if (! cedarv_isValid(decoder_p->extra_data))
 	{
 		free(decoder_p);
 		return VDP_STATUS_RESOURCES;
 	}
-    decoder_p->mbFieldIntraBuf = cedarv_malloc(FIELDINTRABUFSIZE);
+    decoder_p->mbFieldIntraBuf = cedarv_malloc_type(FIELDINTRABUFSIZE, CEDARV_MEM_SCRATCH);
     if(! cedarv_isValid(decoder_p->mbFieldIntraBuf))
     {
       if(cedarv_isValid(decoder_p->deBlkDramBuf))
@@ -1097,7 +1185,7 @@ VdpStatus new_decoder_h264(decoder_ctx_t *decoder)
     cedarv_memset(decoder_p->mbFieldIntraBuf, 0, FIELDINTRABUFSIZE);
     cedarv_flush_cache(decoder_p->mbFieldIntraBuf, FIELDINTRABUFSIZE);
         
-    decoder_p->mbNeighborInfoBuf = cedarv_malloc(NEIGHBORINFOBUFSIZE);
+    decoder_p->mbNeighborInfoBuf = cedarv_malloc_type(NEIGHBORINFOBUFSIZE, CEDARV_MEM_SCRATCH);
     if(! cedarv_isValid(decoder_p->mbNeighborInfoBuf))
     {
       if(cedarv_isValid(decoder_p->deBlkDramBuf))
@@ -1115,5 +1203,6 @@ VdpStatus new_decoder_h264(decoder_ctx_t *decoder)
 	decoder->decode = h264_decode;
 	decoder->private = decoder_p;
 	decoder->private_free = h264_private_free;
+	decoder->private_fits = h264_private_fits;
 	return VDP_STATUS_OK;
 }
@@ -21,6 +21,7 @@
 #include <string.h>
 #include <unistd.h>
 #include "vdpau_private.h"
+#include "timeline.h"
 #include <stdio.h>
 
 #define TIME_MEAS 0
@@ -188,7 +189,7 @@ static struct h265_video_private *get_surface_priv(struct h265_private *p, video
 		if (!vp)
 			return NULL;
 
-		vp->extra_data = cedarv_malloc(PicSizeInCtbsY * 160);
+		vp->extra_data = cedarv_malloc_type(PicSizeInCtbsY * 160, CEDARV_MEM_MV);
 		if (!cedarv_isValid(vp->extra_data))
 		{
 			free(vp);
@@ -198,6 +199,19 @@ static struct h265_video_private *get_surface_priv(struct h265_private *p, video
 		surface->decoder_private = vp;
 		surface->decoder_private_free = h265_video_private_free;
 	}
+	else if (cedarv_getSize(vp->extra_data) < PicSizeInCtbsY * 160)
+	{
+		// the decoder was reconfigured to a bigger size since
+		cedarv_free(vp->extra_data);
+		vp->extra_data = cedarv_malloc_type(PicSizeInCtbsY * 160, CEDARV_MEM_MV);
+		if (!cedarv_isValid(vp->extra_data))
+		{
+			surface->decoder_private = NULL;
+			surface->decoder_private_free = NULL;
+			free(vp);
+			return NULL;
+		}
+	}
 
 	return vp;
 }
@@ -747,7 +761,9 @@ static VdpStatus h265_decode(decoder_ctx_t *decoder,
 		get_u(p->regs, 6);
 		get_u(p->regs, 3);
 
+		TIMELINE_BEGIN("h265_slice_header");
 		slice_header(p);
+		TIMELINE_END("h265_slice_header");
 
 		writel(0x40 | p->nal_unit_type, p->regs + CEDARV_HEVC_NAL_HDR);
 
@@ -858,6 +874,9 @@ uint64_t tv, tv2;
                         printf("cedarv_wait, longer than 20ms:%lld\n", tv2-tv);
                 }
 #endif
+		// the engine was reset, the rest of the slices are skipped
+		if (cedarv_job_hung())
+			break;
 
 		uint32_t status = readl(p->regs + CEDARV_HEVC_STATUS);
 		writel(status & 0x7, p->regs + CEDARV_HEVC_STATUS);
@@ -878,18 +897,25 @@ static void h265_private_free(decoder_ctx_t *decoder)
 	free(p);
 }
 
+// the neighbour info and entry point buffers are made for the largest pictures
+static int h265_private_fits(decoder_ctx_t *decoder, uint32_t width, uint32_t height)
+{
+	return 1;
+}
+
 VdpStatus new_decoder_h265(decoder_ctx_t *decoder)
 {
 	struct h265_private *p = calloc(1, sizeof(*p));
 	if (!p)
 		return VDP_STATUS_RESOURCES;
 
-	p->neighbor_info = cedarv_malloc(397 * 1024);
-	p->entry_points = cedarv_malloc(4 * 1024);
+	p->neighbor_info = cedarv_malloc_type(397 * 1024, CEDARV_MEM_SCRATCH);
+	p->entry_points = cedarv_malloc_type(4 * 1024, CEDARV_MEM_SCRATCH);
 
 	decoder->decode = h265_decode;
 	decoder->private = p;
 	decoder->private_free = h265_private_free;
+	decoder->private_fits = h265_private_fits;
 
 	return VDP_STATUS_OK;
 }
@@ -124,7 +124,7 @@ void handle_destroy(VdpHandle handle)
 	}
     else
     {
-        printf("wrong handle %X\n", handle);
+        log_error("wrong handle %X", handle);
     }
 	pthread_rwlock_unlock(&ht.lock);
 }
@@ -0,0 +1,486 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "vdpau_private.h"
+#include "ve.h"
+
+/*
+ * Baseline JPEG / MJPEG decoding on the MPEG engine.
+ * Markers are parsed in software, the entropy coded scan data is
+ * decoded by the VE. Every bitstream passed to vdp_decoder_render()
+ * has to contain one complete picture starting with SOI, the
+ * VdpPictureInfo pointer is not used.
+ */
+
+#define M_SOF0	0xc0
+#define M_SOF1	0xc1
+#define M_SOF2	0xc2
+#define M_SOF3	0xc3
+#define M_DHT	0xc4
+#define M_SOF5	0xc5
+#define M_SOF15	0xcf
+#define M_RST0	0xd0
+#define M_RST7	0xd7
+#define M_SOI	0xd8
+#define M_EOI	0xd9
+#define M_SOS	0xda
+#define M_DQT	0xdb
+#define M_DRI	0xdd
+#define M_TEM	0x01
+
+struct jpeg_huffman_table
+{
+	uint8_t num[16];
+	uint8_t codes[256];
+};
+
+typedef struct
+{
+	uint16_t width;
+	uint16_t height;
+	uint16_t restart_interval;
+	struct
+	{
+		uint8_t samp_h;
+		uint8_t samp_v;
+		uint8_t qt;
+	} comp[3];
+	int num_comp;
+	uint8_t quant[4][64];
+	/* DC0, DC1, AC0, AC1 */
+	struct jpeg_huffman_table huffman[4];
+	int data_offset;
+} jpeg_private_t;
+
+/* default tables from ITU-T T.81 Annex K, used by most MJPEG sources */
+static const uint8_t bits_dc_luminance[16] =
+	{ 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t bits_dc_chrominance[16] =
+	{ 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const uint8_t val_dc[12] =
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t bits_ac_luminance[16] =
+	{ 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+static const uint8_t val_ac_luminance[162] =
+{
+	0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12,
+	0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+	0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+	0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+	0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16,
+	0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39,
+	0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+	0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+	0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+	0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79,
+	0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+	0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98,
+	0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+	0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+	0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+	0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4,
+	0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+	0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea,
+	0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+	0xf9, 0xfa
+};
+
+static const uint8_t bits_ac_chrominance[16] =
+	{ 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const uint8_t val_ac_chrominance[162] =
+{
+	0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21,
+	0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+	0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+	0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+	0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34,
+	0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+	0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38,
+	0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+	0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+	0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+	0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78,
+	0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+	0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96,
+	0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+	0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+	0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+	0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2,
+	0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+	0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9,
+	0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+	0xf9, 0xfa
+};
+
+static void set_default_huffman(struct jpeg_huffman_table *t, const uint8_t *bits, const uint8_t *val, int len)
+{
+	memset(t, 0, sizeof(*t));
+	memcpy(t->num, bits, 16);
+	memcpy(t->codes, val, len);
+}
+
+static int read_sof(jpeg_private_t *jpeg, const uint8_t *data, int len)
+{
+	int i;
+
+	if (len < 6 || data[0] != 8)
+		return 0;
+
+	jpeg->height = data[1] << 8 | data[2];
+	jpeg->width = data[3] << 8 | data[4];
+	jpeg->num_comp = data[5];
+
+	if (jpeg->width == 0 || jpeg->height == 0)
+		return 0;
+
+	if (jpeg->num_comp != 3 || len < 6 + 3 * 3)
+		return 0;
+
+	for (i = 0; i < 3; i++)
+	{
+		jpeg->comp[i].samp_h = data[6 + i * 3 + 1] >> 4;
+		jpeg->comp[i].samp_v = data[6 + i * 3 + 1] & 0xf;
+		jpeg->comp[i].qt = data[6 + i * 3 + 2] & 0x3;
+	}
+
+	// the engine only subsamples chroma, by 2 at most
+	if (jpeg->comp[0].samp_h < 1 || jpeg->comp[0].samp_h > 2 ||
+	    jpeg->comp[0].samp_v < 1 || jpeg->comp[0].samp_v > 2)
+		return 0;
+
+	for (i = 1; i < 3; i++)
+		if (jpeg->comp[i].samp_h != 1 || jpeg->comp[i].samp_v != 1)
+			return 0;
+
+	return 1;
+}
+
+static int read_dht(jpeg_private_t *jpeg, const uint8_t *data, int len)
+{
+	int pos = 0;
+
+	while (pos + 17 <= len)
+	{
+		int id = data[pos];
+		int i, sum = 0;
+
+		if ((id & 0x0f) > 1 || (id >> 4) > 1)
+			return 0;
+
+		struct jpeg_huffman_table *t = &jpeg->huffman[((id & 0x10) >> 3) | (id & 0x1)];
+
+		for (i = 0; i < 16; i++)
+			sum += data[pos + 1 + i];
+
+		if (sum > 256 || pos + 17 + sum > len)
+			return 0;
+
+		memcpy(t->num, &data[pos + 1], 16);
+		memcpy(t->codes, &data[pos + 17], sum);
+		pos += 17 + sum;
+	}
+
+	return 1;
+}
+
+static int read_dqt(jpeg_private_t *jpeg, const uint8_t *data, int len)
+{
+	int pos = 0;
+
+	while (pos + 65 <= len)
+	{
+		int id = data[pos];
+
+		// 16 bit precision tables are not supported by the hardware
+		if ((id >> 4) != 0 || (id & 0xf) > 3)
+			return 0;
+
+		memcpy(jpeg->quant[id & 0x3], &data[pos + 1], 64);
+		pos += 65;
+	}
+
+	return 1;
+}
+
+static int parse_jpeg(jpeg_private_t *jpeg, const uint8_t *data, int len)
+{
+	int pos = 2;
+	int have_sof = 0;
+
+	if (len < 4 || data[0] != 0xff || data[1] != M_SOI)
+		return 0;
+
+	jpeg->restart_interval = 0;
+
+	while (pos + 4 <= len)
+	{
+		if (data[pos] != 0xff)
+			return 0;
+
+		uint8_t marker = data[pos + 1];
+		pos += 2;
+
+		// fill bytes
+		if (marker == 0xff)
+		{
+			pos--;
+			continue;
+		}
+
+		// markers without payload
+		if ((marker >= M_RST0 && marker <= M_RST7) || marker == M_SOI || marker == M_TEM)
+			continue;
+
+		if (marker == M_EOI)
+			return 0;
+
+		int seg_len = data[pos] << 8 | data[pos + 1];
+		if (seg_len < 2 || pos + seg_len > len)
+			return 0;
+
+		const uint8_t *seg = &data[pos + 2];
+		seg_len -= 2;
+
+		switch (marker)
+		{
+		case M_SOF0:
+		case M_SOF1:
+			if (!read_sof(jpeg, seg, seg_len))
+				return 0;
+			have_sof = 1;
+			break;
+
+		case M_SOF2:
+		case M_SOF3:
+			VDPAU_DBG("progressive and lossless JPEG not supported");
+			return 0;
+
+		case M_DHT:
+			if (!read_dht(jpeg, seg, seg_len))
+				return 0;
+			break;
+
+		case M_DQT:
+			if (!read_dqt(jpeg, seg, seg_len))
+				return 0;
+			break;
+
+		case M_DRI:
+			if (seg_len < 2)
+				return 0;
+			jpeg->restart_interval = seg[0] << 8 | seg[1];
+			break;
+
+		case M_SOS:
+			// only interleaved scans with all three components
+			if (!have_sof || seg_len < 1 || seg[0] != 3)
+				return 0;
+			jpeg->data_offset = pos + 2 + seg_len;
+			return 1;
+
+		default:
+			if (marker >= M_SOF5 && marker <= M_SOF15)
+			{
+				VDPAU_DBG("JPEG SOF marker 0x%02x not supported", marker);
+				return 0;
+			}
+			break;
+		}
+
+		pos += 2 + seg_len;
+	}
+
+	return 0;
+}
+
+static void set_quantization_tables(jpeg_private_t *jpeg, void *cedarv_regs)
+{
+	int i;
+	for (i = 0; i < 64; i++)
+		writel((uint32_t)(64 + i) << 8 | jpeg->quant[jpeg->comp[0].qt][i], cedarv_regs + CEDARV_MPEG_IQ_MIN_INPUT);
+	for (i = 0; i < 64; i++)
+		writel((uint32_t)(i) << 8 | jpeg->quant[jpeg->comp[1].qt][i], cedarv_regs + CEDARV_MPEG_IQ_MIN_INPUT);
+}
+
+static void set_huffman_tables(jpeg_private_t *jpeg, void *cedarv_regs)
+{
+	uint32_t buffer[512];
+	int i;
+
+	memset(buffer, 0, sizeof(buffer));
+
+	/*
+	 * per table: 16 x 16bit first code of each length, 16 x 8bit
+	 * symbol offset of each length, symbols at word 256 + 64 * table
+	 */
+	for (i = 0; i < 4; i++)
+	{
+		struct jpeg_huffman_table *t = &jpeg->huffman[i];
+		int j, sum = 0, last = 0;
+
+		for (j = 0; j < 16; j++)
+		{
+			((uint8_t *)buffer)[i * 64 + 32 + j] = sum;
+			sum += t->num[j];
+			if (t->num[j] != 0)
+				last = j;
+		}
+		memcpy(&buffer[256 + 64 * i], t->codes, sum);
+
+		sum = 0;
+		for (j = 0; j <= last; j++)
+		{
+			((uint16_t *)buffer)[i * 32 + j] = sum;
+			sum += t->num[j];
+			sum *= 2;
+		}
+		for (j = last + 1; j < 16; j++)
+			((uint16_t *)buffer)[i * 32 + j] = 0xffff;
+	}
+
+	writel(0xcc, cedarv_regs + CEDARV_MPEG_RAM_WRITE_PTR);
+	for (i = 0; i < 512; i++)
+		writel(buffer[i], cedarv_regs + CEDARV_MPEG_RAM_WRITE_DATA);
+}
+
+static VdpStatus jpeg_decode(decoder_ctx_t *decoder, VdpPictureInfo const *_info, const int len, video_surface_ctx_t *output)
+{
+	jpeg_private_t *jpeg = (jpeg_private_t *)decoder->private;
+	uint32_t color;
+
+	if (!parse_jpeg(jpeg, cedarv_getPointer(decoder->data), len))
+	{
+		VDPAU_DBG("invalid or unsupported JPEG data");
+		return VDP_STATUS_ERROR;
+	}
+
+	if (jpeg->width > output->stride_width || jpeg->height > output->stride_height)
+		return VDP_STATUS_INVALID_SIZE;
+
+	// the chroma planes are written unscaled, the surface must be big enough
+	switch ((jpeg->comp[0].samp_h << 4) | jpeg->comp[0].samp_v)
+	{
+	case 0x22:
+		if (output->chroma_type != VDP_CHROMA_TYPE_420)
+			return VDP_STATUS_INVALID_CHROMA_TYPE;
+		color = CEDARV_MPEG_TRIG_COLOR_FORMAT_YUV_4_2_0;
+		output->source_format = INTERNAL_YCBCR_FORMAT;
+		break;
+	case 0x21:
+		if (output->chroma_type != VDP_CHROMA_TYPE_422)
+			return VDP_STATUS_INVALID_CHROMA_TYPE;
+		color = CEDARV_MPEG_TRIG_COLOR_FORMAT_YUV_4_2_2_HOR;
+		output->source_format = INTERNAL_YCBCR_FORMAT_422;
+		break;
+	default:
+		VDPAU_DBG("JPEG sampling %dx%d not supported", jpeg->comp[0].samp_h, jpeg->comp[0].samp_v);
+		return VDP_STATUS_ERROR;
+	}
+
+	// activate MPEG engine
+	void *cedarv_regs = cedarv_get(CEDARV_ENGINE_MPEG, 0);
+
+	// set restart interval
+	writel(jpeg->restart_interval, cedarv_regs + CEDARV_MPEG_JPEG_RES_INT);
+
+	// set JPEG format
+	writel(CEDARV_MPEG_TRIG_DEC_FORMAT(3) | CEDARV_MPEG_TRIG_CHROM_FORMAT(color), cedarv_regs + CEDARV_MPEG_TRIGGER);
+
+	// set output buffers (Luma / Croma)
+	writel(cedarv_virt2phys(output->dataY), cedarv_regs + CEDARV_MPEG_ROT_LUMA);
+	writel(cedarv_virt2phys(output->dataU), cedarv_regs + CEDARV_MPEG_ROT_CHROMA);
+
+	// set size in MCUs
+	uint16_t h = (jpeg->height - 1) / (8 * jpeg->comp[0].samp_v);
+	uint16_t w = (jpeg->width - 1) / (8 * jpeg->comp[0].samp_h);
+	writel((uint32_t)h << 16 | w, cedarv_regs + CEDARV_MPEG_JPEG_SIZE);
+
+	// no scaling / rotation
+	writel(0x00000000, cedarv_regs + CEDARV_MPEG_SDROT_CTRL);
+
+	// input end
+	uint32_t input_addr = cedarv_virt2phys(decoder->data);
+	writel(input_addr + VBV_SIZE - 1, cedarv_regs + CEDARV_MPEG_VLD_END);
+
+	// enable finish, error and memory request interrupts
+	writel(0x0000007c, cedarv_regs + CEDARV_MPEG_CTRL);
+
+	// set input offset in bits
+	writel(jpeg->data_offset * 8, cedarv_regs + CEDARV_MPEG_VLD_OFFSET);
+
+	// set input length in bits
+	writel((len - jpeg->data_offset) * 8, cedarv_regs + CEDARV_MPEG_VLD_LEN);
+
+	// set input buffer
+	writel((input_addr & 0x0ffffff0) | (input_addr >> 28) | (0x7 << 28), cedarv_regs + CEDARV_MPEG_VLD_ADDR);
+
+	set_quantization_tables(jpeg, cedarv_regs);
+
+	writel(0x00000000, cedarv_regs + CEDARV_MPEG_RAM_WRITE_PTR);
+	set_huffman_tables(jpeg, cedarv_regs);
+
+	// trigger
+	writel(CEDARV_MPEG_TRIG_DEC_FORMAT(3) | CEDARV_MPEG_TRIG_CHROM_FORMAT(color) | CEDARV_MPEG_TRIG_VE_START_TYPE(0xe), cedarv_regs + CEDARV_MPEG_TRIGGER);
+
+	// wait for interrupt
+	cedarv_wait(1);
+
+	// the engine was reset, its registers say nothing about this frame
+	if (cedarv_job_hung())
+	{
+		cedarv_put();
+		return VDP_STATUS_ERROR;
+	}
+
+	// clean interrupt flag
+	writel(0x0000c00f, cedarv_regs + CEDARV_MPEG_STATUS);
+
+	// stop MPEG engine
+	cedarv_put();
+	output->frame_decoded = 1;
+
+	return VDP_STATUS_OK;
+}
+
+static void jpeg_private_free(decoder_ctx_t *decoder)
+{
+	free(decoder->private);
+}
+
+VdpStatus new_decoder_jpeg(decoder_ctx_t *decoder)
+{
+	jpeg_private_t *jpeg = calloc(1, sizeof(jpeg_private_t));
+	if (!jpeg)
+		return VDP_STATUS_RESOURCES;
+
+	set_default_huffman(&jpeg->huffman[0], bits_dc_luminance, val_dc, sizeof(val_dc));
+	set_default_huffman(&jpeg->huffman[1], bits_dc_chrominance, val_dc, sizeof(val_dc));
+	set_default_huffman(&jpeg->huffman[2], bits_ac_luminance, val_ac_luminance, sizeof(val_ac_luminance));
+	set_default_huffman(&jpeg->huffman[3], bits_ac_chrominance, val_ac_chrominance, sizeof(val_ac_chrominance));
+
+	decoder->decode = jpeg_decode;
+	decoder->private = jpeg;
+	decoder->private_free = jpeg_private_free;
+	return VDP_STATUS_OK;
+}
@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * The ring is a bounded queue with a sequence number per slot, writers
+ * claim slots with a compare and swap and the single reader holds the
+ * drain mutex. A full ring drops messages and counts them.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <pthread.h>
+#include <syslog.h>
+#include "logger.h"
+
+#define LOGGER_SLOTS 256
+#define LOGGER_MESSAGE 120
+#define LOGGER_BURST 10
+#define LOGGER_DRAIN_MS 50
+
+typedef struct
+{
+	uint32_t sequence;
+	uint8_t level;
+	char message[LOGGER_MESSAGE];
+} logger_slot_t;
+
+enum logger_output
+{
+	OUTPUT_STDERR,
+	OUTPUT_SYSLOG,
+};
+
+int logger_level = LOGGER_INFO;
+
+static logger_slot_t slots[LOGGER_SLOTS];
+static uint32_t write_pos;
+static uint32_t read_pos;
+static uint32_t dropped;
+
+static enum logger_output output = OUTPUT_STDERR;
+static void (*callback)(int loglevel, const char *format, ...);
+
+static pthread_once_t logger_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t drain_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int drain_started;
+static pthread_mutex_t drain_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t drain_cond;
+static pthread_t drain;
+static int drain_running;
+static int drain_quit;
+
+static const char *const level_names[] = { "debug", "info", "warning", "error" };
+
+static void logger_setup(void)
+{
+	uint32_t i;
+	for (i = 0; i < LOGGER_SLOTS; i++)
+		slots[i].sequence = i;
+
+	char *env_level = getenv("VDPAU_LOG_LEVEL");
+	for (i = 0; env_level && i < sizeof(level_names) / sizeof(level_names[0]); i++)
+		if (strcasecmp(env_level, level_names[i]) == 0)
+			logger_level = i;
+
+	char *env_log = getenv("VDPAU_LOG");
+	if (env_log && strcmp(env_log, "syslog") == 0)
+	{
+		output = OUTPUT_SYSLOG;
+		openlog("vdpau_sunxi", LOG_PID, LOG_USER);
+	}
+}
+
+void logger_init(void)
+{
+	pthread_once(&logger_once, logger_setup);
+}
+
+void logger_set_callback(void (*_callback)(int loglevel, const char *format, ...))
+{
+	callback = _callback;
+}
+
+static void emit(int level, const char *message)
+{
+	// the callers of the Log callbacks number the levels like xbmc
+	static const int callback_levels[] = { 0, 1, 3, 4 };
+	static const int syslog_levels[] = { LOG_DEBUG, LOG_INFO, LOG_WARNING, LOG_ERR };
+
+	if (callback)
+		callback(callback_levels[level], "[VDPAU SUNXI] %s", message);
+	else if (output == OUTPUT_SYSLOG)
+		syslog(syslog_levels[level], "%s", message);
+	else
+		fprintf(stderr, "[VDPAU SUNXI] %s: %s\n", level_names[level], message);
+}
+
+void logger_flush(void)
+{
+	pthread_mutex_lock(&drain_mutex);
+	while (1)
+	{
+		logger_slot_t *slot = &slots[read_pos % LOGGER_SLOTS];
+		if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != read_pos + 1)
+			break;
+
+		emit(slot->level, slot->message);
+		__atomic_store_n(&slot->sequence, read_pos + LOGGER_SLOTS, __ATOMIC_RELEASE);
+		read_pos++;
+	}
+
+	uint32_t lost = __atomic_exchange_n(&dropped, 0, __ATOMIC_RELAXED);
+	if (lost)
+	{
+		char message[LOGGER_MESSAGE];
+		snprintf(message, sizeof(message), "log ring full, %u messages dropped", lost);
+		emit(LOGGER_WARNING, message);
+	}
+	pthread_mutex_unlock(&drain_mutex);
+}
+
+static void *drain_thread(void *arg)
+{
+	struct timespec ts;
+
+	pthread_mutex_lock(&drain_lock);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	while (!drain_quit)
+	{
+		ts.tv_nsec += LOGGER_DRAIN_MS * 1000000;
+		if (ts.tv_nsec >= 1000000000)
+		{
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&drain_cond, &drain_lock, &ts);
+
+		pthread_mutex_unlock(&drain_lock);
+		logger_flush();
+		pthread_mutex_lock(&drain_lock);
+	}
+	pthread_mutex_unlock(&drain_lock);
+
+	return NULL;
+}
+
+static void start_drain(void)
+{
+	pthread_condattr_t attr;
+
+	if (__sync_lock_test_and_set(&drain_started, 1))
+		return;
+
+	pthread_mutex_lock(&drain_lock);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&drain_cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	drain_quit = 0;
+	drain_running = pthread_create(&drain, NULL, drain_thread, NULL) == 0;
+	if (!drain_running)
+	{
+		pthread_cond_destroy(&drain_cond);
+		drain_started = 0;
+	}
+	pthread_mutex_unlock(&drain_lock);
+}
+
+void logger_close(void)
+{
+	pthread_mutex_lock(&drain_lock);
+	int running = drain_running;
+	drain_running = 0;
+	drain_quit = 1;
+	if (running)
+		pthread_cond_signal(&drain_cond);
+	pthread_mutex_unlock(&drain_lock);
+
+	if (running)
+	{
+		pthread_join(drain, NULL);
+		pthread_cond_destroy(&drain_cond);
+		__sync_lock_release(&drain_started);
+	}
+
+	logger_flush();
+}
+
+static logger_slot_t *claim(void)
+{
+	uint32_t pos = __atomic_load_n(&write_pos, __ATOMIC_RELAXED);
+
+	while (1)
+	{
+		logger_slot_t *slot = &slots[pos % LOGGER_SLOTS];
+		int32_t diff = (int32_t)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - pos);
+
+		if (diff == 0)
+		{
+			if (__atomic_compare_exchange_n(&write_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				return slot;
+		}
+		else if (diff < 0)
+			return NULL;
+		else
+			pos = __atomic_load_n(&write_pos, __ATOMIC_RELAXED);
+	}
+}
+
+static void enqueue(enum logger_level level, const char *prefix, const char *format, va_list args)
+{
+	logger_slot_t *slot = claim();
+	if (!slot)
+	{
+		__atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	// the slot's sequence tells which position it was claimed for
+	uint32_t pos = slot->sequence;
+	int n = prefix ? snprintf(slot->message, LOGGER_MESSAGE, "%s", prefix) : 0;
+	vsnprintf(slot->message + n, LOGGER_MESSAGE - n, format, args);
+	slot->level = level;
+	__atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+}
+
+void logger_write(logger_site_t *site, enum logger_level level, const char *format, ...)
+{
+	char prefix[48];
+	struct timespec ts;
+	va_list args;
+
+	logger_init();
+	if (level < logger_level)
+		return;
+
+	// one second windows per call site, racing threads only blur the count
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	if (site->second != (uint32_t)ts.tv_sec)
+	{
+		site->second = ts.tv_sec;
+		site->count = 0;
+	}
+
+	if (__atomic_add_fetch(&site->count, 1, __ATOMIC_RELAXED) > LOGGER_BURST)
+	{
+		__atomic_add_fetch(&site->suppressed, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	prefix[0] = '\0';
+	uint32_t suppressed = __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+	if (suppressed)
+		snprintf(prefix, sizeof(prefix), "(%u like this suppressed) ", suppressed);
+
+	va_start(args, format);
+	enqueue(level, prefix[0] ? prefix : NULL, format, args);
+	va_end(args);
+
+	if (!drain_started)
+		start_drain();
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __LOGGER_H__
+#define __LOGGER_H__
+
+#include <stdint.h>
+
+/*
+ * Messages of the decode and display paths. A call formats into a slot
+ * of a lock-free ring and returns, a background thread writes the ring
+ * out. Each call site passes at most LOGGER_BURST messages per second,
+ * the rest is counted and reported with the next one that passes.
+ *
+ * VDPAU_LOG_LEVEL=debug|info|warning|error sets the lowest level kept,
+ * VDPAU_LOG=stderr|syslog picks where they go unless a player handed
+ * in a Log callback.
+ */
+
+enum logger_level
+{
+	LOGGER_DEBUG,
+	LOGGER_INFO,
+	LOGGER_WARNING,
+	LOGGER_ERROR,
+};
+
+typedef struct
+{
+	uint32_t second;
+	uint32_t count;
+	uint32_t suppressed;
+} logger_site_t;
+
+extern int logger_level;
+
+void logger_init(void);
+void logger_write(logger_site_t *site, enum logger_level level, const char *format, ...) __attribute__((format(printf, 3, 4)));
+void logger_set_callback(void (*callback)(int loglevel, const char *format, ...));
+// writes out what is queued, from the calling thread
+void logger_flush(void);
+// stops and joins the background thread, then writes out what is left,
+// the next message starts the thread again
+void logger_close(void);
+
+#define logger(level, format, ...) \
+	do { \
+		static logger_site_t __site; \
+		if ((level) >= logger_level) \
+			logger_write(&__site, level, format, ##__VA_ARGS__); \
+	} while (0)
+
+#define log_debug(format, ...) logger(LOGGER_DEBUG, format, ##__VA_ARGS__)
+#define log_info(format, ...) logger(LOGGER_INFO, format, ##__VA_ARGS__)
+#define log_warning(format, ...) logger(LOGGER_WARNING, format, ##__VA_ARGS__)
+#define log_error(format, ...) logger(LOGGER_ERROR, format, ##__VA_ARGS__)
+
+#endif
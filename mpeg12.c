@@ -144,8 +144,43 @@ static VdpStatus mpeg12_decode(decoder_ctx_t *decoder, VdpPictureInfo const *_in
 	// set output buffers (Luma / Croma)
 	writel(cedarv_virt2phys(output->dataY), cedarv_regs + CEDARV_MPEG_REC_LUMA);
 	writel(cedarv_virt2phys(output->dataU)/* + output->plane_size*/, cedarv_regs + CEDARV_MPEG_REC_CHROMA);
-	writel(cedarv_virt2phys(output->dataY), cedarv_regs + CEDARV_MPEG_ROT_LUMA);
-	writel(cedarv_virt2phys(output->dataU)/* + output->plane_size*/, cedarv_regs + CEDARV_MPEG_ROT_CHROMA);
+
+	// the rotate output carries the scaled or rotated copy when the reconstructed picture is written
+	int scale_ratio;
+	int rotate = 0;
+	video_surface_ctx_t *scaled = NULL;
+	if (cedarv_get_version() >= 0x1680)
+	{
+		scaled = video_surface_get_scaled(output, &scale_ratio);
+		rotate = !scaled && output->rotation != VDP_SUNXI_ROTATION_NONE;
+	}
+	output->rotated = 0;
+	if (scaled)
+	{
+		if (output->rotation != VDP_SUNXI_ROTATION_NONE)
+			VDPAU_DBG_ONCE("scaled surface attached, not rotating");
+		writel(cedarv_virt2phys(scaled->dataY), cedarv_regs + CEDARV_MPEG_ROT_LUMA);
+		writel(cedarv_virt2phys(scaled->dataU), cedarv_regs + CEDARV_MPEG_ROT_CHROMA);
+		writel((ALIGN(scaled->width, 16) / 2 << 16) | ALIGN(scaled->width, 32), cedarv_regs + CEDARV_EXTRA_OUT_STRIDE);
+		writel(0x40620000 | SDROT_CTRL_HORIZ_SCALE(scale_ratio) | SDROT_CTRL_VERT_SCALE(scale_ratio) | SDROT_CTRL_SCALE_EN, cedarv_regs + CEDARV_MPEG_SDROT_CTRL);
+		scaled->source_format = VDP_YCBCR_FORMAT_NV12;
+	}
+	else if (rotate)
+	{
+		uint32_t rot_width = video_surface_rotated_width(output);
+		writel(cedarv_virt2phys(output->rotY), cedarv_regs + CEDARV_MPEG_ROT_LUMA);
+		writel(cedarv_virt2phys(output->rotU), cedarv_regs + CEDARV_MPEG_ROT_CHROMA);
+		writel((ALIGN(rot_width, 16) / 2 << 16) | ALIGN(rot_width, 32), cedarv_regs + CEDARV_EXTRA_OUT_STRIDE);
+		writel(0x40620000 | SDROT_CTRL_ROTATE(output->rotation), cedarv_regs + CEDARV_MPEG_SDROT_CTRL);
+	}
+	else
+	{
+		writel(cedarv_virt2phys(output->dataY), cedarv_regs + CEDARV_MPEG_ROT_LUMA);
+		writel(cedarv_virt2phys(output->dataU)/* + output->plane_size*/, cedarv_regs + CEDARV_MPEG_ROT_CHROMA);
+		// don't keep scaling or rotation of a previous frame
+		if (cedarv_get_version() >= 0x1680)
+			writel(0x40620000, cedarv_regs + CEDARV_MPEG_SDROT_CTRL);
+	}
 
         if(cedarv_get_version() >= 0x1680)
         {
@@ -189,6 +224,12 @@ static VdpStatus mpeg12_decode(decoder_ctx_t *decoder, VdpPictureInfo const *_in
 	// stop MPEG engine
 	cedarv_put();
         output->frame_decoded = 1;
+	output->rotated = rotate;
+	if (scaled)
+	{
+		scaled->frame_decoded = 1;
+		handle_release(output->scaled);
+	}
         
 	return VDP_STATUS_OK;
 }
@@ -250,6 +250,26 @@ static void mp4_private_free(decoder_ctx_t *decoder)
     free(decoder_p);
 }
 
+static void mp4_private_flush(decoder_ctx_t *decoder)
+{
+    mp4_private_t *decoder_p = (mp4_private_t *)decoder->private;
+
+    // the VOL header stays valid for the rest of the stream
+    memset(&decoder_p->pkt_hdr, 0, sizeof(decoder_p->pkt_hdr));
+    memset(&decoder_p->vop_header, 0, sizeof(decoder_p->vop_header));
+    memset(decoder_p->MV, 0, sizeof(decoder_p->MV));
+}
+
+static int mp4_private_fits(decoder_ctx_t *decoder, uint32_t width, uint32_t height)
+{
+    mp4_private_t *decoder_p = (mp4_private_t *)decoder->private;
+    size_t mb_width = (width + 15) / 16;
+    size_t mb_height = (height + 15) / 16;
+
+    return cedarv_getSize(decoder_p->mbh_buffer) >= mb_height * 2048 &&
+        cedarv_getSize(decoder_p->dcac_buffer) >= mb_width * mb_height * 2;
+}
+
 static VLCtabMb MCBPCtabIntra[] = {
 	{-1,0},
 	{20,6}, {36,6}, {52,6}, {4,4}, {4,4}, {4,4}, 
@@ -1409,7 +1429,7 @@ static int decode_vop_header(bitstream *bs, VdpPictureInfoMPEG4Part2 const *info
             }
         }
         else {
-		printf("unimplemented leg\n");
+		log_warning("unimplemented leg");
             //combined_motion_shape_texture() 
         }
 	return 1;
@@ -1667,12 +1687,12 @@ int mpeg4_decode_packet_header(bitstream *gb, VdpPictureInfoMPEG4Part2 const *in
     if (vol->video_object_layer_shape != RECT_SHAPE) {
         header_extension = get_bits(gb,1);
         // FIXME more stuff here
-	printf("fixme: more stuff to read here");
+	log_debug("fixme: more stuff to read here");
     }
 
     mb_num = get_bits(gb, mb_num_bits);
     if (mb_num >= mb_num_calc) {
-        printf("illegal mb_num in video packet (%d %d) \n", mb_num, mb_num_calc);
+        log_warning("illegal mb_num in video packet (%d %d)", mb_num, mb_num_calc);
         return -1;
     }
     h->mb_num = mb_num;
@@ -1726,12 +1746,12 @@ int mpeg4_decode_packet_header(bitstream *gb, VdpPictureInfoMPEG4Part2 const *in
             if (vol->video_object_type_indication != AV_PICTURE_TYPE_I) {
                 int f_code = get_bits(gb, 3);       /* fcode_for */
                 if (f_code == 0)
-                    printf("Error, video packet header damaged (f_code=0)\n");
+                    log_warning("video packet header damaged (f_code=0)");
             }
             if (vol->video_object_type_indication == AV_PICTURE_TYPE_B) {
                 int b_code = get_bits(gb, 3);
                 if (b_code == 0)
-                    printf("Error, video packet header damaged (b_code=0)\n");
+                    log_warning("video packet header damaged (b_code=0)");
             }
         }
     }
@@ -1801,7 +1821,8 @@ int mpeg4_decode(decoder_ctx_t *decoder, VdpPictureInfoMPEG4Part2 const *_info,
 
     output->source_format = INTERNAL_YCBCR_FORMAT;
  
-	while (find_startcode(&bs))
+	// a reset engine skips the rest of the bitstream
+	while (!cedarv_job_hung() && find_startcode(&bs))
 	{
             startcode = get_bits(&bs, 8);
             if (startcode == 0xb6)
@@ -2131,21 +2152,22 @@ int mpeg4_decode(decoder_ctx_t *decoder, VdpPictureInfoMPEG4Part2 const *_info,
 #if TIMEMEAS
                 tv = get_time();
 #endif
-                if(cedarv_wait(1) <= 0)
-                {
-                  cedarv_VeReset();
-                }
+                // a timeout resets the engine in there
+                cedarv_wait(1);
 #if TIMEMEAS                
                 tv2 = get_time();
                 if (tv2-tv > 10000000) {
                     printf("cedarv_wait, longer than 10ms:%lld, pics=%ld, longs=%ld\n", tv2-tv, num_pics, ++num_longs);
                 }
 #endif
+                if (cedarv_job_hung())
+                    break;
+
                 // clean interrupt flag
                 writel(0x0000c00f, cedarv_regs + CEDARV_MPEG_STATUS);
                 int error = readl(cedarv_regs + CEDARV_MPEG_ERROR);
                 if(error)
-                    printf("got error=%d while decoding frame=%ld\n", error, num_pics);
+                    log_warning("got error=%d while decoding frame=%ld", error, num_pics);
                 writel(0x0, cedarv_regs + CEDARV_MPEG_ERROR);
 
                 ++num_pics;
@@ -2215,21 +2237,23 @@ VdpStatus new_decoder_mpeg4(decoder_ctx_t *decoder)
 	int width = ((decoder->width + 15) / 16);
 	int height = ((decoder->height + 15) / 16);
 
-	decoder_p->mbh_buffer = cedarv_malloc(height * 2048);
+	decoder_p->mbh_buffer = cedarv_malloc_type(height * 2048, CEDARV_MEM_SCRATCH);
 	if (! cedarv_isValid(decoder_p->mbh_buffer))
 		goto err_mbh;
 
-	decoder_p->dcac_buffer = cedarv_malloc(width * height * 2);
+	decoder_p->dcac_buffer = cedarv_malloc_type(width * height * 2, CEDARV_MEM_SCRATCH);
 	if (! cedarv_isValid(decoder_p->dcac_buffer))
 		goto err_dcac;
 
-	decoder_p->ncf_buffer = cedarv_malloc(4 * 1024);
+	decoder_p->ncf_buffer = cedarv_malloc_type(4 * 1024, CEDARV_MEM_SCRATCH);
 	if (! cedarv_isValid(decoder_p->ncf_buffer))
 		goto err_ncf;
 
 	decoder->decode = mpeg4_decode;
 	decoder->private = decoder_p;
 	decoder->private_free = mp4_private_free;
+	decoder->private_flush = mp4_private_flush;
+	decoder->private_fits = mp4_private_fits;
 
     save_tables(&decoder_p->tables);
 
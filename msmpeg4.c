@@ -42,7 +42,7 @@ extern int nextbits_bytealigned(bitstream *bs, int nbit);
 static void dumpData(char* data)
 {
     int pos=0;
-    printf("data[%d]=%X data[+1]=%X data[+2]=%X data[+3]=%X data[+4]=%X\n",
+    log_debug("msmpeg4: data[%d]=%X data[+1]=%X data[+2]=%X data[+3]=%X data[+4]=%X",
         pos, data[pos], data[pos+1], data[pos+2], data[pos+3],data[pos+4]);
 }
 
@@ -76,13 +76,13 @@ static int decode_vop_header(bitstream *bs, VdpPictureInfoMPEG4Part2 const *info
     h->vop_coding_type = get_bits(bs, 2) ;
     if (h->vop_coding_type != VOP_I &&
         h->vop_coding_type != VOP_P){
-        printf("invalid picture type\n");
+        log_warning("msmpeg4: invalid picture type");
         return -1;
     }
 
     h->vop_quant = get_bits(bs, 5);
     if(h->vop_quant==0){
-        printf( "invalid qscale\n");
+        log_warning("msmpeg4: invalid qscale");
         return -1;
     }
 
@@ -99,7 +99,7 @@ static int decode_vop_header(bitstream *bs, VdpPictureInfoMPEG4Part2 const *info
         }else{
             /* 0x17: one slice, 0x18: two slices, ... */
             if (code < 0x17){
-                printf("error, slice code was %X\n", code);
+                log_warning("msmpeg4: slice code was %X", code);
                 return -1;
             }
 			h->slice_height = vh->mb_height / (code - 0x16);
@@ -558,14 +558,20 @@ int msmpeg4_decode(decoder_ctx_t *decoder, VdpPictureInfoMPEG4Part2 const *_info
         printf("cedarv_wait, longer than 10ms:%lld, pics=%ld, longs=%ld\n", tv2-tv, num_pics, ++num_longs);
     }
 #endif
+    // the engine was reset, its registers say nothing about this frame
+    if (cedarv_job_hung())
+    {
+        cedarv_put();
+        return VDP_STATUS_ERROR;
+    }
     // clean interrupt flag
     uint32_t status = readl(cedarv_regs + CEDARV_MPEG_STATUS);
     if(status)
-    	printf("status=%X\n", status);
+    	log_debug("msmpeg4: status=%X", status);
     writel(0x0000000f, cedarv_regs + CEDARV_MPEG_STATUS);
     error = readl(cedarv_regs + CEDARV_MPEG_ERROR);
     if(error)
-        printf("got error=%d while decoding frame\n", error);
+        log_error("msmpeg4: got error=%d while decoding frame", error);
     writel(0x0, cedarv_regs + CEDARV_MPEG_ERROR);
 
     int veCurPos = readl(cedarv_regs + CEDARV_MPEG_VLD_OFFSET);
@@ -604,15 +610,15 @@ VdpStatus new_decoder_msmpeg4(decoder_ctx_t *decoder)
     int width = ((decoder->width + 15) / 16);
     int height = ((decoder->height + 15) / 16);
 
-    decoder_p->mbh_buffer = cedarv_malloc(height * 2048);
+    decoder_p->mbh_buffer = cedarv_malloc_type(height * 2048, CEDARV_MEM_SCRATCH);
     if (! cedarv_isValid(decoder_p->mbh_buffer))
        goto err_mbh;
 
-    decoder_p->dcac_buffer = cedarv_malloc(width * height * 2);
+    decoder_p->dcac_buffer = cedarv_malloc_type(width * height * 2, CEDARV_MEM_SCRATCH);
     if (! cedarv_isValid(decoder_p->dcac_buffer))
        goto err_dcac;
 
-    decoder_p->ncf_buffer = cedarv_malloc(4 * 1024);
+    decoder_p->ncf_buffer = cedarv_malloc_type(4 * 1024, CEDARV_MEM_SCRATCH);
     if (! cedarv_isValid(decoder_p->ncf_buffer))
        goto err_ncf;
 
@@ -38,8 +38,8 @@
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 #include <stdlib.h>
+#include <pthread.h>
 
-#define USE_TILE 0
 
 static PFNEGLCREATEIMAGEKHRPROC peglCreateImageKHR = NULL;
 static PFNEGLDESTROYIMAGEKHRPROC peglDestroyImageKHR = NULL;
@@ -51,6 +51,53 @@ static EGLSurface    eglSurface = EGL_NO_SURFACE;
 
 static void (*Log)(int loglevel, const char *format, ...);
 
+// VDPAU_GL_TILED=1 skips the scaler on VEs that decode to MB32 tiles
+static int tiledMode = 0;
+
+// the registered surfaces, mapping holds the lock while it uses the conversion buffers
+static pthread_mutex_t nvMutex = PTHREAD_MUTEX_INITIALIZER;
+static surface_nv_ctx_t *nvSurfaces = NULL;
+static const CEDARV_MEMORY noMemory;
+
+/*
+ * Fragment shader for surfaces registered in tiled mode. The first two
+ * textures of a surface hold the luma tiles, one 32x32 tile per row of
+ * 1024 texels, the others the chroma tiles as 512 UV pairs per row.
+ * vdpau_layout comes from glVDPAUGetTiledLayoutNV(). Without highp, as
+ * on the Mali-400, the addresses are FP16 and only exact up to about
+ * 1024 texels, see tiledFits().
+ */
+static const char tiledShader[] =
+  "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+  "precision highp float;\n"
+  "#else\n"
+  "precision mediump float;\n"
+  "#endif\n"
+  "uniform sampler2D vdpau_tex_y;\n"
+  "uniform sampler2D vdpau_tex_uv;\n"
+  "// frame width and height, tiles per row, rows of the luma texture\n"
+  "uniform vec4 vdpau_layout;\n"
+  "varying vec2 vdpau_texcoord;\n"
+  "\n"
+  "vec2 tile_texel(vec2 p, vec2 tile_size, float rows)\n"
+  "{\n"
+  "  vec2 tile = floor(p / tile_size);\n"
+  "  vec2 in_tile = p - tile * tile_size;\n"
+  "  vec2 t = vec2(in_tile.y * tile_size.x + in_tile.x, tile.y * vdpau_layout.z + tile.x);\n"
+  "  return (t + 0.5) / vec2(tile_size.x * 32.0, rows);\n"
+  "}\n"
+  "\n"
+  "void main()\n"
+  "{\n"
+  "  vec2 p = floor(vdpau_texcoord * vdpau_layout.xy);\n"
+  "  float y = texture2D(vdpau_tex_y, tile_texel(p, vec2(32.0, 32.0), vdpau_layout.w)).r;\n"
+  "  vec4 uv = texture2D(vdpau_tex_uv, tile_texel(floor(p / 2.0), vec2(16.0, 32.0), vdpau_layout.w / 2.0));\n"
+  "  y = 1.164 * (y - 0.0625);\n"
+  "  float u = uv.r - 0.5;\n"
+  "  float v = uv.a - 0.5;\n"
+  "  gl_FragColor = vec4(y + 1.596 * v, y - 0.391 * u - 0.813 * v, y + 2.018 * u, 1.0);\n"
+  "}\n";
+
 
 enum col_plane
 {
@@ -62,6 +109,13 @@ enum col_plane
 
 static void createTexture2D(fbdev_pixmap *pm, surface_nv_ctx_t *nv, video_surface_ctx_t *vs, enum col_plane cp);
 static void createTextureRGB2D(fbdev_pixmap *pm, surface_nv_ctx_t *nv, output_surface_ctx_t *vs);
+static void createVideoImage(surface_nv_ctx_t *nv, video_surface_ctx_t *vs, int i);
+static int tiledFits(video_surface_ctx_t *vs);
+static void createOutputImage(surface_nv_ctx_t *nv, output_surface_ctx_t *vs, int i);
+static void destroyImage(surface_nv_ctx_t *nv, int i);
+static int allocConversion(surface_nv_ctx_t *nv, size_t plane_size);
+static size_t freeConversion(surface_nv_ctx_t *nv);
+static size_t evictConversion(void *context, size_t needed);
 
 void glVDPAUUnmapSurfacesNV(GLsizei numSurfaces, const vdpauSurfaceNV *surfaces);
 
@@ -93,6 +147,12 @@ void glVDPAUInitNV(const void *vdpDevice, const void *getProcAddress, EGLContext
 {
    eglSharedContext = shared_context;
    Log = _Log;
+   if (Log)
+      logger_set_callback(Log);
+
+   char *env_gl_tiled = getenv("VDPAU_GL_TILED");
+   // newer VEs decode to NV12, which the scaler path handles as well
+   tiledMode = env_gl_tiled && strncmp(env_gl_tiled, "1", 1) == 0 && cedarv_get_version() < 0x1680;
 
    peglCreateImageKHR =
     (PFNEGLCREATEIMAGEKHRPROC)eglGetProcAddress("eglCreateImageKHR");
@@ -114,6 +174,7 @@ void glVDPAUInitNV(const void *vdpDevice, const void *getProcAddress, EGLContext
   if(pglEGLImageTargetTexture2DOES == NULL){
     printf("glEGLImageTargetTexture2DOES not found!\n");
   }
+  cedarv_mem_add_evictor(evictConversion, NULL);
   if(shared_context != EGL_NO_CONTEXT)
   {
      EGLConfig     eglConfig  = 0;
@@ -154,6 +215,7 @@ void glVDPAUInitNV(const void *vdpDevice, const void *getProcAddress, EGLContext
 
 void glVDPAUFiniNV(void)
 {
+   cedarv_mem_remove_evictor(evictConversion, NULL);
    eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext);
    if(eglSurface != EGL_NO_SURFACE)
    {
@@ -199,20 +261,32 @@ vdpauSurfaceNV glVDPAURegisterVideoSurfaceNV (const void *vdpSurface, uint32_t t
    memset(nv->textureNames, 0, sizeof(nv->textureNames));
    memcpy(nv->textureNames, textureNames, sizeof(uint) * numTextureNames);
 
-   nv->convY = cedarv_malloc(vs->plane_size);
-   nv->convU = cedarv_malloc(vs->plane_size/4);
-   nv->convV = cedarv_malloc(vs->plane_size/4);
-   nv->conv_width 	= (vs->width + 15) & ~15;
-   nv->conv_height	= (vs->height + 15) & ~15;
-
-   if (! cedarv_isValid(nv->convY) || ! cedarv_isValid(nv->convU) || ! cedarv_isValid(nv->convV))
+   nv->tiled = tiledMode && tiledFits(vs);
+   nv->surfaceType = type;
+   // textures are sized for what is shown now, mapping resizes them if that changes
+   CEDARV_MEMORY dataY, dataU;
+   uint32_t width, height;
+   video_surface_get_display(vs, &dataY, &dataU, &width, &height);
+   nv->conv_width 	= (width + 15) & ~15;
+   nv->conv_height	= (height + 15) & ~15;
+
+   if (!nv->tiled && !allocConversion(nv, vs->plane_size))
    {
       handle_release(nv->surface);
       handle_destroy(surfaceNV);
       return 0;
    }
-   nv->surfaceType = type;
+
+   // the images stay bound to the textures until unregister, mapping only converts
+   int i;
+   for(i = 0; i < nv->numTextureNames; i++)
+      createVideoImage(nv, vs, i);
    //handle_release(vdpSurface);
+
+   pthread_mutex_lock(&nvMutex);
+   nv->next = nvSurfaces;
+   nvSurfaces = nv;
+   pthread_mutex_unlock(&nvMutex);
  
    return surfaceNV;
 }
@@ -247,18 +321,23 @@ vdpauSurfaceNV glVDPAURegisterOutputSurfaceNV (const void *vdpSurface, uint32_t
   memset(nv->textureNames, 0, sizeof(nv->textureNames));
   memcpy(nv->textureNames, textureNames, sizeof(uint) * numTextureNames);
 
-  nv->convY = cedarv_malloc(vs->vs->plane_size * 3);
-  nv->conv_width 	= (vs->width + 15) & ~15;
-  nv->conv_height	= (vs->height + 15) & ~15;
+  nv->surfaceType = type;
+  nv->conv_width 	= (vs->rgba.width + 15) & ~15;
+  nv->conv_height	= (vs->rgba.height + 15) & ~15;
 
-  if (! cedarv_isValid(nv->convY) )
+  if (!allocConversion(nv, vs->vs->plane_size))
   {
     handle_release(nv->surface);
     handle_destroy(surfaceNV);
     return 0;
   }
-  nv->surfaceType = type;
+  createOutputImage(nv, vs, 0);
    //handle_release(vdpSurface);
+
+  pthread_mutex_lock(&nvMutex);
+  nv->next = nvSurfaces;
+  nvSurfaces = nv;
+  pthread_mutex_unlock(&nvMutex);
  
   return surfaceNV;
 }
@@ -281,6 +360,16 @@ void glVDPAUUnregisterSurfaceNV (vdpauSurfaceNV surface)
       glVDPAUUnmapSurfacesNV(1, surf);
    }
 
+   pthread_mutex_lock(&nvMutex);
+   surface_nv_ctx_t **p;
+   for (p = &nvSurfaces; *p; p = &(*p)->next)
+      if (*p == nv)
+      {
+         *p = nv->next;
+         break;
+      }
+   pthread_mutex_unlock(&nvMutex);
+
    vs->vdpNvState = VdpauNVState_Unregistered;
    if(nv->surface)
    {
@@ -288,16 +377,7 @@ void glVDPAUUnregisterSurfaceNV (vdpauSurfaceNV surface)
       handle_destroy(nv->surface);
       nv->surface = 0;
    }
-   if( cedarv_isValid(nv->convY) )
-      cedarv_free(nv->convY);
-   if (cedarv_isValid(nv->convU) )
-      cedarv_free(nv->convU);
-   if (cedarv_isValid(nv->convV) )
-      cedarv_free(nv->convV);
-
-   cedarv_setBufferInvalid(nv->convY);
-   cedarv_setBufferInvalid(nv->convU);
-   cedarv_setBufferInvalid(nv->convV);
+   freeConversion(nv);
 
    handle_release(surface);
    handle_destroy(surface); 
@@ -312,126 +392,314 @@ void glVDPAUSurfaceAccessNV(vdpauSurfaceNV surface, uint32_t access)
 {
 }
 
+/*
+ * The shader addresses pixels of the frame and rows of the luma
+ * texture. In FP16 neighbouring rows alias beyond 1024, bigger frames
+ * go through the scaler unless the fragment shaders have highp.
+ */
+static int tiledFits(video_surface_ctx_t *vs)
+{
+   GLint range[2], precision = 0;
+
+   glGetShaderPrecisionFormat(GL_FRAGMENT_SHADER, GL_HIGH_FLOAT, range, &precision);
+   if (precision > 0)
+      return 1;
+
+   return vs->width <= 1024 && vs->height <= 1024 && vs->plane_size / 1024 <= 1024;
+}
+
+const char *glVDPAUGetTiledShaderNV(void)
+{
+   return tiledShader;
+}
+
+// returns 0 if the surface textures hold converted planes, else fills the vdpau_layout uniform
+int glVDPAUGetTiledLayoutNV(vdpauSurfaceNV surface, GLfloat *layout)
+{
+   surface_nv_ctx_t *nv = handle_get(surface);
+   if (!nv)
+      return 0;
+
+   int tiled = nv->tiled;
+   if (tiled)
+   {
+      video_surface_ctx_t *vs = handle_get(nv->surface);
+      assert(vs);
+      layout[0] = vs->width;
+      layout[1] = vs->height;
+      layout[2] = (vs->width + 31) / 32;
+      layout[3] = vs->plane_size / 1024;
+      handle_release(nv->surface);
+   }
+   handle_release(surface);
+   return tiled;
+}
+
+static enum col_plane texturePlane(surface_nv_ctx_t *nv, int i)
+{
+  if (i == 0 || i == 1)
+    return y_plane;
+  else if (nv->tiled)
+    return uv_plane;
+  else if (i == 2 || i == 3)
+    return (nv->numTextureNames == 6) ? u_plane : uv_plane;
+  return v_plane;
+}
+
+static CEDARV_MEMORY planeMemory(surface_nv_ctx_t *nv, video_surface_ctx_t *vs, enum col_plane cp)
+{
+  if (nv->tiled)
+    return (cp == y_plane) ? vs->dataY : vs->dataU;
+
+  switch(cp)
+  {
+    case(y_plane):
+      return nv->convY;
+    case(v_plane):
+      return nv->convV;
+    default:
+      return nv->convU;
+  }
+}
+
+static void bindTexture(surface_nv_ctx_t *nv, int i)
+{
+  glActiveTexture(GL_TEXTURE0 + nv->textureNames[i]);
+  glBindTexture(GL_TEXTURE_2D, nv->textureNames[i]);
+  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+static void createImage(surface_nv_ctx_t *nv, int i)
+{
+  const EGLint renderImageAttrs[] = {
+    EGL_IMAGE_PRESERVED_KHR, EGL_FALSE, 
+    EGL_NONE
+  };
+
+  nv->eglImage[i] = peglCreateImageKHR(eglDisplay,
+                                       EGL_NO_CONTEXT,  
+                                       EGL_NATIVE_PIXMAP_KHR,
+                                       &nv->cMemPixmap[i],
+                                       renderImageAttrs);
+  if (!TestEGLError("eglCreateImageKHR"))
+    return;
+  pglEGLImageTargetTexture2DOES(GL_TEXTURE_2D, (GLeglImageOES)nv->eglImage[i]);
+}
+
+static void createVideoImage(surface_nv_ctx_t *nv, video_surface_ctx_t *vs, int i)
+{
+  bindTexture(nv, i);
+  createTexture2D(&nv->cMemPixmap[i], nv, vs, texturePlane(nv, i));
+  createImage(nv, i);
+}
+
+static void createOutputImage(surface_nv_ctx_t *nv, output_surface_ctx_t *vs, int i)
+{
+  bindTexture(nv, i);
+  createTextureRGB2D(&nv->cMemPixmap[i], nv, vs);
+  createImage(nv, i);
+}
+
+static void destroyImage(surface_nv_ctx_t *nv, int i)
+{
+  if(nv->eglImage[i])
+  {
+    peglDestroyImageKHR(eglDisplay, nv->eglImage[i]);
+    nv->eglImage[i] = 0;
+  }
+  if(nv->cMemPixmap[i].data)
+  {
+    ump_reference_release(nv->cMemPixmap[i].data);
+    nv->cMemPixmap[i].data = NULL;
+  }
+}
+
+/*
+ * Conversion buffers are a cache of the last converted frame. The
+ * evictor gives back those of unmapped surfaces when the contiguous
+ * memory runs short, the next map allocates and converts again.
+ */
+static int allocConversion(surface_nv_ctx_t *nv, size_t plane_size)
+{
+  if (nv->surfaceType == htype_output)
+    nv->convY = cedarv_malloc_type(plane_size * 3, CEDARV_MEM_CONVERSION);
+  else
+  {
+    nv->convY = cedarv_malloc_type(plane_size, CEDARV_MEM_CONVERSION);
+    nv->convU = cedarv_malloc_type(plane_size/4, CEDARV_MEM_CONVERSION);
+    nv->convV = cedarv_malloc_type(plane_size/4, CEDARV_MEM_CONVERSION);
+  }
+  nv->conv_source = NULL;
+
+  if (! cedarv_isValid(nv->convY) || (nv->surfaceType != htype_output &&
+      (! cedarv_isValid(nv->convU) || ! cedarv_isValid(nv->convV))))
+  {
+    freeConversion(nv);
+    return 0;
+  }
+  return 1;
+}
+
+static size_t freeConversion(surface_nv_ctx_t *nv)
+{
+  size_t freed = 0;
+  int i;
+
+  // the images hold references to the buffers
+  for(i = 0; i < nv->numTextureNames; i++)
+    destroyImage(nv, i);
+
+  if (cedarv_isValid(nv->convY))
+  {
+    freed += cedarv_getSize(nv->convY);
+    cedarv_free(nv->convY);
+  }
+  if (cedarv_isValid(nv->convU))
+  {
+    freed += cedarv_getSize(nv->convU);
+    cedarv_free(nv->convU);
+  }
+  if (cedarv_isValid(nv->convV))
+  {
+    freed += cedarv_getSize(nv->convV);
+    cedarv_free(nv->convV);
+  }
+  nv->convY = nv->convU = nv->convV = noMemory;
+  nv->conv_source = NULL;
+  return freed;
+}
+
+static size_t evictConversion(void *context, size_t needed)
+{
+  size_t freed = 0;
+  surface_nv_ctx_t *nv;
+
+  // a map of this thread is allocating, its surfaces are in use
+  if (pthread_mutex_trylock(&nvMutex) != 0)
+    return 0;
+
+  for (nv = nvSurfaces; nv && freed < needed; nv = nv->next)
+    if (!nv->tiled && nv->vdpNvState != VdpauNVState_Mapped && cedarv_isValid(nv->convY))
+      freed += freeConversion(nv);
+
+  pthread_mutex_unlock(&nvMutex);
+  return freed;
+}
+
 static void mapVideoTextures(GLsizei numSurfaces, const vdpauSurfaceNV *surfaces)
 {
   int i, j;
+  pthread_mutex_lock(&nvMutex);
   for(j = 0; j < numSurfaces; j++)
   {
     surface_nv_ctx_t *nv = handle_get(surfaces[j]);
     assert(nv);
-    const EGLint renderImageAttrs[] = {
-      EGL_IMAGE_PRESERVED_KHR, EGL_FALSE, 
-      EGL_NONE
-    };
 
     video_surface_ctx_t *vs = handle_get(nv->surface);
     assert(vs);
 
-    //Log(0, "glVDPAUMapSurfacesNV: starting MB2Yuv planar convert");
-    cedarv_disp_convertMb2Yuv420(nv->conv_width, nv->conv_height,
-                                 vs->dataY, vs->dataU, nv->convY, nv->convU, nv->convV);
-    //Log(0, "glVDPAUMapSurfacesNV: finished MB2Yuv planar convert");
-
-    for(i = 0; (nv->vdpNvState == VdpauNVState_Registered) && (i < nv->numTextureNames); i++)
+    CEDARV_MEMORY dataY, dataU;
+    uint32_t width, height;
+    video_surface_get_display(vs, &dataY, &dataU, &width, &height);
+    // a rotated copy came or went, the textures and their images get the new size
+    if (!nv->tiled && (((width + 15) & ~15) != nv->conv_width || ((height + 15) & ~15) != nv->conv_height))
     {
+      for(i = 0; i < nv->numTextureNames; i++)
+        destroyImage(nv, i);
+      nv->conv_width = (width + 15) & ~15;
+      nv->conv_height = (height + 15) & ~15;
+      nv->conv_source = NULL;
+    }
 
-      glActiveTexture(GL_TEXTURE0 + nv->textureNames[i]);
-      EGLint iErr = eglGetError();
-      assert (iErr == EGL_SUCCESS);
-      
-      glBindTexture(GL_TEXTURE_2D, nv->textureNames[i]);
-      iErr = eglGetError();
-      assert (iErr == EGL_SUCCESS);
-      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-      iErr = eglGetError();
-      assert (iErr == EGL_SUCCESS);
-      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      if (i == 0 || i == 1 )
-      {
-        createTexture2D(&nv->cMemPixmap[i], nv, vs, y_plane);
-      }
-      else if(i == 2 || i == 3) 
-      {
-        if(nv->numTextureNames == 6)
-          createTexture2D(&nv->cMemPixmap[i], nv, vs, u_plane);
-        else
-          createTexture2D(&nv->cMemPixmap[i], nv, vs, uv_plane);
-      }
-      else
+    if (!nv->tiled && !cedarv_isValid(nv->convY) && !allocConversion(nv, vs->plane_size))
+      log_warning("no memory for the conversion buffers, surface not mapped");
+    else if (nv->tiled)
+    {
+      // the shader only knows the decoder's tiles, put_bits surfaces and rotated copies are linear
+      if (vs->source_format != INTERNAL_YCBCR_FORMAT || vs->rotated)
+        VDPAU_DBG_ONCE("surface isn't MB32 tiled, textures show garbage");
+    }
+    else if (nv->conv_source != vs || nv->conv_generation != vs->generation)
+    {
+      // runs while the next surfaces are mapped, waited for below
+      nv->conv_source = NULL;
+      if (cedarv_disp_queueMb2Yuv420(nv->conv_width, nv->conv_height,
+                                     dataY, dataU, nv->convY, nv->convU, nv->convV))
       {
-        createTexture2D(&nv->cMemPixmap[i], nv, vs, v_plane);
+        nv->conv_pending = vs;
+        nv->conv_pending_generation = vs->generation;
       }
-      vs->vdpNvState = VdpauNVState_Mapped;
-      //create the chrominance egl image
-      nv->eglImage[i] = peglCreateImageKHR(eglDisplay,
-                                           EGL_NO_CONTEXT,  
-                                           EGL_NATIVE_PIXMAP_KHR,
-                                           &nv->cMemPixmap[i],
-                                           renderImageAttrs);
-      iErr = eglGetError();
-      assert (iErr == EGL_SUCCESS);
-      pglEGLImageTargetTexture2DOES(GL_TEXTURE_2D, (GLeglImageOES)nv->eglImage[i]);
-      iErr = glGetError();
-      //assert (iErr == GL_NO_ERROR);
     }
+
+    // the images were created at register time, only redo those whose buffer changed
+    for(i = 0; i < nv->numTextureNames; i++)
+    {
+      CEDARV_MEMORY mem = planeMemory(nv, vs, texturePlane(nv, i));
+      if (!cedarv_isValid(mem) || (nv->eglImage[i] && nv->cMemPixmap[i].data == (void *)mem.mem_id))
+        continue;
+      destroyImage(nv, i);
+      createVideoImage(nv, vs, i);
+    }
+    vs->vdpNvState = VdpauNVState_Mapped;
     handle_release(nv->surface);
     nv->vdpNvState = VdpauNVState_Mapped;
     handle_release(surfaces[j]);
   }
+
+  // which one failed isn't known, all of them convert again on the next map
+  int failed = cedarv_disp_sync();
+  surface_nv_ctx_t *nv;
+  for (nv = nvSurfaces; nv; nv = nv->next)
+  {
+    if (nv->conv_pending && !failed)
+    {
+      nv->conv_source = nv->conv_pending;
+      nv->conv_generation = nv->conv_pending_generation;
+    }
+    nv->conv_pending = NULL;
+  }
+  pthread_mutex_unlock(&nvMutex);
 }
 
 static void mapOutputTextures(GLsizei numSurfaces, const vdpauSurfaceNV *surfaces)
 {
-  int i, j;
+  int j;
+  pthread_mutex_lock(&nvMutex);
   for(j = 0; j < numSurfaces; j++)
   {
     surface_nv_ctx_t *nv = handle_get(surfaces[j]);
     assert(nv);
-    const EGLint renderImageAttrs[] = {
-      EGL_IMAGE_PRESERVED_KHR, EGL_FALSE, 
-      EGL_NONE
-    };
 
     output_surface_ctx_t *vs = handle_get(nv->surface);
     assert(vs);
 
-    //Log(0, "glVDPAUMapSurfacesNV: starting MB2Yuv planar convert");
-    cedarv_disp_convertMb2RGB(nv->conv_width, nv->conv_height,
-                                 vs->vs->dataY, vs->vs->dataU, nv->convY);
-    //Log(0, "glVDPAUMapSurfacesNV: finished MB2Yuv planar convert");
-
-    for(i = 0; (nv->vdpNvState == VdpauNVState_Registered) && (i < nv->numTextureNames); i++)
+    if (!cedarv_isValid(nv->convY) && !allocConversion(nv, vs->vs->plane_size))
+      log_warning("no memory for the conversion buffer, surface not mapped");
+    else if (nv->conv_source != vs->vs || nv->conv_generation != vs->vs->generation)
     {
+      nv->conv_source = NULL;
+      if (cedarv_disp_convertMb2RGB(nv->conv_width, nv->conv_height,
+                                    vs->vs->dataY, vs->vs->dataU, nv->convY))
+      {
+        nv->conv_source = vs->vs;
+        nv->conv_generation = vs->vs->generation;
+      }
+    }
 
-      glActiveTexture(GL_TEXTURE0 + nv->textureNames[i]);
-      EGLint iErr = eglGetError();
-      assert (iErr == EGL_SUCCESS);
-      
-      glBindTexture(GL_TEXTURE_2D, nv->textureNames[i]);
-      iErr = eglGetError();
-      assert (iErr == EGL_SUCCESS);
-      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-      iErr = eglGetError();
-      assert (iErr == EGL_SUCCESS);
-      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      createTextureRGB2D(&nv->cMemPixmap[i], nv, vs);
-      vs->vdpNvState = VdpauNVState_Mapped;
-      //create the chrominance egl image
-      nv->eglImage[i] = peglCreateImageKHR(eglDisplay,
-                                           EGL_NO_CONTEXT,  
-                                           EGL_NATIVE_PIXMAP_KHR,
-                                           &nv->cMemPixmap[i],
-                                           renderImageAttrs);
-      iErr = eglGetError();
-      assert (iErr == EGL_SUCCESS);
-      pglEGLImageTargetTexture2DOES(GL_TEXTURE_2D, (GLeglImageOES)nv->eglImage[i]);
-      iErr = glGetError();
-      assert (iErr == GL_NO_ERROR);
+    if (!nv->eglImage[0] && cedarv_isValid(nv->convY))
+    {
+      destroyImage(nv, 0);
+      createOutputImage(nv, vs, 0);
     }
+    // mapped is shown, the next render starts a new frame
+    vs->video_composing = 0;
+    vs->vdpNvState = VdpauNVState_Mapped;
     handle_release(nv->surface);
     nv->vdpNvState = VdpauNVState_Mapped;
     handle_release(surfaces[j]);
   }
+  pthread_mutex_unlock(&nvMutex);
 }
 
 static void createTexture2D(fbdev_pixmap *pm, surface_nv_ctx_t *nv, video_surface_ctx_t *vs, enum col_plane cp)
@@ -445,53 +713,33 @@ static void createTexture2D(fbdev_pixmap *pm, surface_nv_ctx_t *nv, video_surfac
    int height = 0;
 
 
+   mem = planeMemory(nv, vs, cp);
    switch(cp)
    {
       case(y_plane):
-#if USE_TILE
-         mem = vs->dataY;
-         width = vs->width;
-         height = vs->height;
-#else
-         mem = nv->convY;
          width = nv->conv_width;
          height = nv->conv_height;
-#endif
+         if (nv->tiled)
+         {
+            width = 1024;
+            height = vs->plane_size / 1024;
+         }
          break;
       case(u_plane):
-#if USE_TILE
-         mem = vs->dataU;
-         width = (vs->width + 1)/2;
-         height = (vs->height + 1)/2;
-#else
-         mem = nv->convU;
-         width = (nv->conv_width + 1) / 2;
-         height = (nv->conv_height+1) / 2;
-#endif
-         break;
       case(v_plane):
-#if USE_TILE
-         mem = vs->dataV;
-         width = (vs->width + 1) / 2;
-         height = (vs->height + 1) / 2;
-#else
-         mem = nv->convV;
          width = (nv->conv_width + 1) / 2;
          height = (nv->conv_height + 1) / 2;
-#endif
          break;
       case(uv_plane):
          buf_size = 16;
          lum_size = 8;
          alpha_size = 8;
          format = GL_LUMINANCE_ALPHA;
-#if USE_TILE
-         mem = vs->dataU;
-         width = (vs->width + 1) / 2;
-         height = vs->height;
-#else
-         mem = nv->convU;
-#endif
+         if (nv->tiled)
+         {
+            width = 512;
+            height = vs->plane_size / 2048;
+         }
    }
 
    pm->bytes_per_pixel 	= buf_size / 8;
@@ -562,27 +810,19 @@ void glVDPAUMapSurfacesNV(GLsizei numSurfaces, const vdpauSurfaceNV *surfaces)
 
 void glVDPAUUnmapSurfacesNV(GLsizei numSurfaces, const vdpauSurfaceNV *surfaces)
 {
-  int i,j;
+  int j;
   
   for(j = 0; j < numSurfaces; j++)
   {
     surface_nv_ctx_t *nv  = handle_get(surfaces[j]);
     assert(nv);
     
-    for(i = 0; (nv->vdpNvState == VdpauNVState_Mapped) && (i < nv->numTextureNames); i++)
+    // the images stay bound for the next map
+    if(nv->vdpNvState == VdpauNVState_Mapped)
     {
       video_surface_ctx_t *vs = handle_get(nv->surface);
       assert(vs);
       vs->vdpNvState = VdpauNVState_Registered;
-      glActiveTexture(GL_TEXTURE0 + nv->textureNames[i]);
-      glBindTexture(GL_TEXTURE_2D, 0);
-      if(nv->eglImage[i])
-      {
-         peglDestroyImageKHR(eglDisplay, nv->eglImage[i]);
-         nv->eglImage[i] = 0;
-      }
-      ump_reference_release(nv->cMemPixmap[i].data);
-      //cedarv_setBufferInvalid((CEDARV_MEMORY)nv->cMemPixmap[i].data);
       handle_release(nv->surface);
     }
     nv->vdpNvState = VdpauNVState_Registered;
@@ -26,6 +26,16 @@ typedef struct surface_nv_ctx_struct
   CEDARV_MEMORY         convV;
   uint32_t              conv_width;
   uint32_t              conv_height;
+  // what the conversion buffers hold, to skip converting an unchanged frame again
+  const void            *conv_source;
+  uint32_t              conv_generation;
+  // queued conversion, becomes conv_source once the scaler succeeded
+  const void            *conv_pending;
+  uint32_t              conv_pending_generation;
+  // textures show the MB32 tiled planes, the application detiles with the supplied shader
+  int                   tiled;
+  // registered surfaces, for giving back the conversion buffers of unmapped ones
+  struct surface_nv_ctx_struct *next;
 } surface_nv_ctx_t;
 
 #endif
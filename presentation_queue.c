@@ -27,6 +27,18 @@
 #include "ve.h"
 #include <errno.h>
 #include <stdio.h>
+#include "timeline.h"
+
+// layer and video ioctls show up on the timeline under their command name
+#define disp_ioctl(fd, cmd, args) timeline_ioctl(#cmd, fd, cmd, (void *)(args))
+
+static int timeline_ioctl(const char *name, int fd, unsigned long cmd, void *args)
+{
+	TIMELINE_BEGIN(name);
+	int ret = ioctl(fd, cmd, args);
+	TIMELINE_END(name);
+	return ret;
+}
 
 uint64_t get_time(void)
 {
@@ -64,7 +76,9 @@ VdpStatus vdp_presentation_queue_target_create_x11(VdpDevice device, Drawable dr
         return VDP_STATUS_ERROR;
     }
 
-    dev->fb_fd = open("/dev/fb0", O_RDWR);
+    // the device keeps the framebuffer open for later targets
+    if (dev->fb_fd == -1)
+        dev->fb_fd = open("/dev/fb0", O_RDWR);
     if (dev->fb_fd == -1)
     {
         close(qt->fd);
@@ -77,7 +91,6 @@ VdpStatus vdp_presentation_queue_target_create_x11(VdpDevice device, Drawable dr
     if (ioctl(qt->fd, DISP_CMD_VERSION, &ver) < 0)
     {
         close(qt->fd);
-        close(dev->fb_fd);
         handle_release(device);
         handle_destroy(*target);
         return VDP_STATUS_ERROR;
@@ -86,7 +99,6 @@ VdpStatus vdp_presentation_queue_target_create_x11(VdpDevice device, Drawable dr
     if (ioctl(dev->fb_fd, FBIOGET_LAYER_HDL_0, &dev->fb_layer_id))
     {
         close(qt->fd);
-        close(dev->fb_fd);
         handle_release(device);
         handle_destroy(*target);
         return VDP_STATUS_ERROR;
@@ -100,20 +112,31 @@ VdpStatus vdp_presentation_queue_target_create_x11(VdpDevice device, Drawable dr
        args[1] = i;
        args[2] = 0;
        args[3] = 0;
-       ioctl(qt->fd, DISP_CMD_LAYER_RELEASE, &args[0]);
+       disp_ioctl(qt->fd, DISP_CMD_LAYER_RELEASE, &args[0]);
     }
 
     args[1] = DISP_LAYER_WORK_MODE_SCALER;
-    qt->layer = ioctl(qt->fd, DISP_CMD_LAYER_REQUEST, args);
+    qt->layer = disp_ioctl(qt->fd, DISP_CMD_LAYER_REQUEST, args);
     if (qt->layer == 0)
     {
             close(qt->fd);
-            close(dev->fb_fd);
             handle_release(device);
             handle_destroy(*target);
             return VDP_STATUS_RESOURCES;
     }
 
+    // second layer above the video for the OSD rendered into output surfaces
+    if (dev->osd_enabled)
+    {
+        args[0] = dev->fb_id;
+        args[1] = DISP_LAYER_WORK_MODE_NORMAL;
+        args[2] = 0;
+        args[3] = 0;
+        qt->layer_top = disp_ioctl(qt->fd, DISP_CMD_LAYER_REQUEST, args);
+        if (qt->layer_top == 0)
+            VDPAU_DBG("Failed to request OSD layer! OSD not shown.");
+    }
+
     //XSetWindowBackground(dev->display, drawable, 0x000102);
 
     __disp_colorkey_t ck;
@@ -145,14 +168,14 @@ VdpStatus vdp_presentation_queue_target_create_x11(VdpDevice device, Drawable dr
     tmp[1] = dev->fb_layer_id;
     tmp[2] = (unsigned long) (&layer_info);
     tmp[3] = 0;
-    if (ioctl(qt->fd, DISP_CMD_LAYER_GET_PARA, tmp) < 0)
+    if (disp_ioctl(qt->fd, DISP_CMD_LAYER_GET_PARA, tmp) < 0)
     {
             printf("layer get para failed\n");
     }
     layer_info.alpha_en = 1;
     layer_info.alpha_val = 255;
 
-    if (ioctl(qt->fd, DISP_CMD_LAYER_SET_PARA, tmp) < 0)
+    if (disp_ioctl(qt->fd, DISP_CMD_LAYER_SET_PARA, tmp) < 0)
     {
             printf("layer get para failed\n");
     }
@@ -162,7 +185,7 @@ VdpStatus vdp_presentation_queue_target_create_x11(VdpDevice device, Drawable dr
     /* Enable color key for the overlay layer */
     tmp[0] = dev->fb_id;
     tmp[1] = qt->layer;
-    if (ioctl(qt->fd, DISP_CMD_LAYER_CK_ON, &tmp) < 0)
+    if (disp_ioctl(qt->fd, DISP_CMD_LAYER_CK_ON, &tmp) < 0)
     {
             printf("layer ck on failed\n");
     }
@@ -175,16 +198,26 @@ VdpStatus vdp_presentation_queue_target_create_x11(VdpDevice device, Drawable dr
     
     tmp[0] = dev->fb_id;
     tmp[1] = qt->layer;
-    if (ioctl(qt->fd, DISP_CMD_LAYER_TOP, &tmp) < 0)
+    if (disp_ioctl(qt->fd, DISP_CMD_LAYER_TOP, &tmp) < 0)
     {
         printf("layer bottom 2 failed\n");
     }
+
+    if (qt->layer_top)
+    {
+        tmp[0] = dev->fb_id;
+        tmp[1] = qt->layer_top;
+        if (disp_ioctl(qt->fd, DISP_CMD_LAYER_TOP, &tmp) < 0)
+        {
+            printf("osd layer top failed\n");
+        }
+    }
 #if 0
     // but should be 1 when layering is fixed again.
     /* Set the overlay layer below the screen layer */
     tmp[0] = dev->fb_id;
     tmp[1] = dev->fb_layer_id;
-    if (ioctl(qt->fd, DISP_CMD_LAYER_TOP, &tmp) < 0)
+    if (disp_ioctl(qt->fd, DISP_CMD_LAYER_TOP, &tmp) < 0)
     {
         printf("layer bottom 1 failed\n");
     }
@@ -194,32 +227,32 @@ VdpStatus vdp_presentation_queue_target_create_x11(VdpDevice device, Drawable dr
     /* Disable color key and enable global alpha for the screen layer */
     tmp[0] = dev->fb_id;
     tmp[1] = dev->fb_layer_id;
-    if (ioctl(qt->fd, DISP_CMD_LAYER_CK_OFF, &tmp) < 0)
+    if (disp_ioctl(qt->fd, DISP_CMD_LAYER_CK_OFF, &tmp) < 0)
     {
             printf("layer ck off failed\n");
     }
     tmp[0] = dev->fb_id;
     tmp[1] = dev->fb_layer_id;
     tmp[2] = 0xFF;
-    if (ioctl(qt->fd,DISP_CMD_LAYER_SET_ALPHA_VALUE,(void*)tmp) < 0)
+    if (disp_ioctl(qt->fd, DISP_CMD_LAYER_SET_ALPHA_VALUE,(void*)tmp) < 0)
     {
             printf("set alpha value failed\n");
     }
 
     tmp[0] = dev->fb_id;
     tmp[1] = dev->fb_layer_id;
-    if (ioctl(qt->fd, DISP_CMD_LAYER_ALPHA_ON, &tmp) < 0)
+    if (disp_ioctl(qt->fd, DISP_CMD_LAYER_ALPHA_ON, &tmp) < 0)
     {
             printf("alpha on failed\n");
     }
 #if 0
-    error = ioctl(q->target->fd_disp, DISP_CMD_LAYER_BOTTOM, args);
+    error = disp_ioctl(q->target->fd_disp, DISP_CMD_LAYER_BOTTOM, args);
     if(error < 0)
     {
             printf("layer top failed\n");
     }
 
-    if (ioctl(qt->fd, DISP_CMD_VIDEO_START, args) < 0)
+    if (disp_ioctl(qt->fd, DISP_CMD_VIDEO_START, args) < 0)
     {
             printf("video start failed\n");
     }
@@ -238,8 +271,24 @@ VdpStatus vdp_presentation_queue_target_destroy(VdpPresentationQueueTarget prese
 		return VDP_STATUS_INVALID_HANDLE;
 
 	uint32_t args[4] = { 0, qt->layer, 0, 0 };
-	ioctl(qt->fd, DISP_CMD_LAYER_CLOSE, args);
-	ioctl(qt->fd, DISP_CMD_LAYER_RELEASE, args);
+	if (qt->video_started)
+		disp_ioctl(qt->fd, DISP_CMD_VIDEO_STOP, args);
+	disp_ioctl(qt->fd, DISP_CMD_LAYER_CLOSE, args);
+	disp_ioctl(qt->fd, DISP_CMD_LAYER_RELEASE, args);
+	int i;
+	for (i = 0; i < OUTPUT_PIP_MAX; i++)
+		if (qt->layer_pip[i])
+		{
+			args[1] = qt->layer_pip[i];
+			disp_ioctl(qt->fd, DISP_CMD_LAYER_CLOSE, args);
+			disp_ioctl(qt->fd, DISP_CMD_LAYER_RELEASE, args);
+		}
+	if (qt->layer_top)
+	{
+		args[1] = qt->layer_top;
+		disp_ioctl(qt->fd, DISP_CMD_LAYER_CLOSE, args);
+		disp_ioctl(qt->fd, DISP_CMD_LAYER_RELEASE, args);
+	}
 
 	close(qt->fd);
 
@@ -347,6 +396,294 @@ VdpStatus vdp_presentation_queue_get_time(VdpPresentationQueue presentation_queu
 	return VDP_STATUS_OK;
 }
 
+/*
+ * Show what was rendered into the output surface on the layer above
+ * the video, or hide that layer if there is nothing.
+ */
+static void display_osd(queue_ctx_t *q, output_surface_ctx_t *os, uint32_t clip_width, uint32_t clip_height)
+{
+	uint32_t args[4] = { 0, q->target->layer_top, 0, 0 };
+
+	if (!q->target->layer_top)
+		return;
+
+	// also does a delayed clear, the surface might be empty afterwards
+	rgba_flush(&os->rgba);
+
+	if (!(os->rgba.flags & RGBA_FLAG_DIRTY))
+	{
+		disp_ioctl(q->target->fd, DISP_CMD_LAYER_CLOSE, args);
+		return;
+	}
+
+	__disp_layer_info_t layer_info;
+	memset(&layer_info, 0, sizeof(layer_info));
+	layer_info.pipe = 1;
+	layer_info.mode = DISP_LAYER_WORK_MODE_NORMAL;
+	layer_info.fb.mode = DISP_MOD_INTERLEAVED;
+	layer_info.fb.format = DISP_FORMAT_ARGB8888;
+	layer_info.fb.seq = DISP_SEQ_ARGB;
+	layer_info.fb.br_swap = (os->rgba.format == VDP_RGBA_FORMAT_R8G8B8A8);
+	//recalc data to cpu kernel addresses (+ 0x40000000)
+	layer_info.fb.addr[0] = cedarv_virt2phys(os->rgba.data) + 0x40000000;
+	layer_info.fb.cs_mode = DISP_BT601;
+	layer_info.fb.size.width = os->rgba.width;
+	layer_info.fb.size.height = os->rgba.height;
+	layer_info.src_win.x = 0;
+	layer_info.src_win.y = 0;
+	layer_info.src_win.width = clip_width ? min(clip_width, os->rgba.width) : os->rgba.width;
+	layer_info.src_win.height = clip_height ? min(clip_height, os->rgba.height) : os->rgba.height;
+	layer_info.scn_win.x = 0;
+	layer_info.scn_win.y = 0;
+	layer_info.scn_win.width = layer_info.src_win.width;
+	layer_info.scn_win.height = layer_info.src_win.height;
+
+	args[2] = (unsigned long)(&layer_info);
+	if (disp_ioctl(q->target->fd, DISP_CMD_LAYER_SET_PARA, args) < 0)
+		log_error("osd set para failed");
+
+	disp_ioctl(q->target->fd, DISP_CMD_LAYER_OPEN, args);
+}
+
+/*
+ * The mixer source rect is in coordinates of the decoded picture,
+ * map it onto the rotated copy.
+ */
+static void rotate_rect(VdpRect *r, video_surface_ctx_t *vs)
+{
+	VdpRect s = *r;
+	uint32_t w = vs->width, h = vs->height;
+
+	switch (vs->rotation)
+	{
+	case VDP_SUNXI_ROTATION_90:
+		r->x0 = h - s.y1; r->x1 = h - s.y0;
+		r->y0 = s.x0; r->y1 = s.x1;
+		break;
+	case VDP_SUNXI_ROTATION_180:
+		r->x0 = w - s.x1; r->x1 = w - s.x0;
+		r->y0 = h - s.y1; r->y1 = h - s.y0;
+		break;
+	case VDP_SUNXI_ROTATION_270:
+		r->x0 = s.y0; r->x1 = s.y1;
+		r->y0 = w - s.x1; r->y1 = w - s.x0;
+		break;
+	case VDP_SUNXI_ROTATION_FLIP_H:
+		r->x0 = w - s.x1; r->x1 = w - s.x0;
+		break;
+	case VDP_SUNXI_ROTATION_FLIP_V:
+		r->y0 = h - s.y1; r->y1 = h - s.y0;
+		break;
+	}
+}
+
+/*
+ * Framebuffer of a scaler layer showing the video surface.
+ */
+static void set_video_fb(__disp_fb_t *fb, video_surface_ctx_t *vs)
+{
+	fb->format = DISP_FORMAT_YUV420;
+	fb->seq = DISP_SEQ_UVUV;
+	switch (vs->source_format) {
+	case VDP_YCBCR_FORMAT_YUYV:
+		fb->mode = DISP_MOD_INTERLEAVED;
+		fb->format = DISP_FORMAT_YUV422;
+		fb->seq = DISP_SEQ_YUYV;
+		break;
+	case VDP_YCBCR_FORMAT_UYVY:
+		fb->mode = DISP_MOD_INTERLEAVED;
+		fb->format = DISP_FORMAT_YUV422;
+		fb->seq = DISP_SEQ_UYVY;
+		break;
+	case VDP_YCBCR_FORMAT_NV12:
+		fb->mode = DISP_MOD_NON_MB_UV_COMBINED;
+		break;
+	case VDP_YCBCR_FORMAT_YV12:
+		fb->mode = DISP_MOD_NON_MB_PLANAR;
+		break;
+	case INTERNAL_YCBCR_FORMAT_422:
+		fb->mode = DISP_MOD_MB_UV_COMBINED;
+		fb->format = DISP_FORMAT_YUV422;
+		break;
+	default:
+	case INTERNAL_YCBCR_FORMAT:
+		fb->mode = DISP_MOD_MB_UV_COMBINED;
+		break;
+	}
+	
+	// the rotated copy if the decoder wrote one
+	CEDARV_MEMORY dataY, dataU;
+	uint32_t width, height;
+	video_surface_get_display(vs, &dataY, &dataU, &width, &height);
+
+	fb->br_swap = 0;
+	//recalc data to cpu kernel addresses (+ 0x40000000)
+	fb->addr[0] = cedarv_virt2phys(dataY) + 0x40000000;
+	fb->addr[1] = cedarv_virt2phys(dataU)/* + vs->plane_size*/ + 0x40000000;
+	if( cedarv_isValid(vs->dataV))
+	  fb->addr[2] = cedarv_virt2phys(vs->dataV)/* + vs->plane_size + vs->plane_size / 4*/ + 0x40000000;
+
+	fb->cs_mode = DISP_BT709;
+	fb->size.width = width; //q->target->screen_width;
+	fb->size.height = width; //q->target->screen_height;
+}
+
+static int request_pip_layer(queue_ctx_t *q, int i)
+{
+	queue_target_ctx_t *qt = q->target;
+	uint32_t args[4] = { 0, DISP_LAYER_WORK_MODE_SCALER, 0, 0 };
+
+	int layer = disp_ioctl(qt->fd, DISP_CMD_LAYER_REQUEST, args);
+	if (layer <= 0)
+	{
+		// the mixer puts further videos into the OSD from now on
+		q->device->pip_layers = i;
+		VDPAU_DBG("Only %d scaler layers for picture-in-picture", i);
+		return 0;
+	}
+	qt->layer_pip[i] = layer;
+
+	// above the video and the ones before, below the OSD
+	args[1] = layer;
+	disp_ioctl(qt->fd, DISP_CMD_LAYER_TOP, args);
+	if (qt->layer_top)
+	{
+		args[1] = qt->layer_top;
+		disp_ioctl(qt->fd, DISP_CMD_LAYER_TOP, args);
+	}
+
+	return 1;
+}
+
+/*
+ * Further videos the mixer put into the output surface, each on a
+ * scaler layer of its own. Layers are requested when first needed and
+ * closed while unused.
+ */
+static void display_pips(queue_ctx_t *q, output_surface_ctx_t *os)
+{
+	queue_target_ctx_t *qt = q->target;
+	int i;
+
+	for (i = 0; i < OUTPUT_PIP_MAX; i++)
+	{
+		uint32_t args[4] = { 0, qt->layer_pip[i], 0, 0 };
+
+		if (i >= os->pip_count)
+		{
+			if (qt->layer_pip[i])
+				disp_ioctl(qt->fd, DISP_CMD_LAYER_CLOSE, args);
+			continue;
+		}
+
+		if (!qt->layer_pip[i] && !request_pip_layer(q, i))
+			break;
+
+		output_pip_t *pip = &os->pip[i];
+		__disp_layer_info_t layer_info;
+		memset(&layer_info, 0, sizeof(layer_info));
+		layer_info.pipe = 1;
+		layer_info.alpha_en = 1;
+		layer_info.alpha_val = 0xff;
+		layer_info.mode = DISP_LAYER_WORK_MODE_SCALER;
+		set_video_fb(&layer_info.fb, pip->vs);
+
+		VdpRect src_rect = pip->src_rect;
+		if (pip->vs->rotated)
+			rotate_rect(&src_rect, pip->vs);
+		layer_info.src_win.x = src_rect.x0;
+		layer_info.src_win.y = src_rect.y0;
+		layer_info.src_win.width = src_rect.x1 - src_rect.x0;
+		layer_info.src_win.height = src_rect.y1 - src_rect.y0;
+		layer_info.scn_win.x = pip->dst_rect.x0;
+		layer_info.scn_win.y = pip->dst_rect.y0;
+		layer_info.scn_win.width = pip->dst_rect.x1 - pip->dst_rect.x0;
+		layer_info.scn_win.height = pip->dst_rect.y1 - pip->dst_rect.y0;
+		layer_info.ck_enable = 1;
+
+		args[1] = qt->layer_pip[i];
+		args[2] = (unsigned long)(&layer_info);
+		if (disp_ioctl(qt->fd, DISP_CMD_LAYER_SET_PARA, args) < 0)
+			log_error("pip set para failed");
+
+		disp_ioctl(qt->fd, DISP_CMD_LAYER_OPEN, args);
+	}
+}
+
+/*
+ * Bob deinterlacing for linear surfaces without copying anything, the
+ * scaler reads every second line from a framebuffer of twice the pitch
+ * and stretches the field to full height.
+ */
+static void bob_field(__disp_layer_info_t *layer_info, video_surface_ctx_t *vs, int bottom)
+{
+	uint32_t pitch = vs->width;
+	if (vs->source_format == VDP_YCBCR_FORMAT_YUYV || vs->source_format == VDP_YCBCR_FORMAT_UYVY)
+		pitch *= 2;
+
+	if (bottom)
+	{
+		layer_info->fb.addr[0] += pitch;
+		if (vs->source_format == VDP_YCBCR_FORMAT_NV12)
+			layer_info->fb.addr[1] += vs->width;
+		else if (vs->source_format == VDP_YCBCR_FORMAT_YV12)
+		{
+			layer_info->fb.addr[1] += vs->width / 2;
+			layer_info->fb.addr[2] += vs->width / 2;
+		}
+	}
+
+	layer_info->fb.size.width = vs->width * 2;
+	layer_info->fb.size.height = (vs->height + 1) / 2;
+	layer_info->src_win.y /= 2;
+	layer_info->src_win.height /= 2;
+}
+
+/*
+ * Tiled field pictures go through the deinterlacer of the display
+ * engine, which only runs in video mode. It keeps the previous frame
+ * itself, the past surface from the mixer only tells there is one.
+ */
+static void set_deinterlace(queue_ctx_t *q, output_surface_ctx_t *os, int enable, int bottom_first, const __disp_fb_t *fb)
+{
+	queue_target_ctx_t *qt = q->target;
+	uint32_t args[4] = { 0, qt->layer, 0, 0 };
+
+	if (!enable)
+	{
+		if (qt->video_started)
+			disp_ioctl(qt->fd, DISP_CMD_VIDEO_STOP, args);
+		qt->video_started = 0;
+		return;
+	}
+
+	if (!qt->video_started)
+	{
+		if (disp_ioctl(qt->fd, DISP_CMD_VIDEO_START, args) < 0)
+		{
+			log_warning("display engine deinterlacer not available, tiled fields are shown as frames");
+			qt->video_unavailable = 1;
+			return;
+		}
+		qt->video_started = 1;
+	}
+
+	__disp_video_fb_t video;
+	memset(&video, 0, sizeof(video));
+	video.id = ++qt->video_id;
+	video.addr[0] = fb->addr[0];
+	video.addr[1] = fb->addr[1];
+	video.addr[2] = fb->addr[2];
+	video.interlace = 1;
+	// the field asked for first, the engine shows the other one next vsync
+	video.top_field_first = !bottom_first;
+	video.pre_frame_valid = os->video_deinterlace && os->video_has_past;
+
+	args[2] = (unsigned long)(&video);
+	if (disp_ioctl(qt->fd, DISP_CMD_VIDEO_SET_FB, args) < 0)
+		log_error("video set fb failed");
+}
+
 VdpStatus vdp_presentation_queue_display(VdpPresentationQueue presentation_queue, VdpOutputSurface surface, uint32_t clip_width, uint32_t clip_height, VdpTime earliest_presentation_time)
 {
         int error;
@@ -362,10 +699,23 @@ VdpStatus vdp_presentation_queue_display(VdpPresentationQueue presentation_queue
 		return VDP_STATUS_INVALID_HANDLE;
         }
 
+	display_osd(q, os, clip_width, clip_height);
+	display_pips(q, os);
+	// the next render into the surface starts a new frame
+	os->video_composing = 0;
+
 	if (!(os->vs))
 	{
-		printf("trying to display empty surface\n");
-		VDPAU_DBG("trying to display empty surface");
+		if (os->rgba.flags & RGBA_FLAG_DIRTY)
+		{
+			// nothing but OSD on this surface
+			completion_displayed(q->device, surface);
+			handle_release(presentation_queue);
+			handle_release(surface);
+			return VDP_STATUS_OK;
+		}
+
+		log_warning("trying to display empty surface");
                 handle_release(presentation_queue);
                 handle_release(surface);
 		return VDP_STATUS_OK;
@@ -389,41 +739,7 @@ VdpStatus vdp_presentation_queue_display(VdpPresentationQueue presentation_queue
         layer_info.alpha_val = 0xff;
 #endif
 	layer_info.mode = DISP_LAYER_WORK_MODE_SCALER;
-	layer_info.fb.format = DISP_FORMAT_YUV420;
-	layer_info.fb.seq = DISP_SEQ_UVUV;
-	switch (os->vs->source_format) {
-	case VDP_YCBCR_FORMAT_YUYV:
-		layer_info.fb.mode = DISP_MOD_INTERLEAVED;
-		layer_info.fb.format = DISP_FORMAT_YUV422;
-		layer_info.fb.seq = DISP_SEQ_YUYV;
-		break;
-	case VDP_YCBCR_FORMAT_UYVY:
-		layer_info.fb.mode = DISP_MOD_INTERLEAVED;
-		layer_info.fb.format = DISP_FORMAT_YUV422;
-		layer_info.fb.seq = DISP_SEQ_UYVY;
-		break;
-	case VDP_YCBCR_FORMAT_NV12:
-		layer_info.fb.mode = DISP_MOD_NON_MB_UV_COMBINED;
-		break;
-	case VDP_YCBCR_FORMAT_YV12:
-		layer_info.fb.mode = DISP_MOD_NON_MB_PLANAR;
-		break;
-	default:
-	case INTERNAL_YCBCR_FORMAT:
-		layer_info.fb.mode = DISP_MOD_MB_UV_COMBINED;
-		break;
-	}
-	
-	layer_info.fb.br_swap = 0;
-	//recalc data to cpu kernel addresses (+ 0x40000000)
-	layer_info.fb.addr[0] = cedarv_virt2phys(os->vs->dataY) + 0x40000000;
-	layer_info.fb.addr[1] = cedarv_virt2phys(os->vs->dataU)/* + os->vs->plane_size*/ + 0x40000000;
-	if( cedarv_isValid(os->vs->dataV))
-	  layer_info.fb.addr[2] = cedarv_virt2phys(os->vs->dataV)/* + os->vs->plane_size + os->vs->plane_size / 4*/ + 0x40000000;
-
-	layer_info.fb.cs_mode = DISP_BT709;
-	layer_info.fb.size.width = os->vs->width; //q->target->screen_width;
-	layer_info.fb.size.height = os->vs->width; //q->target->screen_height;
+	set_video_fb(&layer_info.fb, os->vs);
 #if 0
        layer_info.src_win.x = 0;
        layer_info.src_win.y = 0;
@@ -432,10 +748,13 @@ VdpStatus vdp_presentation_queue_display(VdpPresentationQueue presentation_queue
        layer_info.scn_win.x = 0; //x + os->video_x;
        layer_info.scn_win.y = 0; //y + os->video_y;
 #endif
-	layer_info.src_win.x = os->video_src_rect.x0;
-	layer_info.src_win.y = os->video_src_rect.y0;
-	layer_info.src_win.width = os->video_src_rect.x1 - os->video_src_rect.x0;
-	layer_info.src_win.height = os->video_src_rect.y1 - os->video_src_rect.y0;
+	VdpRect src_rect = os->video_src_rect;
+	if (os->vs->rotated)
+		rotate_rect(&src_rect, os->vs);
+	layer_info.src_win.x = src_rect.x0;
+	layer_info.src_win.y = src_rect.y0;
+	layer_info.src_win.width = src_rect.x1 - src_rect.x0;
+	layer_info.src_win.height = src_rect.y1 - src_rect.y0;
 	layer_info.scn_win.x = x + os->video_dst_rect.x0;
 	layer_info.scn_win.y = y + os->video_dst_rect.y0;
 	layer_info.scn_win.width = os->video_dst_rect.x1 - os->video_dst_rect.x0;
@@ -451,19 +770,35 @@ VdpStatus vdp_presentation_queue_display(VdpPresentationQueue presentation_queue
 		layer_info.scn_win.height -= cutoff;
 	}
 
+	// fields from the mixer, bob linear surfaces here, tiled ones in the engine
+	int field = os->video_field != VDP_VIDEO_MIXER_PICTURE_STRUCTURE_FRAME;
+	int bottom = os->video_field == VDP_VIDEO_MIXER_PICTURE_STRUCTURE_BOTTOM_FIELD;
+	if (field && os->vs->rotated)
+	{
+		// the lines of a copy turned by 90 or 270 are columns of the fields, it is shown woven
+		if (os->vs->rotation == VDP_SUNXI_ROTATION_90 || os->vs->rotation == VDP_SUNXI_ROTATION_270)
+			field = 0;
+		// upside down the bottom field is on the even lines
+		else if (os->vs->rotation == VDP_SUNXI_ROTATION_180 || os->vs->rotation == VDP_SUNXI_ROTATION_FLIP_V)
+			bottom = !bottom;
+	}
+	int tiled = os->vs->source_format == INTERNAL_YCBCR_FORMAT || os->vs->source_format == INTERNAL_YCBCR_FORMAT_422;
+	int dit = field && tiled && !q->target->video_unavailable;
+	if (field && !tiled)
+		bob_field(&layer_info, os->vs, bottom);
 
 	uint32_t args[4] = { 0, q->target->layer, (unsigned long)(&layer_info), 0 };
-	error = ioctl(q->target->fd, DISP_CMD_LAYER_SET_PARA, args);
+	error = disp_ioctl(q->target->fd, DISP_CMD_LAYER_SET_PARA, args);
 	if(error < 0)
 	{
-		printf("set para failed\n");
+		log_error("set para failed");
 	}
 
 #if 1
-	error = ioctl(q->target->fd, DISP_CMD_LAYER_OPEN, args);
+	error = disp_ioctl(q->target->fd, DISP_CMD_LAYER_OPEN, args);
 	if(error < 0)
 	{
-		printf("layer open failed, fd=%d, errno=%d\n", q->target->fd, errno);
+		log_error("layer open failed, fd=%d, errno=%d", q->target->fd, errno);
 	}
 	// Note: might be more reliable (but slower and problematic when there
 	// are driver issues and the GET functions return wrong values) to query the
@@ -471,21 +806,24 @@ VdpStatus vdp_presentation_queue_display(VdpPresentationQueue presentation_queue
 	// Since the driver calculates a matrix out of these values after each
 	// set doing this unconditionally is costly.
 #endif
+	set_deinterlace(q, os, dit, bottom, &layer_info.fb);
+
 	if (os->csc_change) {
-		ioctl(q->target->fd, DISP_CMD_LAYER_ENHANCE_OFF, args);
+		disp_ioctl(q->target->fd, DISP_CMD_LAYER_ENHANCE_OFF, args);
 		args[2] = 0xff * os->brightness + 0x20;
-		ioctl(q->target->fd, DISP_CMD_LAYER_SET_BRIGHT, args);
+		disp_ioctl(q->target->fd, DISP_CMD_LAYER_SET_BRIGHT, args);
 		args[2] = 0x20 * os->contrast;
-		ioctl(q->target->fd, DISP_CMD_LAYER_SET_CONTRAST, args);
+		disp_ioctl(q->target->fd, DISP_CMD_LAYER_SET_CONTRAST, args);
 		args[2] = 0x20 * os->saturation;
-		ioctl(q->target->fd, DISP_CMD_LAYER_SET_SATURATION, args);
+		disp_ioctl(q->target->fd, DISP_CMD_LAYER_SET_SATURATION, args);
 		// hue scale is randomly chosen, no idea how it maps exactly
 		args[2] = (32 / 3.14) * os->hue + 0x20;
-		ioctl(q->target->fd, DISP_CMD_LAYER_SET_HUE, args);
-		ioctl(q->target->fd, DISP_CMD_LAYER_ENHANCE_ON, args);
+		disp_ioctl(q->target->fd, DISP_CMD_LAYER_SET_HUE, args);
+		disp_ioctl(q->target->fd, DISP_CMD_LAYER_ENHANCE_ON, args);
 		os->csc_change = 0;
 	}
 
+	completion_displayed(q->device, surface);
         handle_release(presentation_queue);
         handle_release(surface);
 	return VDP_STATUS_OK;
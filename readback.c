@@ -0,0 +1,349 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Video surface readback. Planes are copied in bands of 32 rows, which
+ * is one row of MB32 tiles, by the calling thread and a few helpers of
+ * the device. Tiled and linear sources go through the same 32 byte
+ * detile kernels, a tiled chunk is one line of a tile.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "vdpau_private.h"
+#include "detile.h"
+
+// four cores at most on sunxi, the caller works as well
+#define READBACK_THREADS_MAX 3
+#define BAND_ROWS 32
+
+enum readback_kind
+{
+	READBACK_COPY,
+	READBACK_SPLIT,
+	READBACK_PACK_YUYV,
+	READBACK_PACK_UYVY,
+};
+
+typedef struct
+{
+	enum readback_kind kind;
+	const uint8_t *src, *src2;
+	// 0 for MB32 tiled sources
+	uint32_t src_pitch;
+	uint32_t tiles;
+	uint8_t *dst, *dst2;
+	uint32_t dst_pitch, dst2_pitch;
+	// source bytes per row and rows
+	uint32_t width, height;
+} readback_op_t;
+
+struct readback_pool
+{
+	pthread_t threads[READBACK_THREADS_MAX];
+	int thread_count;
+	pthread_mutex_t lock;
+	pthread_mutex_t mutex;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	unsigned int job;
+	int busy;
+	int quit;
+	const readback_op_t *ops;
+	int op_count;
+	int band_count;
+	int next_band;
+};
+
+static const uint8_t *chunk(const readback_op_t *op, const uint8_t *src, uint32_t y, uint32_t x)
+{
+	if (op->src_pitch)
+		return src + y * op->src_pitch + x;
+
+	return detile_line(src, op->tiles, y, x);
+}
+
+static void run_band(const readback_op_t *op, uint32_t y0)
+{
+	const detile_kernels_t *k = detile_kernels();
+	uint32_t y, x, y1 = min(y0 + BAND_ROWS, op->height);
+
+	for (y = y0; y < y1; y++)
+	{
+		uint8_t *dst = op->dst + y * op->dst_pitch;
+		uint8_t *dst2 = op->dst2 ? op->dst2 + y * op->dst2_pitch : NULL;
+
+		for (x = 0; x < op->width; x += 32)
+		{
+			uint32_t n = min(op->width - x, 32u);
+			const uint8_t *src = chunk(op, op->src, y, x);
+
+			switch (op->kind)
+			{
+			case READBACK_COPY:
+				k->copy(dst + x, src, n);
+				break;
+			case READBACK_SPLIT:
+				k->split(dst + x / 2, dst2 + x / 2, src, n);
+				break;
+			case READBACK_PACK_YUYV:
+			case READBACK_PACK_UYVY:
+				k->pack(dst + 2 * x, src, chunk(op, op->src2, y, x), n, op->kind == READBACK_PACK_UYVY);
+				break;
+			}
+		}
+	}
+}
+
+static void run_bands(struct readback_pool *pool)
+{
+	int band;
+
+	while ((band = __sync_fetch_and_add(&pool->next_band, 1)) < pool->band_count)
+	{
+		int i;
+		for (i = 0; i < pool->op_count; i++)
+		{
+			int bands = (pool->ops[i].height + BAND_ROWS - 1) / BAND_ROWS;
+			if (band < bands)
+			{
+				run_band(&pool->ops[i], band * BAND_ROWS);
+				break;
+			}
+			band -= bands;
+		}
+	}
+}
+
+static void *readback_thread(void *arg)
+{
+	struct readback_pool *pool = arg;
+	unsigned int job = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (1)
+	{
+		while (!pool->quit && pool->job == job)
+			pthread_cond_wait(&pool->start, &pool->mutex);
+		if (pool->quit)
+			break;
+
+		job = pool->job;
+		pthread_mutex_unlock(&pool->mutex);
+
+		run_bands(pool);
+
+		pthread_mutex_lock(&pool->mutex);
+		if (--pool->busy == 0)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+static struct readback_pool *readback_pool_new(void)
+{
+	struct readback_pool *pool = calloc(1, sizeof(*pool));
+	if (!pool)
+		return NULL;
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int count = cpus > 1 ? min(cpus - 1, READBACK_THREADS_MAX) : 0;
+	while (pool->thread_count < count &&
+	       pthread_create(&pool->threads[pool->thread_count], NULL, readback_thread, pool) == 0)
+		pool->thread_count++;
+
+	return pool;
+}
+
+static struct readback_pool *readback_pool_get(device_ctx_t *dev)
+{
+	struct readback_pool *pool = __atomic_load_n(&dev->readback, __ATOMIC_ACQUIRE);
+	if (pool)
+		return pool;
+
+	pthread_mutex_lock(&dev->mutex);
+	pool = dev->readback;
+	if (!pool)
+	{
+		pool = readback_pool_new();
+		__atomic_store_n(&dev->readback, pool, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&dev->mutex);
+	return pool;
+}
+
+void readback_free(device_ctx_t *dev)
+{
+	struct readback_pool *pool = dev->readback;
+	if (!pool)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->mutex);
+
+	int i;
+	for (i = 0; i < pool->thread_count; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool);
+	dev->readback = NULL;
+}
+
+static void readback_run(device_ctx_t *dev, const readback_op_t *ops, int op_count)
+{
+	struct readback_pool *pool = readback_pool_get(dev);
+	int i, bands = 0;
+
+	for (i = 0; i < op_count; i++)
+		bands += (ops[i].height + BAND_ROWS - 1) / BAND_ROWS;
+
+	if (!pool)
+	{
+		for (i = 0; i < op_count; i++)
+		{
+			uint32_t y;
+			for (y = 0; y < ops[i].height; y += BAND_ROWS)
+				run_band(&ops[i], y);
+		}
+		return;
+	}
+
+	// one readback at a time per device, the helpers share the band counter
+	pthread_mutex_lock(&pool->lock);
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->ops = ops;
+	pool->op_count = op_count;
+	pool->band_count = bands;
+	pool->next_band = 0;
+	pool->busy = pool->thread_count;
+	pool->job++;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->mutex);
+
+	run_bands(pool);
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->busy)
+		pthread_cond_wait(&pool->done, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+
+	pthread_mutex_unlock(&pool->lock);
+}
+
+static void set_op(readback_op_t *op, enum readback_kind kind, const void *src, uint32_t src_pitch, uint32_t width, uint32_t height, void *dst, uint32_t dst_pitch)
+{
+	memset(op, 0, sizeof(*op));
+	op->kind = kind;
+	op->src = src;
+	op->src_pitch = src_pitch;
+	op->tiles = (width + 31) / 32;
+	op->width = width;
+	op->height = height;
+	op->dst = dst;
+	op->dst_pitch = dst_pitch;
+}
+
+VdpStatus readback_video_surface(video_surface_ctx_t *vs, VdpYCbCrFormat format, void *const *data, uint32_t const *pitches)
+{
+	readback_op_t ops[3];
+	int count = 0;
+
+	const uint8_t *y = cedarv_getPointer(vs->dataY);
+	const uint8_t *u = cedarv_getPointer(vs->dataU);
+	const uint8_t *v = cedarv_isValid(vs->dataV) ? cedarv_getPointer(vs->dataV) : NULL;
+	uint32_t c_width = (vs->width + 1) & ~1;
+	uint32_t c_height = (vs->height + 1) / 2;
+	// decoders write 32 aligned rows, put_bits packs them
+	uint32_t pitch = vs->frame_decoded ? ALIGN(vs->width, 32) : vs->width;
+
+	switch (vs->source_format)
+	{
+	case INTERNAL_YCBCR_FORMAT:
+		if (format != VDP_YCBCR_FORMAT_NV12 && format != VDP_YCBCR_FORMAT_YV12)
+			return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+		// the same ops as NV12, a pitch of 0 reads the tiles
+		pitch = 0;
+		/* fall through */
+	case VDP_YCBCR_FORMAT_NV12:
+		if (format != VDP_YCBCR_FORMAT_NV12 && format != VDP_YCBCR_FORMAT_YV12)
+			return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+		set_op(&ops[count++], READBACK_COPY, y, pitch, vs->width, vs->height, data[0], pitches[0]);
+		if (format == VDP_YCBCR_FORMAT_NV12)
+			set_op(&ops[count++], READBACK_COPY, u, pitch, c_width, c_height, data[1], pitches[1]);
+		else
+		{
+			// YV12 has V before U
+			set_op(&ops[count], READBACK_SPLIT, u, pitch, c_width, c_height, data[2], pitches[2]);
+			ops[count].dst2 = data[1];
+			ops[count++].dst2_pitch = pitches[1];
+		}
+		break;
+
+	case VDP_YCBCR_FORMAT_YV12:
+		if (format != VDP_YCBCR_FORMAT_YV12 || !v)
+			return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+		set_op(&ops[count++], READBACK_COPY, y, vs->width, vs->width, vs->height, data[0], pitches[0]);
+		set_op(&ops[count++], READBACK_COPY, u, vs->width / 2, vs->width / 2, vs->height / 2, data[2], pitches[2]);
+		set_op(&ops[count++], READBACK_COPY, v, vs->width / 2, vs->width / 2, vs->height / 2, data[1], pitches[1]);
+		break;
+
+	case INTERNAL_YCBCR_FORMAT_422:
+		if (format != VDP_YCBCR_FORMAT_YUYV && format != VDP_YCBCR_FORMAT_UYVY)
+			return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+		set_op(&ops[count], format == VDP_YCBCR_FORMAT_UYVY ? READBACK_PACK_UYVY : READBACK_PACK_YUYV,
+		       y, 0, vs->width, vs->height, data[0], pitches[0]);
+		ops[count++].src2 = u;
+		break;
+
+	case VDP_YCBCR_FORMAT_YUYV:
+	case VDP_YCBCR_FORMAT_UYVY:
+		if (format != vs->source_format)
+			return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+		set_op(&ops[count++], READBACK_COPY, y, 2 * vs->width, 2 * vs->width, vs->height, data[0], pitches[0]);
+		break;
+
+	default:
+		return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+	}
+
+	// the engines wrote around the cpu cache
+	cedarv_flush_cache(vs->dataY, cedarv_getSize(vs->dataY));
+	cedarv_flush_cache(vs->dataU, cedarv_getSize(vs->dataU));
+	if (v)
+		cedarv_flush_cache(vs->dataV, cedarv_getSize(vs->dataV));
+
+	readback_run(vs->device, ops, count);
+
+	return VDP_STATUS_OK;
+}
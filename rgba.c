@@ -0,0 +1,904 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "vdpau_private.h"
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#define HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+static const VdpOutputSurfaceRenderBlendState blend_copy =
+{
+	.struct_version = VDP_OUTPUT_SURFACE_RENDER_BLEND_STATE_VERSION,
+	.blend_factor_source_color = VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE,
+	.blend_factor_destination_color = VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ZERO,
+	.blend_factor_source_alpha = VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE,
+	.blend_factor_destination_alpha = VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ZERO,
+	.blend_equation_color = VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_ADD,
+	.blend_equation_alpha = VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_ADD,
+};
+
+static const VdpColor white = { 1.0, 1.0, 1.0, 1.0 };
+
+#define REPLAY_OPS 32
+
+/*
+ * Renders done into a surface since it was last cleared. The clear is
+ * delayed, and as long as the following renders are the same as last
+ * time (same sources with unchanged content) they are skipped, so a
+ * static OSD or subtitle costs nothing per frame.
+ */
+struct rgba_replay
+{
+	int count;
+	int matched;
+	int overflow;	// more renders than fit, or CPU writes
+	struct
+	{
+		rgba_op_t op;
+		uint32_t src_generation;
+	} ops[REPLAY_OPS];
+};
+
+static uint32_t generation_counter;
+
+static void resolve_pending(rgba_surface_t *rgba);
+
+VdpStatus rgba_create(rgba_surface_t *rgba, device_ctx_t *device, uint32_t width, uint32_t height, VdpRGBAFormat format, int cached)
+{
+	if (format != VDP_RGBA_FORMAT_B8G8R8A8 && format != VDP_RGBA_FORMAT_R8G8B8A8)
+		return VDP_STATUS_INVALID_RGBA_FORMAT;
+
+	if (width < 1 || width > 8192 || height < 1 || height > 8192)
+		return VDP_STATUS_INVALID_SIZE;
+
+	rgba->device = device;
+	rgba->format = format;
+	rgba->width = width;
+	rgba->height = height;
+	rgba->flags = 0;
+	rgba->generation = ++generation_counter;
+	rgba->replay = NULL;
+	rgba->next_pending = NULL;
+	memset(&rgba->dirty, 0, sizeof(rgba->dirty));
+	memset(&rgba->data, 0, sizeof(rgba->data));
+
+	// without OSD the surfaces only carry the video, don't waste memory on them
+	if (!device->osd_enabled)
+		return VDP_STATUS_OK;
+
+	// surfaces the CPU writes often are faster cached, even with flushing
+	if (cached)
+	{
+		rgba->data = cedarv_malloc_cached_type(width * height * 4, CEDARV_MEM_OUTPUT_SURFACE);
+		rgba->flags |= RGBA_FLAG_CACHED;
+	}
+	else
+		rgba->data = cedarv_malloc_type(width * height * 4, CEDARV_MEM_OUTPUT_SURFACE);
+	if (!cedarv_isValid(rgba->data))
+		return VDP_STATUS_RESOURCES;
+
+	cedarv_memset(rgba->data, 0, width * height * 4);
+	rgba->flags |= RGBA_FLAG_NEEDS_FLUSH;
+	rgba->flush_y0 = 0;
+	rgba->flush_y1 = height;
+
+	return VDP_STATUS_OK;
+}
+
+static void unlink_pending(rgba_surface_t *rgba)
+{
+	rgba_surface_t **p;
+	for (p = &rgba->device->rgba_pending; *p; p = &(*p)->next_pending)
+		if (*p == rgba)
+		{
+			*p = rgba->next_pending;
+			break;
+		}
+
+	rgba->next_pending = NULL;
+	rgba->flags &= ~RGBA_FLAG_CLEAR_PENDING;
+}
+
+/*
+ * Has to be called before the content of rgba changes. Surfaces that
+ * skipped renders from the old content have to do them for real now.
+ */
+static void begin_change(rgba_surface_t *rgba)
+{
+	if (rgba->flags & RGBA_FLAG_CLEAR_PENDING)
+		resolve_pending(rgba);
+
+	rgba_surface_t *p = rgba->device->rgba_pending;
+	while (p)
+	{
+		if (p->replay->matched)
+		{
+			resolve_pending(p);
+			p = rgba->device->rgba_pending;
+		}
+		else
+			p = p->next_pending;
+	}
+
+	rgba->generation = ++generation_counter;
+}
+
+void rgba_destroy(rgba_surface_t *rgba)
+{
+	if (cedarv_isValid(rgba->data))
+	{
+		unlink_pending(rgba);
+		begin_change(rgba);
+		cedarv_free(rgba->data);
+	}
+	// cedarv_setBufferInvalid() only invalidates its own copy of the handle
+	memset(&rgba->data, 0, sizeof(rgba->data));
+
+	free(rgba->replay);
+	rgba->replay = NULL;
+}
+
+static void needs_flush(rgba_surface_t *rgba, uint32_t y0, uint32_t y1)
+{
+	y1 = min(y1, rgba->height);
+	if (y0 >= y1)
+		return;
+
+	if (rgba->flags & RGBA_FLAG_NEEDS_FLUSH)
+	{
+		rgba->flush_y0 = min(rgba->flush_y0, y0);
+		rgba->flush_y1 = max(rgba->flush_y1, y1);
+	}
+	else
+	{
+		rgba->flush_y0 = y0;
+		rgba->flush_y1 = y1;
+	}
+	rgba->flags |= RGBA_FLAG_NEEDS_FLUSH;
+}
+
+/*
+ * Write back CPU caches before the G2D engine or the display read the
+ * surface, and drop them before the CPU reads what the engine wrote.
+ * Only the rows touched since the last flush are done.
+ */
+void rgba_flush(rgba_surface_t *rgba)
+{
+	if (rgba->flags & RGBA_FLAG_CLEAR_PENDING)
+		resolve_pending(rgba);
+
+	if (!(rgba->flags & RGBA_FLAG_NEEDS_FLUSH))
+		return;
+
+	cedarv_flush_cache_range(rgba->data, rgba->flush_y0 * rgba->width * 4, (rgba->flush_y1 - rgba->flush_y0) * rgba->width * 4);
+	rgba->flags &= ~RGBA_FLAG_NEEDS_FLUSH;
+}
+
+static void dirty_add_rect(VdpRect *dirty, const VdpRect *rect)
+{
+	dirty->x0 = min(dirty->x0, rect->x0);
+	dirty->y0 = min(dirty->y0, rect->y0);
+	dirty->x1 = max(dirty->x1, rect->x1);
+	dirty->y1 = max(dirty->y1, rect->y1);
+}
+
+static int clip_rect(VdpRect *rect, uint32_t width, uint32_t height)
+{
+	rect->x0 = min(rect->x0, width);
+	rect->y0 = min(rect->y0, height);
+	rect->x1 = min(rect->x1, width);
+	rect->y1 = min(rect->y1, height);
+
+	return rect->x1 > rect->x0 && rect->y1 > rect->y0;
+}
+
+static VdpStatus do_render(rgba_op_t *op)
+{
+	VdpStatus ret = VDP_STATUS_NO_IMPLEMENTATION;
+	const rgba_engine_t *engine = op->dest->device->rgba_engine;
+
+	if (engine && engine != &rgba_engine_sw)
+	{
+		rgba_flush(op->dest);
+		if (op->src)
+			rgba_flush(op->src);
+
+		ret = engine->render(op);
+		if (ret == VDP_STATUS_NO_IMPLEMENTATION)
+			VDPAU_DBG_ONCE("%s can't do this composition, using the CPU", engine->name);
+	}
+
+	if (ret == VDP_STATUS_NO_IMPLEMENTATION)
+	{
+		ret = rgba_engine_sw.render(op);
+
+		// the CPU has touched both surfaces now
+		needs_flush(op->dest, op->dest_rect.y0, op->dest_rect.y1);
+		if (op->src)
+		{
+			if (op->flags & 0x1)
+				needs_flush(op->src, 0, op->src->height);
+			else
+				needs_flush(op->src, op->src_rect.y0, op->src_rect.y1);
+		}
+	}
+
+	return ret;
+}
+
+static VdpStatus execute(rgba_op_t *op)
+{
+	rgba_surface_t *dest = op->dest;
+
+	VdpRect clipped = op->dest_rect;
+	if (!clip_rect(&clipped, dest->width, dest->height))
+		return VDP_STATUS_OK;
+
+	begin_change(dest);
+
+	VdpStatus ret = do_render(op);
+	if (ret != VDP_STATUS_OK)
+		return ret;
+
+	if (dest->flags & RGBA_FLAG_DIRTY)
+		dirty_add_rect(&dest->dirty, &clipped);
+	else
+		dest->dirty = clipped;
+	dest->flags |= RGBA_FLAG_DIRTY;
+
+	struct rgba_replay *rp = dest->replay;
+	if (rp)
+	{
+		if (rp->count < REPLAY_OPS)
+		{
+			memcpy(&rp->ops[rp->count].op, op, sizeof(*op));
+			rp->ops[rp->count].src_generation = op->src ? op->src->generation : 0;
+			rp->count++;
+		}
+		else
+			rp->overflow = 1;
+	}
+
+	return VDP_STATUS_OK;
+}
+
+static int replay_matches(const rgba_surface_t *dest, const rgba_op_t *op)
+{
+	const struct rgba_replay *rp = dest->replay;
+
+	if (rp->matched >= rp->count)
+		return 0;
+
+	if (rp->ops[rp->matched].src_generation != (op->src ? op->src->generation : 0))
+		return 0;
+
+	return memcmp(&rp->ops[rp->matched].op, op, sizeof(*op)) == 0;
+}
+
+static void clear_now(rgba_surface_t *rgba)
+{
+	begin_change(rgba);
+
+	rgba_op_t op;
+	memset(&op, 0, sizeof(op));
+	op.dest = rgba;
+	op.dest_rect = rgba->dirty;
+	op.src = NULL;
+	op.src_rect.x1 = op.src_rect.y1 = 1;
+	op.color_count = 1;
+	op.blend = blend_copy;
+
+	do_render(&op);
+
+	memset(&rgba->dirty, 0, sizeof(rgba->dirty));
+	rgba->flags &= ~RGBA_FLAG_DIRTY;
+
+	if (rgba->replay)
+	{
+		rgba->replay->count = 0;
+		rgba->replay->matched = 0;
+		rgba->replay->overflow = 0;
+	}
+}
+
+/*
+ * The renders since the delayed clear didn't repeat the last frame,
+ * clear for real and do the ones that were skipped.
+ */
+static void resolve_pending(rgba_surface_t *rgba)
+{
+	struct rgba_replay *rp = rgba->replay;
+
+	unlink_pending(rgba);
+
+	if (rp->matched == rp->count)
+		return;
+
+	int i, matched = rp->matched;
+	clear_now(rgba);
+	for (i = 0; i < matched; i++)
+	{
+		rgba_op_t op;
+		memcpy(&op, &rp->ops[i].op, sizeof(op));
+		execute(&op);
+	}
+}
+
+VdpStatus rgba_render(rgba_surface_t *dest, const VdpRect *dest_rect, rgba_surface_t *src, const VdpRect *src_rect, const VdpColor *colors, const VdpOutputSurfaceRenderBlendState *blend_state, uint32_t flags)
+{
+	if (blend_state)
+	{
+		if (blend_state->struct_version != VDP_OUTPUT_SURFACE_RENDER_BLEND_STATE_VERSION)
+			return VDP_STATUS_INVALID_STRUCT_VERSION;
+
+		if (blend_state->blend_factor_source_color > VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_CONSTANT_ALPHA ||
+		    blend_state->blend_factor_destination_color > VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_CONSTANT_ALPHA ||
+		    blend_state->blend_factor_source_alpha > VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_CONSTANT_ALPHA ||
+		    blend_state->blend_factor_destination_alpha > VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_CONSTANT_ALPHA)
+			return VDP_STATUS_INVALID_BLEND_FACTOR;
+
+		if (blend_state->blend_equation_color > VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_MAX ||
+		    blend_state->blend_equation_alpha > VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_MAX)
+			return VDP_STATUS_INVALID_BLEND_EQUATION;
+	}
+
+	if (flags & ~(VDP_OUTPUT_SURFACE_RENDER_COLOR_PER_VERTEX | 0x3))
+		return VDP_STATUS_INVALID_FLAG;
+
+	// OSD disabled, nothing to render to
+	if (!cedarv_isValid(dest->data) || (src && !cedarv_isValid(src->data)))
+		return VDP_STATUS_OK;
+
+	// zeroed, renders get compared with memcmp()
+	rgba_op_t op;
+	memset(&op, 0, sizeof(op));
+	op.dest = dest;
+	op.src = src;
+	op.flags = flags;
+	op.blend = blend_state ? *blend_state : blend_copy;
+
+	if (dest_rect)
+		op.dest_rect = *dest_rect;
+	else
+	{
+		op.dest_rect.x0 = op.dest_rect.y0 = 0;
+		op.dest_rect.x1 = dest->width;
+		op.dest_rect.y1 = dest->height;
+	}
+
+	if (src && src_rect)
+		op.src_rect = *src_rect;
+	else
+	{
+		op.src_rect.x0 = op.src_rect.y0 = 0;
+		op.src_rect.x1 = src ? src->width : 1;
+		op.src_rect.y1 = src ? src->height : 1;
+	}
+
+	if (op.src_rect.x1 <= op.src_rect.x0 || op.src_rect.y1 <= op.src_rect.y0)
+		return VDP_STATUS_OK;
+
+	if (!colors)
+	{
+		op.colors[0] = white;
+		op.color_count = 1;
+	}
+	else if (flags & VDP_OUTPUT_SURFACE_RENDER_COLOR_PER_VERTEX)
+	{
+		memcpy(op.colors, colors, 4 * sizeof(VdpColor));
+		op.color_count = 4;
+	}
+	else
+	{
+		op.colors[0] = colors[0];
+		op.color_count = 1;
+	}
+
+	if (src && (src->flags & RGBA_FLAG_CLEAR_PENDING))
+		resolve_pending(src);
+
+	if (dest->flags & RGBA_FLAG_CLEAR_PENDING)
+	{
+		// already there from last time
+		if (replay_matches(dest, &op))
+		{
+			dest->replay->matched++;
+			return VDP_STATUS_OK;
+		}
+
+		resolve_pending(dest);
+	}
+
+	return execute(&op);
+}
+
+/*
+ * Scale a video surface into the surface, for videos that didn't get
+ * a display layer of their own. Only the G2D engine can do this.
+ */
+VdpStatus rgba_render_video(rgba_surface_t *dest, const VdpRect *dest_rect, video_surface_ctx_t *src, const VdpRect *src_rect)
+{
+	const rgba_engine_t *engine = dest->device->rgba_engine;
+
+	if (!cedarv_isValid(dest->data))
+		return VDP_STATUS_OK;
+
+	if (!engine || !engine->render_video)
+	{
+		VDPAU_DBG_ONCE("no engine can render video into output surfaces");
+		return VDP_STATUS_OK;
+	}
+
+	VdpRect clipped = *dest_rect;
+	if (!clip_rect(&clipped, dest->width, dest->height))
+		return VDP_STATUS_OK;
+
+	begin_change(dest);
+	rgba_flush(dest);
+
+	VdpStatus ret = engine->render_video(dest, dest_rect, src, src_rect);
+	if (ret == VDP_STATUS_NO_IMPLEMENTATION)
+	{
+		VDPAU_DBG_ONCE("%s can't render this video surface", engine->name);
+		return VDP_STATUS_OK;
+	}
+	if (ret != VDP_STATUS_OK)
+		return ret;
+
+	if (dest->flags & RGBA_FLAG_DIRTY)
+		dirty_add_rect(&dest->dirty, &clipped);
+	else
+		dest->dirty = clipped;
+	dest->flags |= RGBA_FLAG_DIRTY;
+
+	// the video changes every frame, not worth replaying
+	if (dest->replay)
+		dest->replay->overflow = 1;
+
+	return VDP_STATUS_OK;
+}
+
+/*
+ * Make the whole surface transparent again, touching only what was
+ * rendered since the last clear. If that was done by renders only, the
+ * clear is delayed until the next render differs from the last frame
+ * or someone looks at the surface.
+ */
+void rgba_clear(rgba_surface_t *rgba)
+{
+	if (rgba->flags & RGBA_FLAG_CLEAR_PENDING)
+		resolve_pending(rgba);
+
+	struct rgba_replay *rp = rgba->replay;
+	if (!rp)
+		rgba->replay = calloc(1, sizeof(*rgba->replay));
+
+	if (!(rgba->flags & RGBA_FLAG_DIRTY))
+		return;
+
+	if (rp && rp->count && !rp->overflow)
+	{
+		rp->matched = 0;
+		rgba->flags |= RGBA_FLAG_CLEAR_PENDING;
+		rgba->next_pending = rgba->device->rgba_pending;
+		rgba->device->rgba_pending = rgba;
+		return;
+	}
+
+	clear_now(rgba);
+}
+
+static void put_rect(rgba_surface_t *rgba, const VdpRect *rect, VdpRect *r)
+{
+	if (rect)
+		*r = *rect;
+	else
+	{
+		r->x0 = r->y0 = 0;
+		r->x1 = rgba->width;
+		r->y1 = rgba->height;
+	}
+}
+
+static void cpu_wrote(rgba_surface_t *rgba, const VdpRect *r)
+{
+	if (rgba->flags & RGBA_FLAG_DIRTY)
+		dirty_add_rect(&rgba->dirty, r);
+	else
+		rgba->dirty = *r;
+	rgba->flags |= RGBA_FLAG_DIRTY;
+	needs_flush(rgba, r->y0, r->y1);
+
+	// can't be redone by replaying renders
+	if (rgba->replay)
+		rgba->replay->overflow = 1;
+}
+
+VdpStatus rgba_put_bits_native(rgba_surface_t *rgba, const void *const *source_data, const uint32_t *source_pitches, const VdpRect *destination_rect)
+{
+	if (!source_data || !source_pitches)
+		return VDP_STATUS_INVALID_POINTER;
+
+	if (!cedarv_isValid(rgba->data))
+		return VDP_STATUS_OK;
+
+	VdpRect r;
+	put_rect(rgba, destination_rect, &r);
+	if (!clip_rect(&r, rgba->width, rgba->height))
+		return VDP_STATUS_OK;
+
+	uint32_t *dst = (uint32_t *)cedarv_getPointer(rgba->data) + r.y0 * rgba->width + r.x0;
+	const uint8_t *src = source_data[0];
+	uint32_t y;
+
+	// subtitle renderers upload the same glyphs over and over, leave the
+	// rows that didn't change alone, and with them everything rendered
+	// from this surface. Only cheap if the surface is cached.
+	if (rgba->flags & RGBA_FLAG_CACHED)
+	{
+		while (r.y0 < r.y1 && memcmp(dst, src, (r.x1 - r.x0) * 4) == 0)
+		{
+			r.y0++;
+			dst += rgba->width;
+			src += source_pitches[0];
+		}
+
+		if (r.y0 == r.y1)
+			return VDP_STATUS_OK;
+
+		const uint32_t *last_dst = dst + (r.y1 - r.y0 - 1) * rgba->width;
+		const uint8_t *last_src = src + (r.y1 - r.y0 - 1) * source_pitches[0];
+		while (memcmp(last_dst, last_src, (r.x1 - r.x0) * 4) == 0)
+		{
+			r.y1--;
+			last_dst -= rgba->width;
+			last_src -= source_pitches[0];
+		}
+	}
+
+	begin_change(rgba);
+
+	// whole surface in one go if the pitches match
+	if (r.x0 == 0 && r.x1 == rgba->width && source_pitches[0] == rgba->width * 4)
+		memcpy(dst, src, (r.y1 - r.y0) * rgba->width * 4);
+	else
+		for (y = r.y0; y < r.y1; y++)
+		{
+			memcpy(dst, src, (r.x1 - r.x0) * 4);
+			dst += rgba->width;
+			src += source_pitches[0];
+		}
+
+	cpu_wrote(rgba, &r);
+	return VDP_STATUS_OK;
+}
+
+VdpStatus rgba_get_bits_native(rgba_surface_t *rgba, const VdpRect *source_rect, void *const *destination_data, const uint32_t *destination_pitches)
+{
+	if (!destination_data || !destination_pitches)
+		return VDP_STATUS_INVALID_POINTER;
+
+	if (!cedarv_isValid(rgba->data))
+		return VDP_STATUS_ERROR;
+
+	VdpRect r;
+	put_rect(rgba, source_rect, &r);
+	if (!clip_rect(&r, rgba->width, rgba->height))
+		return VDP_STATUS_OK;
+
+	// the engine might have written it behind the cache
+	needs_flush(rgba, r.y0, r.y1);
+	rgba_flush(rgba);
+
+	const uint32_t *src = (uint32_t *)cedarv_getPointer(rgba->data) + r.y0 * rgba->width + r.x0;
+	uint8_t *dst = destination_data[0];
+	uint32_t y;
+	for (y = r.y0; y < r.y1; y++)
+	{
+		memcpy(dst, src, (r.x1 - r.x0) * 4);
+		src += rgba->width;
+		dst += destination_pitches[0];
+	}
+
+	return VDP_STATUS_OK;
+}
+
+#ifdef HAVE_NEON
+/*
+ * 16 entry palettes fit a vtbl lookup, so the 4 bit formats expand
+ * 8 pixels at a time, one table per byte of the output pixel.
+ */
+static void expand_i4_neon(uint32_t *dst, const uint8_t *src, uint32_t count, const uint32_t *palette, int alpha_high)
+{
+	uint8_t planes[3][16];
+	int i;
+	for (i = 0; i < 16; i++)
+	{
+		planes[0][i] = palette[i];
+		planes[1][i] = palette[i] >> 8;
+		planes[2][i] = palette[i] >> 16;
+	}
+
+	uint8x8x2_t t0 = { { vld1_u8(planes[0]), vld1_u8(planes[0] + 8) } };
+	uint8x8x2_t t1 = { { vld1_u8(planes[1]), vld1_u8(planes[1] + 8) } };
+	uint8x8x2_t t2 = { { vld1_u8(planes[2]), vld1_u8(planes[2] + 8) } };
+	uint8x8_t mask = vdup_n_u8(0x0f);
+
+	for (; count >= 8; count -= 8, src += 8, dst += 8)
+	{
+		uint8x8_t v = vld1_u8(src);
+		uint8x8_t idx = alpha_high ? vand_u8(v, mask) : vshr_n_u8(v, 4);
+		uint8x8_t a = alpha_high ? vshr_n_u8(v, 4) : vand_u8(v, mask);
+		uint8x8x4_t out;
+
+		out.val[0] = vtbl2_u8(t0, idx);
+		out.val[1] = vtbl2_u8(t1, idx);
+		out.val[2] = vtbl2_u8(t2, idx);
+		// 4 to 8 bit, a * 17
+		out.val[3] = vorr_u8(a, vshl_n_u8(a, 4));
+		vst4_u8((uint8_t *)dst, out);
+	}
+
+	for (; count; count--, src++, dst++)
+	{
+		uint8_t idx = alpha_high ? (*src & 0x0f) : (*src >> 4);
+		uint8_t a = alpha_high ? (*src >> 4) : (*src & 0x0f);
+		*dst = (palette[idx] & 0x00ffffff) | ((uint32_t)(a * 17) << 24);
+	}
+}
+#endif
+
+static void expand_i4(uint32_t *dst, const uint8_t *src, uint32_t count, const uint32_t *palette, int alpha_high)
+{
+#ifdef HAVE_NEON
+	expand_i4_neon(dst, src, count, palette, alpha_high);
+#else
+	for (; count; count--, src++, dst++)
+	{
+		uint8_t idx = alpha_high ? (*src & 0x0f) : (*src >> 4);
+		uint8_t a = alpha_high ? (*src >> 4) : (*src & 0x0f);
+		*dst = (palette[idx] & 0x00ffffff) | ((uint32_t)(a * 17) << 24);
+	}
+#endif
+}
+
+#ifdef HAVE_NEON
+/*
+ * 256 entries don't fit a vtbl lookup, the palette gather stays scalar.
+ * The pairs are split with one vld2 and the alpha bytes shifted into
+ * the colours 8 pixels at a time, so the loop only does the loads.
+ */
+static void expand_i8_neon(uint32_t *dst, const uint8_t *src, uint32_t count, const uint32_t *palette, int alpha_first)
+{
+	uint32_t rgb[8], i;
+
+	for (; count >= 8; count -= 8, src += 16, dst += 8)
+	{
+		uint8x8x2_t v = vld2_u8(src);
+		uint8x8_t idx = alpha_first ? v.val[1] : v.val[0];
+		uint16x8_t a = vmovl_u8(alpha_first ? v.val[0] : v.val[1]);
+
+		uint8_t n[8];
+		vst1_u8(n, idx);
+		for (i = 0; i < 8; i++)
+			rgb[i] = palette[n[i]];
+
+		vst1q_u32(dst, vsliq_n_u32(vld1q_u32(rgb), vmovl_u16(vget_low_u16(a)), 24));
+		vst1q_u32(dst + 4, vsliq_n_u32(vld1q_u32(rgb + 4), vmovl_u16(vget_high_u16(a)), 24));
+	}
+
+	const uint8_t *index = src + (alpha_first ? 1 : 0);
+	const uint8_t *alpha = src + (alpha_first ? 0 : 1);
+	for (i = 0; i < count; i++)
+		dst[i] = (palette[index[i * 2]] & 0x00ffffff) | ((uint32_t)alpha[i * 2] << 24);
+}
+#endif
+
+static void expand_i8(uint32_t *dst, const uint8_t *src, uint32_t count, const uint32_t *palette, int alpha_first)
+{
+#ifdef HAVE_NEON
+	expand_i8_neon(dst, src, count, palette, alpha_first);
+#else
+	// 256 entries don't fit any table lookup, alpha gets merged in with the same load
+	const uint8_t *idx = src + (alpha_first ? 1 : 0);
+	const uint8_t *a = src + (alpha_first ? 0 : 1);
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+		dst[i] = (palette[idx[i * 2]] & 0x00ffffff) | ((uint32_t)a[i * 2] << 24);
+#endif
+}
+
+VdpStatus rgba_put_bits_indexed(rgba_surface_t *rgba, VdpIndexedFormat source_indexed_format, const void *const *source_data, const uint32_t *source_pitch, const VdpRect *destination_rect, VdpColorTableFormat color_table_format, const void *color_table)
+{
+	if (!source_data || !source_pitch || !color_table)
+		return VDP_STATUS_INVALID_POINTER;
+
+	if (color_table_format != VDP_COLOR_TABLE_FORMAT_B8G8R8X8)
+		return VDP_STATUS_INVALID_COLOR_TABLE_FORMAT;
+
+	int entries;
+	switch (source_indexed_format)
+	{
+	case VDP_INDEXED_FORMAT_A4I4:
+	case VDP_INDEXED_FORMAT_I4A4:
+		entries = 16;
+		break;
+	case VDP_INDEXED_FORMAT_A8I8:
+	case VDP_INDEXED_FORMAT_I8A8:
+		entries = 256;
+		break;
+	default:
+		return VDP_STATUS_INVALID_INDEXED_FORMAT;
+	}
+
+	if (!cedarv_isValid(rgba->data))
+		return VDP_STATUS_OK;
+
+	VdpRect r;
+	put_rect(rgba, destination_rect, &r);
+	if (!clip_rect(&r, rgba->width, rgba->height))
+		return VDP_STATUS_OK;
+
+	// the table is B8G8R8X8, swap it once for R8G8B8A8 surfaces
+	uint32_t palette[256];
+	const uint32_t *table = color_table;
+	int i;
+	for (i = 0; i < entries; i++)
+	{
+		palette[i] = table[i];
+		if (rgba->format == VDP_RGBA_FORMAT_R8G8B8A8)
+			palette[i] = (table[i] & 0x0000ff00) | ((table[i] >> 16) & 0xff) | ((table[i] & 0xff) << 16);
+	}
+
+	begin_change(rgba);
+
+	uint32_t *dst = (uint32_t *)cedarv_getPointer(rgba->data) + r.y0 * rgba->width + r.x0;
+	const uint8_t *src = source_data[0];
+	uint32_t w = r.x1 - r.x0, y;
+	for (y = r.y0; y < r.y1; y++)
+	{
+		switch (source_indexed_format)
+		{
+		case VDP_INDEXED_FORMAT_A4I4:
+			expand_i4(dst, src, w, palette, 1);
+			break;
+		case VDP_INDEXED_FORMAT_I4A4:
+			expand_i4(dst, src, w, palette, 0);
+			break;
+		case VDP_INDEXED_FORMAT_A8I8:
+			expand_i8(dst, src, w, palette, 1);
+			break;
+		case VDP_INDEXED_FORMAT_I8A8:
+			expand_i8(dst, src, w, palette, 0);
+			break;
+		}
+		dst += rgba->width;
+		src += source_pitch[0];
+	}
+
+	cpu_wrote(rgba, &r);
+	return VDP_STATUS_OK;
+}
+
+// BT.601 limited range, what players expect when they pass no matrix
+static const VdpCSCMatrix default_csc =
+{
+	{ 1.164f,  0.000f,  1.596f, -0.874f },
+	{ 1.164f, -0.392f, -0.813f,  0.532f },
+	{ 1.164f,  2.017f,  0.000f, -1.086f },
+};
+
+VdpStatus rgba_put_bits_y_cb_cr(rgba_surface_t *rgba, VdpYCbCrFormat source_ycbcr_format, const void *const *source_data, const uint32_t *source_pitches, const VdpRect *destination_rect, const VdpCSCMatrix *csc_matrix)
+{
+	if (!source_data || !source_pitches)
+		return VDP_STATUS_INVALID_POINTER;
+
+	switch (source_ycbcr_format)
+	{
+	case VDP_YCBCR_FORMAT_NV12:
+	case VDP_YCBCR_FORMAT_YV12:
+	case VDP_YCBCR_FORMAT_UYVY:
+	case VDP_YCBCR_FORMAT_YUYV:
+	case VDP_YCBCR_FORMAT_Y8U8V8A8:
+	case VDP_YCBCR_FORMAT_V8U8Y8A8:
+		break;
+	default:
+		return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+	}
+
+	if (!cedarv_isValid(rgba->data))
+		return VDP_STATUS_OK;
+
+	VdpRect r;
+	put_rect(rgba, destination_rect, &r);
+	if (!clip_rect(&r, rgba->width, rgba->height))
+		return VDP_STATUS_OK;
+
+	// fixed point matrix with 8 bit inputs, 10 fractional bits
+	const VdpCSCMatrix *m = csc_matrix ? csc_matrix : &default_csc;
+	int32_t k[3][4];
+	int i, j;
+	for (i = 0; i < 3; i++)
+	{
+		for (j = 0; j < 3; j++)
+			k[i][j] = (*m)[i][j] * 1024.0f;
+		k[i][3] = (*m)[i][3] * 255.0f * 1024.0f;
+	}
+
+	int rshift = (rgba->format == VDP_RGBA_FORMAT_R8G8B8A8) ? 0 : 16;
+	int bshift = (rgba->format == VDP_RGBA_FORMAT_R8G8B8A8) ? 16 : 0;
+
+	begin_change(rgba);
+
+	uint32_t *dst = (uint32_t *)cedarv_getPointer(rgba->data) + r.y0 * rgba->width + r.x0;
+	uint32_t x, y;
+	for (y = 0; y < r.y1 - r.y0; y++)
+	{
+		const uint8_t *p0 = (const uint8_t *)source_data[0] + y * source_pitches[0];
+		const uint8_t *p1 = NULL, *p2 = NULL;
+		if (source_ycbcr_format == VDP_YCBCR_FORMAT_NV12)
+			p1 = (const uint8_t *)source_data[1] + (y / 2) * source_pitches[1];
+		else if (source_ycbcr_format == VDP_YCBCR_FORMAT_YV12)
+		{
+			p1 = (const uint8_t *)source_data[1] + (y / 2) * source_pitches[1];
+			p2 = (const uint8_t *)source_data[2] + (y / 2) * source_pitches[2];
+		}
+
+		for (x = 0; x < r.x1 - r.x0; x++)
+		{
+			int32_t Y, U, V, A = 0xff;
+			switch (source_ycbcr_format)
+			{
+			case VDP_YCBCR_FORMAT_NV12:
+				Y = p0[x]; U = p1[x & ~1]; V = p1[x | 1];
+				break;
+			case VDP_YCBCR_FORMAT_YV12:
+				Y = p0[x]; V = p1[x / 2]; U = p2[x / 2];
+				break;
+			case VDP_YCBCR_FORMAT_UYVY:
+				Y = p0[x * 2 + 1]; U = p0[(x & ~1) * 2]; V = p0[(x & ~1) * 2 + 2];
+				break;
+			case VDP_YCBCR_FORMAT_YUYV:
+				Y = p0[x * 2]; U = p0[(x & ~1) * 2 + 1]; V = p0[(x & ~1) * 2 + 3];
+				break;
+			case VDP_YCBCR_FORMAT_Y8U8V8A8:
+				Y = p0[x * 4]; U = p0[x * 4 + 1]; V = p0[x * 4 + 2]; A = p0[x * 4 + 3];
+				break;
+			default:
+				V = p0[x * 4]; U = p0[x * 4 + 1]; Y = p0[x * 4 + 2]; A = p0[x * 4 + 3];
+				break;
+			}
+
+			int32_t R = (k[0][0] * Y + k[0][1] * U + k[0][2] * V + k[0][3] + 512) >> 10;
+			int32_t G = (k[1][0] * Y + k[1][1] * U + k[1][2] * V + k[1][3] + 512) >> 10;
+			int32_t B = (k[2][0] * Y + k[2][1] * U + k[2][2] * V + k[2][3] + 512) >> 10;
+
+			dst[x] = ((uint32_t)A << 24) | ((uint32_t)clamp(R, 0, 255) << rshift) |
+				 ((uint32_t)clamp(G, 0, 255) << 8) | ((uint32_t)clamp(B, 0, 255) << bshift);
+		}
+		dst += rgba->width;
+	}
+
+	cpu_wrote(rgba, &r);
+	return VDP_STATUS_OK;
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Output surface compositing on the G2D engine. It can copy, fill and
+ * alpha blend with per pixel and plane alpha, everything else is left
+ * to the CPU. It also converts and scales video surfaces for videos
+ * that didn't get a display layer.
+ */
+
+#include <string.h>
+#include <sys/ioctl.h>
+#include "vdpau_private.h"
+#include "g2d_driver.h"
+
+enum blend_mode
+{
+	BLEND_UNSUPPORTED,
+	BLEND_COPY,
+	BLEND_OVER,
+};
+
+static enum blend_mode get_blend_mode(const VdpOutputSurfaceRenderBlendState *b)
+{
+	if (b->blend_equation_color != VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_ADD ||
+	    b->blend_equation_alpha != VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_ADD)
+		return BLEND_UNSUPPORTED;
+
+	if (b->blend_factor_source_color == VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE &&
+	    b->blend_factor_destination_color == VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ZERO &&
+	    b->blend_factor_source_alpha == VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE &&
+	    b->blend_factor_destination_alpha == VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ZERO)
+		return BLEND_COPY;
+
+	// source alpha factor varies between players, the engine doesn't care
+	if (b->blend_factor_source_color == VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_SRC_ALPHA &&
+	    b->blend_factor_destination_color == VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA &&
+	    (b->blend_factor_source_alpha == VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE ||
+	     b->blend_factor_source_alpha == VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_SRC_ALPHA) &&
+	    b->blend_factor_destination_alpha == VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA)
+		return BLEND_OVER;
+
+	return BLEND_UNSUPPORTED;
+}
+
+static void set_image(g2d_image *image, rgba_surface_t *rgba)
+{
+	memset(image, 0, sizeof(*image));
+	// recalc to cpu kernel addresses (+ 0x40000000)
+	image->addr[0] = cedarv_virt2phys(rgba->data) + 0x40000000;
+	image->w = rgba->width;
+	image->h = rgba->height;
+	image->format = (rgba->format == VDP_RGBA_FORMAT_R8G8B8A8) ? G2D_FMT_ABGR_AVUY8888 : G2D_FMT_ARGB_AYUV8888;
+	image->pixel_seq = G2D_SEQ_NORMAL;
+}
+
+static void set_rect(g2d_rect *r, const VdpRect *rect)
+{
+	r->x = rect->x0;
+	r->y = rect->y0;
+	r->w = rect->x1 - rect->x0;
+	r->h = rect->y1 - rect->y0;
+}
+
+static int rect_inside(const VdpRect *rect, const rgba_surface_t *rgba)
+{
+	return rect->x1 > rect->x0 && rect->y1 > rect->y0 &&
+	       rect->x1 <= rgba->width && rect->y1 <= rgba->height;
+}
+
+static int rects_overlap(const VdpRect *a, const VdpRect *b)
+{
+	return a->x0 < b->x1 && b->x0 < a->x1 && a->y0 < b->y1 && b->y0 < a->y1;
+}
+
+static uint8_t to_byte(float v)
+{
+	return clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f;
+}
+
+static VdpStatus g2d_render(const rgba_op_t *op)
+{
+	int fd = op->dest->device->g2d_fd;
+	const VdpColor *c = &op->colors[0];
+	enum blend_mode mode = get_blend_mode(&op->blend);
+
+	if (mode == BLEND_UNSUPPORTED || (op->flags & 0x3) || op->color_count != 1 ||
+	    !rect_inside(&op->dest_rect, op->dest))
+		return VDP_STATUS_NO_IMPLEMENTATION;
+
+	if (!op->src)
+	{
+		g2d_fillrect args;
+		memset(&args, 0, sizeof(args));
+
+		set_image(&args.dst_image, op->dest);
+		set_rect(&args.dst_rect, &op->dest_rect);
+		args.color = (to_byte(c->red) << 16) | (to_byte(c->green) << 8) | to_byte(c->blue);
+		if (op->dest->format == VDP_RGBA_FORMAT_R8G8B8A8)
+			args.color = (to_byte(c->blue) << 16) | (to_byte(c->green) << 8) | to_byte(c->red);
+		args.alpha = to_byte(c->alpha);
+		// copy writes the alpha value into the surface, over blends with it
+		args.flag = (mode == BLEND_COPY) ? G2D_FIL_PIXEL_ALPHA : G2D_FIL_PLANE_ALPHA;
+
+		if (ioctl(fd, G2D_CMD_FILLRECT, &args) < 0)
+			return VDP_STATUS_NO_IMPLEMENTATION;
+
+		return VDP_STATUS_OK;
+	}
+
+	// the engine only modulates alpha, and copying can't modulate at all
+	if (c->red != 1.0f || c->green != 1.0f || c->blue != 1.0f ||
+	    (mode == BLEND_COPY && c->alpha != 1.0f))
+		return VDP_STATUS_NO_IMPLEMENTATION;
+
+	if (!rect_inside(&op->src_rect, op->src) ||
+	    (op->src == op->dest && rects_overlap(&op->src_rect, &op->dest_rect)))
+		return VDP_STATUS_NO_IMPLEMENTATION;
+
+	g2d_blt_flags flag = G2D_BLT_NONE;
+	uint32_t alpha = 0;
+	if (mode == BLEND_OVER)
+	{
+		alpha = to_byte(c->alpha);
+		flag = (alpha == 0xff) ? G2D_BLT_PIXEL_ALPHA : G2D_BLT_MULTI_ALPHA;
+	}
+
+	int ret;
+	if (op->src_rect.x1 - op->src_rect.x0 == op->dest_rect.x1 - op->dest_rect.x0 &&
+	    op->src_rect.y1 - op->src_rect.y0 == op->dest_rect.y1 - op->dest_rect.y0)
+	{
+		g2d_blt args;
+		memset(&args, 0, sizeof(args));
+
+		args.flag = flag;
+		set_image(&args.src_image, op->src);
+		set_rect(&args.src_rect, &op->src_rect);
+		set_image(&args.dst_image, op->dest);
+		args.dst_x = op->dest_rect.x0;
+		args.dst_y = op->dest_rect.y0;
+		args.alpha = alpha;
+
+		ret = ioctl(fd, G2D_CMD_BITBLT, &args);
+	}
+	else
+	{
+		g2d_stretchblt args;
+		memset(&args, 0, sizeof(args));
+
+		args.flag = flag;
+		set_image(&args.src_image, op->src);
+		set_rect(&args.src_rect, &op->src_rect);
+		set_image(&args.dst_image, op->dest);
+		set_rect(&args.dst_rect, &op->dest_rect);
+		args.alpha = alpha;
+
+		ret = ioctl(fd, G2D_CMD_STRETCHBLT, &args);
+	}
+
+	if (ret < 0)
+		return VDP_STATUS_NO_IMPLEMENTATION;
+
+	return VDP_STATUS_OK;
+}
+
+static VdpStatus g2d_render_video(rgba_surface_t *dest, const VdpRect *dest_rect, video_surface_ctx_t *src, const VdpRect *src_rect)
+{
+	g2d_stretchblt args;
+	memset(&args, 0, sizeof(args));
+
+	// the rotated copy if the decoder wrote one
+	CEDARV_MEMORY dataY, dataU;
+	uint32_t width, height;
+	video_surface_get_display(src, &dataY, &dataU, &width, &height);
+
+	args.src_image.pixel_seq = G2D_SEQ_NORMAL;
+	switch (src->source_format)
+	{
+	// sequences name the 32 bit word from the top, normal is VYUY
+	case VDP_YCBCR_FORMAT_YUYV:
+		args.src_image.format = G2D_FMT_IYUV422;
+		break;
+	case VDP_YCBCR_FORMAT_UYVY:
+		args.src_image.format = G2D_FMT_IYUV422;
+		args.src_image.pixel_seq = G2D_SEQ_YVYU;
+		break;
+	case VDP_YCBCR_FORMAT_NV12:
+		args.src_image.format = G2D_FMT_PYUV420UVC;
+		break;
+	case INTERNAL_YCBCR_FORMAT_422:
+		args.src_image.format = G2D_FMT_PYUV422UVC_MB32;
+		width = (width + 31) & ~31;
+		break;
+	case INTERNAL_YCBCR_FORMAT:
+		args.src_image.format = G2D_FMT_PYUV420UVC_MB32;
+		width = (width + 31) & ~31;
+		break;
+	default:
+		// planar input isn't supported by the engine
+		return VDP_STATUS_NO_IMPLEMENTATION;
+	}
+
+	args.flag = G2D_BLT_NONE;
+	// recalc to cpu kernel addresses (+ 0x40000000)
+	args.src_image.addr[0] = cedarv_virt2phys(dataY) + 0x40000000;
+	if (args.src_image.format != G2D_FMT_IYUV422)
+		args.src_image.addr[1] = cedarv_virt2phys(dataU) + 0x40000000;
+	args.src_image.w = width;
+	args.src_image.h = height;
+	set_rect(&args.src_rect, src_rect);
+	set_image(&args.dst_image, dest);
+	set_rect(&args.dst_rect, dest_rect);
+
+	if (!rect_inside(dest_rect, dest) || args.src_rect.w == 0 || args.src_rect.h == 0)
+		return VDP_STATUS_NO_IMPLEMENTATION;
+
+	if (ioctl(dest->device->g2d_fd, G2D_CMD_STRETCHBLT, &args) < 0)
+		return VDP_STATUS_NO_IMPLEMENTATION;
+
+	return VDP_STATUS_OK;
+}
+
+const rgba_engine_t rgba_engine_g2d =
+{
+	.name = "G2D",
+	.render = g2d_render,
+	.render_video = g2d_render_video,
+};
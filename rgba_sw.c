@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * CPU implementation of the output surface compositing, complete
+ * VDPAU semantics. It is the fallback for everything the G2D engine
+ * can't do, and only needs the surface memory to be mapped.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "vdpau_private.h"
+
+typedef struct
+{
+	float r, g, b, a;
+} pixel_t;
+
+static inline pixel_t unpack(uint32_t v, VdpRGBAFormat format)
+{
+	pixel_t p;
+	uint32_t c0 = (v >> 16) & 0xff, c2 = v & 0xff;
+
+	// B8G8R8A8 has red in bits 16-23, R8G8B8A8 in bits 0-7
+	if (format == VDP_RGBA_FORMAT_R8G8B8A8)
+	{
+		uint32_t t = c0; c0 = c2; c2 = t;
+	}
+
+	p.r = c0 / 255.0f;
+	p.g = ((v >> 8) & 0xff) / 255.0f;
+	p.b = c2 / 255.0f;
+	p.a = (v >> 24) / 255.0f;
+	return p;
+}
+
+static inline uint32_t pack(pixel_t p, VdpRGBAFormat format)
+{
+	uint32_t r = clamp(p.r, 0.0f, 1.0f) * 255.0f + 0.5f;
+	uint32_t g = clamp(p.g, 0.0f, 1.0f) * 255.0f + 0.5f;
+	uint32_t b = clamp(p.b, 0.0f, 1.0f) * 255.0f + 0.5f;
+	uint32_t a = clamp(p.a, 0.0f, 1.0f) * 255.0f + 0.5f;
+
+	if (format == VDP_RGBA_FORMAT_R8G8B8A8)
+		return (a << 24) | (b << 16) | (g << 8) | r;
+	else
+		return (a << 24) | (r << 16) | (g << 8) | b;
+}
+
+static inline float factor(VdpOutputSurfaceRenderBlendFactor f, float s, float d, float sa, float da, float k, float ka, int alpha)
+{
+	switch (f)
+	{
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ZERO:
+		return 0.0f;
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE:
+		return 1.0f;
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_SRC_COLOR:
+		return s;
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_SRC_COLOR:
+		return 1.0f - s;
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_SRC_ALPHA:
+		return sa;
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA:
+		return 1.0f - sa;
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_DST_ALPHA:
+		return da;
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_DST_ALPHA:
+		return 1.0f - da;
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_DST_COLOR:
+		return d;
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_DST_COLOR:
+		return 1.0f - d;
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_SRC_ALPHA_SATURATE:
+		return alpha ? 1.0f : min(sa, 1.0f - da);
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_CONSTANT_COLOR:
+		return k;
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_CONSTANT_COLOR:
+		return 1.0f - k;
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_CONSTANT_ALPHA:
+		return ka;
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_CONSTANT_ALPHA:
+		return 1.0f - ka;
+	}
+
+	return 0.0f;
+}
+
+static inline float equation(VdpOutputSurfaceRenderBlendEquation eq, float s, float sf, float d, float df)
+{
+	switch (eq)
+	{
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_SUBTRACT:
+		return s * sf - d * df;
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_REVERSE_SUBTRACT:
+		return d * df - s * sf;
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_ADD:
+		return s * sf + d * df;
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_MIN:
+		return min(s, d);
+	case VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_MAX:
+		return max(s, d);
+	}
+
+	return s;
+}
+
+static inline pixel_t blend(const VdpOutputSurfaceRenderBlendState *b, pixel_t s, pixel_t d)
+{
+	const VdpColor *k = &b->blend_constant;
+	pixel_t o;
+
+#define BLEND_CHANNEL(c, kc) \
+	o.c = equation(b->blend_equation_color, s.c, \
+		factor(b->blend_factor_source_color, s.c, d.c, s.a, d.a, k->kc, k->alpha, 0), d.c, \
+		factor(b->blend_factor_destination_color, s.c, d.c, s.a, d.a, k->kc, k->alpha, 0))
+
+	BLEND_CHANNEL(r, red);
+	BLEND_CHANNEL(g, green);
+	BLEND_CHANNEL(b, blue);
+#undef BLEND_CHANNEL
+
+	o.a = equation(b->blend_equation_alpha, s.a,
+		factor(b->blend_factor_source_alpha, s.a, d.a, s.a, d.a, k->alpha, k->alpha, 1), d.a,
+		factor(b->blend_factor_destination_alpha, s.a, d.a, s.a, d.a, k->alpha, k->alpha, 1));
+
+	return o;
+}
+
+static int is_copy(const VdpOutputSurfaceRenderBlendState *b)
+{
+	return b->blend_factor_source_color == VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE &&
+	       b->blend_factor_destination_color == VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ZERO &&
+	       b->blend_factor_source_alpha == VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE &&
+	       b->blend_factor_destination_alpha == VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ZERO &&
+	       b->blend_equation_color == VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_ADD &&
+	       b->blend_equation_alpha == VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_ADD;
+}
+
+static int is_white(const VdpColor *c)
+{
+	return c->red == 1.0f && c->green == 1.0f && c->blue == 1.0f && c->alpha == 1.0f;
+}
+
+// solid fills and unscaled, unrotated, unmodulated copies don't need the blending
+static int fast_copy(const rgba_op_t *op, const VdpRect *clip)
+{
+	uint32_t *dst = cedarv_getPointer(op->dest->data);
+	uint32_t x, y;
+
+	if (!op->src && op->color_count == 1 && is_copy(&op->blend))
+	{
+		pixel_t c = { op->colors[0].red, op->colors[0].green, op->colors[0].blue, op->colors[0].alpha };
+		uint32_t v = pack(c, op->dest->format);
+		for (y = clip->y0; y < clip->y1; y++)
+		{
+			uint32_t *d = dst + y * op->dest->width;
+			if (v == 0)
+				memset(d + clip->x0, 0, (clip->x1 - clip->x0) * 4);
+			else
+				for (x = clip->x0; x < clip->x1; x++)
+					d[x] = v;
+		}
+		return 1;
+	}
+
+	if (!op->src || op->src == op->dest || (op->flags & 0x3) || op->color_count != 1 || !is_white(&op->colors[0]) ||
+	    !is_copy(&op->blend) || op->src->format != op->dest->format ||
+	    op->src_rect.x1 - op->src_rect.x0 != op->dest_rect.x1 - op->dest_rect.x0 ||
+	    op->src_rect.y1 - op->src_rect.y0 != op->dest_rect.y1 - op->dest_rect.y0)
+		return 0;
+
+	uint32_t sx = op->src_rect.x0 + clip->x0 - op->dest_rect.x0;
+	uint32_t sy = op->src_rect.y0 + clip->y0 - op->dest_rect.y0;
+	uint32_t w = clip->x1 - clip->x0, h = clip->y1 - clip->y0;
+	if (sx + w > op->src->width || sy + h > op->src->height)
+		return 0;
+
+	const uint32_t *src = cedarv_getPointer(op->src->data);
+	for (y = 0; y < h; y++)
+		memcpy(dst + (clip->y0 + y) * op->dest->width + clip->x0,
+			src + (sy + y) * op->src->width + sx, w * 4);
+
+	return 1;
+}
+
+static VdpStatus sw_render(const rgba_op_t *op)
+{
+	VdpRect clip = op->dest_rect;
+	clip.x1 = min(clip.x1, op->dest->width);
+	clip.y1 = min(clip.y1, op->dest->height);
+	if (clip.x0 >= clip.x1 || clip.y0 >= clip.y1)
+		return VDP_STATUS_OK;
+
+	if (fast_copy(op, &clip))
+		return VDP_STATUS_OK;
+
+	// rendering a surface onto itself, work from a copy of the source
+	uint32_t *src_copy = NULL;
+	const uint32_t *src = NULL;
+	if (op->src)
+	{
+		src = cedarv_getPointer(op->src->data);
+		if (op->src == op->dest)
+		{
+			size_t size = op->src->width * op->src->height * 4;
+			src_copy = malloc(size);
+			if (!src_copy)
+				return VDP_STATUS_RESOURCES;
+			memcpy(src_copy, src, size);
+			src = src_copy;
+		}
+	}
+
+	uint32_t *dst = cedarv_getPointer(op->dest->data);
+	float dw = op->dest_rect.x1 - op->dest_rect.x0, dh = op->dest_rect.y1 - op->dest_rect.y0;
+	float sw = op->src_rect.x1 - op->src_rect.x0, sh = op->src_rect.y1 - op->src_rect.y0;
+	pixel_t white_px = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+	uint32_t x, y;
+	for (y = clip.y0; y < clip.y1; y++)
+	{
+		float v = (y + 0.5f - op->dest_rect.y0) / dh;
+		for (x = clip.x0; x < clip.x1; x++)
+		{
+			float u = (x + 0.5f - op->dest_rect.x0) / dw;
+			pixel_t s = white_px;
+
+			if (src)
+			{
+				// position in the source after rotating it clockwise
+				float su, sv;
+				switch (op->flags & 0x3)
+				{
+				case VDP_OUTPUT_SURFACE_RENDER_ROTATE_90:
+					su = v; sv = 1.0f - u;
+					break;
+				case VDP_OUTPUT_SURFACE_RENDER_ROTATE_180:
+					su = 1.0f - u; sv = 1.0f - v;
+					break;
+				case VDP_OUTPUT_SURFACE_RENDER_ROTATE_270:
+					su = 1.0f - v; sv = u;
+					break;
+				default:
+					su = u; sv = v;
+					break;
+				}
+
+				uint32_t sx = min((uint32_t)(op->src_rect.x0 + su * sw), op->src->width - 1);
+				uint32_t sy = min((uint32_t)(op->src_rect.y0 + sv * sh), op->src->height - 1);
+				s = unpack(src[sy * op->src->width + sx], op->src->format);
+			}
+
+			if (op->color_count == 4)
+			{
+				// 0 top left, 1 top right, 2 bottom right, 3 bottom left
+				const VdpColor *c = op->colors;
+				s.r *= (c[0].red * (1 - u) + c[1].red * u) * (1 - v) + (c[3].red * (1 - u) + c[2].red * u) * v;
+				s.g *= (c[0].green * (1 - u) + c[1].green * u) * (1 - v) + (c[3].green * (1 - u) + c[2].green * u) * v;
+				s.b *= (c[0].blue * (1 - u) + c[1].blue * u) * (1 - v) + (c[3].blue * (1 - u) + c[2].blue * u) * v;
+				s.a *= (c[0].alpha * (1 - u) + c[1].alpha * u) * (1 - v) + (c[3].alpha * (1 - u) + c[2].alpha * u) * v;
+			}
+			else
+			{
+				s.r *= op->colors[0].red;
+				s.g *= op->colors[0].green;
+				s.b *= op->colors[0].blue;
+				s.a *= op->colors[0].alpha;
+			}
+
+			uint32_t *d = &dst[y * op->dest->width + x];
+			*d = pack(blend(&op->blend, s, unpack(*d, op->dest->format)), op->dest->format);
+		}
+	}
+
+	free(src_copy);
+	return VDP_STATUS_OK;
+}
+
+const rgba_engine_t rgba_engine_sw =
+{
+	.name = "CPU",
+	.render = sw_render,
+};
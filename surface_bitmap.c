@@ -21,32 +21,39 @@
 
 VdpStatus vdp_bitmap_surface_create(VdpDevice device, VdpRGBAFormat rgba_format, uint32_t width, uint32_t height, VdpBool frequently_accessed, VdpBitmapSurface *surface)
 {
-#if 0
+	if (!surface)
+		return VDP_STATUS_INVALID_POINTER;
+
 	device_ctx_t *dev = handle_get(device);
 	if (!dev)
 		return VDP_STATUS_INVALID_HANDLE;
 
 	bitmap_surface_ctx_t *out = handle_create(sizeof(*out), surface, htype_bitmap);
 	if (!out)
+	{
+		handle_release(device);
 		return VDP_STATUS_RESOURCES;
+	}
 
 	out->frequently_accessed = frequently_accessed;
 
-	ret = rgba_create(&out->rgba, dev, width, height, rgba_format);
+	VdpStatus ret = rgba_create(&out->rgba, dev, width, height, rgba_format, frequently_accessed);
 	if (ret != VDP_STATUS_OK)
-	{
 		handle_destroy(*surface);
-		return ret;
-	}
 
-	return VDP_STATUS_OK;
-#else
-	return VDP_STATUS_ERROR;
-#endif
+	handle_release(device);
+	return ret;
 }
 
 VdpStatus vdp_bitmap_surface_destroy(VdpBitmapSurface surface)
 {
+	bitmap_surface_ctx_t *out = handle_get(surface);
+	if (!out)
+		return VDP_STATUS_INVALID_HANDLE;
+
+	rgba_destroy(&out->rgba);
+
+	handle_release(surface);
 	handle_destroy(surface);
 
 	return VDP_STATUS_OK;
@@ -54,16 +61,36 @@ VdpStatus vdp_bitmap_surface_destroy(VdpBitmapSurface surface)
 
 VdpStatus vdp_bitmap_surface_get_parameters(VdpBitmapSurface surface, VdpRGBAFormat *rgba_format, uint32_t *width, uint32_t *height, VdpBool *frequently_accessed)
 {
+	bitmap_surface_ctx_t *out = handle_get(surface);
+	if (!out)
+		return VDP_STATUS_INVALID_HANDLE;
+
+	if (rgba_format)
+		*rgba_format = out->rgba.format;
+
+	if (width)
+		*width = out->rgba.width;
 
+	if (height)
+		*height = out->rgba.height;
 
-	return VDP_STATUS_ERROR;
+	if (frequently_accessed)
+		*frequently_accessed = out->frequently_accessed;
+
+	handle_release(surface);
+	return VDP_STATUS_OK;
 }
 
 VdpStatus vdp_bitmap_surface_put_bits_native(VdpBitmapSurface surface, void const *const *source_data, uint32_t const *source_pitches, VdpRect const *destination_rect)
 {
+	bitmap_surface_ctx_t *out = handle_get(surface);
+	if (!out)
+		return VDP_STATUS_INVALID_HANDLE;
 
+	VdpStatus ret = rgba_put_bits_native(&out->rgba, source_data, source_pitches, destination_rect);
 
-	return VDP_STATUS_ERROR;
+	handle_release(surface);
+	return ret;
 }
 
 VdpStatus vdp_bitmap_surface_query_capabilities(VdpDevice device, VdpRGBAFormat surface_rgba_format, VdpBool *is_supported, uint32_t *max_width, uint32_t *max_height)
@@ -75,9 +102,10 @@ VdpStatus vdp_bitmap_surface_query_capabilities(VdpDevice device, VdpRGBAFormat
 	if (!dev)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	*is_supported = VDP_FALSE;
+	*is_supported = (surface_rgba_format == VDP_RGBA_FORMAT_R8G8B8A8 || surface_rgba_format == VDP_RGBA_FORMAT_B8G8R8A8);
 	*max_width = 8192;
 	*max_height = 8192;
 
+	handle_release(device);
 	return VDP_STATUS_OK;
 }
@@ -38,12 +38,15 @@ VdpStatus vdp_output_surface_create(VdpDevice device, VdpRGBAFormat rgba_format,
 	if (out)
         {
             memset(out, 0, sizeof(*out));
-            out->width = width;
-            out->height = height;
-            out->rgba_format = rgba_format;
+            status = rgba_create(&out->rgba, dev, width, height, rgba_format, 0);
+            if (status != VDP_STATUS_OK)
+            {
+                handle_destroy(*surface);
+                handle_release(device);
+                return status;
+            }
             out->contrast = 1.0;
             out->saturation = 1.0;
-            out->device = dev;
         }
         else{
             status = VDP_STATUS_RESOURCES;
@@ -58,6 +61,7 @@ VdpStatus vdp_output_surface_destroy(VdpOutputSurface surface)
 	if (!out)
 		return VDP_STATUS_INVALID_HANDLE;
 
+	rgba_destroy(&out->rgba);
 	memset(out, 0, sizeof(*out));
 	
         handle_release(surface);
@@ -73,13 +77,13 @@ VdpStatus vdp_output_surface_get_parameters(VdpOutputSurface surface, VdpRGBAFor
 		return VDP_STATUS_INVALID_HANDLE;
 
 	if (rgba_format)
-		*rgba_format = out->rgba_format;
+		*rgba_format = out->rgba.format;
 
 	if (width)
-		*width = out->width;
+		*width = out->rgba.width;
 
 	if (height)
-		*height = out->height;
+		*height = out->rgba.height;
 
         handle_release(surface);
 	return VDP_STATUS_OK;
@@ -91,9 +95,10 @@ VdpStatus vdp_output_surface_get_bits_native(VdpOutputSurface surface, VdpRect c
 	if (!out)
 		return VDP_STATUS_INVALID_HANDLE;
 
+	VdpStatus ret = rgba_get_bits_native(&out->rgba, source_rect, destination_data, destination_pitches);
 
         handle_release(surface);
-	return VDP_STATUS_ERROR;
+	return ret;
 }
 
 VdpStatus vdp_output_surface_put_bits_native(VdpOutputSurface surface, void const *const *source_data, uint32_t const *source_pitches, VdpRect const *destination_rect)
@@ -102,11 +107,10 @@ VdpStatus vdp_output_surface_put_bits_native(VdpOutputSurface surface, void cons
 	if (!out)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	VDPAU_DBG_ONCE("%s called but unimplemented!", __func__);
-
+	VdpStatus ret = rgba_put_bits_native(&out->rgba, source_data, source_pitches, destination_rect);
 
         handle_release(surface);
-	return VDP_STATUS_OK;
+	return ret;
 }
 
 VdpStatus vdp_output_surface_put_bits_indexed(VdpOutputSurface surface, VdpIndexedFormat source_indexed_format, void const *const *source_data, uint32_t const *source_pitch, VdpRect const *destination_rect, VdpColorTableFormat color_table_format, void const *color_table)
@@ -115,11 +119,10 @@ VdpStatus vdp_output_surface_put_bits_indexed(VdpOutputSurface surface, VdpIndex
 	if (!out)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	VDPAU_DBG_ONCE("%s called but unimplemented!", __func__);
-
+	VdpStatus ret = rgba_put_bits_indexed(&out->rgba, source_indexed_format, source_data, source_pitch, destination_rect, color_table_format, color_table);
 
         handle_release(surface);
-	return VDP_STATUS_OK;
+	return ret;
 }
 
 VdpStatus vdp_output_surface_put_bits_y_cb_cr(VdpOutputSurface surface, VdpYCbCrFormat source_ycbcr_format, void const *const *source_data, uint32_t const *source_pitches, VdpRect const *destination_rect, VdpCSCMatrix const *csc_matrix)
@@ -128,11 +131,10 @@ VdpStatus vdp_output_surface_put_bits_y_cb_cr(VdpOutputSurface surface, VdpYCbCr
 	if (!out)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	VDPAU_DBG_ONCE("%s called but unimplemented!", __func__);
-
+	VdpStatus ret = rgba_put_bits_y_cb_cr(&out->rgba, source_ycbcr_format, source_data, source_pitches, destination_rect, csc_matrix);
 
         handle_release(surface);
-	return VDP_STATUS_OK;
+	return ret;
 }
 
 VdpStatus vdp_output_surface_render_output_surface(VdpOutputSurface destination_surface, VdpRect const *destination_rect, VdpOutputSurface source_surface, VdpRect const *source_rect, VdpColor const *colors, VdpOutputSurfaceRenderBlendState const *blend_state, uint32_t flags)
@@ -141,16 +143,23 @@ VdpStatus vdp_output_surface_render_output_surface(VdpOutputSurface destination_
 	if (!out)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	output_surface_ctx_t *in = handle_get(source_surface);
-	if (!in)
-		return VDP_STATUS_INVALID_HANDLE;
-
-	VDPAU_DBG_ONCE("%s called but unimplemented!", __func__);
+	output_surface_ctx_t *in = NULL;
+	if (source_surface != VDP_INVALID_HANDLE)
+	{
+		in = handle_get(source_surface);
+		if (!in)
+		{
+			handle_release(destination_surface);
+			return VDP_STATUS_INVALID_HANDLE;
+		}
+	}
 
+	VdpStatus ret = rgba_render(&out->rgba, destination_rect, in ? &in->rgba : NULL, source_rect, colors, blend_state, flags);
 
         handle_release(destination_surface);
-        handle_release(source_surface);
-	return VDP_STATUS_OK;
+        if (in)
+            handle_release(source_surface);
+	return ret;
 }
 
 VdpStatus vdp_output_surface_render_bitmap_surface(VdpOutputSurface destination_surface, VdpRect const *destination_rect, VdpBitmapSurface source_surface, VdpRect const *source_rect, VdpColor const *colors, VdpOutputSurfaceRenderBlendState const *blend_state, uint32_t flags)
@@ -159,11 +168,23 @@ VdpStatus vdp_output_surface_render_bitmap_surface(VdpOutputSurface destination_
 	if (!out)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	VDPAU_DBG_ONCE("%s called but unimplemented!", __func__);
+	bitmap_surface_ctx_t *in = NULL;
+	if (source_surface != VDP_INVALID_HANDLE)
+	{
+		in = handle_get(source_surface);
+		if (!in)
+		{
+			handle_release(destination_surface);
+			return VDP_STATUS_INVALID_HANDLE;
+		}
+	}
 
+	VdpStatus ret = rgba_render(&out->rgba, destination_rect, in ? &in->rgba : NULL, source_rect, colors, blend_state, flags);
 
         handle_release(destination_surface);
-	return VDP_STATUS_OK;
+        if (in)
+            handle_release(source_surface);
+	return ret;
 }
 
 VdpStatus vdp_output_surface_query_capabilities(VdpDevice device, VdpRGBAFormat surface_rgba_format, VdpBool *is_supported, uint32_t *max_width, uint32_t *max_height)
@@ -193,7 +214,7 @@ VdpStatus vdp_output_surface_query_get_put_bits_native_capabilities(VdpDevice de
 	if (!dev)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	*is_supported = VDP_FALSE;
+	*is_supported = (surface_rgba_format == VDP_RGBA_FORMAT_R8G8B8A8 || surface_rgba_format == VDP_RGBA_FORMAT_B8G8R8A8);
 
         handle_release(device);
 	return VDP_STATUS_OK;
@@ -208,7 +229,10 @@ VdpStatus vdp_output_surface_query_put_bits_indexed_capabilities(VdpDevice devic
 	if (!dev)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	*is_supported = VDP_FALSE;
+	*is_supported = (surface_rgba_format == VDP_RGBA_FORMAT_R8G8B8A8 || surface_rgba_format == VDP_RGBA_FORMAT_B8G8R8A8) &&
+			(bits_indexed_format == VDP_INDEXED_FORMAT_A4I4 || bits_indexed_format == VDP_INDEXED_FORMAT_I4A4 ||
+			 bits_indexed_format == VDP_INDEXED_FORMAT_A8I8 || bits_indexed_format == VDP_INDEXED_FORMAT_I8A8) &&
+			color_table_format == VDP_COLOR_TABLE_FORMAT_B8G8R8X8;
 
         handle_release(device);
 	return VDP_STATUS_OK;
@@ -223,7 +247,10 @@ VdpStatus vdp_output_surface_query_put_bits_y_cb_cr_capabilities(VdpDevice devic
 	if (!dev)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	*is_supported = VDP_FALSE;
+	*is_supported = (surface_rgba_format == VDP_RGBA_FORMAT_R8G8B8A8 || surface_rgba_format == VDP_RGBA_FORMAT_B8G8R8A8) &&
+			(bits_ycbcr_format == VDP_YCBCR_FORMAT_NV12 || bits_ycbcr_format == VDP_YCBCR_FORMAT_YV12 ||
+			 bits_ycbcr_format == VDP_YCBCR_FORMAT_UYVY || bits_ycbcr_format == VDP_YCBCR_FORMAT_YUYV ||
+			 bits_ycbcr_format == VDP_YCBCR_FORMAT_Y8U8V8A8 || bits_ycbcr_format == VDP_YCBCR_FORMAT_V8U8Y8A8);
 
         handle_release(device);
 	return VDP_STATUS_OK;
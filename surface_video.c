@@ -23,6 +23,7 @@
 #include "vdpau_private.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 VdpStatus vdp_video_surface_create(VdpDevice device, VdpChromaType chroma_type, uint32_t width, uint32_t height, VdpVideoSurface *surface)
 {
@@ -53,18 +54,22 @@ VdpStatus vdp_video_surface_create(VdpDevice device, VdpChromaType chroma_type,
    cedarv_setBufferInvalid(vs->dataY);
    cedarv_setBufferInvalid(vs->dataU);
    cedarv_setBufferInvalid(vs->dataV);
+   cedarv_setBufferInvalid(vs->rotY);
+   cedarv_setBufferInvalid(vs->rotU);
    
    switch (chroma_type)
    {
    case VDP_CHROMA_TYPE_444:
       //vs->data = cedarv_malloc(vs->plane_size * 3);
-      vs->dataY = cedarv_malloc(vs->plane_size);
-      vs->dataU = cedarv_malloc(vs->plane_size);
-      vs->dataV = cedarv_malloc(vs->plane_size);
+      vs->dataY = cedarv_malloc_type(vs->plane_size, CEDARV_MEM_VIDEO_SURFACE);
+      vs->dataU = cedarv_malloc_type(vs->plane_size, CEDARV_MEM_VIDEO_SURFACE);
+      vs->dataV = cedarv_malloc_type(vs->plane_size, CEDARV_MEM_VIDEO_SURFACE);
       if (! cedarv_isValid(vs->dataY) || ! cedarv_isValid(vs->dataU) || ! cedarv_isValid(vs->dataV))
       {
 	  printf("vdpau video surface=%d create, failure\n", *surface);
 
+	  // the planes that could be allocated
+	  video_surface_free_planes(vs);
 	  handle_destroy(*surface);
           handle_release(device);
 	  return VDP_STATUS_RESOURCES;
@@ -72,13 +77,16 @@ VdpStatus vdp_video_surface_create(VdpDevice device, VdpChromaType chroma_type,
       break;
    case VDP_CHROMA_TYPE_422:
       //vs->data = cedarv_malloc(vs->plane_size * 2);
-      vs->dataY = cedarv_malloc(vs->plane_size);
-      vs->dataU = cedarv_malloc(vs->plane_size/2);
-      vs->dataV = cedarv_malloc(vs->plane_size/2);
+      vs->dataY = cedarv_malloc_type(vs->plane_size, CEDARV_MEM_VIDEO_SURFACE);
+      // big enough for the interleaved 4:2:2 chroma written by the JPEG decoder
+      vs->dataU = cedarv_malloc_type(vs->plane_size, CEDARV_MEM_VIDEO_SURFACE);
+      vs->dataV = cedarv_malloc_type(vs->plane_size/2, CEDARV_MEM_VIDEO_SURFACE);
       if (! cedarv_isValid(vs->dataY) || ! cedarv_isValid(vs->dataU) || ! cedarv_isValid(vs->dataV))
       {
 	  printf("vdpau video surface=%d create, failure\n", *surface);
 
+	  // the planes that could be allocated
+	  video_surface_free_planes(vs);
 	  handle_destroy(*surface);
           handle_release(device);
 	  return VDP_STATUS_RESOURCES;
@@ -86,12 +94,14 @@ VdpStatus vdp_video_surface_create(VdpDevice device, VdpChromaType chroma_type,
       break;
    case VDP_CHROMA_TYPE_420:
       //vs->data = cedarv_malloc(vs->plane_size + (vs->plane_size / 2));
-      vs->dataY = cedarv_malloc(vs->plane_size);
-      vs->dataU = cedarv_malloc(vs->plane_size/2);
+      vs->dataY = cedarv_malloc_type(vs->plane_size, CEDARV_MEM_VIDEO_SURFACE);
+      vs->dataU = cedarv_malloc_type(vs->plane_size/2, CEDARV_MEM_VIDEO_SURFACE);
       if (! cedarv_isValid(vs->dataY) || ! cedarv_isValid(vs->dataU))
       {
 	  printf("vdpau video surface=%d create, failure\n", *surface);
 
+	  // the planes that could be allocated
+	  video_surface_free_planes(vs);
 	  handle_destroy(*surface);
           handle_release(device);
 	  return VDP_STATUS_RESOURCES;
@@ -99,33 +109,35 @@ VdpStatus vdp_video_surface_create(VdpDevice device, VdpChromaType chroma_type,
       
       break;
    default:
-      free(vs);
+      handle_destroy(*surface);
       handle_release(device);
       return VDP_STATUS_INVALID_CHROMA_TYPE;
    }
+   capture_surface_create(*surface, chroma_type, width, height);
    handle_release(device);
    
    return VDP_STATUS_OK;
 }
 
+static void free_rotated(video_surface_ctx_t *vs);
+
+typedef struct
+{
+	video_planes_t *planes;
+} video_export_ctx_t;
+
 VdpStatus vdp_video_surface_destroy(VdpVideoSurface surface)
 {
 	video_surface_ctx_t *vs = handle_get(surface);
 	if (!vs)
 		return VDP_STATUS_INVALID_HANDLE;
 
+	completion_sync(vs->device);
+	capture_surface_destroy(surface);
 	if (vs->decoder_private_free)
 		vs->decoder_private_free(vs);
-	if( cedarv_isValid(vs->dataY) )
-	  cedarv_free(vs->dataY);
-	if( cedarv_isValid(vs->dataU) )
-	  cedarv_free(vs->dataU);
-	if (cedarv_isValid(vs->dataV) )
-	  cedarv_free(vs->dataV);
-
-        cedarv_setBufferInvalid(vs->dataY);
-        cedarv_setBufferInvalid(vs->dataU);
-        cedarv_setBufferInvalid(vs->dataV);
+	free_rotated(vs);
+	video_surface_free_planes(vs);
         
         VDPAU_DBG("vdpau video surface=%d destroyed", surface);
         
@@ -155,14 +167,296 @@ VdpStatus vdp_video_surface_get_parameters(VdpVideoSurface surface, VdpChromaTyp
 	return VDP_STATUS_OK;
 }
 
+static int scaled_ratio(video_surface_ctx_t *vs, video_surface_ctx_t *scaled)
+{
+	int ratio;
+
+	if (scaled->chroma_type != VDP_CHROMA_TYPE_420)
+		return 0;
+
+	// 1: 1/2, 2: 1/4
+	for (ratio = 1; ratio <= 2; ratio++)
+		if (scaled->width == (vs->width + (1 << ratio) - 1) >> ratio &&
+		    scaled->height == (vs->height + (1 << ratio) - 1) >> ratio)
+			return ratio;
+
+	return 0;
+}
+
+VdpStatus vdp_video_surface_attach_scaled_sunxi(VdpVideoSurface surface, VdpVideoSurface scaled)
+{
+	VdpStatus ret = VDP_STATUS_OK;
+
+	if (surface == scaled)
+		return VDP_STATUS_INVALID_HANDLE;
+
+	video_surface_ctx_t *vs = handle_get(surface);
+	if (!vs)
+		return VDP_STATUS_INVALID_HANDLE;
+
+	if (scaled == VDP_INVALID_HANDLE)
+	{
+		vs->scaled = VDP_INVALID_HANDLE;
+		handle_release(surface);
+		return VDP_STATUS_OK;
+	}
+
+	video_surface_ctx_t *ss = handle_get(scaled);
+	if (!ss || handle_get_type(scaled) != htype_video)
+		ret = VDP_STATUS_INVALID_HANDLE;
+	else if (!scaled_ratio(vs, ss))
+		ret = VDP_STATUS_INVALID_SIZE;
+	else
+		vs->scaled = scaled;
+
+	if (ss)
+		handle_release(scaled);
+	handle_release(surface);
+	return ret;
+}
+
+/*
+ * Returns the attached scaled surface and its ratio for the decoders,
+ * which have to handle_release(vs->scaled) after use.
+ */
+video_surface_ctx_t *video_surface_get_scaled(video_surface_ctx_t *vs, int *ratio)
+{
+	if (!vs->scaled || vs->scaled == VDP_INVALID_HANDLE)
+		return NULL;
+
+	video_surface_ctx_t *ss = handle_get(vs->scaled);
+	if (!ss)
+		return NULL;
+
+	// the handle might have been reused since attaching
+	if (handle_get_type(vs->scaled) != htype_video || !(*ratio = scaled_ratio(vs, ss)))
+	{
+		handle_release(vs->scaled);
+		return NULL;
+	}
+
+	return ss;
+}
+
+static void free_rotated(video_surface_ctx_t *vs)
+{
+	if (cedarv_isValid(vs->rotY))
+		cedarv_free(vs->rotY);
+	if (cedarv_isValid(vs->rotU))
+		cedarv_free(vs->rotU);
+
+	// cedarv_setBufferInvalid() only invalidates its own copy of the handle
+	memset(&vs->rotY, 0, sizeof(vs->rotY));
+	memset(&vs->rotU, 0, sizeof(vs->rotU));
+}
+
+VdpStatus vdp_video_surface_set_rotation_sunxi(VdpVideoSurface surface, uint32_t rotation)
+{
+	if (rotation > VDP_SUNXI_ROTATION_FLIP_V)
+		return VDP_STATUS_INVALID_VALUE;
+
+	video_surface_ctx_t *vs = handle_get(surface);
+	if (!vs)
+		return VDP_STATUS_INVALID_HANDLE;
+
+	if (vs->chroma_type != VDP_CHROMA_TYPE_420)
+	{
+		handle_release(surface);
+		return VDP_STATUS_INVALID_CHROMA_TYPE;
+	}
+
+	vs->rotated = 0;
+	if (rotation == VDP_SUNXI_ROTATION_NONE)
+		free_rotated(vs);
+	else if (!cedarv_isValid(vs->rotY))
+	{
+		// stride_width and stride_height are both 64 aligned, so the planes fit either way round
+		vs->rotY = cedarv_malloc_type(vs->plane_size, CEDARV_MEM_VIDEO_SURFACE);
+		vs->rotU = cedarv_malloc_type(vs->plane_size/2, CEDARV_MEM_VIDEO_SURFACE);
+		if (!cedarv_isValid(vs->rotY) || !cedarv_isValid(vs->rotU))
+		{
+			free_rotated(vs);
+			vs->rotation = VDP_SUNXI_ROTATION_NONE;
+			handle_release(surface);
+			return VDP_STATUS_RESOURCES;
+		}
+	}
+
+	vs->rotation = rotation;
+	handle_release(surface);
+	return VDP_STATUS_OK;
+}
+
+static int export_plane(VdpVideoSurfaceExportInfoSunxi *info, CEDARV_MEMORY mem, uint32_t pitch, uint32_t height)
+{
+	int i = info->num_planes++;
+
+	info->planes[i].fd = cedarv_export_dmabuf(mem);
+	info->planes[i].offset = 0;
+	info->planes[i].pitch = pitch;
+	info->planes[i].size = cedarv_getSize(mem);
+	info->planes[i].phys_addr = cedarv_virt2phys(mem);
+
+	// consumers read pitch * height bytes
+	return info->planes[i].size >= (size_t)pitch * height;
+}
+
+VdpStatus vdp_video_surface_export_sunxi(VdpVideoSurface surface, VdpVideoSurfaceExportInfoSunxi *info)
+{
+	if (!info)
+		return VDP_STATUS_INVALID_POINTER;
+
+	video_surface_ctx_t *vs = handle_get(surface);
+	if (!vs)
+		return VDP_STATUS_INVALID_HANDLE;
+
+	// the surface may still be decoded into asynchronously
+	completion_sync(vs->device);
+
+	memset(info, 0, sizeof(*info));
+	info->width = vs->width;
+	info->height = vs->height;
+	info->modifier = VDP_SUNXI_MODIFIER_LINEAR;
+
+	// decoders write 32 aligned rows, put_bits packs them
+	uint32_t pitch = vs->frame_decoded ? ALIGN(vs->width, 32) : vs->width;
+	uint32_t c_height = (vs->height + 1) / 2;
+	int ok = 1;
+
+	switch (vs->source_format)
+	{
+	case INTERNAL_YCBCR_FORMAT:
+	case INTERNAL_YCBCR_FORMAT_422:
+		// newer VEs write NV12 and NV16 without tiles
+		if (cedarv_get_version() < 0x1680)
+			info->modifier = VDP_SUNXI_MODIFIER_TILED;
+		pitch = ALIGN(vs->width, 32);
+		info->fourcc = VDP_SUNXI_FOURCC_NV12;
+		if (vs->source_format == INTERNAL_YCBCR_FORMAT_422)
+		{
+			info->fourcc = VDP_SUNXI_FOURCC_NV16;
+			c_height = vs->height;
+		}
+		ok &= export_plane(info, vs->dataY, pitch, ALIGN(vs->height, 32));
+		ok &= export_plane(info, vs->dataU, pitch, ALIGN(c_height, 32));
+		break;
+
+	case VDP_YCBCR_FORMAT_NV12:
+		info->fourcc = VDP_SUNXI_FOURCC_NV12;
+		ok &= export_plane(info, vs->dataY, pitch, vs->height);
+		ok &= export_plane(info, vs->dataU, pitch, c_height);
+		break;
+
+	case VDP_YCBCR_FORMAT_YV12:
+		// put_bits keeps U in dataU and V in dataV, which is YUV420 order
+		info->fourcc = VDP_SUNXI_FOURCC_YUV420;
+		ok &= export_plane(info, vs->dataY, vs->width, vs->height);
+		ok &= export_plane(info, vs->dataU, vs->width / 2, vs->height / 2);
+		ok &= export_plane(info, vs->dataV, vs->width / 2, vs->height / 2);
+		break;
+
+	case VDP_YCBCR_FORMAT_YUYV:
+	case VDP_YCBCR_FORMAT_UYVY:
+		info->fourcc = vs->source_format == VDP_YCBCR_FORMAT_YUYV ? VDP_SUNXI_FOURCC_YUYV : VDP_SUNXI_FOURCC_UYVY;
+		ok &= export_plane(info, vs->dataY, 2 * vs->width, vs->height);
+		break;
+
+	default:
+		handle_release(surface);
+		return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+	}
+
+	int i, dmabuf = 1;
+	for (i = 0; i < info->num_planes; i++)
+		if (info->planes[i].fd == -1)
+			dmabuf = 0;
+
+	// either every plane has a DMA-BUF or none, the physical addresses are always there
+	if (!dmabuf)
+		for (i = 0; i < info->num_planes; i++)
+			if (info->planes[i].fd != -1)
+			{
+				close(info->planes[i].fd);
+				info->planes[i].fd = -1;
+			}
+	info->flags = dmabuf ? VDP_SUNXI_EXPORT_FLAG_DMABUF : 0;
+
+	if (ok && !vs->exported)
+	{
+		vs->exported = calloc(1, sizeof(*vs->exported));
+		if (vs->exported)
+			vs->exported->refs = 1;
+	}
+
+	video_export_ctx_t *e = NULL;
+	if (ok && vs->exported)
+		e = handle_create(sizeof(*e), &info->handle, htype_export);
+
+	if (!e)
+	{
+		for (i = 0; i < info->num_planes; i++)
+			if (info->planes[i].fd != -1)
+				close(info->planes[i].fd);
+		memset(info, 0, sizeof(*info));
+		handle_release(surface);
+		return ok ? VDP_STATUS_RESOURCES : VDP_STATUS_ERROR;
+	}
+
+	// the engines wrote around the cpu cache
+	cedarv_flush_cache(vs->dataY, cedarv_getSize(vs->dataY));
+	cedarv_flush_cache(vs->dataU, cedarv_getSize(vs->dataU));
+	if (cedarv_isValid(vs->dataV))
+		cedarv_flush_cache(vs->dataV, cedarv_getSize(vs->dataV));
+
+	// the export keeps the planes, not the surface
+	e->planes = vs->exported;
+	__atomic_add_fetch(&e->planes->refs, 1, __ATOMIC_ACQ_REL);
+	handle_release(surface);
+	return VDP_STATUS_OK;
+}
+
+VdpStatus vdp_video_surface_export_release_sunxi(VdpHandle export)
+{
+	if (handle_get_type(export) != htype_export)
+		return VDP_STATUS_INVALID_HANDLE;
+
+	video_export_ctx_t *e = handle_get(export);
+	if (!e)
+		return VDP_STATUS_INVALID_HANDLE;
+
+	video_planes_put(e->planes);
+	handle_release(export);
+	handle_destroy(export);
+	return VDP_STATUS_OK;
+}
+
+/*
+ * Width of the rotated copy, which is the line stride the decoders
+ * program for it.
+ */
+uint32_t video_surface_rotated_width(video_surface_ctx_t *vs)
+{
+	if (vs->rotation == VDP_SUNXI_ROTATION_90 || vs->rotation == VDP_SUNXI_ROTATION_270)
+		return vs->height;
+
+	return vs->width;
+}
+
 VdpStatus vdp_video_surface_get_bits_y_cb_cr(VdpVideoSurface surface, VdpYCbCrFormat destination_ycbcr_format, void *const *destination_data, uint32_t const *destination_pitches)
 {
+	if (!destination_data || !destination_pitches)
+		return VDP_STATUS_INVALID_POINTER;
+
 	video_surface_ctx_t *vs = handle_get(surface);
 	if (!vs)
 		return VDP_STATUS_INVALID_HANDLE;
 
+	// the surface may still be decoded into asynchronously
+	completion_sync(vs->device);
+	VdpStatus status = readback_video_surface(vs, destination_ycbcr_format, destination_data, destination_pitches);
+
         handle_release(surface);
-	return VDP_STATUS_ERROR;
+	return status;
 }
 
 VdpStatus vdp_video_surface_put_bits_y_cb_cr(VdpVideoSurface surface, VdpYCbCrFormat source_ycbcr_format, void const *const *source_data, uint32_t const *source_pitches)
@@ -176,6 +470,7 @@ VdpStatus vdp_video_surface_put_bits_y_cb_cr(VdpVideoSurface surface, VdpYCbCrFo
 		return VDP_STATUS_INVALID_HANDLE;
 
 	vs->source_format = source_ycbcr_format;
+	vs->rotated = 0;
 
 	switch (source_ycbcr_format)
 	{
@@ -208,7 +503,7 @@ VdpStatus vdp_video_surface_put_bits_y_cb_cr(VdpVideoSurface surface, VdpYCbCrFo
 			offset += vs->width;
 		}
 		src = source_data[1];
-		offset = vs->plane_size;
+		offset = 0;
 		for (i = 0; i < vs->height / 2; i++) {
 			cedarv_memcpy(vs->dataU, offset, src, vs->width);
 			src += source_pitches[1];
@@ -221,6 +516,13 @@ VdpStatus vdp_video_surface_put_bits_y_cb_cr(VdpVideoSurface surface, VdpYCbCrFo
                    status = VDP_STATUS_INVALID_CHROMA_TYPE;
                    break;
                 }
+		// 4:2:0 surfaces get the separate V plane with the first planar frame
+		if (!cedarv_isValid(vs->dataV))
+			vs->dataV = cedarv_malloc_type(vs->plane_size/4, CEDARV_MEM_VIDEO_SURFACE);
+		if (!cedarv_isValid(vs->dataV)) {
+                   status = VDP_STATUS_RESOURCES;
+                   break;
+                }
 		src = source_data[0];
 		for (i = 0; i < vs->height; i++) {
 			cedarv_memcpy(vs->dataY, offset, src, vs->width);
@@ -231,18 +533,20 @@ VdpStatus vdp_video_surface_put_bits_y_cb_cr(VdpVideoSurface surface, VdpYCbCrFo
 		offset = 0; //vs->plane_size;
 		for (i = 0; i < vs->height / 2; i++) {
 			cedarv_memcpy(vs->dataU, offset, src, vs->width / 2);
-			src += source_pitches[1];
+			src += source_pitches[2];
 			offset += vs->width / 2;
 		}
 		src = source_data[1];
 		offset = 0; //vs->plane_size + vs->plane_size / 4;
 		for (i = 0; i < vs->height / 2; i++) {
 			cedarv_memcpy(vs->dataV, offset, src, vs->width / 2);
-			src += source_pitches[2];
+			src += source_pitches[1];
 			offset += vs->width / 2;
 		}
 		break;
 	}
+	vs->frame_decoded = 0;
+	vs->generation++;
 
         handle_release(surface);
 	return status;
@@ -274,7 +578,18 @@ VdpStatus vdp_video_surface_query_get_put_bits_y_cb_cr_capabilities(VdpDevice de
 	if (!dev)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	*is_supported = VDP_FALSE;
+	switch (surface_chroma_type)
+	{
+	case VDP_CHROMA_TYPE_420:
+		*is_supported = bits_ycbcr_format == VDP_YCBCR_FORMAT_NV12 || bits_ycbcr_format == VDP_YCBCR_FORMAT_YV12;
+		break;
+	case VDP_CHROMA_TYPE_422:
+		*is_supported = bits_ycbcr_format == VDP_YCBCR_FORMAT_YUYV || bits_ycbcr_format == VDP_YCBCR_FORMAT_UYVY;
+		break;
+	default:
+		*is_supported = VDP_FALSE;
+		break;
+	}
 
         handle_release(device);
 	return VDP_STATUS_OK;
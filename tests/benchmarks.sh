@@ -0,0 +1,19 @@
+#!/bin/sh
+#
+# Runs the vdpau_replay benchmarks once on the fake engine of an old
+# and a new VE, decoded surfaces are tiled on the old one. They check
+# their first round against plain C, so this catches SIMD paths that
+# went wrong. Run from the top directory by make check.
+
+fail=0
+for version in 1623 1680; do
+	for bench in osd readback seek subtitle; do
+		if ! LD_LIBRARY_PATH=. VDPAU_FAKE_VE=$version ./vdpau_replay -b $bench >/dev/null; then
+			echo "FAIL benchmark $bench on $version"
+			fail=1
+		fi
+	done
+done
+
+[ $fail -eq 0 ] && echo "benchmarks: ok"
+exit $fail
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Runs every detile kernel set this cpu has against the plain C one,
+ * for all lengths up to 32 bytes and unaligned sources and
+ * destinations. The destinations are compared including a guard area
+ * behind them, a kernel may write neither more nor less than C.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../detile.h"
+
+#define GUARD 64
+#define SIZE (2 * 32 + GUARD)
+
+static uint8_t src[2][SIZE];
+static uint8_t out[2][2][SIZE];
+
+static int compare(const char *name, const char *kernel, uint32_t n, uint32_t offset)
+{
+	if (memcmp(out[0][0], out[1][0], SIZE) == 0 && memcmp(out[0][1], out[1][1], SIZE) == 0)
+		return 0;
+
+	fprintf(stderr, "FAIL %s %s differs from c, n=%u offset=%u\n", name, kernel, n, offset);
+	return 1;
+}
+
+static void reset(void)
+{
+	memset(out, 0xa5, sizeof(out));
+}
+
+int main(void)
+{
+	const detile_kernels_t *const *available = detile_kernels_available();
+	const detile_kernels_t *c = NULL;
+	uint32_t i, n, offset;
+	int failed = 0, k;
+
+	for (k = 0; available[k]; k++)
+		if (strcmp(available[k]->name, "c") == 0)
+			c = available[k];
+
+	if (!c)
+	{
+		fprintf(stderr, "FAIL no c kernels\n");
+		return 1;
+	}
+
+	srand(3);
+	for (i = 0; i < SIZE; i++)
+	{
+		src[0][i] = rand();
+		src[1][i] = rand();
+	}
+
+	for (k = 0; available[k]; k++)
+	{
+		const detile_kernels_t *t = available[k];
+		const detile_kernels_t *both[2] = { c, t };
+		int j, bad = 0;
+
+		for (n = 0; n <= 32; n++)
+			for (offset = 0; offset < 16; offset++)
+			{
+				const uint8_t *s = src[0] + offset, *s2 = src[1] + offset;
+
+				reset();
+				for (j = 0; j < 2; j++)
+					both[j]->copy(out[j][0] + offset, s, n);
+				bad |= compare(t->name, "copy", n, offset);
+
+				reset();
+				for (j = 0; j < 2; j++)
+					both[j]->split(out[j][0] + offset, out[j][1] + offset, s, n);
+				bad |= compare(t->name, "split", n, offset);
+
+				reset();
+				for (j = 0; j < 2; j++)
+					both[j]->swap(out[j][0] + offset, s, n);
+				bad |= compare(t->name, "swap", n, offset);
+
+				reset();
+				for (j = 0; j < 2; j++)
+					both[j]->pack(out[j][0] + offset, s, s2, n, 0);
+				bad |= compare(t->name, "pack yuyv", n, offset);
+
+				reset();
+				for (j = 0; j < 2; j++)
+					both[j]->pack(out[j][0] + offset, s, s2, n, 1);
+				bad |= compare(t->name, "pack uyvy", n, offset);
+			}
+
+		printf("detile kernels %s: %s\n", t->name, bad ? "FAILED" : "ok");
+		failed |= bad;
+	}
+
+	return failed;
+}
@@ -0,0 +1,6 @@
+#!/bin/sh
+#
+# Compares the detile kernels of this cpu with the C ones. Run from the
+# top directory by make check.
+
+exec tests/detile_kernels
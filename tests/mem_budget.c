@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Checks the accounting of the contiguous memory on the fake engine,
+ * with VDPAU_MEM_BUDGET set by mem_budget.sh: the usage per type has
+ * to add up to the total and follow every allocation and free, an
+ * allocation over the budget has to fail with invalid memory after
+ * asking the evictors, and video surfaces have to fail with
+ * VDP_STATUS_RESOURCES once the budget is used up.
+ *
+ *   VDPAU_FAKE_VE=<version> VDPAU_MEM_BUDGET=<MiB> mem_budget
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vdpau/vdpau.h>
+#include "../vdpau_sunxi.h"
+#include "../ve.h"
+
+VdpDeviceCreateSunxi vdp_imp_device_create_sunxi;
+
+static int errors;
+
+#define CHECK(cond, ...) \
+	do { if (!(cond)) { fprintf(stderr, "mem budget: " __VA_ARGS__); fprintf(stderr, "\n"); errors++; } } while (0)
+
+static size_t usage_sum(size_t *usage)
+{
+	size_t total = cedarv_mem_get_usage(usage), sum = 0;
+	int t;
+
+	for (t = 0; t < CEDARV_MEM_TYPES; t++)
+		sum += usage[t];
+
+	CHECK(sum == total, "usage adds up to %zu, total is %zu", sum, total);
+	return total;
+}
+
+static CEDARV_MEMORY cache;
+static int evicted;
+
+static size_t evict_cache(void *context, size_t needed)
+{
+	if (!cedarv_isValid(cache))
+		return 0;
+
+	size_t size = cedarv_getSize(cache);
+	cedarv_free(cache);
+	memset(&cache, 0, sizeof(cache));
+	evicted++;
+	return size;
+}
+
+int main(void)
+{
+	size_t base[CEDARV_MEM_TYPES], usage[CEDARV_MEM_TYPES];
+	CEDARV_MEMORY mem[CEDARV_MEM_TYPES];
+	VdpGetProcAddress *get_proc_address;
+	VdpDevice device;
+	int t;
+
+	if (vdp_imp_device_create_sunxi(&device, &get_proc_address) != VDP_STATUS_OK)
+	{
+		fprintf(stderr, "could not create the device\n");
+		return 1;
+	}
+
+	const size_t budget = cedarv_mem_get_budget();
+	if (budget == 0)
+	{
+		fprintf(stderr, "VDPAU_MEM_BUDGET is not set\n");
+		return 1;
+	}
+
+	// one allocation of every type, sizes that aren't whole pages
+	size_t base_total = usage_sum(base);
+	for (t = 0; t < CEDARV_MEM_TYPES; t++)
+	{
+		mem[t] = cedarv_malloc_type(4096 * (t + 1) + 100, t);
+		CHECK(cedarv_isValid(mem[t]), "allocation of type %d failed", t);
+	}
+
+	size_t total = usage_sum(usage), expected = base_total;
+	for (t = 0; t < CEDARV_MEM_TYPES; t++)
+	{
+		size_t size = cedarv_isValid(mem[t]) ? cedarv_getSize(mem[t]) : 0;
+		CHECK(usage[t] == base[t] + size, "type %d uses %zu, expected %zu", t, usage[t], base[t] + size);
+		expected += size;
+	}
+	CHECK(total == expected, "total is %zu, expected %zu", total, expected);
+
+	for (t = 0; t < CEDARV_MEM_TYPES; t++)
+		cedarv_free(mem[t]);
+	total = usage_sum(usage);
+	CHECK(total == base_total, "total is %zu after freeing, was %zu", total, base_total);
+	CHECK(memcmp(usage, base, sizeof(usage)) == 0, "usage per type differs after freeing");
+
+	// over the budget with nothing to evict
+	CEDARV_MEMORY over = cedarv_malloc_type(budget - base_total + 4096, CEDARV_MEM_VBV);
+	CHECK(!cedarv_isValid(over), "allocation over the budget succeeded");
+	cedarv_free(over);
+	CHECK(cedarv_mem_get_usage(NULL) == base_total, "failed allocation was counted");
+
+	// over the budget, but a cache gives enough back
+	cache = cedarv_malloc_cached_type(budget / 2, CEDARV_MEM_CONVERSION);
+	CHECK(cedarv_isValid(cache), "allocation of the cache failed");
+	cedarv_mem_add_evictor(evict_cache, NULL);
+
+	CEDARV_MEMORY fits = cedarv_malloc_type(budget - base_total - 4096, CEDARV_MEM_SCRATCH);
+	CHECK(cedarv_isValid(fits), "allocation after evicting failed");
+	CHECK(evicted == 1, "the cache was evicted %d times", evicted);
+	CHECK(usage_sum(usage) <= budget, "total is over the budget after evicting");
+	CHECK(usage[CEDARV_MEM_CONVERSION] == base[CEDARV_MEM_CONVERSION], "the evicted cache is still counted");
+
+	cedarv_mem_remove_evictor(evict_cache, NULL);
+	cedarv_free(fits);
+
+	// video surfaces until the budget is used up
+	VdpVideoSurfaceCreate *surface_create;
+	VdpVideoSurfaceDestroy *surface_destroy;
+	if (get_proc_address(device, VDP_FUNC_ID_VIDEO_SURFACE_CREATE, (void **)&surface_create) != VDP_STATUS_OK ||
+	    get_proc_address(device, VDP_FUNC_ID_VIDEO_SURFACE_DESTROY, (void **)&surface_destroy) != VDP_STATUS_OK)
+	{
+		fprintf(stderr, "driver misses video surface functions\n");
+		return 1;
+	}
+
+	VdpVideoSurface surfaces[64];
+	VdpStatus status = VDP_STATUS_OK;
+	int count = 0;
+	while (count < 64)
+	{
+		status = surface_create(device, VDP_CHROMA_TYPE_420, 1920, 1080, &surfaces[count]);
+		if (status != VDP_STATUS_OK)
+			break;
+		count++;
+	}
+	CHECK(status == VDP_STATUS_RESOURCES, "surface %d returned %d instead of running out", count, status);
+	CHECK(usage_sum(usage) <= budget, "total is over the budget after %d surfaces", count);
+
+	while (count)
+		surface_destroy(surfaces[--count]);
+	total = usage_sum(usage);
+	CHECK(total == base_total, "total is %zu after destroying the surfaces, was %zu", total, base_total);
+
+	// without a budget only the memory itself is the limit
+	cedarv_mem_set_budget(0);
+	over = cedarv_malloc_type(budget - base_total + 4096, CEDARV_MEM_VBV);
+	CHECK(cedarv_isValid(over), "allocation without a budget failed");
+	cedarv_free(over);
+
+	VdpDeviceDestroy *device_destroy;
+	if (get_proc_address(device, VDP_FUNC_ID_DEVICE_DESTROY, (void **)&device_destroy) == VDP_STATUS_OK)
+		device_destroy(device);
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,21 @@
+#!/bin/sh
+#
+# Runs the memory accounting checks with a budget far below the fake
+# engine's memory on an old and a new VE. The driver reports the
+# allocations that have to fail, so its output is only shown on failure.
+# Run from the top directory by make check.
+
+log=$(mktemp) || exit 1
+trap 'rm -f "$log"' EXIT
+
+fail=0
+for version in 1623 1680; do
+	if ! LD_LIBRARY_PATH=. VDPAU_FAKE_VE=$version VDPAU_MEM_BUDGET=16 tests/mem_budget >"$log" 2>&1; then
+		echo "FAIL mem budget on $version"
+		cat "$log"
+		fail=1
+	fi
+done
+
+[ $fail -eq 0 ] && echo "mem budget: ok"
+exit $fail
@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Writes the VC-1 replay corpus into a directory: one trace per
+ * sequence layout with a picture of every type the picture layer parser
+ * handles, named good_*.vcap, and one trace per picture it has to
+ * reject, named bad_*.vcap. The picture layers are spelled out bit by
+ * bit below, followed by filler where the macroblock layer would be.
+ * The picture type of each info is what the parser has to find.
+ *
+ *   vc1_corpus directory
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vdpau/vdpau.h>
+#include "../capture.h"
+
+#define PTYPE_I		0
+#define PTYPE_P		1
+#define PTYPE_B		3
+#define PTYPE_BI	4
+
+#define WIDTH 176
+#define HEIGHT 144
+#define FILLER 64
+
+typedef struct
+{
+	const char *name;
+	VdpDecoderProfile profile;
+	VdpPictureInfoVC1 seq;
+	struct
+	{
+		uint8_t type;
+		// '0' and '1' are bits, everything else is skipped
+		const char *bits;
+	} pictures[6];
+} sequence_t;
+
+// frames of an advanced profile stream start with a frame start code
+static const uint8_t start_code[4] = { 0x00, 0x00, 0x01, 0x0d };
+
+static const sequence_t good[] =
+{
+	{ "good_simple", VDP_DECODER_PROFILE_VC1_SIMPLE,
+	  { .quantizer = 0 },
+	  { { PTYPE_I, "FRMCNT 00 PTYPE 0 BF 0000000 PQINDEX 00101 HALFQP 0" },
+	    { PTYPE_P, "FRMCNT 01 PTYPE 1 PQINDEX 01010" },
+	    { PTYPE_P, "FRMCNT 10 PTYPE 1 PQINDEX 00011 HALFQP 1" } } },
+
+	{ "good_main", VDP_DECODER_PROFILE_VC1_MAIN,
+	  { .finterpflag = 1, .rangered = 1, .maxbframes = 1, .quantizer = 1, .extended_mv = 1, .multires = 1 },
+	  { { PTYPE_I, "INTERPFRM 0 FRMCNT 00 RANGEREDFRM 0 PTYPE 01 BF 0000000 PQINDEX 00100 HALFQP 0 PQUANTIZER 1 MVRANGE 0 RESPIC 00" },
+	    { PTYPE_P, "INTERPFRM 1 FRMCNT 01 RANGEREDFRM 1 PTYPE 1 PQINDEX 01100 PQUANTIZER 0 MVRANGE 10 RESPIC 00" },
+	    { PTYPE_B, "INTERPFRM 0 FRMCNT 10 RANGEREDFRM 0 PTYPE 00 BFRACTION 011 PQINDEX 01100 PQUANTIZER 1 MVRANGE 110" },
+	    { PTYPE_B, "INTERPFRM 0 FRMCNT 11 RANGEREDFRM 0 PTYPE 00 BFRACTION 1110011 PQINDEX 01100 PQUANTIZER 1 MVRANGE 111" },
+	    { PTYPE_BI, "INTERPFRM 0 FRMCNT 00 RANGEREDFRM 0 PTYPE 00 BFRACTION 1111111 BF 0000000 PQINDEX 10000 PQUANTIZER 0 MVRANGE 0" } } },
+
+	{ "good_advanced", VDP_DECODER_PROFILE_VC1_ADVANCED,
+	  { .quantizer = 2, .postprocflag = 1, .extended_mv = 1 },
+	  { { PTYPE_I, "PTYPE 110 RNDCTRL 0 PQINDEX 00110 HALFQP 1 POSTPROC 00" },
+	    { PTYPE_P, "PTYPE 0 RNDCTRL 1 PQINDEX 01000 HALFQP 0 POSTPROC 01 MVRANGE 0" },
+	    { PTYPE_B, "PTYPE 10 RNDCTRL 0 BFRACTION 001 PQINDEX 01001 POSTPROC 00 MVRANGE 10" },
+	    { PTYPE_BI, "PTYPE 1110 RNDCTRL 0 PQINDEX 01001 POSTPROC 10" } } },
+
+	{ "good_advanced_interlace", VDP_DECODER_PROFILE_VC1_ADVANCED,
+	  { .interlace = 1, .tfcntrflag = 1, .pulldown = 1, .panscan_flag = 1, .finterpflag = 1, .quantizer = 3 },
+	  { { PTYPE_I, "FCM 0 PTYPE 110 TFCNTR 00000001 TFF/RFF 10 PS_PRESENT 0 RNDCTRL 0 UVSAMP 1 INTERPFRM 0 PQINDEX 00111 HALFQP 0" },
+	    { PTYPE_P, "FCM 0 PTYPE 0 TFCNTR 00000010 TFF/RFF 10 PS_PRESENT 0 RNDCTRL 1 UVSAMP 1 INTERPFRM 1 PQINDEX 11111" } } },
+};
+
+static const sequence_t bad[] =
+{
+	{ "bad_main_bfraction", VDP_DECODER_PROFILE_VC1_MAIN,
+	  { .maxbframes = 1 },
+	  { { PTYPE_B, "FRMCNT 00 PTYPE 00 BFRACTION 1111110 PQINDEX 01100" } } },
+
+	{ "bad_advanced_field", VDP_DECODER_PROFILE_VC1_ADVANCED,
+	  { .interlace = 1 },
+	  { { PTYPE_I, "FCM 10 PTYPE 110 RNDCTRL 0 UVSAMP 0 PQINDEX 00110 HALFQP 0" } } },
+
+	{ "bad_advanced_skipped", VDP_DECODER_PROFILE_VC1_ADVANCED,
+	  { },
+	  { { PTYPE_P, "PTYPE 1111" } } },
+
+	{ "bad_advanced_panscan", VDP_DECODER_PROFILE_VC1_ADVANCED,
+	  { .panscan_flag = 1 },
+	  { { PTYPE_I, "PTYPE 110 PS_PRESENT 1" } } },
+
+	{ "bad_advanced_bi_bfraction", VDP_DECODER_PROFILE_VC1_ADVANCED,
+	  { },
+	  { { PTYPE_B, "PTYPE 10 RNDCTRL 0 BFRACTION 1111111 PQINDEX 01100" } } },
+};
+
+static void write_record(FILE *f, uint32_t type, const void *payload, uint32_t size)
+{
+	static const uint8_t padding[8];
+	capture_record_t record = { .type = type, .size = CAPTURE_ALIGN(size) };
+
+	fwrite(&record, sizeof(record), 1, f);
+	fwrite(payload, size, 1, f);
+	fwrite(padding, CAPTURE_ALIGN(size) - size, 1, f);
+}
+
+static uint32_t picture_layer(uint8_t *data, const char *bits, int advanced)
+{
+	uint32_t pos = 0, bitpos;
+
+	if (advanced)
+	{
+		memcpy(data, start_code, sizeof(start_code));
+		pos = sizeof(start_code);
+	}
+
+	bitpos = pos * 8;
+	for (; *bits; bits++)
+	{
+		if (*bits != '0' && *bits != '1')
+			continue;
+		if (*bits == '1')
+			data[bitpos / 8] |= 0x80 >> (bitpos % 8);
+		bitpos++;
+	}
+
+	pos = (bitpos + 7) / 8;
+	memset(data + pos, 0x5a, FILLER);
+	return pos + FILLER;
+}
+
+static int write_trace(const char *dir, const sequence_t *s)
+{
+	char path[256];
+	snprintf(path, sizeof(path), "%s/%s.vcap", dir, s->name);
+
+	FILE *f = fopen(path, "wb");
+	if (!f)
+	{
+		fprintf(stderr, "could not open %s\n", path);
+		return 0;
+	}
+
+	capture_header_t header = { .magic = CAPTURE_MAGIC, .version = CAPTURE_VERSION };
+	fwrite(&header, sizeof(header), 1, f);
+
+	const uint32_t decoder = 1;
+	uint32_t i, count = 0;
+	while (count < 6 && s->pictures[count].bits)
+		count++;
+
+	for (i = 0; i < count; i++)
+	{
+		capture_surface_t surface = { .surface = 100 + i, .chroma_type = VDP_CHROMA_TYPE_420, .width = WIDTH, .height = HEIGHT };
+		write_record(f, CAPTURE_SURFACE_CREATE, &surface, sizeof(surface));
+	}
+
+	capture_decoder_t d = { .decoder = decoder, .profile = s->profile, .width = WIDTH, .height = HEIGHT, .max_references = 2 };
+	write_record(f, CAPTURE_DECODER_CREATE, &d, sizeof(d));
+
+	for (i = 0; i < count; i++)
+	{
+		struct
+		{
+			capture_render_t render;
+			uint8_t info[CAPTURE_ALIGN(sizeof(VdpPictureInfoVC1))];
+			uint32_t length[2];
+			uint8_t data[256];
+		} r;
+		memset(&r, 0, sizeof(r));
+
+		VdpPictureInfoVC1 info = s->seq;
+		info.slice_count = 1;
+		info.picture_type = s->pictures[i].type;
+		info.forward_reference = (i > 0 && info.picture_type != PTYPE_I) ? 100 + i - 1 : VDP_INVALID_HANDLE;
+		info.backward_reference = (i > 1 && info.picture_type >= PTYPE_B) ? 100 + i - 2 : VDP_INVALID_HANDLE;
+
+		r.render = (capture_render_t) { .decoder = decoder, .target = 100 + i, .info_size = sizeof(info), .buffer_count = 1 };
+		memcpy(r.info, &info, sizeof(info));
+		r.length[0] = picture_layer(r.data, s->pictures[i].bits, s->profile == VDP_DECODER_PROFILE_VC1_ADVANCED);
+		write_record(f, CAPTURE_DECODER_RENDER, &r, sizeof(r) - sizeof(r.data) + r.length[0]);
+	}
+
+	write_record(f, CAPTURE_DECODER_DESTROY, &d, sizeof(d));
+
+	return fclose(f) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int i;
+
+	if (argc != 2)
+	{
+		fprintf(stderr, "usage: %s directory\n", argv[0]);
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(good) / sizeof(good[0]); i++)
+		if (!write_trace(argv[1], &good[i]))
+			return 1;
+
+	for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+		if (!write_trace(argv[1], &bad[i]))
+			return 1;
+
+	return 0;
+}
@@ -0,0 +1,38 @@
+#!/bin/sh
+#
+# Replays the VC-1 corpus written by vc1_corpus on the fake engine of
+# an old and a new VE. Good traces have to decode without errors and
+# without the picture layer parser disagreeing with the picture types,
+# bad ones have to be rejected. Run from the top directory by make check.
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+tests/vc1_corpus "$dir" || exit 1
+
+fail=0
+for version in 1623 1680; do
+	for trace in "$dir"/*.vcap; do
+		name=$(basename "$trace" .vcap)
+		LD_LIBRARY_PATH=. VDPAU_FAKE_VE=$version ./vdpau_replay "$trace" >/dev/null 2>"$dir/log"
+		status=$?
+		case $name in
+		good_*)
+			if [ $status -ne 0 ] || grep -q "vc1:" "$dir/log"; then
+				echo "FAIL $name on $version: exit $status"
+				cat "$dir/log"
+				fail=1
+			fi
+			;;
+		bad_*)
+			if [ $status -ne 2 ]; then
+				echo "FAIL $name on $version: exit $status, expected 2"
+				fail=1
+			fi
+			;;
+		esac
+	done
+done
+
+[ $fail -eq 0 ] && echo "vc1 corpus: ok"
+exit $fail
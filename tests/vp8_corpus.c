@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Writes the VP8 replay corpus into a directory: one trace per stream
+ * the decoder has to accept, named good_*.vcap, and one per stream it
+ * has to reject, named bad_*.vcap. The frame headers are spelled out
+ * bit by bit below and written through a boolean encoder at probability
+ * 128 like the parser in vp8.c reads them, followed by filler where the
+ * token probability updates and the macroblocks would be.
+ *
+ *   vp8_corpus directory
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vdpau/vdpau.h>
+#include "../vdpau_sunxi.h"
+#include "../capture.h"
+
+#define WIDTH 176
+#define HEIGHT 144
+#define FILLER 64
+
+// the header fields every frame type shares, RFC 6386 section 19.2
+#define SEG_OFF		"SEGMENTATION 0 "
+#define FILTER		"FILTER_TYPE 0 LEVEL 011000 SHARPNESS 010 "
+#define LF_ADJ_OFF	"LF_ADJ 0 "
+#define QUANT		"PARTITIONS 00 Y_AC_QI 0111111 DELTAS 0 0 0 0 0 "
+#define KEY_START	"COLOR_SPACE 0 CLAMPING 0 "
+
+typedef struct
+{
+	int key_frame;
+	int width, height;
+	// '0' and '1' are bits, everything else is skipped
+	const char *bits;
+	// first partition size larger than the frame
+	int truncated;
+} frame_t;
+
+typedef struct
+{
+	const char *name;
+	frame_t frames[8];
+} stream_t;
+
+static const stream_t good[] =
+{
+	{ "good_key",
+	  { { 1, WIDTH, HEIGHT, KEY_START SEG_OFF FILTER LF_ADJ_OFF QUANT "REFRESH_PROBS 1" },
+	    { 1, WIDTH, HEIGHT, KEY_START SEG_OFF FILTER LF_ADJ_OFF QUANT "REFRESH_PROBS 1" } } },
+
+	{ "good_inter",
+	  { { 1, WIDTH, HEIGHT, KEY_START SEG_OFF FILTER LF_ADJ_OFF QUANT "REFRESH_PROBS 1" },
+	    { 0, 0, 0, SEG_OFF FILTER LF_ADJ_OFF QUANT "GOLDEN 0 ALT 0 COPY_GOLDEN 00 COPY_ALT 00 SIGN_BIAS 0 0 REFRESH_PROBS 1 REFRESH_LAST 1" },
+	    { 0, 0, 0, SEG_OFF FILTER LF_ADJ_OFF QUANT "GOLDEN 1 ALT 0 COPY_ALT 01 SIGN_BIAS 1 0 REFRESH_PROBS 1 REFRESH_LAST 1" },
+	    { 0, 0, 0, SEG_OFF FILTER LF_ADJ_OFF QUANT "GOLDEN 0 ALT 1 COPY_GOLDEN 10 SIGN_BIAS 0 1 REFRESH_PROBS 1 REFRESH_LAST 0" },
+	    { 0, 0, 0, SEG_OFF FILTER LF_ADJ_OFF QUANT "GOLDEN 0 ALT 0 COPY_GOLDEN 01 COPY_ALT 10 SIGN_BIAS 0 0 REFRESH_PROBS 1 REFRESH_LAST 1" } } },
+
+	// probabilities of these frames only apply to themselves
+	{ "good_not_refreshing",
+	  { { 1, WIDTH, HEIGHT, KEY_START SEG_OFF FILTER LF_ADJ_OFF QUANT "REFRESH_PROBS 0" },
+	    { 0, 0, 0, SEG_OFF FILTER LF_ADJ_OFF QUANT "GOLDEN 0 ALT 0 COPY_GOLDEN 00 COPY_ALT 00 SIGN_BIAS 0 0 REFRESH_PROBS 0 REFRESH_LAST 1" },
+	    { 0, 0, 0, SEG_OFF FILTER LF_ADJ_OFF QUANT "GOLDEN 0 ALT 0 COPY_GOLDEN 00 COPY_ALT 00 SIGN_BIAS 0 0 REFRESH_PROBS 1 REFRESH_LAST 1" },
+	    { 0, 0, 0, SEG_OFF FILTER LF_ADJ_OFF QUANT "GOLDEN 0 ALT 0 COPY_GOLDEN 00 COPY_ALT 00 SIGN_BIAS 0 0 REFRESH_PROBS 0 REFRESH_LAST 0" } } },
+
+	{ "good_segmentation",
+	  { { 1, WIDTH, HEIGHT, KEY_START "SEGMENTATION 1 UPDATE_MAP 1 UPDATE_DATA 1 ABS_DELTA 0 "
+	      "QUANT 1 0000101 0 0 1 0000011 1 0 LF 1 000010 1 0 0 0 PROBS 1 10000000 0 1 01000000 "
+	      FILTER "LF_ADJ 1 DELTA_UPDATE 1 REF 1 000010 0 0 0 1 000001 1 MODE 0 1 000100 0 0 0 "
+	      QUANT "REFRESH_PROBS 1" },
+	    { 0, 0, 0, "SEGMENTATION 1 UPDATE_MAP 0 UPDATE_DATA 0 " FILTER "LF_ADJ 1 DELTA_UPDATE 0 "
+	      QUANT "GOLDEN 0 ALT 0 COPY_GOLDEN 00 COPY_ALT 00 SIGN_BIAS 0 0 REFRESH_PROBS 1 REFRESH_LAST 1" } } },
+
+	// smaller key frames still fit the surfaces
+	{ "good_resize_down",
+	  { { 1, WIDTH, HEIGHT, KEY_START SEG_OFF FILTER LF_ADJ_OFF QUANT "REFRESH_PROBS 1" },
+	    { 1, WIDTH / 2, HEIGHT / 2, KEY_START SEG_OFF FILTER LF_ADJ_OFF QUANT "REFRESH_PROBS 1" },
+	    { 0, 0, 0, SEG_OFF FILTER LF_ADJ_OFF QUANT "GOLDEN 0 ALT 0 COPY_GOLDEN 00 COPY_ALT 00 SIGN_BIAS 0 0 REFRESH_PROBS 1 REFRESH_LAST 1" } } },
+};
+
+static const stream_t bad[] =
+{
+	{ "bad_resize_up",
+	  { { 1, WIDTH, HEIGHT, KEY_START SEG_OFF FILTER LF_ADJ_OFF QUANT "REFRESH_PROBS 1" },
+	    { 1, WIDTH * 2, HEIGHT * 2, KEY_START SEG_OFF FILTER LF_ADJ_OFF QUANT "REFRESH_PROBS 1" } } },
+
+	{ "bad_inter_first",
+	  { { 0, 0, 0, SEG_OFF FILTER LF_ADJ_OFF QUANT "GOLDEN 0 ALT 0 COPY_GOLDEN 00 COPY_ALT 00 SIGN_BIAS 0 0 REFRESH_PROBS 1 REFRESH_LAST 1" } } },
+
+	{ "bad_truncated",
+	  { { 1, WIDTH, HEIGHT, KEY_START SEG_OFF FILTER LF_ADJ_OFF QUANT "REFRESH_PROBS 1", 1 } } },
+};
+
+// boolean encoder of RFC 6386 section 7.3
+typedef struct
+{
+	uint8_t *output;
+	uint32_t range;
+	uint32_t bottom;
+	int bit_count;
+} bool_encoder;
+
+static void add_one_to_output(uint8_t *q)
+{
+	while (*--q == 255)
+		*q = 0;
+	++*q;
+}
+
+static void write_bool(bool_encoder *e, int prob, int value)
+{
+	uint32_t split = 1 + (((e->range - 1) * prob) >> 8);
+
+	if (value)
+	{
+		e->bottom += split;
+		e->range -= split;
+	}
+	else
+		e->range = split;
+
+	while (e->range < 128)
+	{
+		e->range <<= 1;
+		if (e->bottom & (1u << 31))
+			add_one_to_output(e->output);
+		e->bottom <<= 1;
+		if (!--e->bit_count)
+		{
+			*e->output++ = e->bottom >> 24;
+			e->bottom &= (1 << 24) - 1;
+			e->bit_count = 8;
+		}
+	}
+}
+
+static void flush_bool_encoder(bool_encoder *e)
+{
+	int c = e->bit_count;
+	uint32_t v = e->bottom;
+
+	if (v & (1u << (32 - c)))
+		add_one_to_output(e->output);
+	v <<= c & 7;
+	c >>= 3;
+	while (--c >= 0)
+		v <<= 8;
+	for (c = 0; c < 4; c++)
+	{
+		*e->output++ = v >> 24;
+		v <<= 8;
+	}
+}
+
+static uint32_t frame(uint8_t *data, const frame_t *f)
+{
+	uint32_t header_size = f->key_frame ? 10 : 3;
+	bool_encoder e = { .output = data + header_size, .range = 255, .bottom = 0, .bit_count = 24 };
+	const char *bits;
+
+	for (bits = f->bits; *bits; bits++)
+		if (*bits == '0' || *bits == '1')
+			write_bool(&e, 128, *bits == '1');
+	flush_bool_encoder(&e);
+
+	uint32_t first_part_size = e.output - (data + header_size);
+	memset(e.output, 0x5a, FILLER * 2);
+	first_part_size += FILLER;
+
+	if (f->truncated)
+		first_part_size += FILLER * 2;
+
+	// frame tag: version 0, shown
+	uint32_t tag = (f->key_frame ? 0 : 1) | (1 << 4) | (first_part_size << 5);
+	data[0] = tag;
+	data[1] = tag >> 8;
+	data[2] = tag >> 16;
+
+	if (f->key_frame)
+	{
+		data[3] = 0x9d;
+		data[4] = 0x01;
+		data[5] = 0x2a;
+		data[6] = f->width;
+		data[7] = f->width >> 8;
+		data[8] = f->height;
+		data[9] = f->height >> 8;
+	}
+
+	return e.output - data + FILLER * 2;
+}
+
+static void write_record(FILE *f, uint32_t type, const void *payload, uint32_t size)
+{
+	static const uint8_t padding[8];
+	capture_record_t record = { .type = type, .size = CAPTURE_ALIGN(size) };
+
+	fwrite(&record, sizeof(record), 1, f);
+	fwrite(payload, size, 1, f);
+	fwrite(padding, CAPTURE_ALIGN(size) - size, 1, f);
+}
+
+static int write_trace(const char *dir, const stream_t *s)
+{
+	char path[256];
+	snprintf(path, sizeof(path), "%s/%s.vcap", dir, s->name);
+
+	FILE *f = fopen(path, "wb");
+	if (!f)
+	{
+		fprintf(stderr, "could not open %s\n", path);
+		return 0;
+	}
+
+	capture_header_t header = { .magic = CAPTURE_MAGIC, .version = CAPTURE_VERSION };
+	fwrite(&header, sizeof(header), 1, f);
+
+	const uint32_t decoder = 1;
+	uint32_t i, count = 0;
+	while (count < 8 && s->frames[count].bits)
+		count++;
+
+	for (i = 0; i < count; i++)
+	{
+		capture_surface_t surface = { .surface = 100 + i, .chroma_type = VDP_CHROMA_TYPE_420, .width = WIDTH, .height = HEIGHT };
+		write_record(f, CAPTURE_SURFACE_CREATE, &surface, sizeof(surface));
+	}
+
+	capture_decoder_t d = { .decoder = decoder, .profile = VDP_DECODER_PROFILE_SUNXI_VP8, .width = WIDTH, .height = HEIGHT, .max_references = 3 };
+	write_record(f, CAPTURE_DECODER_CREATE, &d, sizeof(d));
+
+	for (i = 0; i < count; i++)
+	{
+		// VP8 frames come without a picture info
+		struct
+		{
+			capture_render_t render;
+			uint32_t length[2];
+			uint8_t data[512];
+		} r;
+		memset(&r, 0, sizeof(r));
+
+		r.render = (capture_render_t) { .decoder = decoder, .target = 100 + i, .info_size = 0, .buffer_count = 1 };
+		r.length[0] = frame(r.data, &s->frames[i]);
+		write_record(f, CAPTURE_DECODER_RENDER, &r, sizeof(r) - sizeof(r.data) + r.length[0]);
+	}
+
+	write_record(f, CAPTURE_DECODER_DESTROY, &d, sizeof(d));
+
+	return fclose(f) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int i;
+
+	if (argc != 2)
+	{
+		fprintf(stderr, "usage: %s directory\n", argv[0]);
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(good) / sizeof(good[0]); i++)
+		if (!write_trace(argv[1], &good[i]))
+			return 1;
+
+	for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+		if (!write_trace(argv[1], &bad[i]))
+			return 1;
+
+	return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * The rings are only written by their thread and never freed, so
+ * recording takes no lock. A flush reads them while they are written,
+ * the oldest events of a full ring may be overwritten meanwhile and
+ * are left out.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include "timeline.h"
+
+#define TIMELINE_EVENTS 16384
+// left out of a full ring, its thread may be writing there
+#define TIMELINE_GUARD 64
+
+typedef struct
+{
+	uint64_t time;
+	const char *name;
+	char phase;
+} timeline_event_t;
+
+struct timeline_ring
+{
+	struct timeline_ring *next;
+	int tid;
+	char thread_name[16];
+	uint32_t head;
+	timeline_event_t events[TIMELINE_EVENTS];
+};
+
+int timeline_enabled;
+
+static char *timeline_path;
+static struct timeline_ring *rings;
+static __thread struct timeline_ring *ring;
+static pthread_mutex_t flush_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void timeline_init(void)
+{
+	char *env_timeline = getenv("VDPAU_TIMELINE");
+	if (!env_timeline || timeline_path)
+		return;
+
+	timeline_path = strdup(env_timeline);
+	timeline_enabled = (timeline_path != NULL);
+}
+
+static struct timeline_ring *ring_create(void)
+{
+	struct timeline_ring *r = calloc(1, sizeof(*r));
+	if (!r)
+		return NULL;
+
+	r->tid = syscall(SYS_gettid);
+	pthread_getname_np(pthread_self(), r->thread_name, sizeof(r->thread_name));
+
+	do
+		r->next = rings;
+	while (!__sync_bool_compare_and_swap(&rings, r->next, r));
+
+	ring = r;
+	return r;
+}
+
+void timeline_event(const char *name, char phase)
+{
+	struct timeline_ring *r = ring;
+	if (!r && !(r = ring_create()))
+		return;
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	uint32_t head = r->head;
+	timeline_event_t *e = &r->events[head % TIMELINE_EVENTS];
+	e->time = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+	e->name = name;
+	e->phase = phase;
+	__atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+int timeline_flush(void)
+{
+	if (!timeline_path)
+		return 0;
+
+	pthread_mutex_lock(&flush_mutex);
+
+	FILE *f = fopen(timeline_path, "w");
+	if (!f)
+	{
+		printf("could not open timeline file %s\n", timeline_path);
+		pthread_mutex_unlock(&flush_mutex);
+		return 0;
+	}
+
+	int pid = getpid();
+	int first = 1;
+	struct timeline_ring *r;
+
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	for (r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r; r = r->next)
+	{
+		uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+		uint32_t i = head > TIMELINE_EVENTS ? head - TIMELINE_EVENTS + TIMELINE_GUARD : 0;
+
+		if (r->thread_name[0])
+		{
+			fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",", pid, r->tid, r->thread_name);
+			first = 0;
+		}
+
+		for (; i != head; i++)
+		{
+			const timeline_event_t *e = &r->events[i % TIMELINE_EVENTS];
+			fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":%d,\"tid\":%d}",
+				first ? "" : ",", e->name, e->phase,
+				(unsigned long long)(e->time / 1000), (unsigned int)(e->time % 1000), pid, r->tid);
+			first = 0;
+		}
+	}
+	fprintf(f, "\n]}\n");
+
+	int ok = (fclose(f) == 0);
+	pthread_mutex_unlock(&flush_mutex);
+	return ok;
+}
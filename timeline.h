@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __TIMELINE_H__
+#define __TIMELINE_H__
+
+/*
+ * Begin and end events of the decode and display paths, recorded when
+ * VDPAU_TIMELINE names a file. Every thread writes into its own ring,
+ * a flush writes all rings as Chrome trace event JSON, which Perfetto
+ * and chrome://tracing open. Names must be string literals, only the
+ * pointer is kept.
+ */
+
+extern int timeline_enabled;
+
+void timeline_init(void);
+void timeline_event(const char *name, char phase);
+// writes what the rings hold now, for VdpDeviceTimelineFlushSunxi and the last close
+int timeline_flush(void);
+
+#define TIMELINE_BEGIN(name) do { if (timeline_enabled) timeline_event(name, 'B'); } while (0)
+#define TIMELINE_END(name) do { if (timeline_enabled) timeline_event(name, 'E'); } while (0)
+
+#endif
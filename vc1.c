@@ -0,0 +1,482 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "vdpau_private.h"
+#include "ve.h"
+#include "bitstream.h"
+
+/*
+ * VC-1 runs on the MPEG engine in its WMV mode (same as MS-MPEG4, with
+ * the VC-1 bit in CEDARV_MPEG_MSMPEG4_HDR set). The picture layer is
+ * parsed in software up to the first bitplane, the VE continues from
+ * there with the bitplanes, the VLC table selectors and the macroblock
+ * layer. Sequence and entry point parameters come from the picture info.
+ */
+
+// VdpPictureInfoVC1.picture_type
+#define VC1_PTYPE_I	0
+#define VC1_PTYPE_P	1
+#define VC1_PTYPE_B	3
+#define VC1_PTYPE_BI	4
+
+#define VC1_START_CODE_FRAME	0x0d
+
+typedef struct
+{
+	uint8_t ptype;
+	uint8_t interpfrm;
+	uint8_t rangeredfrm;
+	uint8_t bfraction;
+	uint8_t pqindex;
+	uint8_t pquant;
+	uint8_t halfqp;
+	uint8_t pquantizer;
+	uint8_t mvrange;
+	uint8_t respic;
+	uint8_t rndctrl;
+	uint8_t postproc;
+	uint8_t uvsamp;
+} vc1_picture_header_t;
+
+typedef struct
+{
+	vc1_picture_header_t header;
+	CEDARV_MEMORY mbh_buffer;
+	CEDARV_MEMORY dcac_buffer;
+	CEDARV_MEMORY ncf_buffer;
+} vc1_private_t;
+
+// SMPTE 421M table 36, PQINDEX to PQUANT for implicit quantizer
+static const uint8_t pquant_table[32] =
+{
+	 0,  1,  2,  3,  4,  5,  6,  7,  8,  6,  7,  8,  9, 10, 11, 12,
+	13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 27, 29, 31
+};
+
+static int find_frame_start(const uint8_t *data, int len)
+{
+	int pos, zeros = 0;
+	for (pos = 0; pos < len - 1; pos++)
+	{
+		if (data[pos] == 0x00)
+			zeros++;
+		else if (data[pos] == 0x01 && zeros >= 2 && data[pos + 1] == VC1_START_CODE_FRAME)
+			return pos + 2;
+		else
+			zeros = 0;
+	}
+
+	// no start code, simple/main profile or bare frame data
+	return 0;
+}
+
+static int decode_bfraction(bitstream *bs)
+{
+	int code = get_bits(bs, 3);
+	if (code < 7)
+		return code;
+
+	code = (code << 4) | get_bits(bs, 4);
+	if (code == 0x7e)
+		return -1;
+
+	// 0x7f signals a BI picture in simple/main profile, returned as 21
+	return code == 0x7f ? 21 : code - 0x70 + 7;
+}
+
+static int decode_mvrange(bitstream *bs)
+{
+	if (!get_bits(bs, 1))
+		return 0;
+	if (!get_bits(bs, 1))
+		return 1;
+	return get_bits(bs, 1) ? 3 : 2;
+}
+
+static int decode_ptype_advanced(bitstream *bs)
+{
+	if (!get_bits(bs, 1))
+		return VC1_PTYPE_P;
+	if (!get_bits(bs, 1))
+		return VC1_PTYPE_B;
+	if (!get_bits(bs, 1))
+		return VC1_PTYPE_I;
+	if (!get_bits(bs, 1))
+		return VC1_PTYPE_BI;
+
+	// skipped picture
+	return -1;
+}
+
+static void decode_quantizer(bitstream *bs, VdpPictureInfoVC1 const *info, vc1_picture_header_t *h)
+{
+	h->pqindex = get_bits(bs, 5);
+	h->halfqp = 0;
+	if (h->pqindex <= 8)
+		h->halfqp = get_bits(bs, 1);
+
+	switch (info->quantizer)
+	{
+	case 0:
+		// implicit, uniform for low indices
+		h->pquant = pquant_table[h->pqindex];
+		h->pquantizer = h->pqindex <= 8;
+		break;
+	case 1:
+		h->pquant = h->pqindex;
+		h->pquantizer = get_bits(bs, 1);
+		break;
+	case 2:
+		h->pquant = h->pqindex;
+		h->pquantizer = 0;
+		break;
+	default:
+		h->pquant = h->pqindex;
+		h->pquantizer = 1;
+		break;
+	}
+}
+
+static int decode_picture_header_simple(bitstream *bs, VdpPictureInfoVC1 const *info, vc1_picture_header_t *h)
+{
+	if (info->finterpflag)
+		h->interpfrm = get_bits(bs, 1);
+
+	// FRMCNT
+	flush_bits(bs, 2);
+
+	if (info->rangered)
+		h->rangeredfrm = get_bits(bs, 1);
+
+	if (info->maxbframes == 0)
+		h->ptype = get_bits(bs, 1) ? VC1_PTYPE_P : VC1_PTYPE_I;
+	else if (get_bits(bs, 1))
+		h->ptype = VC1_PTYPE_P;
+	else
+		h->ptype = get_bits(bs, 1) ? VC1_PTYPE_I : VC1_PTYPE_B;
+
+	if (h->ptype == VC1_PTYPE_B)
+	{
+		int bfraction = decode_bfraction(bs);
+		if (bfraction < 0)
+			return 0;
+		if (bfraction == 21)
+			h->ptype = VC1_PTYPE_BI;
+		h->bfraction = bfraction;
+	}
+
+	// BF, buffer fullness
+	if (h->ptype == VC1_PTYPE_I || h->ptype == VC1_PTYPE_BI)
+		flush_bits(bs, 7);
+
+	decode_quantizer(bs, info, h);
+
+	if (info->extended_mv)
+		h->mvrange = decode_mvrange(bs);
+
+	if ((h->ptype == VC1_PTYPE_I || h->ptype == VC1_PTYPE_P) && info->multires)
+		h->respic = get_bits(bs, 2);
+
+	return 1;
+}
+
+static int decode_picture_header_advanced(bitstream *bs, VdpPictureInfoVC1 const *info, vc1_picture_header_t *h)
+{
+	// only progressive frames for now
+	if (info->interlace && get_bits(bs, 1))
+		return 0;
+
+	int ptype = decode_ptype_advanced(bs);
+	if (ptype < 0)
+		return 0;
+	h->ptype = ptype;
+
+	if (info->tfcntrflag)
+		flush_bits(bs, 8);
+
+	// RPTFRM or TFF/RFF
+	if (info->pulldown)
+		flush_bits(bs, 2);
+
+	// pan scan windows are not supported
+	if (info->panscan_flag && get_bits(bs, 1))
+		return 0;
+
+	h->rndctrl = get_bits(bs, 1);
+
+	if (info->interlace)
+		h->uvsamp = get_bits(bs, 1);
+
+	if (info->finterpflag)
+		h->interpfrm = get_bits(bs, 1);
+
+	if (h->ptype == VC1_PTYPE_B)
+	{
+		int bfraction = decode_bfraction(bs);
+		if (bfraction < 0 || bfraction == 21)
+			return 0;
+		h->bfraction = bfraction;
+	}
+
+	decode_quantizer(bs, info, h);
+
+	if (info->postprocflag)
+		h->postproc = get_bits(bs, 2);
+
+	if (info->extended_mv && h->ptype != VC1_PTYPE_I && h->ptype != VC1_PTYPE_BI)
+		h->mvrange = decode_mvrange(bs);
+
+	return 1;
+}
+
+static void vc1_private_free(decoder_ctx_t *decoder)
+{
+	vc1_private_t *decoder_p = (vc1_private_t *)decoder->private;
+	cedarv_free(decoder_p->mbh_buffer);
+	cedarv_free(decoder_p->dcac_buffer);
+	cedarv_free(decoder_p->ncf_buffer);
+	free(decoder_p);
+}
+
+static void set_reference(VdpVideoSurface surface, void *luma_reg, void *chroma_reg)
+{
+	video_surface_ctx_t *ref = NULL;
+
+	if (surface != VDP_INVALID_HANDLE)
+		ref = handle_get(surface);
+
+	if (ref)
+	{
+		writel(cedarv_virt2phys(ref->dataY), luma_reg);
+		writel(cedarv_virt2phys(ref->dataU), chroma_reg);
+		handle_release(surface);
+	}
+	else
+	{
+		writel(0x0, luma_reg);
+		writel(0x0, chroma_reg);
+	}
+}
+
+static VdpStatus vc1_decode(decoder_ctx_t *decoder, VdpPictureInfo const *_info, const int len, video_surface_ctx_t *output)
+{
+	VdpPictureInfoVC1 const *info = (VdpPictureInfoVC1 const *)_info;
+	vc1_private_t *decoder_p = (vc1_private_t *)decoder->private;
+	vc1_picture_header_t *h = &decoder_p->header;
+	const int advanced = decoder->profile == VDP_DECODER_PROFILE_VC1_ADVANCED;
+	int ok;
+
+	const uint8_t *data = cedarv_getPointer(decoder->data);
+	bitstream bs = { .data = data, .length = len, .bitpos = 0 };
+
+	memset(h, 0, sizeof(*h));
+	if (advanced)
+	{
+		bs.bitpos = find_frame_start(data, len) * 8;
+		ok = decode_picture_header_advanced(&bs, info, h);
+	}
+	else
+		ok = decode_picture_header_simple(&bs, info, h);
+
+	if (!ok)
+	{
+		VDPAU_DBG("vc1: unsupported picture header");
+		return VDP_STATUS_ERROR;
+	}
+
+	if (h->ptype != info->picture_type)
+		log_warning("vc1: picture type %d, expected %d", h->ptype, info->picture_type);
+
+	output->source_format = INTERNAL_YCBCR_FORMAT;
+
+	void *cedarv_regs = cedarv_get(CEDARV_ENGINE_MPEG, 0);
+
+	writel(0xffffffff, cedarv_regs + CEDARV_MPEG_STATUS);
+	writel(0x0, cedarv_regs + CEDARV_MPEG_CTR_MB);
+	writel(0x0, cedarv_regs + CEDARV_MPEG_ERROR);
+
+	// set forward/backward prediction buffers
+	set_reference(info->forward_reference, cedarv_regs + CEDARV_MPEG_FWD_LUMA, cedarv_regs + CEDARV_MPEG_FWD_CHROMA);
+	set_reference(info->backward_reference, cedarv_regs + CEDARV_MPEG_BACK_LUMA, cedarv_regs + CEDARV_MPEG_BACK_CHROMA);
+
+	// set size
+	uint16_t width = (decoder->width + 15) / 16;
+	uint16_t height = (decoder->height + 15) / 16;
+	writel((((width & 1) ? width + 1 : width) << 16) | (width << 8) | height, cedarv_regs + CEDARV_MPEG_SIZE);
+	writel(((width * 16) << 16) | (height * 16), cedarv_regs + CEDARV_MPEG_FRAME_SIZE);
+
+	// set buffers
+	writel(cedarv_virt2phys(decoder_p->mbh_buffer), cedarv_regs + CEDARV_MPEG_MBH_ADDR);
+	writel(cedarv_virt2phys(decoder_p->dcac_buffer), cedarv_regs + CEDARV_MPEG_DCAC_ADDR);
+	writel(cedarv_virt2phys(decoder_p->ncf_buffer), cedarv_regs + CEDARV_MPEG_NCF_ADDR);
+
+	// set output buffers (Luma / Croma)
+	writel(cedarv_virt2phys(output->dataY), cedarv_regs + CEDARV_MPEG_REC_LUMA);
+	writel(cedarv_virt2phys(output->dataU), cedarv_regs + CEDARV_MPEG_REC_CHROMA);
+	writel(cedarv_virt2phys(output->dataY), cedarv_regs + CEDARV_MPEG_ROT_LUMA);
+	writel(cedarv_virt2phys(output->dataU), cedarv_regs + CEDARV_MPEG_ROT_CHROMA);
+
+	if (cedarv_get_version() >= 0x1680)
+	{
+		writel(OUTPUT_FORMAT_NV12 | EXTRA_OUTPUT_FORMAT_NV12, cedarv_regs + CEDARV_OUTPUT_FORMAT);
+		writel((0x1 << 30) | (0x1 << 28), cedarv_regs + CEDARV_EXTRA_OUT_FMT_OFFSET);
+		writel((ALIGN(output->width, 16) / 2 << 16) | ALIGN(output->width, 32), cedarv_regs + CEDARV_OUTPUT_STRIDE);
+		writel((ALIGN(output->width, 16) / 2 << 16) | ALIGN(output->width, 32), cedarv_regs + CEDARV_EXTRA_OUT_STRIDE);
+		output->source_format = VDP_YCBCR_FORMAT_NV12;
+	}
+
+	// no rotation, no scaling
+	writel(0x40620000, cedarv_regs + CEDARV_MPEG_SDROT_CTRL);
+
+	uint32_t cedarv_control = 0;
+	cedarv_control |= CEDARV_MPEG_CTRL_CEDARV_FINISH_INT_EN(1);
+	cedarv_control |= CEDARV_MPEG_CTRL_CEDARV_ERROR_INT_EN(1);
+	cedarv_control |= CEDARV_MPEG_CTRL_QP_AC_DC_OUT_EN(1);
+	if (h->ptype == VC1_PTYPE_P)
+		cedarv_control |= CEDARV_MPEG_CTRL_OUTPUT_EN(1);
+	cedarv_control |= CEDARV_MPEG_CTRL_MVCS_FLD_HM(1);
+	cedarv_control |= CEDARV_MPEG_CTRL_MC_CACHE_EN(1);
+	cedarv_control |= CEDARV_MPEG_CTRL_WRITE_ROTATE_PIC(1);
+	cedarv_control |= CEDARV_MPEG_CTRL_NOT_WRITE_RECONS_FLAG((cedarv_get_version() < 0x1680));
+	// quarter pel motion vectors, the VE switches to half pel by MVMODE
+	cedarv_control |= CEDARV_MPEG_CTRL_MVCS_MV1_QM(2);
+	cedarv_control |= CEDARV_MPEG_CTRL_MVCS_MV4_QM(2);
+	writel(cedarv_control, cedarv_regs + CEDARV_MPEG_CTRL);
+
+	writel(0x0, cedarv_regs + CEDARV_MPEG_MBA);
+
+	// picture header, unverified
+	uint32_t pic_hdr = 0;
+	pic_hdr |= (h->ptype & 0x7) << 0;
+	pic_hdr |= (h->halfqp & 0x1) << 3;
+	pic_hdr |= (h->pquantizer & 0x1) << 4;
+	pic_hdr |= (h->mvrange & 0x3) << 5;
+	pic_hdr |= (h->respic & 0x3) << 7;
+	pic_hdr |= (h->rndctrl & 0x1) << 9;
+	pic_hdr |= (h->rangeredfrm & 0x1) << 10;
+	pic_hdr |= (h->interpfrm & 0x1) << 11;
+	pic_hdr |= (h->uvsamp & 0x1) << 12;
+	pic_hdr |= (info->overlap & 0x1) << 13;
+	pic_hdr |= (info->loopfilter & 0x1) << 14;
+	pic_hdr |= (info->fastuvmc & 0x1) << 15;
+	pic_hdr |= (info->extended_mv & 0x1) << 16;
+	pic_hdr |= (info->extended_dmv & 0x1) << 17;
+	pic_hdr |= (info->dquant & 0x3) << 18;
+	pic_hdr |= (info->vstransform & 0x1) << 20;
+	pic_hdr |= (info->quantizer & 0x3) << 21;
+	pic_hdr |= (advanced & 0x1) << 23;
+	pic_hdr |= (h->bfraction & 0x1f) << 24;
+	writel(pic_hdr, cedarv_regs + CEDARV_MPEG_VC1_PIC_HDR);
+
+	uint32_t range_map = 0;
+	if (advanced && info->range_mapy_flag)
+		range_map |= (1 << 3) | (info->range_mapy & 0x7);
+	if (advanced && info->range_mapuv_flag)
+		range_map |= (1 << 7) | ((info->range_mapuv & 0x7) << 4);
+	writel(range_map, cedarv_regs + CEDARV_MPEG_VC1_RANGE_MAP);
+
+	// is VC1 bit
+	writel((height << 24) | (1 << 2), cedarv_regs + CEDARV_MPEG_MSMPEG4_HDR);
+
+	writel(h->pquant, cedarv_regs + CEDARV_MPEG_QP_INPUT);
+
+	// clean up everything
+	writel(0xffffffff, cedarv_regs + CEDARV_MPEG_STATUS);
+
+	// set input offset and length in bits
+	writel(bs.bitpos, cedarv_regs + CEDARV_MPEG_VLD_OFFSET);
+	writel(((len * 8) + 0x1f) & ~0x1f, cedarv_regs + CEDARV_MPEG_VLD_LEN);
+
+	// input end
+	uint32_t input_addr = cedarv_virt2phys(decoder->data);
+	writel(input_addr + VBV_SIZE - 1, cedarv_regs + CEDARV_MPEG_VLD_END);
+
+	// set input buffer
+	writel((input_addr & 0x0ffffff0) | (input_addr >> 28) | (0x7 << 28), cedarv_regs + CEDARV_MPEG_VLD_ADDR);
+
+	// trigger
+	uint32_t mpeg_trigger = 0;
+	mpeg_trigger |= CEDARV_MPEG_TRIG_NUM_MB_IN_GOB(width * height);
+	mpeg_trigger |= CEDARV_MPEG_TRIG_VE_START_TYPE(0xd);
+	mpeg_trigger |= CEDARV_MPEG_TRIG_CHROM_FORMAT(CEDARV_MPEG_TRIG_COLOR_FORMAT_YUV_4_2_0);
+	mpeg_trigger |= CEDARV_MPEG_TRIG_DEC_FORMAT(4);
+	mpeg_trigger |= CEDARV_MPEG_TRIG_MB_BOUNDARY(1);
+	writel(mpeg_trigger, cedarv_regs + CEDARV_MPEG_TRIGGER);
+
+	// wait for interrupt
+	cedarv_wait(1);
+
+	// the engine was reset, its registers say nothing about this frame
+	if (cedarv_job_hung())
+	{
+		cedarv_put();
+		return VDP_STATUS_ERROR;
+	}
+
+	// clean interrupt flag
+	writel(0x0000000f, cedarv_regs + CEDARV_MPEG_STATUS);
+	uint32_t error = readl(cedarv_regs + CEDARV_MPEG_ERROR);
+	if (error)
+		log_warning("vc1: got error=%d while decoding frame", error);
+	writel(0x0, cedarv_regs + CEDARV_MPEG_ERROR);
+
+	cedarv_put();
+
+	output->frame_decoded = 1;
+	return VDP_STATUS_OK;
+}
+
+VdpStatus new_decoder_vc1(decoder_ctx_t *decoder)
+{
+	vc1_private_t *decoder_p = calloc(1, sizeof(vc1_private_t));
+	if (!decoder_p)
+		goto err_priv;
+
+	int width = ((decoder->width + 15) / 16);
+	int height = ((decoder->height + 15) / 16);
+
+	decoder_p->mbh_buffer = cedarv_malloc_type(height * 2048, CEDARV_MEM_SCRATCH);
+	if (!cedarv_isValid(decoder_p->mbh_buffer))
+		goto err_mbh;
+
+	decoder_p->dcac_buffer = cedarv_malloc_type(width * height * 2, CEDARV_MEM_SCRATCH);
+	if (!cedarv_isValid(decoder_p->dcac_buffer))
+		goto err_dcac;
+
+	decoder_p->ncf_buffer = cedarv_malloc_type(4 * 1024, CEDARV_MEM_SCRATCH);
+	if (!cedarv_isValid(decoder_p->ncf_buffer))
+		goto err_ncf;
+
+	decoder->decode = vc1_decode;
+	decoder->private = decoder_p;
+	decoder->private_free = vc1_private_free;
+	return VDP_STATUS_OK;
+
+err_ncf:
+	cedarv_free(decoder_p->dcac_buffer);
+err_dcac:
+	cedarv_free(decoder_p->mbh_buffer);
+err_mbh:
+	free(decoder_p);
+err_priv:
+	return VDP_STATUS_RESOURCES;
+}
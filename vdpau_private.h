@@ -24,14 +24,19 @@
 #define MAX_HANDLES 64
 #define VBV_SIZE (1 * 1024 * 1024)
 
-//#include <stdlib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 #include <vdpau/vdpau.h>
 #include <vdpau/vdpau_x11.h>
 //#include <X11/Xlib.h>
 
 #include "ve.h"
+#include "logger.h"
+#include "vdpau_sunxi.h"
 
 #define INTERNAL_YCBCR_FORMAT (VdpYCbCrFormat)0xffff
+#define INTERNAL_YCBCR_FORMAT_422 (VdpYCbCrFormat)0xfffe
 
 typedef uint32_t VdpHandle;
 
@@ -48,7 +53,8 @@ enum HandleType
    htype_presentation,
    htype_presentation_target,
    htype_nvidia_vdpau,
-   htype_display_vdpau
+   htype_display_vdpau,
+   htype_export
 };
 
 enum VdpauNVState
@@ -70,6 +76,13 @@ typedef struct
     int fb_id;
     int g2d_fd;
     int osd_enabled;
+    const struct rgba_engine_struct *rgba_engine;
+    struct rgba_surface_struct *rgba_pending;
+    int pip_layers;
+    // guards creating the readback pool and the completion queue on first use
+    pthread_mutex_t mutex;
+    struct readback_pool *readback;
+    struct completion_queue *completion;
 } device_ctx_t;
 
 typedef struct video_surface_ctx_struct
@@ -88,8 +101,78 @@ typedef struct video_surface_ctx_struct
 	void *decoder_private;
 	void (*decoder_private_free)(struct video_surface_ctx_struct *surface);
     uint8_t frame_decoded;
+	VdpVideoSurface scaled;
+	uint32_t rotation;
+	CEDARV_MEMORY rotY;
+	CEDARV_MEMORY rotU;
+	uint8_t rotated;
+	// bumped whenever the decoder or put_bits writes new content
+	uint32_t generation;
+	// shared with the exports once the surface was exported
+	struct video_planes_struct *exported;
 } video_surface_ctx_t;
 
+// planes and size of what is shown for a video surface, the rotated copy if the decoder wrote one
+static inline void video_surface_get_display(video_surface_ctx_t *vs, CEDARV_MEMORY *y, CEDARV_MEMORY *uv, uint32_t *width, uint32_t *height)
+{
+	int swap = vs->rotated && (vs->rotation == VDP_SUNXI_ROTATION_90 || vs->rotation == VDP_SUNXI_ROTATION_270);
+
+	*y = vs->rotated ? vs->rotY : vs->dataY;
+	*uv = vs->rotated ? vs->rotU : vs->dataU;
+	*width = swap ? vs->height : vs->width;
+	*height = swap ? vs->width : vs->height;
+}
+
+/*
+ * Planes of an exported surface, the surface and every export hold a
+ * reference, the last one frees them.
+ */
+typedef struct video_planes_struct
+{
+	CEDARV_MEMORY dataY, dataU, dataV;
+	uint32_t refs;
+} video_planes_t;
+
+static inline void video_planes_free(CEDARV_MEMORY y, CEDARV_MEMORY u, CEDARV_MEMORY v)
+{
+	if (cedarv_isValid(y))
+		cedarv_free(y);
+	if (cedarv_isValid(u))
+		cedarv_free(u);
+	if (cedarv_isValid(v))
+		cedarv_free(v);
+}
+
+static inline void video_planes_put(video_planes_t *p)
+{
+	if (__atomic_sub_fetch(&p->refs, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+
+	video_planes_free(p->dataY, p->dataU, p->dataV);
+	free(p);
+}
+
+// on destroy, exported planes stay until the last export is released
+static inline void video_surface_free_planes(video_surface_ctx_t *vs)
+{
+	video_planes_t *p = vs->exported;
+	if (p)
+	{
+		// put_bits may have allocated V since the first export
+		p->dataY = vs->dataY;
+		p->dataU = vs->dataU;
+		p->dataV = vs->dataV;
+		vs->exported = NULL;
+		video_planes_put(p);
+	}
+	else
+		video_planes_free(vs->dataY, vs->dataU, vs->dataV);
+
+	memset(&vs->dataY, 0, sizeof(vs->dataY));
+	memset(&vs->dataU, 0, sizeof(vs->dataU));
+	memset(&vs->dataV, 0, sizeof(vs->dataV));
+}
+
 typedef struct decoder_ctx_struct
 {
 	uint32_t width, height;
@@ -100,13 +183,26 @@ typedef struct decoder_ctx_struct
 	VdpStatus (*decode)(struct decoder_ctx_struct *decoder, VdpPictureInfo const *info, const int len, video_surface_ctx_t *output);
 	void *private;
 	void (*private_free)(struct decoder_ctx_struct *decoder);
+	// optional, forgets what earlier pictures left behind, for seeks
+	void (*private_flush)(struct decoder_ctx_struct *decoder);
+	// optional, whether the buffers of private suffice for another size
+	int (*private_fits)(struct decoder_ctx_struct *decoder, uint32_t width, uint32_t height);
 } decoder_ctx_t;
 
+// videos mixed into one output surface besides the main one
+#define OUTPUT_PIP_MAX 3
+
 typedef struct
 {
     Drawable drawable;
     int fd;
     int layer;
+    int layer_pip[OUTPUT_PIP_MAX];
+    int layer_top;
+    int video_started;
+    // DISP_CMD_VIDEO_START failed once, tiled fields are shown as frames
+    int video_unavailable;
+    int video_id;
     int screen_height;
     int screen_width;
 } queue_target_ctx_t;
@@ -128,15 +224,75 @@ typedef struct
 	float contrast;
 	float saturation;
 	float hue;
+	int deinterlace;
 } mixer_ctx_t;
 
-typedef struct
+#define RGBA_FLAG_DIRTY (1 << 0)
+#define RGBA_FLAG_NEEDS_FLUSH (1 << 1)
+#define RGBA_FLAG_CACHED (1 << 2)
+#define RGBA_FLAG_CLEAR_PENDING (1 << 3)
+
+typedef struct rgba_surface_struct
 {
 	device_ctx_t *device;
-	VdpRGBAFormat rgba_format;
+	VdpRGBAFormat format;
 	uint32_t width, height;
+	CEDARV_MEMORY data;
+	VdpRect dirty;
+	uint32_t flush_y0, flush_y1;	// rows to flush with RGBA_FLAG_NEEDS_FLUSH
+	uint32_t generation;	// new value whenever the content changes
+	uint32_t flags;
+	struct rgba_replay *replay;	// renders since the last clear, see rgba_clear()
+	struct rgba_surface_struct *next_pending;
+} rgba_surface_t;
+
+/*
+ * One compositing operation, with rects already clipped and blend
+ * state and colors filled in with the VDPAU defaults.
+ */
+typedef struct
+{
+	rgba_surface_t *dest;
+	VdpRect dest_rect;
+	rgba_surface_t *src;	// NULL for a single white pixel stretched over dest_rect
+	VdpRect src_rect;
+	VdpColor colors[4];
+	int color_count;	// 1, or 4 with VDP_OUTPUT_SURFACE_RENDER_COLOR_PER_VERTEX
+	VdpOutputSurfaceRenderBlendState blend;
+	uint32_t flags;
+} rgba_op_t;
+
+typedef struct rgba_engine_struct
+{
+	const char *name;
+	// returns VDP_STATUS_NO_IMPLEMENTATION for operations it can't do, which then go to the CPU
+	VdpStatus (*render)(const rgba_op_t *op);
+	// scaled copy of a video surface, NULL if not supported
+	VdpStatus (*render_video)(rgba_surface_t *dest, const VdpRect *dest_rect, video_surface_ctx_t *src, const VdpRect *src_rect);
+} rgba_engine_t;
+
+extern const rgba_engine_t rgba_engine_g2d;
+extern const rgba_engine_t rgba_engine_sw;
+
+typedef struct
+{
+	video_surface_ctx_t *vs;
+	VdpRect src_rect, dst_rect;
+} output_pip_t;
+
+typedef struct
+{
+	rgba_surface_t rgba;
 	video_surface_ctx_t *vs;
 	VdpRect video_src_rect, video_dst_rect;
+	output_pip_t pip[OUTPUT_PIP_MAX];	// shown on their own scaler layers above vs
+	int pip_count;
+	// a main video was mixed in since the surface was last displayed
+	int video_composing;
+	VdpVideoMixerPictureStructure video_field;
+	int video_deinterlace;
+	// the mixer got a past picture, the surface itself may be gone by display
+	int video_has_past;
 	int csc_change;
 	float brightness;
 	float contrast;
@@ -145,6 +301,12 @@ typedef struct
 	enum VdpauNVState vdpNvState;
 } output_surface_ctx_t;
 
+typedef struct
+{
+	rgba_surface_t rgba;
+	VdpBool frequently_accessed;
+} bitmap_surface_ctx_t;
+
 #ifndef ARRAY_SIZE
 #define ARRAY_SIZE(a) (sizeof((a)) / sizeof((a)[0]))
 #endif
@@ -185,6 +347,13 @@ VdpStatus new_decoder_h264(decoder_ctx_t *decoder);
 VdpStatus new_decoder_mpeg4(decoder_ctx_t *decoder);
 VdpStatus new_decoder_msmpeg4(decoder_ctx_t *decoder);
 VdpStatus new_decoder_h265(decoder_ctx_t *decoder);
+VdpStatus new_decoder_jpeg(decoder_ctx_t *decoder);
+#if USE_VC1
+VdpStatus new_decoder_vc1(decoder_ctx_t *decoder);
+#endif
+#if USE_VP8
+VdpStatus new_decoder_vp8(decoder_ctx_t *decoder);
+#endif
 
 void *handle_create(size_t size, VdpHandle *handle, enum HandleType type);
 void *handle_get(VdpHandle handle);
@@ -193,6 +362,7 @@ void handle_release(VdpHandle handle);
 enum HandleType handle_get_type(VdpHandle handle);
 
 VdpStatus vdp_imp_device_create_x11(Display *display, int screen, VdpDevice *device, VdpGetProcAddress **get_proc_address);
+VdpStatus vdp_imp_device_create_sunxi(VdpDevice *device, VdpGetProcAddress **get_proc_address);
 VdpStatus vdp_device_destroy(VdpDevice device);
 VdpStatus vdp_preemption_callback_register(VdpDevice device, VdpPreemptionCallback callback, void *context);
 
@@ -220,6 +390,12 @@ VdpStatus vdp_video_surface_get_parameters(VdpVideoSurface surface, VdpChromaTyp
 VdpStatus vdp_video_surface_get_bits_y_cb_cr(VdpVideoSurface surface, VdpYCbCrFormat destination_ycbcr_format, void *const *destination_data, uint32_t const *destination_pitches);
 VdpStatus vdp_video_surface_put_bits_y_cb_cr(VdpVideoSurface surface, VdpYCbCrFormat source_ycbcr_format, void const *const *source_data, uint32_t const *source_pitches);
 VdpStatus vdp_video_surface_query_capabilities(VdpDevice device, VdpChromaType surface_chroma_type, VdpBool *is_supported, uint32_t *max_width, uint32_t *max_height);
+VdpStatus vdp_video_surface_attach_scaled_sunxi(VdpVideoSurface surface, VdpVideoSurface scaled);
+video_surface_ctx_t *video_surface_get_scaled(video_surface_ctx_t *vs, int *ratio);
+VdpStatus vdp_video_surface_set_rotation_sunxi(VdpVideoSurface surface, uint32_t rotation);
+VdpStatus vdp_video_surface_export_sunxi(VdpVideoSurface surface, VdpVideoSurfaceExportInfoSunxi *info);
+VdpStatus vdp_video_surface_export_release_sunxi(VdpHandle export);
+uint32_t video_surface_rotated_width(video_surface_ctx_t *vs);
 VdpStatus vdp_video_surface_query_get_put_bits_y_cb_cr_capabilities(VdpDevice device, VdpChromaType surface_chroma_type, VdpYCbCrFormat bits_ycbcr_format, VdpBool *is_supported);
 
 VdpStatus vdp_output_surface_create(VdpDevice device, VdpRGBAFormat rgba_format, uint32_t width, uint32_t height, VdpOutputSurface  *surface);
@@ -258,6 +434,39 @@ VdpStatus vdp_decoder_get_parameters(VdpDecoder decoder, VdpDecoderProfile *prof
 VdpStatus vdp_decoder_render(VdpDecoder decoder, VdpVideoSurface target, VdpPictureInfo const *picture_info, uint32_t bitstream_buffer_count, VdpBitstreamBuffer const *bitstream_buffers);
 VdpStatus vdp_decoder_query_capabilities(VdpDevice device, VdpDecoderProfile profile, VdpBool *is_supported, uint32_t *max_level, uint32_t *max_macroblocks, uint32_t *max_width, uint32_t *max_height);
 
+VdpStatus rgba_create(rgba_surface_t *rgba, device_ctx_t *device, uint32_t width, uint32_t height, VdpRGBAFormat format, int cached);
+void rgba_destroy(rgba_surface_t *rgba);
+VdpStatus rgba_render(rgba_surface_t *dest, const VdpRect *dest_rect, rgba_surface_t *src, const VdpRect *src_rect, const VdpColor *colors, const VdpOutputSurfaceRenderBlendState *blend_state, uint32_t flags);
+void rgba_clear(rgba_surface_t *rgba);
+VdpStatus rgba_render_video(rgba_surface_t *dest, const VdpRect *dest_rect, video_surface_ctx_t *src, const VdpRect *src_rect);
+VdpStatus rgba_put_bits_native(rgba_surface_t *rgba, const void *const *source_data, const uint32_t *source_pitches, const VdpRect *destination_rect);
+VdpStatus rgba_get_bits_native(rgba_surface_t *rgba, const VdpRect *source_rect, void *const *destination_data, const uint32_t *destination_pitches);
+VdpStatus rgba_put_bits_indexed(rgba_surface_t *rgba, VdpIndexedFormat source_indexed_format, const void *const *source_data, const uint32_t *source_pitch, const VdpRect *destination_rect, VdpColorTableFormat color_table_format, const void *color_table);
+VdpStatus rgba_put_bits_y_cb_cr(rgba_surface_t *rgba, VdpYCbCrFormat source_ycbcr_format, const void *const *source_data, const uint32_t *source_pitches, const VdpRect *destination_rect, const VdpCSCMatrix *csc_matrix);
+void rgba_flush(rgba_surface_t *rgba);
+
+VdpStatus readback_video_surface(video_surface_ctx_t *vs, VdpYCbCrFormat format, void *const *data, uint32_t const *pitches);
+void readback_free(device_ctx_t *dev);
+
+VdpStatus decoder_render(VdpDecoder decoder, VdpVideoSurface target, VdpPictureInfo const *picture_info, uint32_t bitstream_buffer_count, VdpBitstreamBuffer const *bitstream_buffers);
+void completion_free(device_ctx_t *dev);
+void completion_sync(device_ctx_t *dev);
+void completion_displayed(device_ctx_t *dev, VdpOutputSurface surface);
+VdpStatus vdp_decoder_render_async_sunxi(VdpDecoder decoder, VdpVideoSurface target, VdpPictureInfo const *picture_info, uint32_t bitstream_buffer_count, VdpBitstreamBuffer const *bitstream_buffers);
+VdpStatus vdp_device_completion_fd_sunxi(VdpDevice device, int *fd);
+VdpStatus vdp_device_collect_completions_sunxi(VdpDevice device, VdpCompletionSunxi *completions, uint32_t max, uint32_t *count);
+VdpStatus vdp_decoder_flush_sunxi(VdpDecoder decoder);
+VdpStatus vdp_decoder_reconfigure_sunxi(VdpDecoder decoder, uint32_t width, uint32_t height);
+VdpStatus vdp_device_timeline_flush_sunxi(VdpDevice device);
+
+void capture_surface_create(VdpVideoSurface surface, VdpChromaType chroma_type, uint32_t width, uint32_t height);
+void capture_surface_destroy(VdpVideoSurface surface);
+void capture_decoder_create(VdpDecoder decoder, VdpDecoderProfile profile, uint32_t width, uint32_t height, uint32_t max_references);
+void capture_decoder_destroy(VdpDecoder decoder);
+void capture_decoder_flush(VdpDecoder decoder);
+void capture_decoder_reconfigure(VdpDecoder decoder, uint32_t width, uint32_t height);
+void capture_decoder_render(VdpDecoder decoder, VdpDecoderProfile profile, VdpVideoSurface target, VdpPictureInfo const *picture_info, uint32_t bitstream_buffer_count, VdpBitstreamBuffer const *bitstream_buffers);
+
 VdpStatus vdp_bitmap_surface_create(VdpDevice device, VdpRGBAFormat rgba_format, uint32_t width, uint32_t height, VdpBool frequently_accessed, VdpBitmapSurface *surface);
 VdpStatus vdp_bitmap_surface_destroy(VdpBitmapSurface surface);
 VdpStatus vdp_bitmap_surface_get_parameters(VdpBitmapSurface surface, VdpRGBAFormat *rgba_format, uint32_t *width, uint32_t *height, VdpBool *frequently_accessed);
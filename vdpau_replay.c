@@ -0,0 +1,1155 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Replays a VDPAU_CAPTURE trace against the driver, as fast as possible
+ * or paced to a frame rate, and reports the decode rate, latency
+ * percentiles and the CPU time used. Run it with VDPAU_FAKE_VE=<version>
+ * on machines without the engine.
+ *
+ * -b runs one of the benchmarks of the CPU paths instead, -l times:
+ *   osd       PutBitsIndexed of a 1280x720 OSD in every indexed format
+ *   readback  GetBitsYCbCr of a 1280x720 video surface, NV12 and YV12 from
+ *             put_bits surfaces and decoded ones, which are tiled before 0x1680
+ *   seek      H.264 seeks with and without a resolution change, through the
+ *             flush and reconfigure extensions and by recreating the decoder
+ *   subtitle  1280x720 frames with subtitles rendered from output surfaces,
+ *             checks the pixels the delayed clear leaves behind
+ *
+ *   vdpau_replay [-r fps] [-l loops] trace
+ *   vdpau_replay [-l loops] -b benchmark
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <vdpau/vdpau.h>
+#include "vdpau_sunxi.h"
+#include "capture.h"
+
+// the driver entry point, called directly instead of through libvdpau
+VdpDeviceCreateSunxi vdp_imp_device_create_sunxi;
+
+typedef struct
+{
+	uint32_t from;
+	uint32_t to;
+	VdpDecoderProfile profile;
+} handle_map_t;
+
+static struct
+{
+	VdpDevice device;
+	VdpVideoSurfaceCreate *surface_create;
+	VdpVideoSurfaceDestroy *surface_destroy;
+	VdpDecoderCreate *decoder_create;
+	VdpDecoderDestroy *decoder_destroy;
+	VdpDecoderRender *decoder_render;
+	VdpDecoderFlushSunxi *decoder_flush;
+	VdpDecoderReconfigureSunxi *decoder_reconfigure;
+
+	handle_map_t *surfaces;
+	int surface_count;
+	handle_map_t *decoders;
+	int decoder_count;
+
+	uint64_t *latencies;
+	int frames;
+	int frames_max;
+	int errors;
+} r;
+
+static uint64_t now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static handle_map_t *map_find(handle_map_t *map, int count, uint32_t from)
+{
+	int i;
+	for (i = 0; i < count; i++)
+		if (map[i].from == from)
+			return &map[i];
+
+	return NULL;
+}
+
+static int map_add(handle_map_t **map, int *count, uint32_t from, uint32_t to, VdpDecoderProfile profile)
+{
+	handle_map_t *m = realloc(*map, (*count + 1) * sizeof(**map));
+	if (!m)
+		return 0;
+
+	m[*count].from = from;
+	m[*count].to = to;
+	m[*count].profile = profile;
+	*map = m;
+	(*count)++;
+	return 1;
+}
+
+static void map_remove(handle_map_t *map, int *count, handle_map_t *entry)
+{
+	*entry = map[--(*count)];
+}
+
+static void remap_surface(VdpVideoSurface *surface)
+{
+	handle_map_t *m = map_find(r.surfaces, r.surface_count, *surface);
+	*surface = m ? m->to : VDP_INVALID_HANDLE;
+}
+
+// the references in the picture info name surfaces of the captured process
+static void remap_info(VdpDecoderProfile profile, void *info, uint32_t size)
+{
+	int i;
+
+	if (size == 0 || size != capture_info_size(profile))
+		return;
+
+	switch (profile)
+	{
+	case VDP_DECODER_PROFILE_MPEG1:
+	case VDP_DECODER_PROFILE_MPEG2_SIMPLE:
+	case VDP_DECODER_PROFILE_MPEG2_MAIN:
+		remap_surface(&((VdpPictureInfoMPEG1Or2 *)info)->forward_reference);
+		remap_surface(&((VdpPictureInfoMPEG1Or2 *)info)->backward_reference);
+		break;
+
+	case VDP_DECODER_PROFILE_H264_BASELINE:
+	case VDP_DECODER_PROFILE_H264_MAIN:
+	case VDP_DECODER_PROFILE_H264_HIGH:
+		for (i = 0; i < 16; i++)
+			remap_surface(&((VdpPictureInfoH264 *)info)->referenceFrames[i].surface);
+		break;
+
+	case VDP_DECODER_PROFILE_HEVC_MAIN:
+		for (i = 0; i < 16; i++)
+			remap_surface(&((VdpPictureInfoHEVC *)info)->RefPics[i]);
+		break;
+
+	case VDP_DECODER_PROFILE_VC1_SIMPLE:
+	case VDP_DECODER_PROFILE_VC1_MAIN:
+	case VDP_DECODER_PROFILE_VC1_ADVANCED:
+		remap_surface(&((VdpPictureInfoVC1 *)info)->forward_reference);
+		remap_surface(&((VdpPictureInfoVC1 *)info)->backward_reference);
+		break;
+
+	default:
+		// the MPEG4 part 2 and DivX profiles
+		remap_surface(&((VdpPictureInfoMPEG4Part2 *)info)->forward_reference);
+		remap_surface(&((VdpPictureInfoMPEG4Part2 *)info)->backward_reference);
+		break;
+	}
+}
+
+static void render(const uint8_t *payload, uint32_t size)
+{
+	const capture_render_t *c = (const capture_render_t *)payload;
+	const uint8_t *p = payload + CAPTURE_ALIGN(sizeof(*c));
+	const uint8_t *end = payload + size;
+	VdpBitstreamBuffer buffers[32];
+	uint8_t info[4096];
+	uint32_t i;
+
+	handle_map_t *dec = map_find(r.decoders, r.decoder_count, c->decoder);
+	handle_map_t *target = map_find(r.surfaces, r.surface_count, c->target);
+	if (!dec || !target || c->info_size > sizeof(info) || c->buffer_count > 32)
+	{
+		r.errors++;
+		return;
+	}
+
+	memcpy(info, p, c->info_size);
+	remap_info(dec->profile, info, c->info_size);
+	p += CAPTURE_ALIGN(c->info_size);
+
+	for (i = 0; i < c->buffer_count; i++)
+	{
+		uint32_t bytes = *(const uint32_t *)p;
+		p += CAPTURE_ALIGN(sizeof(uint32_t));
+		if (p + bytes > end)
+		{
+			r.errors++;
+			return;
+		}
+		buffers[i].struct_version = VDP_BITSTREAM_BUFFER_VERSION;
+		buffers[i].bitstream = p;
+		buffers[i].bitstream_bytes = bytes;
+		p += CAPTURE_ALIGN(bytes);
+	}
+
+	uint64_t start = now();
+	VdpStatus status = r.decoder_render(dec->to, target->to, (VdpPictureInfo const *)info, c->buffer_count, buffers);
+	uint64_t latency = now() - start;
+
+	if (status != VDP_STATUS_OK)
+		r.errors++;
+
+	if (r.frames == r.frames_max)
+	{
+		int max = r.frames_max ? r.frames_max * 2 : 1024;
+		uint64_t *l = realloc(r.latencies, max * sizeof(*l));
+		if (!l)
+			return;
+		r.latencies = l;
+		r.frames_max = max;
+	}
+	r.latencies[r.frames++] = latency;
+}
+
+static void destroy_all(void)
+{
+	while (r.decoder_count)
+	{
+		r.decoder_destroy(r.decoders[0].to);
+		map_remove(r.decoders, &r.decoder_count, &r.decoders[0]);
+	}
+
+	while (r.surface_count)
+	{
+		r.surface_destroy(r.surfaces[0].to);
+		map_remove(r.surfaces, &r.surface_count, &r.surfaces[0]);
+	}
+}
+
+static int replay(const uint8_t *trace, size_t size, double fps)
+{
+	const uint8_t *p = trace + sizeof(capture_header_t);
+	const uint8_t *end = trace + size;
+	uint64_t start = now();
+	int frame = 0;
+
+	while (p + sizeof(capture_record_t) <= end)
+	{
+		const capture_record_t *rec = (const capture_record_t *)p;
+		const uint8_t *payload = p + sizeof(*rec);
+		p = payload + rec->size;
+		if (p > end)
+		{
+			fprintf(stderr, "trace truncated\n");
+			break;
+		}
+
+		const capture_surface_t *s = (const capture_surface_t *)payload;
+		const capture_decoder_t *d = (const capture_decoder_t *)payload;
+		handle_map_t *m;
+		uint32_t handle;
+
+		switch (rec->type)
+		{
+		case CAPTURE_SURFACE_CREATE:
+			if (r.surface_create(r.device, s->chroma_type, s->width, s->height, &handle) != VDP_STATUS_OK ||
+			    !map_add(&r.surfaces, &r.surface_count, s->surface, handle, 0))
+				r.errors++;
+			break;
+
+		case CAPTURE_SURFACE_DESTROY:
+			if ((m = map_find(r.surfaces, r.surface_count, s->surface)))
+			{
+				r.surface_destroy(m->to);
+				map_remove(r.surfaces, &r.surface_count, m);
+			}
+			break;
+
+		case CAPTURE_DECODER_CREATE:
+			if (r.decoder_create(r.device, d->profile, d->width, d->height, d->max_references, &handle) != VDP_STATUS_OK ||
+			    !map_add(&r.decoders, &r.decoder_count, d->decoder, handle, d->profile))
+				r.errors++;
+			break;
+
+		case CAPTURE_DECODER_DESTROY:
+			if ((m = map_find(r.decoders, r.decoder_count, d->decoder)))
+			{
+				r.decoder_destroy(m->to);
+				map_remove(r.decoders, &r.decoder_count, m);
+			}
+			break;
+
+		case CAPTURE_DECODER_FLUSH:
+			if ((m = map_find(r.decoders, r.decoder_count, d->decoder)) && r.decoder_flush(m->to) != VDP_STATUS_OK)
+				r.errors++;
+			break;
+
+		case CAPTURE_DECODER_RECONFIGURE:
+			if ((m = map_find(r.decoders, r.decoder_count, d->decoder)) &&
+			    r.decoder_reconfigure(m->to, d->width, d->height) != VDP_STATUS_OK)
+				r.errors++;
+			break;
+
+		case CAPTURE_DECODER_RENDER:
+			if (fps > 0.0)
+			{
+				uint64_t due = start + (uint64_t)(frame * 1000000000.0 / fps);
+				struct timespec ts = { .tv_sec = due / 1000000000ull, .tv_nsec = due % 1000000000ull };
+				clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+			}
+			render(payload, rec->size);
+			frame++;
+			break;
+
+		default:
+			// unknown records are skipped, newer traces stay readable
+			break;
+		}
+	}
+
+	destroy_all();
+	return frame;
+}
+
+static int compare(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+static double percentile(double p)
+{
+	int i = (int)(p * (r.frames - 1) + 0.5);
+	return r.latencies[i] / 1000000.0;
+}
+
+static double cpu_seconds(void)
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1000000.0 +
+	       ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1000000.0;
+}
+
+static int get_proc(VdpGetProcAddress *get_proc_address, VdpFuncId id, void *func)
+{
+	return get_proc_address(r.device, id, (void **)func) == VDP_STATUS_OK;
+}
+
+#define BENCH_WIDTH 1280
+#define BENCH_HEIGHT 720
+#define BENCH_ROUNDS 50
+
+static void bench_report(const char *name, uint64_t start, int loops, uint64_t bytes_per_round)
+{
+	double seconds = (now() - start) / 1000000000.0;
+	double rounds = (double)loops * BENCH_ROUNDS;
+	printf("%-14s %8.1f MB/s, %8.1f Mpixel/s\n", name, rounds * bytes_per_round / seconds / 1000000.0,
+	       rounds * BENCH_WIDTH * BENCH_HEIGHT / seconds / 1000000.0);
+}
+
+/*
+ * Every round expands the whole surface, the first one is checked
+ * against a plain C expansion read back with GetBitsNative.
+ */
+static int bench_osd(VdpGetProcAddress *get_proc_address, int loops)
+{
+	VdpOutputSurfaceCreate *create;
+	VdpOutputSurfaceDestroy *destroy;
+	VdpOutputSurfacePutBitsIndexed *put_bits_indexed;
+	VdpOutputSurfaceGetBitsNative *get_bits_native;
+
+	if (!get_proc(get_proc_address, VDP_FUNC_ID_OUTPUT_SURFACE_CREATE, &create) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_OUTPUT_SURFACE_DESTROY, &destroy) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_OUTPUT_SURFACE_PUT_BITS_INDEXED, &put_bits_indexed) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_OUTPUT_SURFACE_GET_BITS_NATIVE, &get_bits_native))
+	{
+		fprintf(stderr, "driver misses output surface functions\n");
+		return 2;
+	}
+
+	static const struct
+	{
+		VdpIndexedFormat format;
+		const char *name;
+		int bytes;
+	} formats[] =
+	{
+		{ VDP_INDEXED_FORMAT_A4I4, "A4I4", 1 },
+		{ VDP_INDEXED_FORMAT_I4A4, "I4A4", 1 },
+		{ VDP_INDEXED_FORMAT_A8I8, "A8I8", 2 },
+		{ VDP_INDEXED_FORMAT_I8A8, "I8A8", 2 },
+	};
+
+	VdpOutputSurface surface;
+	if (create(r.device, VDP_RGBA_FORMAT_B8G8R8A8, BENCH_WIDTH, BENCH_HEIGHT, &surface) != VDP_STATUS_OK)
+	{
+		fprintf(stderr, "could not create the output surface\n");
+		return 2;
+	}
+
+	uint8_t *src = malloc(BENCH_WIDTH * BENCH_HEIGHT * 2);
+	uint32_t *out = malloc(BENCH_WIDTH * BENCH_HEIGHT * 4);
+	uint32_t table[256], i, f;
+	int errors = 0;
+
+	srand(1);
+	for (i = 0; i < BENCH_WIDTH * BENCH_HEIGHT * 2; i++)
+		src[i] = rand();
+	for (i = 0; i < 256; i++)
+		table[i] = rand();
+
+	for (f = 0; f < sizeof(formats) / sizeof(formats[0]); f++)
+	{
+		const void *data[1] = { src };
+		uint32_t pitch[1] = { BENCH_WIDTH * formats[f].bytes };
+		void *out_data[1] = { out };
+		uint32_t out_pitch[1] = { BENCH_WIDTH * 4 };
+
+		if (put_bits_indexed(surface, formats[f].format, data, pitch, NULL, VDP_COLOR_TABLE_FORMAT_B8G8R8X8, table) != VDP_STATUS_OK ||
+		    get_bits_native(surface, NULL, out_data, out_pitch) != VDP_STATUS_OK)
+		{
+			fprintf(stderr, "%s: put bits failed\n", formats[f].name);
+			errors++;
+			continue;
+		}
+
+		for (i = 0; i < BENCH_WIDTH * BENCH_HEIGHT; i++)
+		{
+			uint8_t idx, a;
+			const uint8_t *s = src + i * formats[f].bytes;
+			switch (formats[f].format)
+			{
+			case VDP_INDEXED_FORMAT_A4I4:
+				idx = *s & 0x0f, a = (*s >> 4) * 17;
+				break;
+			case VDP_INDEXED_FORMAT_I4A4:
+				idx = *s >> 4, a = (*s & 0x0f) * 17;
+				break;
+			case VDP_INDEXED_FORMAT_A8I8:
+				idx = s[1], a = s[0];
+				break;
+			default:
+				idx = s[0], a = s[1];
+				break;
+			}
+			if (out[i] != ((table[idx] & 0x00ffffff) | ((uint32_t)a << 24)))
+				break;
+		}
+		if (i != BENCH_WIDTH * BENCH_HEIGHT)
+		{
+			fprintf(stderr, "%s: pixel %u differs\n", formats[f].name, i);
+			errors++;
+		}
+
+		uint64_t start = now();
+		int l, k;
+		for (l = 0; l < loops; l++)
+			for (k = 0; k < BENCH_ROUNDS; k++)
+				put_bits_indexed(surface, formats[f].format, data, pitch, NULL, VDP_COLOR_TABLE_FORMAT_B8G8R8X8, table);
+		bench_report(formats[f].name, start, loops, BENCH_WIDTH * BENCH_HEIGHT * (formats[f].bytes + 4));
+	}
+
+	free(out);
+	free(src);
+	destroy(surface);
+	return errors ? 2 : 0;
+}
+
+// the decoder only has to write into the surface, the fake engine writes nothing
+static int decode_one(VdpVideoSurface surface)
+{
+	static const uint8_t slice[64] = { 0x00, 0x00, 0x01, 0x01, 0x0a };
+	VdpPictureInfoMPEG1Or2 info;
+	VdpBitstreamBuffer buffer = { .struct_version = VDP_BITSTREAM_BUFFER_VERSION, .bitstream = slice, .bitstream_bytes = sizeof(slice) };
+	VdpDecoder decoder;
+
+	memset(&info, 0, sizeof(info));
+	info.forward_reference = VDP_INVALID_HANDLE;
+	info.backward_reference = VDP_INVALID_HANDLE;
+	info.slice_count = 1;
+	info.picture_structure = 3;
+	info.picture_coding_type = 1;
+	info.f_code[0][0] = info.f_code[0][1] = info.f_code[1][0] = info.f_code[1][1] = 15;
+
+	if (r.decoder_create(r.device, VDP_DECODER_PROFILE_MPEG1, BENCH_WIDTH, BENCH_HEIGHT, 2, &decoder) != VDP_STATUS_OK)
+		return 0;
+
+	VdpStatus status = r.decoder_render(decoder, surface, (VdpPictureInfo const *)&info, 1, &buffer);
+	r.decoder_destroy(decoder);
+	return status == VDP_STATUS_OK;
+}
+
+/*
+ * The put_bits surfaces are read back into both formats once and
+ * checked against what was put before they are timed, decoded ones
+ * only timed.
+ */
+static int bench_readback(VdpGetProcAddress *get_proc_address, int loops)
+{
+	VdpVideoSurfacePutBitsYCbCr *put_bits;
+	VdpVideoSurfaceGetBitsYCbCr *get_bits;
+
+	if (!get_proc(get_proc_address, VDP_FUNC_ID_VIDEO_SURFACE_CREATE, &r.surface_create) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_VIDEO_SURFACE_DESTROY, &r.surface_destroy) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_VIDEO_SURFACE_PUT_BITS_Y_CB_CR, &put_bits) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_VIDEO_SURFACE_GET_BITS_Y_CB_CR, &get_bits) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_DECODER_CREATE, &r.decoder_create) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_DECODER_DESTROY, &r.decoder_destroy) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_DECODER_RENDER, &r.decoder_render))
+	{
+		fprintf(stderr, "driver misses video surface functions\n");
+		return 2;
+	}
+
+	static const struct
+	{
+		const char *name;
+		// put_bits source format, or decoded if -1
+		int source;
+		VdpYCbCrFormat format;
+	} cases[] =
+	{
+		{ "nv12 > nv12", VDP_YCBCR_FORMAT_NV12, VDP_YCBCR_FORMAT_NV12 },
+		{ "nv12 > yv12", VDP_YCBCR_FORMAT_NV12, VDP_YCBCR_FORMAT_YV12 },
+		{ "yv12 > yv12", VDP_YCBCR_FORMAT_YV12, VDP_YCBCR_FORMAT_YV12 },
+		{ "decoded > nv12", -1, VDP_YCBCR_FORMAT_NV12 },
+		{ "decoded > yv12", -1, VDP_YCBCR_FORMAT_YV12 },
+	};
+
+	const uint32_t w = BENCH_WIDTH, h = BENCH_HEIGHT, cw = w / 2, ch = h / 2;
+	uint8_t *y = malloc(w * h), *u = malloc(cw * ch), *v = malloc(cw * ch), *uv = malloc(w * ch);
+	uint8_t *out_y = malloc(w * h), *out_c = malloc(w * ch);
+	uint32_t i, c;
+	int errors = 0;
+
+	srand(2);
+	for (i = 0; i < w * h; i++)
+		y[i] = rand();
+	for (i = 0; i < cw * ch; i++)
+	{
+		uv[2 * i] = u[i] = rand();
+		uv[2 * i + 1] = v[i] = rand();
+	}
+
+	for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+	{
+		VdpVideoSurface surface;
+		if (r.surface_create(r.device, VDP_CHROMA_TYPE_420, w, h, &surface) != VDP_STATUS_OK)
+		{
+			fprintf(stderr, "could not create the video surface\n");
+			errors++;
+			break;
+		}
+
+		VdpStatus status;
+		if (cases[c].source == VDP_YCBCR_FORMAT_NV12)
+		{
+			const void *data[2] = { y, uv };
+			uint32_t pitches[2] = { w, w };
+			status = put_bits(surface, VDP_YCBCR_FORMAT_NV12, data, pitches);
+		}
+		else if (cases[c].source == VDP_YCBCR_FORMAT_YV12)
+		{
+			const void *data[3] = { y, v, u };
+			uint32_t pitches[3] = { w, cw, cw };
+			status = put_bits(surface, VDP_YCBCR_FORMAT_YV12, data, pitches);
+		}
+		else
+			status = decode_one(surface) ? VDP_STATUS_OK : VDP_STATUS_ERROR;
+
+		// YV12 wants V before U
+		void *data[3] = { out_y, out_c, out_c + cw * ch };
+		uint32_t pitches[3] = { w, cw, cw };
+		if (cases[c].format == VDP_YCBCR_FORMAT_NV12)
+			pitches[1] = w;
+
+		if (status != VDP_STATUS_OK || get_bits(surface, cases[c].format, data, pitches) != VDP_STATUS_OK)
+		{
+			fprintf(stderr, "%s: put or get bits failed\n", cases[c].name);
+			errors++;
+			r.surface_destroy(surface);
+			continue;
+		}
+
+		if (cases[c].source != -1)
+		{
+			int same = memcmp(out_y, y, w * h) == 0;
+			for (i = 0; same && i < cw * ch; i++)
+			{
+				if (cases[c].format == VDP_YCBCR_FORMAT_NV12)
+					same = out_c[2 * i] == u[i] && out_c[2 * i + 1] == v[i];
+				else
+					same = out_c[i] == v[i] && out_c[cw * ch + i] == u[i];
+			}
+			if (!same)
+			{
+				fprintf(stderr, "%s: read back differs\n", cases[c].name);
+				errors++;
+			}
+		}
+
+		uint64_t start = now();
+		int l, k;
+		for (l = 0; l < loops; l++)
+			for (k = 0; k < BENCH_ROUNDS; k++)
+				get_bits(surface, cases[c].format, data, pitches);
+		bench_report(cases[c].name, start, loops, w * h * 3 / 2);
+
+		r.surface_destroy(surface);
+	}
+
+	free(out_c);
+	free(out_y);
+	free(uv);
+	free(v);
+	free(u);
+	free(y);
+	return errors ? 2 : 0;
+}
+
+// an IDR slice, the fake engine reads back the slice header as zeros
+static VdpStatus decode_idr(VdpDecoder decoder, VdpVideoSurface surface)
+{
+	static const uint8_t slice[64] = { 0x00, 0x00, 0x01, 0x65, 0x88, 0x84 };
+	VdpPictureInfoH264 info;
+	VdpBitstreamBuffer buffer = { .struct_version = VDP_BITSTREAM_BUFFER_VERSION, .bitstream = slice, .bitstream_bytes = sizeof(slice) };
+	int i;
+
+	memset(&info, 0, sizeof(info));
+	for (i = 0; i < 16; i++)
+		info.referenceFrames[i].surface = VDP_INVALID_HANDLE;
+	info.slice_count = 1;
+	info.is_reference = 1;
+	info.num_ref_frames = 4;
+	info.frame_mbs_only_flag = 1;
+
+	return r.decoder_render(decoder, surface, (VdpPictureInfo const *)&info, 1, &buffer);
+}
+
+/*
+ * A seek drops the decoder state and decodes an IDR picture, a seek with
+ * a resolution change alternates between two sizes. Done with the flush
+ * and reconfigure extensions and with a new decoder for comparison, the
+ * first round checks every call and the size the decoder reports.
+ */
+static int bench_seek(VdpGetProcAddress *get_proc_address, int loops)
+{
+	VdpDecoderGetParameters *get_parameters;
+
+	if (!get_proc(get_proc_address, VDP_FUNC_ID_VIDEO_SURFACE_CREATE, &r.surface_create) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_VIDEO_SURFACE_DESTROY, &r.surface_destroy) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_DECODER_CREATE, &r.decoder_create) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_DECODER_DESTROY, &r.decoder_destroy) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_DECODER_RENDER, &r.decoder_render) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_DECODER_GET_PARAMETERS, &get_parameters) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_DECODER_FLUSH_SUNXI, &r.decoder_flush) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_DECODER_RECONFIGURE_SUNXI, &r.decoder_reconfigure))
+	{
+		fprintf(stderr, "driver misses decoder functions\n");
+		return 2;
+	}
+
+	enum { SEEK_FLUSH, SEEK_RECONFIGURE, SEEK_RECREATE, SEEK_RECREATE_RESIZE };
+	static const struct
+	{
+		const char *name;
+		int method;
+	} cases[] =
+	{
+		{ "flush", SEEK_FLUSH },
+		{ "reconfigure", SEEK_RECONFIGURE },
+		{ "recreate", SEEK_RECREATE },
+		{ "recreate size", SEEK_RECREATE_RESIZE },
+	};
+
+	static const uint32_t sizes[2][2] = { { 1920, 1088 }, { BENCH_WIDTH, BENCH_HEIGHT } };
+	const VdpDecoderProfile profile = VDP_DECODER_PROFILE_H264_HIGH;
+	VdpVideoSurface surface;
+	uint32_t c;
+	int errors = 0;
+
+	if (r.surface_create(r.device, VDP_CHROMA_TYPE_420, sizes[0][0], sizes[0][1], &surface) != VDP_STATUS_OK)
+	{
+		fprintf(stderr, "could not create the video surface\n");
+		return 2;
+	}
+
+	for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+	{
+		VdpDecoder decoder;
+		if (r.decoder_create(r.device, profile, sizes[0][0], sizes[0][1], 4, &decoder) != VDP_STATUS_OK)
+		{
+			fprintf(stderr, "%s: could not create the decoder\n", cases[c].name);
+			errors++;
+			continue;
+		}
+
+		uint64_t start = 0;
+		int l, k, failed = 0;
+		for (l = 0; l <= loops && decoder != VDP_INVALID_HANDLE; l++)
+		{
+			// the first round is checked, the others timed
+			if (l == 1)
+				start = now();
+
+			for (k = 0; k < BENCH_ROUNDS; k++)
+			{
+				const uint32_t *size = sizes[0];
+				if (cases[c].method == SEEK_RECONFIGURE || cases[c].method == SEEK_RECREATE_RESIZE)
+					size = sizes[(k + 1) % 2];
+
+				VdpStatus status;
+				switch (cases[c].method)
+				{
+				case SEEK_FLUSH:
+					status = r.decoder_flush(decoder);
+					break;
+				case SEEK_RECONFIGURE:
+					status = r.decoder_reconfigure(decoder, size[0], size[1]);
+					break;
+				default:
+					r.decoder_destroy(decoder);
+					status = r.decoder_create(r.device, profile, size[0], size[1], 4, &decoder);
+					if (status != VDP_STATUS_OK)
+						decoder = VDP_INVALID_HANDLE;
+					break;
+				}
+
+				if (status == VDP_STATUS_OK)
+					status = decode_idr(decoder, surface);
+
+				if (l == 0 && status == VDP_STATUS_OK)
+				{
+					VdpDecoderProfile p;
+					uint32_t w, h;
+					if (get_parameters(decoder, &p, &w, &h) != VDP_STATUS_OK || w != size[0] || h != size[1])
+						status = VDP_STATUS_ERROR;
+				}
+
+				if (status != VDP_STATUS_OK)
+				{
+					fprintf(stderr, "%s: seek %d failed\n", cases[c].name, k);
+					failed = 1;
+					break;
+				}
+			}
+
+			if (failed)
+				break;
+		}
+
+		if (failed)
+			errors++;
+		else
+			printf("%-14s %8.1f us per seek\n", cases[c].name,
+			       (now() - start) / 1000.0 / ((double)loops * BENCH_ROUNDS));
+
+		if (decoder != VDP_INVALID_HANDLE)
+			r.decoder_destroy(decoder);
+	}
+
+	r.surface_destroy(surface);
+	return errors ? 2 : 0;
+}
+
+#define SUB_WIDTH 256
+#define SUB_HEIGHT 64
+
+// what the target of the subtitle benchmark has to show
+typedef struct
+{
+	VdpOutputSurfacePutBitsNative *put_bits;
+	VdpOutputSurfaceGetBitsNative *get_bits;
+	VdpOutputSurfaceRenderOutputSurface *render;
+	VdpVideoMixerRender *mixer_render;
+	VdpVideoMixer mixer;
+	VdpVideoSurface video;
+	VdpOutputSurface target;
+	uint32_t *expected;
+	uint32_t *out;
+} subtitle_t;
+
+static void subtitle_fill(uint32_t *pixels, int seed)
+{
+	int i;
+	srand(seed);
+	for (i = 0; i < SUB_WIDTH * SUB_HEIGHT; i++)
+		pixels[i] = rand();
+}
+
+static void subtitle_copy(subtitle_t *s, const uint32_t *pixels, uint32_t width, uint32_t height, uint32_t x, uint32_t y)
+{
+	uint32_t i;
+	for (i = 0; i < height; i++)
+		memcpy(s->expected + (y + i) * BENCH_WIDTH + x, pixels + i * width, width * 4);
+}
+
+// the video starts a new frame and clears what was rendered onto the last one
+static void subtitle_frame(subtitle_t *s, VdpOutputSurface target)
+{
+	s->mixer_render(s->mixer, VDP_INVALID_HANDLE, NULL, VDP_VIDEO_MIXER_PICTURE_STRUCTURE_FRAME, 0, NULL, s->video,
+			0, NULL, NULL, target, NULL, NULL, 0, NULL);
+	if (target == s->target)
+		memset(s->expected, 0, BENCH_WIDTH * BENCH_HEIGHT * 4);
+}
+
+static void subtitle_render(subtitle_t *s, VdpOutputSurface target, VdpOutputSurface src, const uint32_t *pixels, uint32_t x, uint32_t y)
+{
+	VdpRect rect = { x, y, x + SUB_WIDTH, y + SUB_HEIGHT };
+	s->render(target, &rect, src, NULL, NULL, NULL, 0);
+	if (target == s->target)
+		subtitle_copy(s, pixels, SUB_WIDTH, SUB_HEIGHT, x, y);
+}
+
+static void subtitle_put(subtitle_t *s, VdpOutputSurface surface, const uint32_t *pixels, uint32_t x, uint32_t y)
+{
+	const void *data[1] = { pixels };
+	uint32_t pitch[1] = { SUB_WIDTH * 4 };
+	VdpRect rect = { x, y, x + SUB_WIDTH, y + SUB_HEIGHT };
+	s->put_bits(surface, data, pitch, &rect);
+	if (surface == s->target)
+		subtitle_copy(s, pixels, SUB_WIDTH, SUB_HEIGHT, x, y);
+}
+
+// reading the target back does what displaying it would, resolve pending clears
+static int subtitle_check(subtitle_t *s, const char *what)
+{
+	void *data[1] = { s->out };
+	uint32_t pitch[1] = { BENCH_WIDTH * 4 };
+
+	if (s->get_bits(s->target, NULL, data, pitch) != VDP_STATUS_OK ||
+	    memcmp(s->out, s->expected, BENCH_WIDTH * BENCH_HEIGHT * 4) != 0)
+	{
+		fprintf(stderr, "subtitle: %s differs\n", what);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Subtitles rendered over the video from two output surfaces. Renders
+ * that repeat the last frame's are skipped by the delayed clear, so the
+ * target is checked against what it has to show after repeated and
+ * changed renders, a source or the target written by the CPU, and
+ * surfaces destroyed while a clear is pending. Then frames with the
+ * same subtitle and with one that changes every frame are timed.
+ */
+static int bench_subtitle(VdpGetProcAddress *get_proc_address, int loops)
+{
+	VdpOutputSurfaceCreate *create;
+	VdpOutputSurfaceDestroy *destroy;
+	VdpVideoMixerCreate *mixer_create;
+	VdpVideoMixerDestroy *mixer_destroy;
+	subtitle_t s;
+
+	if (!get_proc(get_proc_address, VDP_FUNC_ID_OUTPUT_SURFACE_CREATE, &create) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_OUTPUT_SURFACE_DESTROY, &destroy) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_OUTPUT_SURFACE_PUT_BITS_NATIVE, &s.put_bits) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_OUTPUT_SURFACE_GET_BITS_NATIVE, &s.get_bits) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_OUTPUT_SURFACE_RENDER_OUTPUT_SURFACE, &s.render) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_VIDEO_SURFACE_CREATE, &r.surface_create) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_VIDEO_SURFACE_DESTROY, &r.surface_destroy) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_VIDEO_MIXER_CREATE, &mixer_create) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_VIDEO_MIXER_DESTROY, &mixer_destroy) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_VIDEO_MIXER_RENDER, &s.mixer_render))
+	{
+		fprintf(stderr, "driver misses output surface or mixer functions\n");
+		return 2;
+	}
+
+	VdpOutputSurface src[2], other;
+	if (create(r.device, VDP_RGBA_FORMAT_B8G8R8A8, BENCH_WIDTH, BENCH_HEIGHT, &s.target) != VDP_STATUS_OK ||
+	    create(r.device, VDP_RGBA_FORMAT_B8G8R8A8, SUB_WIDTH, SUB_HEIGHT, &src[0]) != VDP_STATUS_OK ||
+	    create(r.device, VDP_RGBA_FORMAT_B8G8R8A8, SUB_WIDTH, SUB_HEIGHT, &src[1]) != VDP_STATUS_OK ||
+	    r.surface_create(r.device, VDP_CHROMA_TYPE_420, BENCH_WIDTH, BENCH_HEIGHT, &s.video) != VDP_STATUS_OK ||
+	    mixer_create(r.device, 0, NULL, 0, NULL, NULL, &s.mixer) != VDP_STATUS_OK)
+	{
+		fprintf(stderr, "could not create the surfaces\n");
+		return 2;
+	}
+
+	uint32_t *pixels[2] = { malloc(SUB_WIDTH * SUB_HEIGHT * 4), malloc(SUB_WIDTH * SUB_HEIGHT * 4) };
+	uint32_t *changed = malloc(SUB_WIDTH * SUB_HEIGHT * 4);
+	s.expected = malloc(BENCH_WIDTH * BENCH_HEIGHT * 4);
+	s.out = malloc(BENCH_WIDTH * BENCH_HEIGHT * 4);
+	int errors = 0;
+
+	subtitle_fill(pixels[0], 3);
+	subtitle_fill(pixels[1], 4);
+	subtitle_fill(changed, 5);
+	subtitle_put(&s, src[0], pixels[0], 0, 0);
+	subtitle_put(&s, src[1], pixels[1], 0, 0);
+
+	subtitle_frame(&s, s.target);
+	subtitle_render(&s, s.target, src[0], pixels[0], 100, 600);
+	errors += subtitle_check(&s, "first frame");
+
+	subtitle_frame(&s, s.target);
+	subtitle_render(&s, s.target, src[0], pixels[0], 100, 600);
+	errors += subtitle_check(&s, "repeated render");
+
+	subtitle_frame(&s, s.target);
+	subtitle_render(&s, s.target, src[0], pixels[0], 100, 600);
+	subtitle_render(&s, s.target, src[1], pixels[1], 400, 600);
+	errors += subtitle_check(&s, "added render");
+
+	subtitle_frame(&s, s.target);
+	subtitle_render(&s, s.target, src[0], pixels[0], 100, 600);
+	errors += subtitle_check(&s, "dropped render");
+
+	subtitle_frame(&s, s.target);
+	subtitle_render(&s, s.target, src[0], pixels[0], 100, 500);
+	errors += subtitle_check(&s, "moved render");
+
+	// the same render of a source with new content
+	subtitle_frame(&s, s.target);
+	subtitle_render(&s, s.target, src[0], pixels[0], 100, 500);
+	subtitle_put(&s, src[0], changed, 0, 0);
+	errors += subtitle_check(&s, "source changed after the render");
+
+	subtitle_frame(&s, s.target);
+	subtitle_render(&s, s.target, src[0], changed, 100, 500);
+	errors += subtitle_check(&s, "changed source");
+
+	// CPU writes can't be replayed, the next clear has to happen
+	subtitle_frame(&s, s.target);
+	subtitle_render(&s, s.target, src[0], changed, 100, 500);
+	subtitle_put(&s, s.target, pixels[1], 800, 100);
+	errors += subtitle_check(&s, "cpu write");
+
+	subtitle_frame(&s, s.target);
+	subtitle_render(&s, s.target, src[0], changed, 100, 500);
+	errors += subtitle_check(&s, "after cpu write");
+
+	// a destroyed source leaves what was rendered from it
+	subtitle_frame(&s, s.target);
+	subtitle_render(&s, s.target, src[0], changed, 100, 500);
+	destroy(src[0]);
+	errors += subtitle_check(&s, "source destroyed");
+
+	create(r.device, VDP_RGBA_FORMAT_B8G8R8A8, SUB_WIDTH, SUB_HEIGHT, &src[0]);
+	subtitle_put(&s, src[0], pixels[0], 0, 0);
+
+	// a target destroyed with its clear pending has to leave the pending list
+	create(r.device, VDP_RGBA_FORMAT_B8G8R8A8, BENCH_WIDTH, BENCH_HEIGHT, &other);
+	subtitle_frame(&s, other);
+	subtitle_render(&s, other, src[1], pixels[1], 0, 0);
+	subtitle_frame(&s, other);
+	destroy(other);
+	subtitle_put(&s, src[1], pixels[1], 0, 0);
+
+	subtitle_frame(&s, s.target);
+	subtitle_render(&s, s.target, src[0], pixels[0], 100, 600);
+	subtitle_render(&s, s.target, src[1], pixels[1], 400, 600);
+	errors += subtitle_check(&s, "target destroyed");
+
+	uint64_t start = now();
+	int l, k;
+	for (l = 0; l < loops; l++)
+		for (k = 0; k < BENCH_ROUNDS; k++)
+		{
+			subtitle_frame(&s, s.target);
+			subtitle_render(&s, s.target, src[0], pixels[0], 100, 600);
+			subtitle_render(&s, s.target, src[1], pixels[1], 400, 600);
+		}
+	printf("%-14s %8.1f us per frame\n", "static", (now() - start) / 1000.0 / ((double)loops * BENCH_ROUNDS));
+
+	start = now();
+	for (l = 0; l < loops; l++)
+		for (k = 0; k < BENCH_ROUNDS; k++)
+		{
+			subtitle_put(&s, src[1], k % 2 ? pixels[1] : changed, 0, 0);
+			subtitle_frame(&s, s.target);
+			subtitle_render(&s, s.target, src[0], pixels[0], 100, 600);
+			subtitle_render(&s, s.target, src[1], k % 2 ? pixels[1] : changed, 400, 600);
+		}
+	printf("%-14s %8.1f us per frame\n", "changing", (now() - start) / 1000.0 / ((double)loops * BENCH_ROUNDS));
+	errors += subtitle_check(&s, "last frame");
+
+	free(s.out);
+	free(s.expected);
+	free(changed);
+	free(pixels[1]);
+	free(pixels[0]);
+	mixer_destroy(s.mixer);
+	r.surface_destroy(s.video);
+	destroy(src[1]);
+	destroy(src[0]);
+	destroy(s.target);
+	return errors ? 2 : 0;
+}
+
+static const struct
+{
+	const char *name;
+	int (*run)(VdpGetProcAddress *get_proc_address, int loops);
+	// output surfaces only get memory with VDPAU_OSD=1
+	int osd;
+} benchmarks[] =
+{
+	{ "osd", bench_osd, 1 },
+	{ "readback", bench_readback, 0 },
+	{ "seek", bench_seek, 0 },
+	{ "subtitle", bench_subtitle, 1 },
+};
+
+static int benchmark(const char *name, int loops)
+{
+	unsigned int i;
+	for (i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++)
+		if (strcmp(name, benchmarks[i].name) == 0)
+			break;
+
+	if (i == sizeof(benchmarks) / sizeof(benchmarks[0]))
+	{
+		fprintf(stderr, "no benchmark %s\n", name);
+		return 1;
+	}
+
+	if (benchmarks[i].osd)
+		setenv("VDPAU_OSD", "1", 1);
+
+	VdpGetProcAddress *get_proc_address;
+	if (vdp_imp_device_create_sunxi(&r.device, &get_proc_address) != VDP_STATUS_OK)
+	{
+		fprintf(stderr, "could not create the device\n");
+		return 1;
+	}
+
+	int ret = benchmarks[i].run(get_proc_address, loops);
+
+	VdpDeviceDestroy *device_destroy;
+	if (get_proc(get_proc_address, VDP_FUNC_ID_DEVICE_DESTROY, &device_destroy))
+		device_destroy(r.device);
+
+	return ret;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-r fps] [-l loops] trace\n", name);
+	fprintf(stderr, "       %s [-l loops] -b benchmark\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+	double fps = 0.0;
+	int loops = 1;
+	const char *bench = NULL;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "r:l:b:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'r':
+			fps = atof(optarg);
+			break;
+		case 'l':
+			loops = atoi(optarg);
+			break;
+		case 'b':
+			bench = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (bench && optind == argc)
+		return benchmark(bench, loops);
+
+	if (bench || optind != argc - 1)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	int fd = open(argv[optind], O_RDONLY);
+	struct stat st;
+	if (fd == -1 || fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(capture_header_t))
+	{
+		fprintf(stderr, "could not open %s\n", argv[optind]);
+		return 1;
+	}
+
+	const uint8_t *trace = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (trace == MAP_FAILED)
+	{
+		fprintf(stderr, "could not map %s\n", argv[optind]);
+		return 1;
+	}
+
+	const capture_header_t *header = (const capture_header_t *)trace;
+	if (header->magic != CAPTURE_MAGIC || header->version != CAPTURE_VERSION)
+	{
+		fprintf(stderr, "%s is no trace of this version\n", argv[optind]);
+		return 1;
+	}
+
+	VdpGetProcAddress *get_proc_address;
+	if (vdp_imp_device_create_sunxi(&r.device, &get_proc_address) != VDP_STATUS_OK)
+	{
+		fprintf(stderr, "could not create the device\n");
+		return 1;
+	}
+
+	if (!get_proc(get_proc_address, VDP_FUNC_ID_VIDEO_SURFACE_CREATE, &r.surface_create) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_VIDEO_SURFACE_DESTROY, &r.surface_destroy) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_DECODER_CREATE, &r.decoder_create) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_DECODER_DESTROY, &r.decoder_destroy) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_DECODER_RENDER, &r.decoder_render) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_DECODER_FLUSH_SUNXI, &r.decoder_flush) ||
+	    !get_proc(get_proc_address, VDP_FUNC_ID_DECODER_RECONFIGURE_SUNXI, &r.decoder_reconfigure))
+	{
+		fprintf(stderr, "driver misses decoder functions\n");
+		return 1;
+	}
+
+	double cpu = cpu_seconds();
+	uint64_t start = now();
+	int i;
+	for (i = 0; i < loops; i++)
+		replay(trace, st.st_size, fps);
+	double wall = (now() - start) / 1000000000.0;
+	cpu = cpu_seconds() - cpu;
+
+	VdpDeviceDestroy *device_destroy;
+	if (get_proc(get_proc_address, VDP_FUNC_ID_DEVICE_DESTROY, &device_destroy))
+		device_destroy(r.device);
+
+	if (r.frames == 0)
+	{
+		fprintf(stderr, "no frames decoded, %d errors\n", r.errors);
+		return 1;
+	}
+
+	qsort(r.latencies, r.frames, sizeof(*r.latencies), compare);
+
+	printf("frames:  %d (%d errors)\n", r.frames, r.errors);
+	printf("time:    %.3f s, %.2f fps\n", wall, r.frames / wall);
+	printf("latency: p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+	       percentile(0.5), percentile(0.9), percentile(0.99), percentile(1.0));
+	printf("cpu:     %.3f s, %.1f %% of one core, %.3f ms per frame\n",
+	       cpu, 100.0 * cpu / wall, 1000.0 * cpu / r.frames);
+
+	free(r.latencies);
+	free(r.surfaces);
+	free(r.decoders);
+	munmap((void *)trace, st.st_size);
+	return r.errors ? 2 : 0;
+}
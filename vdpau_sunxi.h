@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __VDPAU_SUNXI_H__
+#define __VDPAU_SUNXI_H__
+
+#include <vdpau/vdpau.h>
+
+/*
+ * Extensions to VDPAU provided by this driver, function pointers are
+ * retrieved with VdpGetProcAddress.
+ */
+
+// not part of VDPAU, complete JPEG pictures are passed as bitstream
+#define VDP_DECODER_PROFILE_SUNXI_MJPEG (VdpDecoderProfile)0x4a504700
+// not part of VDPAU, complete VP8 frames are passed as bitstream
+#define VDP_DECODER_PROFILE_SUNXI_VP8 (VdpDecoderProfile)0x56503800
+
+/*
+ * Create a device without an X server, for decoding and reading the
+ * surfaces back. libvdpau always wants a Display, so load
+ * libvdpau_sunxi.so.1 with dlopen and look this up with dlsym. Only the
+ * VE is opened, the display driver is opened if a presentation queue
+ * target is created later.
+ */
+typedef VdpStatus VdpDeviceCreateSunxi(VdpDevice *device, VdpGetProcAddress **get_proc_address);
+#define VDP_DEVICE_CREATE_SUNXI_SYMBOL "vdp_imp_device_create_sunxi"
+
+#define VDP_FUNC_ID_VIDEO_SURFACE_ATTACH_SCALED_SUNXI (VDP_FUNC_ID_BASE_DRIVER + 0)
+#define VDP_FUNC_ID_VIDEO_SURFACE_SET_ROTATION_SUNXI (VDP_FUNC_ID_BASE_DRIVER + 1)
+#define VDP_FUNC_ID_VIDEO_SURFACE_EXPORT_SUNXI (VDP_FUNC_ID_BASE_DRIVER + 2)
+#define VDP_FUNC_ID_VIDEO_SURFACE_EXPORT_RELEASE_SUNXI (VDP_FUNC_ID_BASE_DRIVER + 3)
+#define VDP_FUNC_ID_DECODER_RENDER_ASYNC_SUNXI (VDP_FUNC_ID_BASE_DRIVER + 4)
+#define VDP_FUNC_ID_DEVICE_COMPLETION_FD_SUNXI (VDP_FUNC_ID_BASE_DRIVER + 5)
+#define VDP_FUNC_ID_DEVICE_COLLECT_COMPLETIONS_SUNXI (VDP_FUNC_ID_BASE_DRIVER + 6)
+#define VDP_FUNC_ID_DECODER_FLUSH_SUNXI (VDP_FUNC_ID_BASE_DRIVER + 7)
+#define VDP_FUNC_ID_DECODER_RECONFIGURE_SUNXI (VDP_FUNC_ID_BASE_DRIVER + 8)
+#define VDP_FUNC_ID_DEVICE_TIMELINE_FLUSH_SUNXI (VDP_FUNC_ID_BASE_DRIVER + 9)
+
+/*
+ * Attach a second video surface to surface, which gets a 1/2 or 1/4
+ * scaled copy of every frame decoded into surface. The ratio is taken
+ * from the size of scaled, (width + 1) / 2 x (height + 1) / 2 or
+ * (width + 3) / 4 x (height + 3) / 4. Pass VDP_INVALID_HANDLE as
+ * scaled to detach.
+ * Supported for H.264 and, on VE 0x1680 and later, MPEG-1/2. Other
+ * decoders leave scaled untouched.
+ */
+typedef VdpStatus VdpVideoSurfaceAttachScaledSunxi(VdpVideoSurface surface, VdpVideoSurface scaled);
+
+#define VDP_SUNXI_ROTATION_NONE   0
+#define VDP_SUNXI_ROTATION_90     1
+#define VDP_SUNXI_ROTATION_180    2
+#define VDP_SUNXI_ROTATION_270    3
+#define VDP_SUNXI_ROTATION_FLIP_H 4
+#define VDP_SUNXI_ROTATION_FLIP_V 5
+
+/*
+ * Let the decoder write a rotated (clockwise) or mirrored copy of every
+ * frame decoded into surface. The surface itself keeps the unrotated
+ * picture for reference, the presentation queue and the GL interop
+ * show the rotated copy, with width and height swapped for 90 and 270.
+ * Supported where the scaled output is, an attached scaled surface
+ * takes precedence over rotation. Frames of the other decoders and of
+ * put_bits are shown unrotated.
+ */
+typedef VdpStatus VdpVideoSurfaceSetRotationSunxi(VdpVideoSurface surface, uint32_t rotation);
+
+// DRM fourccs and modifiers, as in drm_fourcc.h
+#define VDP_SUNXI_FOURCC(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+#define VDP_SUNXI_FOURCC_NV12   VDP_SUNXI_FOURCC('N', 'V', '1', '2')
+#define VDP_SUNXI_FOURCC_NV16   VDP_SUNXI_FOURCC('N', 'V', '1', '6')
+#define VDP_SUNXI_FOURCC_YUV420 VDP_SUNXI_FOURCC('Y', 'U', '1', '2')
+#define VDP_SUNXI_FOURCC_YUYV   VDP_SUNXI_FOURCC('Y', 'U', 'Y', 'V')
+#define VDP_SUNXI_FOURCC_UYVY   VDP_SUNXI_FOURCC('U', 'Y', 'V', 'Y')
+
+#define VDP_SUNXI_MODIFIER_LINEAR 0ULL
+// DRM_FORMAT_MOD_ALLWINNER_TILED, 32x32 tiles of luma and 32x32 tiles of CbCr pairs
+#define VDP_SUNXI_MODIFIER_TILED ((0x09ULL << 56) | 1)
+
+#define VDP_SUNXI_EXPORT_PLANES 3
+
+// every plane has a DMA-BUF
+#define VDP_SUNXI_EXPORT_FLAG_DMABUF (1 << 0)
+
+typedef struct
+{
+	// pass to VdpVideoSurfaceExportReleaseSunxi once the consumer is done
+	uint32_t handle;
+	uint32_t flags;
+	uint32_t fourcc;
+	uint64_t modifier;
+	uint32_t width;
+	uint32_t height;
+	uint32_t num_planes;
+	struct
+	{
+		// DMA-BUF of the plane's buffer, owned by the caller, -1 without VDP_SUNXI_EXPORT_FLAG_DMABUF
+		int fd;
+		uint32_t offset;
+		uint32_t pitch;
+		uint32_t size;
+		// for consumers that take physical addresses
+		uint32_t phys_addr;
+	} planes[VDP_SUNXI_EXPORT_PLANES];
+} VdpVideoSurfaceExportInfoSunxi;
+
+/*
+ * Describe the planes of surface as the decoder or put_bits wrote them,
+ * unrotated, for handing them to other hardware without a copy. Each
+ * plane is its own buffer. The planes stay allocated until the export
+ * is released, even if the surface is destroyed meanwhile, so release
+ * every export by its handle once the consumer is done with the frame.
+ * Decoding into the surface again overwrites the planes.
+ *
+ * Where the memory can't be exported as DMA-BUFs, which is the case with
+ * UMP and the cedar_dev memory, VDP_SUNXI_EXPORT_FLAG_DMABUF is clear and
+ * the consumer has only the physical addresses.
+ */
+typedef VdpStatus VdpVideoSurfaceExportSunxi(VdpVideoSurface surface, VdpVideoSurfaceExportInfoSunxi *info);
+typedef VdpStatus VdpVideoSurfaceExportReleaseSunxi(uint32_t export);
+
+#define VDP_SUNXI_COMPLETION_DECODED   0
+#define VDP_SUNXI_COMPLETION_DISPLAYED 1
+
+typedef struct
+{
+	uint32_t type;
+	VdpStatus status;
+	// the video surface decoded into or the output surface displayed
+	uint32_t surface;
+	VdpTime time;
+} VdpCompletionSunxi;
+
+/*
+ * Like VdpDecoderRender, but returns once picture_info and the
+ * bitstream are copied. A worker of the device decodes the renders in
+ * order and posts a VDP_SUNXI_COMPLETION_DECODED with the result for
+ * each. At most 32 renders may be pending or uncollected, further ones
+ * fail with VDP_STATUS_RESOURCES. Destroying a decoder or surface
+ * waits for the pending renders.
+ */
+typedef VdpStatus VdpDecoderRenderAsyncSunxi(VdpDecoder decoder, VdpVideoSurface target, VdpPictureInfo const *picture_info, uint32_t bitstream_buffer_count, VdpBitstreamBuffer const *bitstream_buffers);
+
+/*
+ * An eventfd of the device, readable while completions are waiting to
+ * be collected. Once it was asked for, presentation queue displays
+ * post VDP_SUNXI_COMPLETION_DISPLAYED as well. The device owns it.
+ */
+typedef VdpStatus VdpDeviceCompletionFdSunxi(VdpDevice device, int *fd);
+
+// takes up to max completions without blocking
+typedef VdpStatus VdpDeviceCollectCompletionsSunxi(VdpDevice device, VdpCompletionSunxi *completions, uint32_t max, uint32_t *count);
+
+/*
+ * For seeks, drops the state earlier pictures left in the decoder, like
+ * references the codec tracks itself. Waits for pending asynchronous
+ * renders. The next picture should be a random access point.
+ */
+typedef VdpStatus VdpDecoderFlushSunxi(VdpDecoder decoder);
+
+/*
+ * Flushes and changes the picture size of a decoder, for resolution
+ * changes within a stream. The buffers are kept when they are big
+ * enough, reallocated otherwise. The profile stays the same. If the
+ * reallocation fails the decoder keeps its old size and returns
+ * VDP_STATUS_RESOURCES.
+ */
+typedef VdpStatus VdpDecoderReconfigureSunxi(VdpDecoder decoder, uint32_t width, uint32_t height);
+
+/*
+ * Writes the events recorded so far to the VDPAU_TIMELINE file,
+ * replacing what an earlier flush wrote, so a player can save the
+ * moments around a stutter while it keeps running. Does nothing
+ * without VDPAU_TIMELINE, returns VDP_STATUS_ERROR if the file can't
+ * be written.
+ */
+typedef VdpStatus VdpDeviceTimelineFlushSunxi(VdpDevice device);
+
+#endif
@@ -17,6 +17,8 @@
  *
  */
 
+#define _GNU_SOURCE
+#include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
 #include <stdint.h>
@@ -25,9 +27,13 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 #include "ve.h"
+#include "timeline.h"
+#include "logger.h"
 #include <string.h>
 #include <math.h>
+#include <time.h>
 
 #if defined(VALGRIND_DEBUG)
 #include <valgrind/ammt_reqs.h>
@@ -37,6 +43,33 @@
 #define PAGE_OFFSET (0xc0000000) // from kernel
 #define PAGE_SIZE (4096)
 
+// reserved memory of the fake engine, at a made up physical address
+#define FAKE_MEM_PHYS (0x10000000)
+#define FAKE_MEM_SIZE (96 * 1024 * 1024)
+
+// from linux/udmabuf.h, turns a range of a sealed memfd into a DMA-BUF
+struct udmabuf_create
+{
+	uint32_t memfd;
+	uint32_t flags;
+	uint64_t offset;
+	uint64_t size;
+};
+
+// default range of the clock governor, VDPAU_VE_FREQ overrides it
+#define GOVERNOR_MIN_MHZ 120
+#define GOVERNOR_MAX_MHZ 320
+#define GOVERNOR_STEP_MHZ 24
+#define GOVERNOR_PERIOD_MS 250
+#define GOVERNOR_IDLE_MS 2000
+// percent of the period the engine is held
+#define GOVERNOR_UP 80
+#define GOVERNOR_TARGET 60
+#define GOVERNOR_DOWN 35
+
+#define UDMABUF_FLAGS_CLOEXEC 0x01
+#define UDMABUF_CREATE _IOW('u', 0x42, struct udmabuf_create)
+
 enum IOCTL_CMD
 {
 	IOCTL_UNKOWN = 0x100,
@@ -97,14 +130,21 @@ static struct ve_dev
 #if USE_UMP == 0
 	struct memchunk_t first_memchunk;
 	pthread_rwlock_t memory_lock;
+	void *fake_mem;
+	int fake_memfd;
 #endif
 	pthread_mutex_t device_lock;
+	// what cedarv_get() selected, restored after a reset
+	uint32_t ctrl;
+	cedarv_hang_stats_t hangs;
+	int fake;
     int initialized;
     unsigned int refCnt;
     int reservedEngine;
 } ve = { .fd = -1, 
 #if USE_UMP == 0
 	.memory_lock = PTHREAD_RWLOCK_INITIALIZER, 
+	.fake_memfd = -1,
 #endif
         .device_lock = PTHREAD_MUTEX_INITIALIZER,
         .initialized = 0,
@@ -127,23 +167,193 @@ int cedarv_allocateEngine(int engine)
   return status;
 }
 
+/*
+ * Clock governor. The time between cedarv_get() and cedarv_put() is
+ * summed up, all streams share the engine so that load is what they
+ * need together to keep up with their frame rates. Every period the
+ * frequency is scaled to bring the load back to GOVERNOR_TARGET when it
+ * left the band between GOVERNOR_DOWN and GOVERNOR_UP. An engine that
+ * had nothing to do for GOVERNOR_IDLE_MS is switched off and reset on
+ * its next use. The governor thread runs with the device lock, so the
+ * clock never changes during a job.
+ */
+
+static struct
+{
+	pthread_t thread;
+	pthread_cond_t cond;
+	int started;
+	int quit;
+	int min, max;
+	int freq;
+	int powered;
+	int idle_ms;
+	uint64_t job_start;
+	uint64_t busy;
+	uint64_t last_tick;
+} governor = {
+	.min = GOVERNOR_MIN_MHZ,
+	.max = GOVERNOR_MAX_MHZ,
+	.freq = GOVERNOR_MAX_MHZ,
+	.powered = 1,
+};
+
+static uint64_t governor_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// VDPAU_VE_FREQ=<MHz> fixes the clock, <min>-<max> sets the range
+static void governor_init(void)
+{
+	char *env_freq = getenv("VDPAU_VE_FREQ");
+	if (env_freq)
+	{
+		char *end;
+		int min = strtol(env_freq, &end, 10);
+		int max = (*end == '-') ? strtol(end + 1, NULL, 10) : min;
+		if (min > 0 && max >= min)
+		{
+			governor.min = min;
+			governor.max = max;
+		}
+	}
+
+	// starts fast, the first frames shouldn't wait for the governor
+	governor.freq = governor.max;
+	governor.powered = 1;
+}
+
 int cedarv_VeReset()
 {
   if(ve.version < 0x1639) 
   {
     ioctl(ve.fd, IOCTL_ENABLE_VE, 0);
-    ioctl(ve.fd, IOCTL_SET_VE_FREQ, 320);
+    ioctl(ve.fd, IOCTL_SET_VE_FREQ, governor.freq);
     ioctl(ve.fd, IOCTL_RESET_VE, 0);
   }
   else
   {
     ioctl(ve.fd, IOCTL_ENABLE_VE_DISP2, 0);
-    ioctl(ve.fd, IOCTL_SET_VE_FREQ_DISP2, 320);
+    ioctl(ve.fd, IOCTL_SET_VE_FREQ_DISP2, governor.freq);
     ioctl(ve.fd, IOCTL_RESET_VE_DISP2, 0);
   }
+  governor.powered = 1;
   return 0;
 }
 
+static void governor_set_freq(int freq)
+{
+	if (ve.version < 0x1639)
+		ioctl(ve.fd, IOCTL_SET_VE_FREQ, freq);
+	else
+		ioctl(ve.fd, IOCTL_SET_VE_FREQ_DISP2, freq);
+
+	log_debug("VE clock %d -> %d MHz", governor.freq, freq);
+	governor.freq = freq;
+}
+
+static void governor_power_down(void)
+{
+	if (ve.version < 0x1639)
+		ioctl(ve.fd, IOCTL_DISABLE_VE, 0);
+	else
+		ioctl(ve.fd, IOCTL_DISABLE_VE_DISP2, 0);
+
+	log_debug("VE idle, clock off");
+	governor.powered = 0;
+}
+
+static void governor_tick(void)
+{
+	uint64_t now = governor_time();
+	uint64_t period = now - governor.last_tick;
+	governor.last_tick = now;
+
+	if (!governor.busy)
+	{
+		if (!governor.powered)
+			return;
+		governor.idle_ms += period / 1000000;
+		if (governor.idle_ms >= GOVERNOR_IDLE_MS)
+			governor_power_down();
+		else if (governor.freq != governor.min)
+			governor_set_freq(governor.min);
+		return;
+	}
+
+	uint32_t load = governor.busy * 100 / period;
+	governor.busy = 0;
+	governor.idle_ms = 0;
+	if (load >= GOVERNOR_DOWN && load <= GOVERNOR_UP)
+		return;
+
+	int freq = (uint64_t)governor.freq * load / GOVERNOR_TARGET;
+	freq = (freq + GOVERNOR_STEP_MHZ - 1) / GOVERNOR_STEP_MHZ * GOVERNOR_STEP_MHZ;
+	if (freq < governor.min)
+		freq = governor.min;
+	if (freq > governor.max)
+		freq = governor.max;
+	if (freq != governor.freq)
+		governor_set_freq(freq);
+}
+
+static void *governor_thread(void *arg)
+{
+	struct timespec ts;
+
+	pthread_mutex_lock(&ve.device_lock);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	governor.last_tick = governor_time();
+	while (!governor.quit)
+	{
+		ts.tv_nsec += GOVERNOR_PERIOD_MS * 1000000;
+		ts.tv_sec += ts.tv_nsec / 1000000000;
+		ts.tv_nsec %= 1000000000;
+		if (pthread_cond_timedwait(&governor.cond, &ve.device_lock, &ts) == ETIMEDOUT)
+			governor_tick();
+	}
+	pthread_mutex_unlock(&ve.device_lock);
+	return NULL;
+}
+
+// called with the device lock
+static void governor_start(void)
+{
+	pthread_condattr_t attr;
+
+	if (governor.min == governor.max)
+		return;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&governor.cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	governor.quit = 0;
+	governor.busy = 0;
+	governor.idle_ms = 0;
+	governor.started = (pthread_create(&governor.thread, NULL, governor_thread, NULL) == 0);
+	if (!governor.started)
+		pthread_cond_destroy(&governor.cond);
+}
+
+static void governor_stop(void)
+{
+	if (!governor.started)
+		return;
+
+	pthread_mutex_lock(&ve.device_lock);
+	governor.quit = 1;
+	pthread_cond_signal(&governor.cond);
+	pthread_mutex_unlock(&ve.device_lock);
+	pthread_join(governor.thread, NULL);
+	pthread_cond_destroy(&governor.cond);
+	governor.started = 0;
+}
+
 int cedarv_freeEngine()
 {
   int status = 1;
@@ -155,6 +365,61 @@ int cedarv_freeEngine()
   return status;
 }
 
+/*
+ * VDPAU_FAKE_VE=<version> runs without /dev/cedar_dev, for replaying
+ * traces on machines without the engine. The registers are plain memory,
+ * so the codecs find every status bit clear, every wait succeeds at once
+ * and the surfaces keep whatever was in them. Without UMP the reserved
+ * memory is an anonymous mapping.
+ */
+static int cedarv_open_fake(const char *version)
+{
+	// a real fd, the ioctls fail on it and change nothing
+	ve.fd = open("/dev/null", O_RDWR);
+	if (ve.fd == -1)
+		return 0;
+
+	ve.regs = calloc(1, 0x800);
+	if (!ve.regs)
+		goto err;
+
+#if USE_UMP == 0
+	// backed by a memfd if possible, udmabuf exports from those
+	ve.fake_memfd = syscall(SYS_memfd_create, "cedar_fake", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (ve.fake_memfd != -1 && (ftruncate(ve.fake_memfd, FAKE_MEM_SIZE) == -1 ||
+	    fcntl(ve.fake_memfd, F_ADD_SEALS, F_SEAL_SHRINK) == -1))
+	{
+		close(ve.fake_memfd);
+		ve.fake_memfd = -1;
+	}
+
+	if (ve.fake_memfd != -1)
+		ve.fake_mem = mmap(NULL, FAKE_MEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, ve.fake_memfd, 0);
+	else
+		ve.fake_mem = mmap(NULL, FAKE_MEM_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ve.fake_mem == MAP_FAILED)
+	{
+		ve.fake_mem = NULL;
+		if (ve.fake_memfd != -1)
+			close(ve.fake_memfd);
+		ve.fake_memfd = -1;
+		free(ve.regs);
+		goto err;
+	}
+	ve.first_memchunk.phys_addr = FAKE_MEM_PHYS;
+	ve.first_memchunk.size = FAKE_MEM_SIZE;
+#endif
+
+	writel(strtoul(version, NULL, 16) << 16, ve.regs + CEDARV_VERSION);
+	ve.fake = 1;
+	return 1;
+
+err:
+	close(ve.fd);
+	ve.fd = -1;
+	return 0;
+}
+
 int cedarv_open(void)
 {
         if (pthread_mutex_lock(&ve.device_lock))
@@ -169,6 +434,22 @@ int cedarv_open(void)
 
              struct ve_info info;
 
+             timeline_init();
+             logger_init();
+             governor_init();
+
+             char *env_fake = getenv("VDPAU_FAKE_VE");
+             if (env_fake)
+             {
+                 if (!cedarv_open_fake(env_fake))
+                 {
+                     printf("could not set up the fake engine\n");
+                     pthread_mutex_unlock(&ve.device_lock);
+                     return 0;
+                 }
+                 goto opened;
+             }
+
              ve.fd = open(DEVICE, O_RDWR);
 	     if (ve.fd == -1)
              {
@@ -201,6 +482,7 @@ int cedarv_open(void)
 
              ioctl(ve.fd, IOCTL_ENGINE_REQ, 0);
 
+opened:
              ve.version = readl(ve.regs + CEDARV_VERSION) >> 16;
 
          cedarv_VeReset();
@@ -214,6 +496,7 @@ int cedarv_open(void)
 	          goto err;
 	     }
 #endif
+             governor_start();
              ve.initialized = 1;
         }
         ve.refCnt ++;
@@ -236,6 +519,8 @@ void cedarv_close(void)
 	    if (ve.fd == -1)
 		return;
 
+            governor_stop();
+
             if (ve.version < 1639)
                ioctl(ve.fd, IOCTL_DISABLE_VE, 0);
             else
@@ -243,7 +528,20 @@ void cedarv_close(void)
 
 	    ioctl(ve.fd, IOCTL_ENGINE_REL, 0);
 
-	    munmap(ve.regs, 0x800);
+	    if (ve.fake)
+	    {
+		free(ve.regs);
+#if USE_UMP == 0
+		munmap(ve.fake_mem, FAKE_MEM_SIZE);
+		ve.fake_mem = NULL;
+		if (ve.fake_memfd != -1)
+			close(ve.fake_memfd);
+		ve.fake_memfd = -1;
+#endif
+		ve.fake = 0;
+	    }
+	    else
+		munmap(ve.regs, 0x800);
 	    ve.regs = NULL;
 
 	    close(ve.fd);
@@ -252,6 +550,8 @@ void cedarv_close(void)
 	    ump_close();
 #endif
             ve.initialized = 0;
+            timeline_flush();
+            logger_close();
         }
 }
 
@@ -260,15 +560,80 @@ int cedarv_get_version(void)
 	return ve.version;
 }
 
+/*
+ * Hang watchdog. A job that doesn't finish within the wait timeout, or
+ * a register poll that never ends, resets the engine while the caller
+ * still holds it. The rest of that frame is skipped and the render
+ * fails, the next job finds a clean engine.
+ */
+
+// set for the thread whose job hung, until cedarv_take_hang()
+static __thread int job_hung;
+
+void cedarv_hang(const char *where)
+{
+	struct timespec ts;
+
+	if (job_hung)
+		return;
+	job_hung = 1;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ve.hangs.hangs++;
+	ve.hangs.last_hang = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+	log_error("VE hang in %s, resetting the engine", where);
+
+	if (ve.fake)
+		return;
+
+	cedarv_VeReset();
+	ve.hangs.resets++;
+	writel(ve.ctrl, ve.regs + CEDARV_CTRL);
+}
+
+int cedarv_job_hung(void)
+{
+	return job_hung;
+}
+
+int cedarv_take_hang(void)
+{
+	int hung = job_hung;
+	job_hung = 0;
+	return hung;
+}
+
+void cedarv_get_hang_stats(cedarv_hang_stats_t *stats)
+{
+	pthread_mutex_lock(&ve.device_lock);
+	*stats = ve.hangs;
+	pthread_mutex_unlock(&ve.device_lock);
+}
+
 int cedarv_wait(int timeout)
 {
 	if (ve.fd == -1)
 		return -1;
 
+	if (ve.fake)
+		return 1;
+
+	// nothing was started after a reset in this job
+	if (job_hung)
+		return 0;
+
+	int ret;
+	TIMELINE_BEGIN("cedarv_wait");
 	if (ve.version < 1669)
-		return ioctl(ve.fd, IOCTL_WAIT_VE, timeout);
+		ret = ioctl(ve.fd, IOCTL_WAIT_VE, timeout);
 	else
-		return ioctl(ve.fd, IOCTL_WAIT_VE_DE_DISP2, timeout);
+		ret = ioctl(ve.fd, IOCTL_WAIT_VE_DE_DISP2, timeout);
+	TIMELINE_END("cedarv_wait");
+
+	if (ret <= 0)
+		cedarv_hang("cedarv_wait");
+
+	return ret;
 }
 
 void *cedarv_get(int engine, uint32_t flags)
@@ -276,14 +641,24 @@ void *cedarv_get(int engine, uint32_t flags)
 	if (pthread_mutex_lock(&ve.device_lock))
 		return NULL;
 
-	writel(0x00130000 | (engine & 0xf) | (flags & ~0xf), ve.regs + CEDARV_CTRL);
+	if (!governor.powered)
+	{
+		governor.freq = governor.max;
+		cedarv_VeReset();
+	}
+	governor.job_start = governor_time();
+
+	ve.ctrl = 0x00130000 | (engine & 0xf) | (flags & ~0xf);
+	writel(ve.ctrl, ve.regs + CEDARV_CTRL);
 
 	return ve.regs;
 }
 
 void cedarv_put(void)
 {
-	writel(0x00130007, ve.regs + CEDARV_CTRL);
+	governor.busy += governor_time() - governor.job_start;
+	ve.ctrl = 0x00130007;
+	writel(ve.ctrl, ve.regs + CEDARV_CTRL);
 	pthread_mutex_unlock(&ve.device_lock);
 }
 
@@ -293,24 +668,33 @@ void* cedarv_get_regs()
 }
 #if USE_UMP
 
-CEDARV_MEMORY cedarv_malloc(int size)
+// cached for buffers mostly written and read by the CPU, needs flushing
+static CEDARV_MEMORY raw_malloc(int size, int cached)
 {
   CEDARV_MEMORY mem;
-  mem.mem_id = ump_ref_drv_allocate (size, UMP_REF_DRV_CONSTRAINT_PHYSICALLY_LINEAR);
-  if(mem.mem_id == UMP_INVALID_MEMORY_HANDLE)
-  {
-    printf("could not allocate ump buffer!\n");
-    exit(1);
-  }
+  ump_alloc_constraints constraints = UMP_REF_DRV_CONSTRAINT_PHYSICALLY_LINEAR;
+  if (cached)
+    constraints |= UMP_REF_DRV_CONSTRAINT_USE_CACHE;
+  mem.mem_id = ump_ref_drv_allocate (size, constraints);
   return mem;
 }
 
+static const void *memory_key(CEDARV_MEMORY mem)
+{
+  return mem.mem_id;
+}
+
+static size_t memory_size(CEDARV_MEMORY mem, int size)
+{
+  return ump_size_get(mem.mem_id);
+}
+
 int cedarv_isValid(CEDARV_MEMORY mem)
 {
   return (mem.mem_id != UMP_INVALID_MEMORY_HANDLE);
 }
 
-void cedarv_free(CEDARV_MEMORY mem)
+static void raw_free(CEDARV_MEMORY mem)
 {
   ump_reference_release(mem.mem_id);
 }
@@ -324,6 +708,11 @@ void cedarv_flush_cache(CEDARV_MEMORY mem, int len)
 {
   ump_cpu_msync_now(mem.mem_id, UMP_MSYNC_CLEAN_AND_INVALIDATE, 0, len);
 }
+void cedarv_flush_cache_range(CEDARV_MEMORY mem, size_t offset, int len)
+{
+  char *ptr = (char*)ump_mapped_pointer_get(mem.mem_id);
+  ump_cpu_msync_now(mem.mem_id, UMP_MSYNC_CLEAN_AND_INVALIDATE, ptr + offset, len);
+}
 void cedarv_memcpy(CEDARV_MEMORY dst, size_t offset, const void * src, size_t len)
 {
   ump_write(dst.mem_id, offset, src, len);
@@ -349,6 +738,12 @@ size_t cedarv_getSize(CEDARV_MEMORY mem)
   return ump_size_get(mem.mem_id);
 }
 
+// UMP only shares buffers by secure id
+int cedarv_export_dmabuf(CEDARV_MEMORY mem)
+{
+  return -1;
+}
+
 void cedarv_setBufferInvalid(CEDARV_MEMORY mem)
 {
   mem.mem_id = UMP_INVALID_MEMORY_HANDLE;
@@ -356,7 +751,8 @@ void cedarv_setBufferInvalid(CEDARV_MEMORY mem)
 
 #else
 
-void *cedarv_malloc(int size)
+// the cedar_dev reserved memory is always mapped cached
+static void *raw_malloc(int size, int cached)
 {
 	if (ve.fd == -1)
 		return NULL;
@@ -385,7 +781,10 @@ void *cedarv_malloc(int size)
 
 	int left_size = best_chunk->size - size;
 
-	addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, ve.fd, best_chunk->phys_addr + PAGE_OFFSET);
+	if (ve.fake_mem)
+		addr = ve.fake_mem + (best_chunk->phys_addr - FAKE_MEM_PHYS);
+	else
+		addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, ve.fd, best_chunk->phys_addr + PAGE_OFFSET);
 	if (addr == MAP_FAILED)
 	{
 		addr = NULL;
@@ -410,11 +809,22 @@ out:
 	return addr;
 }
 
+static const void *memory_key(void *mem)
+{
+	return mem;
+}
+
+static size_t memory_size(void *mem, int size)
+{
+	return (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+}
+
 int cedarv_isValid(void* mem)
 {
   return mem != NULL;
 }
-void cedarv_free(void *ptr)
+
+static void raw_free(void *ptr)
 {
 	if (ve.fd == -1)
 		return;
@@ -430,7 +840,8 @@ void cedarv_free(void *ptr)
 	{
 		if (c->virt_addr == ptr)
 		{
-			munmap(ptr, c->size);
+			if (!ve.fake_mem)
+				munmap(ptr, c->size);
 			c->virt_addr = NULL;
 			break;
 		}
@@ -499,11 +910,21 @@ void cedarv_flush_cache(void *start, int len)
 	ioctl(ve.fd, IOCTL_FLUSH_CACHE, (void*)(&range));
 }
 
+void cedarv_flush_cache_range(void *mem, size_t offset, int len)
+{
+	cedarv_flush_cache((char *)mem + offset, len);
+}
+
 void cedarv_memcpy(void* dst, size_t offset, const void * src, size_t len)
 {
 	memcpy((char*)dst + offset, src, len);
 }
 
+void cedarv_memset(void *dst, unsigned char value, size_t len)
+{
+	memset(dst, value, len);
+}
+
 void* cedarv_getPointer(CEDARV_MEMORY mem)
 {
   return mem;
@@ -515,9 +936,291 @@ unsigned char cedarv_byteAccess(void* mem, size_t offset)
   return ptr[offset];
 }
 
+size_t cedarv_getSize(void *mem)
+{
+	size_t size = 0;
+	struct memchunk_t *c;
+
+	if (pthread_rwlock_rdlock(&ve.memory_lock))
+		return 0;
+
+	for (c = &ve.first_memchunk; c != NULL; c = c->next)
+	{
+		if (c->virt_addr == mem)
+		{
+			size = c->size;
+			break;
+		}
+	}
+
+	pthread_rwlock_unlock(&ve.memory_lock);
+	return size;
+}
+
 void cedarv_setBufferInvalid(void* mem)
 {
   mem = NULL;
 }
 
+// the cedar_dev reserved memory has no exporter, only the fake engine's memfd
+int cedarv_export_dmabuf(void *mem)
+{
+	if (!ve.fake_mem || ve.fake_memfd == -1 || !mem)
+		return -1;
+
+	int udmabuf = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+	if (udmabuf == -1)
+		return -1;
+
+	struct udmabuf_create create =
+	{
+		.memfd = ve.fake_memfd,
+		.flags = UDMABUF_FLAGS_CLOEXEC,
+		.offset = (char *)mem - (char *)ve.fake_mem,
+		.size = cedarv_getSize(mem),
+	};
+
+	int fd = ioctl(udmabuf, UDMABUF_CREATE, &create);
+	close(udmabuf);
+	return fd;
+}
+
 #endif
+
+/*
+ * Accounting of the contiguous memory by what it is used for. Caches
+ * register evictors, which are asked to give memory back before an
+ * allocation goes over the budget or fails.
+ */
+
+#define ACCOUNT_BUCKETS 64
+#define EVICTORS_MAX 8
+
+struct account_entry
+{
+	const void *key;
+	size_t size;
+	int type;
+	struct account_entry *next;
+};
+
+static struct
+{
+	pthread_mutex_t lock;
+	struct account_entry *buckets[ACCOUNT_BUCKETS];
+	size_t usage[CEDARV_MEM_TYPES];
+	size_t total;
+	size_t budget;
+	int budget_read;
+	struct
+	{
+		cedarv_evict_func *evict;
+		void *context;
+	} evictors[EVICTORS_MAX];
+	int evictor_count;
+} account = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static unsigned int account_bucket(const void *key)
+{
+	return ((uintptr_t)key >> 4) % ACCOUNT_BUCKETS;
+}
+
+// VDPAU_MEM_BUDGET=<MiB> until cedarv_mem_set_budget() says otherwise
+static void account_read_budget(void)
+{
+	if (account.budget_read)
+		return;
+
+	char *env_budget = getenv("VDPAU_MEM_BUDGET");
+	if (env_budget)
+		account.budget = (size_t)strtoul(env_budget, NULL, 10) << 20;
+	account.budget_read = 1;
+}
+
+static size_t evict(size_t needed)
+{
+	cedarv_evict_func *evict[EVICTORS_MAX];
+	void *context[EVICTORS_MAX];
+	size_t freed = 0;
+	int i, count;
+
+	// evictors free memory themselves, call them without the lock
+	pthread_mutex_lock(&account.lock);
+	count = account.evictor_count;
+	for (i = 0; i < count; i++)
+	{
+		evict[i] = account.evictors[i].evict;
+		context[i] = account.evictors[i].context;
+	}
+	pthread_mutex_unlock(&account.lock);
+
+	for (i = 0; i < count && freed < needed; i++)
+		freed += evict[i](context[i], needed - freed);
+
+	return freed;
+}
+
+static size_t over_budget(size_t size)
+{
+	size_t over = 0;
+
+	pthread_mutex_lock(&account.lock);
+	account_read_budget();
+	if (account.budget && account.total + size > account.budget)
+		over = account.total + size - account.budget;
+	pthread_mutex_unlock(&account.lock);
+
+	return over;
+}
+
+static CEDARV_MEMORY account_malloc(int size, int cached, int type)
+{
+	CEDARV_MEMORY mem;
+	size_t over = over_budget(size);
+
+	if (over && evict(over) < over && over_budget(size))
+	{
+		log_warning("allocation of %d bytes exceeds the memory budget", size);
+		memset(&mem, 0, sizeof(mem));
+		return mem;
+	}
+
+	mem = raw_malloc(size, cached);
+	if (!cedarv_isValid(mem) && evict(size) > 0)
+		mem = raw_malloc(size, cached);
+
+	if (!cedarv_isValid(mem))
+	{
+		log_error("could not allocate %d bytes of contiguous memory", size);
+		return mem;
+	}
+
+	struct account_entry *e = malloc(sizeof(*e));
+	if (!e)
+		return mem;
+
+	if (type < 0 || type >= CEDARV_MEM_TYPES)
+		type = CEDARV_MEM_OTHER;
+
+	e->key = memory_key(mem);
+	e->size = memory_size(mem, size);
+	e->type = type;
+
+	pthread_mutex_lock(&account.lock);
+	unsigned int b = account_bucket(e->key);
+	e->next = account.buckets[b];
+	account.buckets[b] = e;
+	account.usage[type] += e->size;
+	account.total += e->size;
+	pthread_mutex_unlock(&account.lock);
+
+	return mem;
+}
+
+CEDARV_MEMORY cedarv_malloc(int size)
+{
+	return account_malloc(size, 0, CEDARV_MEM_OTHER);
+}
+
+CEDARV_MEMORY cedarv_malloc_cached(int size)
+{
+	return account_malloc(size, 1, CEDARV_MEM_OTHER);
+}
+
+CEDARV_MEMORY cedarv_malloc_type(int size, int type)
+{
+	return account_malloc(size, 0, type);
+}
+
+CEDARV_MEMORY cedarv_malloc_cached_type(int size, int type)
+{
+	return account_malloc(size, 1, type);
+}
+
+void cedarv_free(CEDARV_MEMORY mem)
+{
+	if (!cedarv_isValid(mem))
+		return;
+
+	const void *key = memory_key(mem);
+	struct account_entry **p, *e = NULL;
+
+	pthread_mutex_lock(&account.lock);
+	for (p = &account.buckets[account_bucket(key)]; *p; p = &(*p)->next)
+	{
+		if ((*p)->key == key)
+		{
+			e = *p;
+			*p = e->next;
+			account.usage[e->type] -= e->size;
+			account.total -= e->size;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&account.lock);
+
+	free(e);
+	raw_free(mem);
+}
+
+size_t cedarv_mem_get_usage(size_t *usage)
+{
+	pthread_mutex_lock(&account.lock);
+	if (usage)
+		memcpy(usage, account.usage, sizeof(account.usage));
+	size_t total = account.total;
+	pthread_mutex_unlock(&account.lock);
+
+	return total;
+}
+
+size_t cedarv_mem_get_budget(void)
+{
+	pthread_mutex_lock(&account.lock);
+	account_read_budget();
+	size_t budget = account.budget;
+	pthread_mutex_unlock(&account.lock);
+
+	return budget;
+}
+
+void cedarv_mem_set_budget(size_t bytes)
+{
+	pthread_mutex_lock(&account.lock);
+	account.budget = bytes;
+	account.budget_read = 1;
+	pthread_mutex_unlock(&account.lock);
+}
+
+int cedarv_mem_add_evictor(cedarv_evict_func *evict, void *context)
+{
+	int ok = 0;
+
+	pthread_mutex_lock(&account.lock);
+	if (account.evictor_count < EVICTORS_MAX)
+	{
+		account.evictors[account.evictor_count].evict = evict;
+		account.evictors[account.evictor_count].context = context;
+		account.evictor_count++;
+		ok = 1;
+	}
+	pthread_mutex_unlock(&account.lock);
+
+	return ok;
+}
+
+void cedarv_mem_remove_evictor(cedarv_evict_func *evict, void *context)
+{
+	int i;
+
+	pthread_mutex_lock(&account.lock);
+	for (i = 0; i < account.evictor_count; i++)
+	{
+		if (account.evictors[i].evict == evict && account.evictors[i].context == context)
+		{
+			account.evictors[i] = account.evictors[--account.evictor_count];
+			break;
+		}
+	}
+	pthread_mutex_unlock(&account.lock);
+}
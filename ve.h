@@ -29,6 +29,21 @@ int cedarv_get_version(void);
 int cedarv_wait(int timeout);
 void *cedarv_get(int engine, uint32_t flags);
 void cedarv_put(void);
+
+typedef struct
+{
+	uint32_t hangs;
+	uint32_t resets;
+	// CLOCK_MONOTONIC nanoseconds
+	uint64_t last_hang;
+} cedarv_hang_stats_t;
+
+// resets a hung engine between cedarv_get() and cedarv_put() and marks the calling thread's job failed
+void cedarv_hang(const char *where);
+int cedarv_job_hung(void);
+// whether a job of the calling thread hung since the last call
+int cedarv_take_hang(void);
+void cedarv_get_hang_stats(cedarv_hang_stats_t *stats);
 void* cedarv_get_regs();
 
 #if USE_UMP
@@ -43,15 +58,47 @@ void* cedarv_get_regs();
   
 #endif
 
+/*
+ * What the contiguous memory is used for, cedarv_malloc() counts as
+ * CEDARV_MEM_OTHER.
+ */
+enum cedarv_mem_type
+{
+	CEDARV_MEM_OTHER,
+	CEDARV_MEM_VIDEO_SURFACE,
+	CEDARV_MEM_OUTPUT_SURFACE,
+	CEDARV_MEM_MV,
+	CEDARV_MEM_VBV,
+	CEDARV_MEM_SCRATCH,
+	CEDARV_MEM_CONVERSION,
+	CEDARV_MEM_TYPES
+};
+
+// gives back memory of a cache, returns the bytes freed
+typedef size_t cedarv_evict_func(void *context, size_t needed);
+
 CEDARV_MEMORY cedarv_malloc(int size);
+CEDARV_MEMORY cedarv_malloc_cached(int size);
+CEDARV_MEMORY cedarv_malloc_type(int size, int type);
+CEDARV_MEMORY cedarv_malloc_cached_type(int size, int type);
+// fills usage[CEDARV_MEM_TYPES] if not NULL, returns the total
+size_t cedarv_mem_get_usage(size_t *usage);
+// 0 is no budget, VDPAU_MEM_BUDGET=<MiB> sets the initial one
+size_t cedarv_mem_get_budget(void);
+void cedarv_mem_set_budget(size_t bytes);
+int cedarv_mem_add_evictor(cedarv_evict_func *evict, void *context);
+void cedarv_mem_remove_evictor(cedarv_evict_func *evict, void *context);
 int cedarv_isValid(CEDARV_MEMORY mem);
 void cedarv_free(CEDARV_MEMORY mem);
 uint32_t cedarv_virt2phys(CEDARV_MEMORY mem);
 void cedarv_flush_cache(CEDARV_MEMORY mem, int len);
+void cedarv_flush_cache_range(CEDARV_MEMORY mem, size_t offset, int len);
 void cedarv_memcpy(CEDARV_MEMORY dst, size_t offset, const void * src, size_t len);
 void cedarv_memset(CEDARV_MEMORY dst, unsigned char value, size_t len);
 void* cedarv_getPointer(CEDARV_MEMORY mem);
 size_t cedarv_getSize(CEDARV_MEMORY mem);
+// a new DMA-BUF fd of the whole buffer, -1 if the memory manager can't export it
+int cedarv_export_dmabuf(CEDARV_MEMORY mem);
 unsigned char cedarv_byteAccess(CEDARV_MEMORY mem, size_t offset);
 void cedarv_setBufferInvalid(CEDARV_MEMORY mem);
 int cedarv_allocateEngine(int engine);
@@ -125,6 +172,8 @@ static inline void writeb(uint8_t val, void *addr)
 #define CEDARV_MPEG_IQ_MIN_INPUT	0x180
 #define CEDARV_MPEG_QP_INPUT        0x184
 #define CEDARV_MPEG_MSMPEG4_HDR     0x188
+#define CEDARV_MPEG_VC1_PIC_HDR     0x18c
+#define CEDARV_MPEG_VC1_RANGE_MAP   0x190
 #define CEDARV_MPEG_MV5             0x1A8
 #define CEDARV_MPEG_MV6             0x1AC
 #define CEDARV_MPEG_JPEG_SIZE		0x1b8
@@ -175,6 +224,26 @@ static inline void writeb(uint8_t val, void *addr)
 #define CEDARV_SRAM_H264_REF_LIST1		0x664
 #define CEDARV_SRAM_H264_SCALING_LISTS	0x800
 
+// VP8 uses the H264 engine with CEDARV_H264_CTRL_VP8 set
+#define CEDARV_VP8_PPS				0x214
+#define CEDARV_VP8_QP_INDEX_DELTA		0x218
+#define CEDARV_VP8_ENTROPY_PROBS_ADDR		0x250
+#define CEDARV_VP8_FIRST_DATA_PART_LEN		0x254
+#define CEDARV_VP8_PART_SIZE_OFFSET		0x258
+#define CEDARV_VP8_REC_LUMA			0x2ac
+#define CEDARV_VP8_FWD_LUMA			0x2b0
+#define CEDARV_VP8_BWD_LUMA			0x2b4
+#define CEDARV_VP8_REC_CHROMA			0x2b8
+#define CEDARV_VP8_FWD_CHROMA			0x2bc
+#define CEDARV_VP8_BWD_CHROMA			0x2c0
+#define CEDARV_VP8_ALT_LUMA			0x2c4
+#define CEDARV_VP8_ALT_CHROMA			0x2c8
+#define CEDARV_VP8_SEGMENT_FEAT_MB_LV0		0x2cc
+#define CEDARV_VP8_SEGMENT_FEAT_MB_LV1		0x2d0
+#define CEDARV_VP8_REF_LF_DELTA			0x2d4
+#define CEDARV_VP8_MODE_LF_DELTA		0x2d8
+#define CEDARV_VP8_PICSIZE			0x300
+
 #define CEDARV_HEVC_NAL_HDR                 0x500
 #define CEDARV_HEVC_SPS                     0x504
 #define CEDARV_HEVC_PIC_SIZE                0x508
@@ -304,6 +373,12 @@ static inline void writeb(uint8_t val, void *addr)
 #define CEDARV_MPEG_CTRL_FDC_QAC_IN_DRAM(val)        (((val) & 0x1) << 30)
 #define CEDARV_MPEG_CTRL_MC_CACHE_EN(val)            (((val) & 0x1) << 31)
 
+//CEDARV_MPEG_SDROT_CTRL / CEDARV_H264_SDROT_CTRL
+#define SDROT_CTRL_ROTATE(x)                     (((x) & 0xf) << 0)
+#define SDROT_CTRL_HORIZ_SCALE(x)                (((x) & 0x3) << 4)
+#define SDROT_CTRL_VERT_SCALE(x)                 (((x) & 0x3) << 6)
+#define SDROT_CTRL_SCALE_EN                      (0x1 << 8)
+
 #define CEDARV_MPEG_MVOPHDR_VOP_FCODE_B(val)         (((val) & 0x7) << 0)
 #define CEDARV_MPEG_MVOPHDR_VOP_FCODE_F(val)         (((val) & 0x7) << 3)
 #define CEDARV_MPEG_MVOPHDR_ALTER_V_SCAN(val)        (((val) & 0x1) << 6)
@@ -329,6 +404,39 @@ static inline void writeb(uint8_t val, void *addr)
 #define VLD_BUSY                (1 << 8)
 #define VLD_DATA_REQ_INTERRUPT  (1 << 2)
 
+//CEDARV_H264_CTRL / CEDARV_H264_TRIGGER / CEDARV_H264_STATUS in VP8 mode
+#define CEDARV_H264_CTRL_VP8			(1 << 24)
+#define VP8_TRIG_INIT_SWDEC			0x7
+#define VP8_TRIG_SLICE_DECODE			0xa
+#define VP8_TRIG_UPDATE_COEF			0xe
+#define VP8_TRIG_GET_BITS			0xf
+#define VP8_TRIG_BIN_LENGTH(x)			(((x) & 0x3f) << 16)
+#define VP8_TRIG_PROBABILITY(x)			(((x) & 0xff) << 24)
+#define VP8_STATUS_UPPROB_BUSY			(1 << 17)
+
+//CEDARV_VP8_PPS
+#define VP8_PPS_FILTER_TYPE_SIMPLE		(1 << 31)
+#define VP8_PPS_BILINEAR_MC_FILTER		(1 << 30)
+#define VP8_PPS_FULL_PIXEL			(1 << 29)
+#define VP8_PPS_SHARPNESS_LEVEL(x)		(((x) & 0x7) << 26)
+#define VP8_PPS_LOOP_FILTER_LEVEL(x)		(((x) & 0x3f) << 20)
+#define VP8_PPS_LOOP_FILTER_SIMPLE		(1 << 19)
+#define VP8_PPS_LPF_DISABLE			(1 << 18)
+#define VP8_PPS_MODE_REF_LF_DELTA_UPDATE	(1 << 17)
+#define VP8_PPS_MODE_REF_LF_DELTA_ENABLE	(1 << 16)
+#define VP8_PPS_LAST_SHARPNESS_LEVEL(x)		(((x) & 0x7) << 13)
+#define VP8_PPS_LAST_LOOP_FILTER_SIMPLE		(1 << 12)
+#define VP8_PPS_TOKEN_PARTITION(x)		(((x) & 0x3) << 10)
+#define VP8_PPS_MB_SEGMENT_ABS_DELTA		(1 << 9)
+#define VP8_PPS_UPDATE_MB_SEGMENTATION_MAP	(1 << 8)
+#define VP8_PPS_SEGMENTATION_ENABLE		(1 << 7)
+#define VP8_PPS_MB_NO_COEFF_SKIP		(1 << 6)
+#define VP8_PPS_RELOAD_ENTROPY_PROBS		(1 << 5)
+#define VP8_PPS_ALTREF_SIGN_BIAS		(1 << 4)
+#define VP8_PPS_GOLDEN_SIGN_BIAS		(1 << 3)
+#define VP8_PPS_LAST_PIC_TYPE_P_FRAME		(1 << 2)
+#define VP8_PPS_PIC_TYPE_P_FRAME		(1 << 0)
+
 //CEDARV_OUTPUT_FORMAT
 #define OUTPUT_FORMAT(x)		((x) << 4)
 #define OUTPUT_FORMAT_TILE32x32 	(OUTPUT_FORMAT(0x0))
@@ -8,6 +8,10 @@
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include "ve.h"
+#include "veisp.h"
+#include "detile.h"
+#include "timeline.h"
+#include "logger.h"
 #include "sunxi_disp_ioctl.h"
 #include <errno.h>
 #include <string.h>
@@ -15,6 +19,94 @@
 
 static int fd = -1;
 
+// one scaler is requested on first use and kept until close, not per frame
+static unsigned long scaler = (unsigned long)-1;
+
+// conversions run in order on a worker thread, callers wait with cedarv_disp_sync()
+#define CONVERT_QUEUE_SIZE 8
+static __disp_scaler_para_t queue[CONVERT_QUEUE_SIZE];
+static unsigned int queue_head, queue_tail;
+// conversions of the worker that failed since the last cedarv_disp_sync()
+static unsigned int queue_failed;
+static int worker_running;
+static pthread_t worker;
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+
+static int scaler_execute(__disp_scaler_para_t *scaler_para)
+{
+   unsigned long arg[4] = {0, 0, 0, 0};
+   if(scaler == (unsigned long)-1)
+   {
+      scaler = ioctl(fd, DISP_CMD_SCALER_REQUEST, (unsigned long) arg);
+      if(scaler == (unsigned long)-1) return 0;
+   }
+
+   arg[1] = scaler;
+   arg[2] = (unsigned long) scaler_para;
+   TIMELINE_BEGIN("scaler");
+   int ok = ioctl(fd, DISP_CMD_SCALER_EXECUTE, (unsigned long) arg) >= 0;
+   if(!ok)
+      log_error("scaler execution failed=%d", errno);
+   TIMELINE_END("scaler");
+   return ok;
+}
+
+static void *convert_thread(void *arg)
+{
+   __disp_scaler_para_t scaler_para;
+
+   pthread_mutex_lock(&queue_mutex);
+   while(1)
+   {
+      while(worker_running && queue_head == queue_tail)
+         pthread_cond_wait(&queue_cond, &queue_mutex);
+      if(queue_head == queue_tail)
+         break;
+
+      scaler_para = queue[queue_tail % CONVERT_QUEUE_SIZE];
+      pthread_mutex_unlock(&queue_mutex);
+
+      int ok = scaler_execute(&scaler_para);
+
+      pthread_mutex_lock(&queue_mutex);
+      if(!ok)
+         queue_failed++;
+      queue_tail++;
+      pthread_cond_broadcast(&queue_cond);
+   }
+   pthread_mutex_unlock(&queue_mutex);
+   return NULL;
+}
+
+static int scaler_queue(__disp_scaler_para_t *scaler_para, int wait)
+{
+   pthread_mutex_lock(&queue_mutex);
+   if(!worker_running)
+   {
+      worker_running = 1;
+      if(pthread_create(&worker, NULL, convert_thread, NULL))
+         worker_running = 0;
+   }
+   if(!worker_running)
+   {
+      // no thread, convert right away
+      pthread_mutex_unlock(&queue_mutex);
+      return scaler_execute(scaler_para);
+   }
+
+   while(queue_head - queue_tail == CONVERT_QUEUE_SIZE)
+      pthread_cond_wait(&queue_cond, &queue_mutex);
+   queue[queue_head % CONVERT_QUEUE_SIZE] = *scaler_para;
+   queue_head++;
+   pthread_cond_broadcast(&queue_cond);
+   pthread_mutex_unlock(&queue_mutex);
+
+   if(wait)
+      return cedarv_disp_sync() == 0;
+   return 1;
+}
+
 void cedarv_disp_init()
 {
    if(fd == -1)
@@ -23,58 +115,81 @@ void cedarv_disp_init()
 
 void cedarv_disp_close()
 {
+   pthread_mutex_lock(&queue_mutex);
+   int running = worker_running;
+   worker_running = 0;
+   pthread_cond_broadcast(&queue_cond);
+   pthread_mutex_unlock(&queue_mutex);
+   // the worker finishes what is queued before it exits
+   if(running)
+      pthread_join(worker, NULL);
+
+   if(scaler != (unsigned long)-1)
+   {
+      unsigned long arg[4] = {0, scaler, 0, 0};
+      ioctl(fd, DISP_CMD_SCALER_RELEASE, (unsigned long) arg);
+      scaler = (unsigned long)-1;
+   }
    close(fd);
    fd = -1;
 }
 
+int cedarv_disp_sync()
+{
+   pthread_mutex_lock(&queue_mutex);
+   while(queue_head != queue_tail)
+      pthread_cond_wait(&queue_cond, &queue_mutex);
+   int failed = queue_failed;
+   queue_failed = 0;
+   pthread_mutex_unlock(&queue_mutex);
+   return failed;
+}
+
+static void set_mb2yuv420(__disp_scaler_para_t *scaler_para, int width, int height, CEDARV_MEMORY y, CEDARV_MEMORY uv, CEDARV_MEMORY convY, CEDARV_MEMORY convU, CEDARV_MEMORY convV)
+{
+   memset(scaler_para, 0, sizeof(__disp_scaler_para_t));
+   scaler_para->input_fb.addr[0] = cedarv_virt2phys(y);
+   scaler_para->input_fb.addr[1] = cedarv_virt2phys(uv);
+   scaler_para->input_fb.size.width = width;
+   scaler_para->input_fb.size.height = height;
+   scaler_para->input_fb.format = DISP_FORMAT_YUV420;
+   scaler_para->input_fb.seq = DISP_SEQ_UVUV;
+   scaler_para->input_fb.mode = DISP_MOD_MB_UV_COMBINED;
+   scaler_para->input_fb.br_swap = 0;
+   scaler_para->input_fb.cs_mode = DISP_BT601;
+   scaler_para->source_regn.x = 0;
+   scaler_para->source_regn.y = 0;
+   scaler_para->source_regn.width = width;
+   scaler_para->source_regn.height = height;
+   scaler_para->output_fb.addr[0] = cedarv_virt2phys(convY);
+   scaler_para->output_fb.addr[1] = cedarv_virt2phys(convU);
+   scaler_para->output_fb.addr[2] = cedarv_virt2phys(convV);
+   scaler_para->output_fb.size.width = width;
+   scaler_para->output_fb.size.height = height;
+   scaler_para->output_fb.format = DISP_FORMAT_YUV420;
+   scaler_para->output_fb.seq = DISP_SEQ_P3210;
+   scaler_para->output_fb.mode = DISP_MOD_NON_MB_PLANAR;
+   scaler_para->output_fb.br_swap = 0;
+   scaler_para->output_fb.cs_mode = DISP_BT601;
+}
+
 int cedarv_disp_convertMb2Yuv420(int width, int height, CEDARV_MEMORY y, CEDARV_MEMORY uv, CEDARV_MEMORY convY, CEDARV_MEMORY convU, CEDARV_MEMORY convV)
 {
-   unsigned long arg[4] = {0, 0, 0, 0};
    __disp_scaler_para_t scaler_para;
-   int result; 
-   arg[1] = ioctl(fd, DISP_CMD_SCALER_REQUEST, (unsigned long) arg);
-   if(arg[1] == (unsigned long)-1) return 0;
-
-   memset(&scaler_para, 0, sizeof(__disp_scaler_para_t));
-   scaler_para.input_fb.addr[0] = cedarv_virt2phys(y);
-   scaler_para.input_fb.addr[1] = cedarv_virt2phys(uv);
-   scaler_para.input_fb.size.width = width;
-   scaler_para.input_fb.size.height = height;
-   scaler_para.input_fb.format = DISP_FORMAT_YUV420;
-   scaler_para.input_fb.seq = DISP_SEQ_UVUV;
-   scaler_para.input_fb.mode = DISP_MOD_MB_UV_COMBINED;
-   scaler_para.input_fb.br_swap = 0;
-   scaler_para.input_fb.cs_mode = DISP_BT601;
-   scaler_para.source_regn.x = 0;
-   scaler_para.source_regn.y = 0;
-   scaler_para.source_regn.width = width;
-   scaler_para.source_regn.height = height;
-   scaler_para.output_fb.addr[0] = cedarv_virt2phys(convY);
-   scaler_para.output_fb.addr[1] = cedarv_virt2phys(convU);
-   scaler_para.output_fb.addr[2] = cedarv_virt2phys(convV);
-   scaler_para.output_fb.size.width = width;
-   scaler_para.output_fb.size.height = height;
-   scaler_para.output_fb.format = DISP_FORMAT_YUV420;
-   scaler_para.output_fb.seq = DISP_SEQ_P3210;
-   scaler_para.output_fb.mode = DISP_MOD_NON_MB_PLANAR;
-   scaler_para.output_fb.br_swap = 0;
-   scaler_para.output_fb.cs_mode = DISP_BT601;
-
-   arg[2] = (unsigned long) &scaler_para;
-   result = ioctl(fd, DISP_CMD_SCALER_EXECUTE, (unsigned long) arg);
-   if(result < 0)
-      printf("scaler execution failed=%d\n", errno);
-   ioctl(fd, DISP_CMD_SCALER_RELEASE, (unsigned long) arg);
-   return 1;
+   set_mb2yuv420(&scaler_para, width, height, y, uv, convY, convU, convV);
+   return scaler_queue(&scaler_para, 1);
+}
+
+int cedarv_disp_queueMb2Yuv420(int width, int height, CEDARV_MEMORY y, CEDARV_MEMORY uv, CEDARV_MEMORY convY, CEDARV_MEMORY convU, CEDARV_MEMORY convV)
+{
+   __disp_scaler_para_t scaler_para;
+   set_mb2yuv420(&scaler_para, width, height, y, uv, convY, convU, convV);
+   return scaler_queue(&scaler_para, 0);
 }
 
 int cedarv_disp_convertARGB2Yuv420(int width, int height, CEDARV_MEMORY y, CEDARV_MEMORY convY, CEDARV_MEMORY convUV)
 {
-  unsigned long arg[4] = {0, 0, 0, 0};
   __disp_scaler_para_t scaler_para;
-  int result; 
-  arg[1] = ioctl(fd, DISP_CMD_SCALER_REQUEST, (unsigned long) arg);
-  if(arg[1] == (unsigned long)-1) return 0;
 
   memset(&scaler_para, 0, sizeof(__disp_scaler_para_t));
   scaler_para.input_fb.addr[0] = cedarv_virt2phys(y);
@@ -99,21 +214,12 @@ int cedarv_disp_convertARGB2Yuv420(int width, int height, CEDARV_MEMORY y, CEDAR
   scaler_para.output_fb.br_swap = 0;
   scaler_para.output_fb.cs_mode = DISP_BT601;
 
-  arg[2] = (unsigned long) &scaler_para;
-  result = ioctl(fd, DISP_CMD_SCALER_EXECUTE, (unsigned long) arg);
-  if(result < 0)
-    printf("scaler execution failed=%d\n", errno);
-  ioctl(fd, DISP_CMD_SCALER_RELEASE, (unsigned long) arg);
-  return 1;
+  return scaler_queue(&scaler_para, 1);
 }
 
 int cedarv_disp_convertMb2RGB(int width, int height, CEDARV_MEMORY y, CEDARV_MEMORY uv, CEDARV_MEMORY convY)
 {
-  unsigned long arg[4] = {0, 0, 0, 0};
   __disp_scaler_para_t scaler_para;
-  int result; 
-  arg[1] = ioctl(fd, DISP_CMD_SCALER_REQUEST, (unsigned long) arg);
-  if(arg[1] == (unsigned long)-1) return 0;
 
   memset(&scaler_para, 0, sizeof(__disp_scaler_para_t));
   scaler_para.input_fb.addr[0] = cedarv_virt2phys(y);
@@ -138,12 +244,7 @@ int cedarv_disp_convertMb2RGB(int width, int height, CEDARV_MEMORY y, CEDARV_MEM
   scaler_para.output_fb.br_swap = 0;
   scaler_para.output_fb.cs_mode = DISP_BT601;
 
-  arg[2] = (unsigned long) &scaler_para;
-  result = ioctl(fd, DISP_CMD_SCALER_EXECUTE, (unsigned long) arg);
-  if(result < 0)
-    printf("scaler execution failed=%d\n", errno);
-  ioctl(fd, DISP_CMD_SCALER_RELEASE, (unsigned long) arg);
-  return 1;
+  return scaler_queue(&scaler_para, 1);
 }
 
 #if 0
@@ -297,406 +398,74 @@ void cedarv_sw_convertToNv21C(char* pSrc, char* pDst, int nWidth, int nHeight)
    }
 }
 
-void cedarv_sw_convertMb32420ToNv21Y(char* pSrc,char* pDst,int nWidth, int nHeight)
+enum mb32_op
 {
-	int nMbWidth = 0;
-	int nMbHeight = 0;
-	int i = 0;
-	int j = 0;
-	int m = 0;
-	int k = 0;
-    int nLineStride=0;
-    int lineNum = 0;
-    int offset = 0;
-    char* ptr = NULL;
-    char *dstAsm = NULL;
-    char *srcAsm = NULL;
-    char bufferU[32];
-    int nWidthMatchFlag = 0;
-    int nCopyMbWidth = 0;
-
-    nLineStride = (nWidth + 15) &~15;
-    nMbWidth = (nWidth+31)&~31;
-    nMbWidth /= 32;
-
-    nMbHeight = (nHeight+31)&~31;
-    nMbHeight /= 32;
-    ptr = pSrc;
-
-    nWidthMatchFlag = 0;
-	nCopyMbWidth = nMbWidth-1;
-
-    if(nMbWidth*32 == nLineStride)
-    {
-    	nWidthMatchFlag = 1;
-    	nCopyMbWidth = nMbWidth;
-
-    }
-    for(i=0; i<nMbHeight; i++)
-    {
-    	for(j=0; j<nCopyMbWidth; j++)
-    	{
-    		for(m=0; m<32; m++)
-    		{
-    			if((i*32 + m) >= nHeight)
-    		  	{
-    				ptr += 32;
-    		    	continue;
-    		  	}
-    			srcAsm = ptr;
-    			lineNum = i*32 + m;           //line num
-    			offset =  lineNum*nLineStride + j*32;
-    			dstAsm = pDst+ offset;
-
-    			 asm volatile (
-    					        "vld1.8         {d0 - d3}, [%[srcAsm]]              \n\t"
-    					        "vst1.8         {d0 - d3}, [%[dstAsm]]              \n\t"
-    					       	: [dstAsm] "+r" (dstAsm), [srcAsm] "+r" (srcAsm)
-    					       	:  //[srcY] "r" (srcY)
-    					       	: "cc", "memory", "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d16", "d17", "d18", "d19", "d20", "d21", "d22", "d23", "d24", "d28", "d29", "d30", "d31");
-    			ptr += 32;
-    		}
-    	}
-
-    	if(nWidthMatchFlag == 1)
-    	{
-    		continue;
-    	}
-    	for(m=0; m<32; m++)
-    	{
-    		if((i*32 + m) >= nHeight)
-    		{
-    			ptr += 32;
-    	    	continue;
-    	   	}
-    		dstAsm = bufferU;
-    		srcAsm = ptr;
-    	 	lineNum = i*32 + m;           //line num
-    		offset =  lineNum*nLineStride + j*32;
-
-    	   	 asm volatile (
-    	    	      "vld1.8         {d0 - d3}, [%[srcAsm]]              \n\t"
-    	              "vst1.8         {d0 - d3}, [%[dstAsm]]              \n\t"
-    	         	    : [dstAsm] "+r" (dstAsm), [srcAsm] "+r" (srcAsm)
-    	    	     	:  //[srcY] "r" (srcY)
-    	    	    	: "cc", "memory", "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d16", "d17", "d18", "d19", "d20", "d21", "d22", "d23", "d24", "d28", "d29", "d30", "d31");
-    	   	ptr += 32;
-    	   	for(k=0; k<32; k++)
-    	   	{
-    	   		if((j*32+ k) >= nLineStride)
-    	   	   	{
-    	   			break;
-    	   	  	}
-    	   	 	pDst[offset+k] = bufferU[k];
-    	   	}
-    	}
-    }
+	MB32_COPY,
+	MB32_SWAP,
+	MB32_SPLIT,
+};
+
+// rows of a tiled plane to a linear one, line_step 2 takes every other source line
+static void convert_mb32(enum mb32_op op, const char *src, int tiles, int line_step, char *dst, char *dst2, int stride, int bytes, int rows)
+{
+	const detile_kernels_t *k = detile_kernels();
+	int x, y;
+
+	for (y = 0; y < rows; y++)
+	{
+		for (x = 0; x < bytes; x += 32)
+		{
+			uint32_t n = (bytes - x < 32) ? bytes - x : 32;
+			const uint8_t *line = detile_line((const uint8_t *)src, tiles, y * line_step, x);
+			uint8_t *d = (uint8_t *)dst + y * stride;
+
+			switch (op)
+			{
+			case MB32_COPY:
+				k->copy(d + x, line, n);
+				break;
+			case MB32_SWAP:
+				k->swap(d + x, line, n);
+				break;
+			case MB32_SPLIT:
+				k->split(d + x / 2, (uint8_t *)dst2 + y * stride + x / 2, line, n);
+				break;
+			}
+		}
+	}
 }
 
+void cedarv_sw_convertMb32420ToNv21Y(char* pSrc,char* pDst,int nWidth, int nHeight)
+{
+	int nLineStride = (nWidth + 15) & ~15;
+
+	convert_mb32(MB32_COPY, pSrc, (nWidth + 31) / 32, 1, pDst, NULL, nLineStride, nLineStride, nHeight);
+}
 
 void cedarv_sw_convertMb32420ToNv21C(char* pSrc,char* pDst,int nPicWidth, int nPicHeight)
 {
-	int nMbWidth = 0;
-	int nMbHeight = 0;
-	int i = 0;
-	int j = 0;
-	int m = 0;
-	int k = 0;
-    int nLineStride=0;
-    int lineNum = 0;
-    int offset = 0;
-    char* ptr = NULL;
-    char *dst0Asm = NULL;
-    char *dst1Asm = NULL;
-    char *srcAsm = NULL;
-    char bufferV[16], bufferU[16];
-    int nWidth = 0;
-    int nHeight = 0;
-
-    nWidth = (nPicWidth+1)/2;
-    nHeight = (nPicHeight+1)/2;
-
-    nLineStride = (nWidth*2 + 15) &~15;
-    nMbWidth = (nWidth*2+31)&~31;
-    nMbWidth /= 32;
-
-    nMbHeight = (nHeight+31)&~31;
-    nMbHeight /= 32;
-
-
-    ptr = pSrc;
-
-    for(i=0; i<nMbHeight; i++)
-    {
-    	for(j=0; j<nMbWidth; j++)
-    	{
-    		for(m=0; m<32; m++)
-    		{
-    			if((i*32 + m) >= nHeight)
-    			{
-    				ptr += 32;
-    				continue;
-        		}
-
-    			dst0Asm = bufferU;
-    			dst1Asm = bufferV;
-    			srcAsm = ptr;
-    			lineNum = i*32 + m;           //line num
-    			offset =  lineNum*nLineStride + j*32;
-
-    			asm volatile(
-    					"vld2.8         {d0-d3}, [%[srcAsm]]              \n\t"
-    			    	"vst1.8         {d0,d1}, [%[dst0Asm]]              \n\t"
-    			    	"vst1.8         {d2,d3}, [%[dst1Asm]]              \n\t"
-    			    	: [dst0Asm] "+r" (dst0Asm), [dst1Asm] "+r" (dst1Asm), [srcAsm] "+r" (srcAsm)
-    			        :  //[srcY] "r" (srcY)
-    			        : "cc", "memory", "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d16", "d17", "d18", "d19", "d20", "d21", "d22", "d23", "d24", "d28", "d29", "d30", "d31"
-    			     );
-    			ptr += 32;
-
-
-    			for(k=0; k<16; k++)
-    			{
-    				if((j*32+ 2*k) >= nLineStride)
-    				{
-    					break;
-    				}
-    				pDst[offset+2*k]   = bufferV[k];
-    			   	pDst[offset+2*k+1] = bufferU[k];
-    			}
-    		}
-    	}
-    }
+	int nWidth = (nPicWidth + 1) / 2;
+	int nHeight = (nPicHeight + 1) / 2;
+	int nLineStride = (nWidth * 2 + 15) & ~15;
+
+	convert_mb32(MB32_SWAP, pSrc, (nWidth * 2 + 31) / 32, 1, pDst, NULL, nLineStride, nLineStride, nHeight);
 }
 
 void cedarv_sw_convertMb32420ToYv12C(char* pSrc,char* pDstU, char*pDstV,int nPicWidth, int nPicHeight)
 {
-	int nMbWidth = 0;
-	int nMbHeight = 0;
-	int i = 0;
-	int j = 0;
-	int m = 0;
-	int k = 0;
-    int nLineStride=0;
-    int lineNum = 0;
-    int offset = 0;
-    char* ptr = NULL;
-    char *dst0Asm = NULL;
-    char *dst1Asm = NULL;
-    char *srcAsm = NULL;
-    int nWidth = 0;
-    int nHeight = 0;
-    char bufferV[16], bufferU[16];
-    int nWidthMatchFlag = 0;
-    int nCopyMbWidth = 0;
-
-    nWidth = (nPicWidth+1)/2;
-    nHeight = (nPicHeight+1)/2;
-
-    //nLineStride = ((nPicWidth+ 15) &~15)/2;
-    nLineStride = (nWidth+7)&~7;
-
-    nMbWidth = (nWidth*2+31)&~31;
-    nMbWidth /= 32;
-
-    nMbHeight = (nHeight+31)&~31;
-    nMbHeight /= 32;
-
-
-    ptr = pSrc;
-
-    nWidthMatchFlag = 0;
-	nCopyMbWidth = nMbWidth-1;
-
-    if(nMbWidth*16 == nLineStride)
-    {
-    	nWidthMatchFlag = 1;
-    	nCopyMbWidth = nMbWidth;
-    }
-
-    for(i=0; i<nMbHeight; i++)
-    {
-    	for(j=0; j<nCopyMbWidth; j++)
-    	{
-    		for(m=0; m<32; m++)
-    		{
-    			if((i*32 + m) >= nHeight)
-    			{
-    				ptr += 32;
-    				continue;
-        		}
-
-    			srcAsm = ptr;
-    			lineNum = i*32 + m;           //line num
-    			offset =  lineNum*nLineStride + j*16;
-    			dst0Asm = pDstU+offset;
-    		    dst1Asm = pDstV+offset;
-    			asm volatile(
-    					"vld2.8         {d0-d3}, [%[srcAsm]]              \n\t"
-    			    	"vst1.8         {d0,d1}, [%[dst0Asm]]              \n\t"
-    			    	"vst1.8         {d2,d3}, [%[dst1Asm]]              \n\t"
-    			    	: [dst0Asm] "+r" (dst0Asm), [dst1Asm] "+r" (dst1Asm), [srcAsm] "+r" (srcAsm)
-    			        :  //[srcY] "r" (srcY)
-    			        : "cc", "memory", "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d16", "d17", "d18", "d19", "d20", "d21", "d22", "d23", "d24", "d28", "d29", "d30", "d31"
-    			     );
-    			ptr += 32;
-    		}
-    	}
-
-    	if(nWidthMatchFlag == 1)
-    	{
-    		continue;
-    	}
-    	for(m=0; m<32; m++)
-    	{
-    		if((i*32 + m) >= nHeight)
-    		{
-    			ptr += 32;
-    			continue;
-    		}
-
-
-    	   	srcAsm = ptr;
-    	   	lineNum = i*32 + m;           //line num
-    		offset =  lineNum*nLineStride + j*16;
-    	   	dst0Asm = bufferU;
-        	dst1Asm = bufferV;
-    	   	asm volatile(
-    	   			"vld2.8         {d0-d3}, [%[srcAsm]]              \n\t"
-    	    		"vst1.8         {d0,d1}, [%[dst0Asm]]              \n\t"
-    	    	 	"vst1.8         {d2,d3}, [%[dst1Asm]]              \n\t"
-    	    	   	: [dst0Asm] "+r" (dst0Asm), [dst1Asm] "+r" (dst1Asm), [srcAsm] "+r" (srcAsm)
-    	            :  //[srcY] "r" (srcY)
-    	            : "cc", "memory", "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d16", "d17", "d18", "d19", "d20", "d21", "d22", "d23", "d24", "d28", "d29", "d30", "d31"
-    	         );
-    	   	ptr += 32;
-
-    	   	for(k=0; k<16; k++)
-    	   	{
-    	   		if((j*16+ k) >= nLineStride)
-    	   		{
-    	   			break;
-    	   		}
-    	   		pDstV[offset+k] = bufferV[k];
-    	   		pDstU[offset+k] = bufferU[k];
-    	   	}
-    	}
-    }
-}
+	int nWidth = (nPicWidth + 1) / 2;
+	int nHeight = (nPicHeight + 1) / 2;
+	int nLineStride = (nWidth + 7) & ~7;
 
+	convert_mb32(MB32_SPLIT, pSrc, (nWidth * 2 + 31) / 32, 1, pDstU, pDstV, nLineStride, nLineStride * 2, nHeight);
+}
 
+// 4:2:2 chroma has twice the lines, every other one is dropped
 void cedarv_sw_convertMb32422ToYv12C(char* pSrc,char* pDstU, char*pDstV,int nPicWidth, int nPicHeight)
 {
-	int nMbWidth = 0;
-	int nMbHeight = 0;
-	int i = 0;
-	int j = 0;
-	int m = 0;
-	int k = 0;
-    int nLineStride=0;
-    int lineNum = 0;
-    int offset = 0;
-    char* ptr = NULL;
-    char *dst0Asm = NULL;
-    char *dst1Asm = NULL;
-    char *srcAsm = NULL;
-
-    int nWidth = 0;
-    int nHeight = 0;
-    char bufferV[16], bufferU[16];
-    int nWidthMatchFlag = 0;
-    int nCopyMbWidth = 0;
-
-    nWidth = (nPicWidth+1)/2;
-    nHeight = (nPicHeight+1)/2;
-
-    nLineStride = (nWidth+7)&~7;
-
-    nMbWidth = (nWidth*2+31)&~31;
-    nMbWidth /= 32;
-
-    nMbHeight = (nHeight*2+31)&~31;
-    nMbHeight /= 32;
-
-    ptr = pSrc;
-
-    nWidthMatchFlag = 0;
-	nCopyMbWidth = nMbWidth-1;
-
-    if(nMbWidth*16 == nLineStride)
-    {
-    	nWidthMatchFlag = 1;
-    	nCopyMbWidth = nMbWidth;
-    }
-
-    for(i=0; i<nMbHeight; i++)
-    {
-    	for(j=0; j<nCopyMbWidth; j++)
-    	{
-    		for(m=0; m<16; m++)
-    		{
-    			if((i*16 + m) >= nHeight)
-    			{
-    				ptr += 64;
-    				continue;
-        		}
-
-    			srcAsm = ptr;
-    			lineNum = i*16 + m;           //line num
-    			offset =  lineNum*nLineStride + j*16;
-    			dst0Asm = pDstU+offset;
-    			dst1Asm = pDstV+offset;
-
-
-    			asm volatile(
-    					"vld2.8         {d0-d3}, [%[srcAsm]]              \n\t"
-    			    	"vst1.8         {d0,d1}, [%[dst0Asm]]              \n\t"
-    			    	"vst1.8         {d2,d3}, [%[dst1Asm]]              \n\t"
-    			    	: [dst0Asm] "+r" (dst0Asm), [dst1Asm] "+r" (dst1Asm), [srcAsm] "+r" (srcAsm)
-    			        :  //[srcY] "r" (srcY)
-    			        : "cc", "memory", "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d16", "d17", "d18", "d19", "d20", "d21", "d22", "d23", "d24", "d28", "d29", "d30", "d31"
-    			     );
-    			ptr += 64;
-    		}
-    	}
-
-    	if(nWidthMatchFlag==1)
-    	{
-    		continue;
-    	}
-    	for(m=0; m<16; m++)
-    	{
-    		if((i*16 + m) >= nHeight)
-    	    {
-    			ptr += 64;
-    			continue;
-    	    }
-
-    		dst0Asm = bufferU;
-    	    dst1Asm = bufferV;
-    	   	srcAsm = ptr;
-    	   	lineNum = i*16 + m;           //line num
-    		offset =  lineNum*nLineStride + j*16;
-
-    	   	asm volatile(
-    	    			"vld2.8         {d0-d3}, [%[srcAsm]]              \n\t"
-    	    		 	"vst1.8         {d0,d1}, [%[dst0Asm]]              \n\t"
-    	    	    	"vst1.8         {d2,d3}, [%[dst1Asm]]              \n\t"
-    	    	    	: [dst0Asm] "+r" (dst0Asm), [dst1Asm] "+r" (dst1Asm), [srcAsm] "+r" (srcAsm)
-    	    	        :  //[srcY] "r" (srcY)
-    	    	        : "cc", "memory", "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d16", "d17", "d18", "d19", "d20", "d21", "d22", "d23", "d24", "d28", "d29", "d30", "d31"
-    	   		     );
-    	   	ptr += 64;
-
-    	   	for(k=0; k<16; k++)
-    	    {
-    	   		if((j*16+ k) >= nLineStride)
-    	   		{
-    	   			break;
-    	   		}
-    	    	pDstV[offset+k] = bufferV[k];
-    	   	   	pDstU[offset+k] = bufferU[k];
-    		}
-    	}
-    }
+	int nWidth = (nPicWidth + 1) / 2;
+	int nHeight = (nPicHeight + 1) / 2;
+	int nLineStride = (nWidth + 7) & ~7;
+
+	convert_mb32(MB32_SPLIT, pSrc, (nWidth * 2 + 31) / 32, 2, pDstU, pDstV, nLineStride, nLineStride * 2, nHeight);
 }
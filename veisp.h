@@ -19,8 +19,13 @@ void ConvertMb32420ToYv12Y(char* pSrc,char* pDst,int nWidth, int nHeight);
 
 void cedarv_disp_init();
 void cedarv_disp_close();
+// waits for the queued conversions, returns how many of them failed
+int cedarv_disp_sync();
 int cedarv_disp_convertMb2Yuv420(int width, int height, CEDARV_MEMORY y, CEDARV_MEMORY uv, 
                                  CEDARV_MEMORY convY, CEDARV_MEMORY convU, CEDARV_MEMORY convV);
+int cedarv_disp_queueMb2Yuv420(int width, int height, CEDARV_MEMORY y, CEDARV_MEMORY uv, 
+                               CEDARV_MEMORY convY, CEDARV_MEMORY convU, CEDARV_MEMORY convV);
 int cedarv_disp_convertARGB2Yuv420(int width, int height, CEDARV_MEMORY y, CEDARV_MEMORY convY, CEDARV_MEMORY convUV);
+int cedarv_disp_convertMb2RGB(int width, int height, CEDARV_MEMORY y, CEDARV_MEMORY uv, CEDARV_MEMORY convY);
 
 #endif
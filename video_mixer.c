@@ -18,6 +18,7 @@
  */
 
 #include <math.h>
+#include <string.h>
 #include "vdpau_private.h"
 
 VdpStatus vdp_video_mixer_create(VdpDevice device, uint32_t feature_count, VdpVideoMixerFeature const *features, uint32_t parameter_count, VdpVideoMixerParameter const *parameters, void const *const *parameter_values, VdpVideoMixer *mixer)
@@ -50,54 +51,210 @@ VdpStatus vdp_video_mixer_destroy(VdpVideoMixer mixer)
 	return VDP_STATUS_OK;
 }
 
-VdpStatus vdp_video_mixer_render(VdpVideoMixer mixer, VdpOutputSurface background_surface, VdpRect const *background_source_rect, VdpVideoMixerPictureStructure current_picture_structure, uint32_t video_surface_past_count, VdpVideoSurface const *video_surface_past, VdpVideoSurface video_surface_current, uint32_t video_surface_future_count, VdpVideoSurface const *video_surface_future, VdpRect const *video_source_rect, VdpOutputSurface destination_surface, VdpRect const *destination_rect, VdpRect const *destination_video_rect, uint32_t layer_count, VdpLayer const *layers)
+static const VdpOutputSurfaceRenderBlendState blend_over =
 {
-	mixer_ctx_t *mix = handle_get(mixer);
-	if (!mix)
-		return VDP_STATUS_INVALID_HANDLE;
+	.struct_version = VDP_OUTPUT_SURFACE_RENDER_BLEND_STATE_VERSION,
+	.blend_factor_source_color = VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_SRC_ALPHA,
+	.blend_factor_destination_color = VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+	.blend_factor_source_alpha = VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE,
+	.blend_factor_destination_alpha = VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+	.blend_equation_color = VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_ADD,
+	.blend_equation_alpha = VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_ADD,
+};
 
-	if (background_surface != VDP_INVALID_HANDLE)
-		VDPAU_DBG_ONCE("Requested unimplemented background_surface");
+static const VdpColor transparent = { 0.0, 0.0, 0.0, 0.0 };
+
+/*
+ * The background only shows around the video, which is on a layer
+ * below the OSD, so it goes into the OSD in up to four stripes.
+ */
+static void render_background(output_surface_ctx_t *os, output_surface_ctx_t *bg, const VdpRect *background_source_rect, const VdpRect *dest, const VdpRect *video)
+{
+	VdpRect src = { 0, 0, bg->rgba.width, bg->rgba.height };
+	if (background_source_rect)
+		src = *background_source_rect;
+
+	VdpRect v;
+	v.x0 = max(video->x0, dest->x0);
+	v.y0 = max(video->y0, dest->y0);
+	v.x1 = min(video->x1, dest->x1);
+	v.y1 = min(video->y1, dest->y1);
+
+	VdpRect stripes[4] =
+	{
+		{ dest->x0, dest->y0, dest->x1, v.y0 },
+		{ dest->x0, v.y1, dest->x1, dest->y1 },
+		{ dest->x0, v.y0, v.x0, v.y1 },
+		{ v.x1, v.y0, dest->x1, v.y1 },
+	};
+	int i, count = 4;
+
+	if (v.x0 >= v.x1 || v.y0 >= v.y1)
+	{
+		stripes[0] = *dest;
+		count = 1;
+	}
+
+	uint32_t dw = dest->x1 - dest->x0, dh = dest->y1 - dest->y0;
+	uint32_t sw = src.x1 - src.x0, sh = src.y1 - src.y0;
+	if (dw == 0 || dh == 0)
+		return;
+
+	for (i = 0; i < count; i++)
+	{
+		VdpRect *d = &stripes[i];
+		if (d->x0 >= d->x1 || d->y0 >= d->y1)
+			continue;
+
+		VdpRect s;
+		s.x0 = src.x0 + (uint64_t)(d->x0 - dest->x0) * sw / dw;
+		s.y0 = src.y0 + (uint64_t)(d->y0 - dest->y0) * sh / dh;
+		s.x1 = src.x0 + (uint64_t)(d->x1 - dest->x0) * sw / dw;
+		s.y1 = src.y0 + (uint64_t)(d->y1 - dest->y0) * sh / dh;
+
+		rgba_render(&os->rgba, d, &bg->rgba, &s, NULL, NULL, 0);
+	}
+}
 
+/*
+ * Videos mixed into part of an output surface that already got its main
+ * video for this frame go onto scaler layers of their own as long as the
+ * display has some left, otherwise G2D scales them into the OSD.
+ */
+static void add_pip(mixer_ctx_t *mix, output_surface_ctx_t *os, video_surface_ctx_t *vs, const VdpRect *src_rect, const VdpRect *dst_rect)
+{
+	int i;
+	for (i = 0; i < os->pip_count; i++)
+		if (memcmp(&os->pip[i].dst_rect, dst_rect, sizeof(*dst_rect)) == 0)
+			break;
 
-	if (current_picture_structure != VDP_VIDEO_MIXER_PICTURE_STRUCTURE_FRAME)
-		VDPAU_DBG_ONCE("Requested unimplemented picture_structure");
+	if (i == os->pip_count)
+	{
+		if (i >= OUTPUT_PIP_MAX || i >= mix->device->pip_layers)
+		{
+			rgba_render_video(&os->rgba, dst_rect, vs, src_rect);
+			return;
+		}
+		os->pip_count++;
+	}
 
+	os->pip[i].vs = vs;
+	os->pip[i].src_rect = *src_rect;
+	os->pip[i].dst_rect = *dst_rect;
+}
 
+VdpStatus vdp_video_mixer_render(VdpVideoMixer mixer, VdpOutputSurface background_surface, VdpRect const *background_source_rect, VdpVideoMixerPictureStructure current_picture_structure, uint32_t video_surface_past_count, VdpVideoSurface const *video_surface_past, VdpVideoSurface video_surface_current, uint32_t video_surface_future_count, VdpVideoSurface const *video_surface_future, VdpRect const *video_source_rect, VdpOutputSurface destination_surface, VdpRect const *destination_rect, VdpRect const *destination_video_rect, uint32_t layer_count, VdpLayer const *layers)
+{
+	uint32_t i;
+
+	if (layer_count && !layers)
+		return VDP_STATUS_INVALID_POINTER;
+
+	for (i = 0; i < layer_count; i++)
+		if (layers[i].struct_version != VDP_LAYER_VERSION)
+			return VDP_STATUS_INVALID_STRUCT_VERSION;
+
+	mixer_ctx_t *mix = handle_get(mixer);
+	if (!mix)
+		return VDP_STATUS_INVALID_HANDLE;
+
+	if (current_picture_structure > VDP_VIDEO_MIXER_PICTURE_STRUCTURE_FRAME)
+	{
+		handle_release(mixer);
+		return VDP_STATUS_INVALID_VIDEO_MIXER_PICTURE_STRUCTURE;
+	}
 
 	output_surface_ctx_t *os = handle_get(destination_surface);
 	if (!os)
+	{
+		handle_release(mixer);
 		return VDP_STATUS_INVALID_HANDLE;
+	}
 
-	os->vs = handle_get(video_surface_current);
-	if (!(os->vs))
+	video_surface_ctx_t *vs = handle_get(video_surface_current);
+	if (!vs)
+	{
+		handle_release(mixer);
+		handle_release(destination_surface);
 		return VDP_STATUS_INVALID_HANDLE;
+	}
+
+	VdpRect dest = { 0, 0, os->rgba.width, os->rgba.height };
+	if (destination_rect)
+		dest = *destination_rect;
 
+	VdpRect video_dst = dest;
 	if (destination_video_rect)
+		video_dst = *destination_video_rect;
+
+	VdpRect video_src = { 0, 0, vs->width, vs->height };
+	if (video_source_rect)
+		video_src = *video_source_rect;
+
+	// a render after the surface was displayed, into the whole surface or
+	// the main video's place starts a new frame, anything else adds a PiP
+	if (!os->video_composing || memcmp(&video_dst, &os->video_dst_rect, sizeof(video_dst)) == 0 ||
+	    (dest.x0 == 0 && dest.y0 == 0 && dest.x1 >= os->rgba.width && dest.y1 >= os->rgba.height))
 	{
-		os->video_dst_rect = *destination_video_rect;
-		if (video_source_rect)
-			os->video_src_rect = *video_source_rect;
-		else
+		// the video replaces whatever was rendered onto the surface before
+		rgba_clear(&os->rgba);
+
+		os->vs = vs;
+		os->video_src_rect = video_src;
+		os->video_dst_rect = video_dst;
+		os->pip_count = 0;
+		os->video_composing = 1;
+
+		// fields are deinterlaced when displayed, only whether there is
+		// a past picture is remembered, never the picture itself
+		os->video_field = current_picture_structure;
+		os->video_deinterlace = mix->deinterlace;
+		os->video_has_past = 0;
+		if (video_surface_past_count && video_surface_past && video_surface_past[0] != VDP_INVALID_HANDLE &&
+		    handle_get(video_surface_past[0]))
 		{
-			os->video_src_rect.x0 = os->video_src_rect.y0 = 0;
-			os->video_src_rect.x1 = os->vs->width;
-			os->video_src_rect.y1 = os->vs->height;
+			os->video_has_past = 1;
+			handle_release(video_surface_past[0]);
 		}
+
+		os->csc_change = mix->csc_change;
+		os->brightness = mix->brightness;
+		os->contrast = mix->contrast;
+		os->saturation = mix->saturation;
+		os->hue = mix->hue;
+		mix->csc_change = 0;
+	}
+	else
+	{
+		// picture-in-picture or one of several views, only its own part is replaced
+		rgba_render(&os->rgba, &dest, NULL, NULL, &transparent, NULL, 0);
+		add_pip(mix, os, vs, &video_src, &video_dst);
 	}
-	os->csc_change = mix->csc_change;
-	os->brightness = mix->brightness;
-	os->contrast = mix->contrast;
-	os->saturation = mix->saturation;
-	os->hue = mix->hue;
-	mix->csc_change = 0;
 
-	if (layer_count != 0)
-		VDPAU_DBG_ONCE("Requested unimplemented additional layers");
+	if (background_surface != VDP_INVALID_HANDLE)
+	{
+		output_surface_ctx_t *bg = handle_get(background_surface);
+		if (bg)
+		{
+			render_background(os, bg, background_source_rect, &dest, &video_dst);
+			handle_release(background_surface);
+		}
+	}
 
-        handle_release(mixer);
-        handle_release(destination_surface);
-        handle_release(video_surface_current);
+	// layers are blended onto the OSD above the video
+	for (i = 0; i < layer_count; i++)
+	{
+		output_surface_ctx_t *layer = handle_get(layers[i].source_surface);
+		if (!layer)
+			continue;
+
+		rgba_render(&os->rgba, layers[i].destination_rect, &layer->rgba, layers[i].source_rect, NULL, &blend_over, 0);
+		handle_release(layers[i].source_surface);
+	}
+
+	handle_release(mixer);
+	handle_release(destination_surface);
+	handle_release(video_surface_current);
 	return VDP_STATUS_OK;
 }
 
@@ -113,8 +270,17 @@ VdpStatus vdp_video_mixer_get_feature_support(VdpVideoMixer mixer, uint32_t feat
 	if (!mix)
 		return VDP_STATUS_INVALID_HANDLE;
 
+	/*
+	 * Fields are deinterlaced when displayed, tiled ones motion adaptive
+	 * in the display engine and linear ones by bob. Without the engine's
+	 * deinterlacer, and for copies turned by 90 or 270, they are woven.
+	 */
+	uint32_t i;
+	for (i = 0; i < feature_count; i++)
+		feature_supports[i] = (features[i] == VDP_VIDEO_MIXER_FEATURE_DEINTERLACE_TEMPORAL);
+
         handle_release(mixer);
-	return VDP_STATUS_ERROR;
+	return VDP_STATUS_OK;
 }
 
 VdpStatus vdp_video_mixer_set_feature_enables(VdpVideoMixer mixer, uint32_t feature_count, VdpVideoMixerFeature const *features, VdpBool const *feature_enables)
@@ -129,6 +295,11 @@ VdpStatus vdp_video_mixer_set_feature_enables(VdpVideoMixer mixer, uint32_t feat
 	if (!mix)
 		return VDP_STATUS_INVALID_HANDLE;
 
+	uint32_t i;
+	for (i = 0; i < feature_count; i++)
+		if (features[i] == VDP_VIDEO_MIXER_FEATURE_DEINTERLACE_TEMPORAL)
+			mix->deinterlace = feature_enables[i];
+
         handle_release(mixer);
 	return VDP_STATUS_OK;
 }
@@ -142,8 +313,12 @@ VdpStatus vdp_video_mixer_get_feature_enables(VdpVideoMixer mixer, uint32_t feat
 	if (!mix)
 		return VDP_STATUS_INVALID_HANDLE;
 
+	uint32_t i;
+	for (i = 0; i < feature_count; i++)
+		feature_enables[i] = (features[i] == VDP_VIDEO_MIXER_FEATURE_DEINTERLACE_TEMPORAL) && mix->deinterlace;
+
         handle_release(mixer);
-	return VDP_STATUS_ERROR;
+	return VDP_STATUS_OK;
 }
 
 static void set_csc_matrix(mixer_ctx_t *mix, const VdpCSCMatrix *matrix)
@@ -219,7 +394,7 @@ VdpStatus vdp_video_mixer_query_feature_support(VdpDevice device, VdpVideoMixerF
 	if (!dev)
 		return VDP_STATUS_INVALID_HANDLE;
 
-	*is_supported = VDP_FALSE;
+	*is_supported = (feature == VDP_VIDEO_MIXER_FEATURE_DEINTERLACE_TEMPORAL);
         handle_release(device);
 	return VDP_STATUS_OK;
 }
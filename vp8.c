@@ -0,0 +1,427 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <string.h>
+#include "vp8.h"
+
+/*
+ * Frame header parsing as described in RFC 6386, sections 9 and 19.
+ * Only the part of the first partition before the token probability
+ * updates is parsed here, everything after it is read through the
+ * boolean decoder of the VE (see vp8_decoder.c).
+ */
+
+typedef struct
+{
+	const uint8_t *input;
+	const uint8_t *end;
+	uint32_t range;
+	uint32_t value;
+	int bit_count;
+	int reads;
+} bool_decoder;
+
+static void bool_init(bool_decoder *d, const uint8_t *data, int len)
+{
+	d->input = data;
+	d->end = data + len;
+	d->value = 0;
+	if (d->input < d->end)
+		d->value = *d->input++ << 8;
+	if (d->input < d->end)
+		d->value |= *d->input++;
+	d->range = 255;
+	d->bit_count = 0;
+	d->reads = 0;
+}
+
+static int bool_read(bool_decoder *d, int prob)
+{
+	uint32_t split = 1 + (((d->range - 1) * prob) >> 8);
+	uint32_t bigsplit = split << 8;
+	int ret;
+
+	if (d->value >= bigsplit)
+	{
+		ret = 1;
+		d->range -= split;
+		d->value -= bigsplit;
+	}
+	else
+	{
+		ret = 0;
+		d->range = split;
+	}
+
+	while (d->range < 128)
+	{
+		d->value <<= 1;
+		d->range <<= 1;
+		if (++d->bit_count == 8)
+		{
+			d->bit_count = 0;
+			if (d->input < d->end)
+				d->value |= *d->input++;
+		}
+	}
+
+	d->reads++;
+	return ret;
+}
+
+static uint32_t bool_literal(bool_decoder *d, int bits)
+{
+	uint32_t v = 0;
+	while (bits--)
+		v = (v << 1) | bool_read(d, 128);
+	return v;
+}
+
+static int bool_signed(bool_decoder *d, int bits)
+{
+	int v = bool_literal(d, bits);
+	return bool_read(d, 128) ? -v : v;
+}
+
+static int8_t read_delta(bool_decoder *d, int bits)
+{
+	if (bool_read(d, 128))
+		return bool_signed(d, bits);
+	return 0;
+}
+
+int vp8_parse_frame_header(vp8_header_t *h, const uint8_t *data, int len)
+{
+	bool_decoder d;
+	int i;
+
+	if (len < 3)
+		return 0;
+
+	uint32_t tag = data[0] | (data[1] << 8) | (data[2] << 16);
+	h->key_frame = !(tag & 0x1);
+	h->version = (tag >> 1) & 0x7;
+	h->show_frame = (tag >> 4) & 0x1;
+	h->first_part_size = (tag >> 5) & 0x7ffff;
+	h->header_size = 3;
+
+	if (h->version > 3)
+		return 0;
+
+	if (h->key_frame)
+	{
+		if (len < 10 || data[3] != 0x9d || data[4] != 0x01 || data[5] != 0x2a)
+			return 0;
+
+		h->width = (data[6] | (data[7] << 8)) & 0x3fff;
+		h->horiz_scale = data[7] >> 6;
+		h->height = (data[8] | (data[9] << 8)) & 0x3fff;
+		h->vert_scale = data[9] >> 6;
+		h->header_size = 10;
+
+		// segmentation and loop filter deltas are reset on key frames
+		h->segmentation_enabled = 0;
+		h->segment_feature_mode = 0;
+		memset(h->segment_quant, 0, sizeof(h->segment_quant));
+		memset(h->segment_lf, 0, sizeof(h->segment_lf));
+		memset(h->segment_probs, 255, sizeof(h->segment_probs));
+		memset(h->ref_lf_deltas, 0, sizeof(h->ref_lf_deltas));
+		memset(h->mode_lf_deltas, 0, sizeof(h->mode_lf_deltas));
+	}
+
+	if (h->header_size + h->first_part_size > len)
+		return 0;
+
+	bool_init(&d, data + h->header_size, h->first_part_size);
+
+	if (h->key_frame)
+	{
+		h->color_space = bool_read(&d, 128);
+		h->clamping_type = bool_read(&d, 128);
+	}
+
+	h->update_mb_segmentation_map = 0;
+	h->update_segment_feature_data = 0;
+	h->segmentation_enabled = bool_read(&d, 128);
+	if (h->segmentation_enabled)
+	{
+		h->update_mb_segmentation_map = bool_read(&d, 128);
+		h->update_segment_feature_data = bool_read(&d, 128);
+
+		if (h->update_segment_feature_data)
+		{
+			h->segment_feature_mode = bool_read(&d, 128);
+			for (i = 0; i < 4; i++)
+				h->segment_quant[i] = read_delta(&d, 7);
+			for (i = 0; i < 4; i++)
+				h->segment_lf[i] = read_delta(&d, 6);
+		}
+
+		if (h->update_mb_segmentation_map)
+			for (i = 0; i < 3; i++)
+				h->segment_probs[i] = bool_read(&d, 128) ? bool_literal(&d, 8) : 255;
+	}
+
+	h->filter_type = bool_read(&d, 128);
+	h->loop_filter_level = bool_literal(&d, 6);
+	h->sharpness_level = bool_literal(&d, 3);
+
+	h->mode_ref_lf_delta_update = 0;
+	h->loop_filter_adj_enable = bool_read(&d, 128);
+	if (h->loop_filter_adj_enable)
+	{
+		h->mode_ref_lf_delta_update = bool_read(&d, 128);
+		if (h->mode_ref_lf_delta_update)
+		{
+			for (i = 0; i < 4; i++)
+				if (bool_read(&d, 128))
+					h->ref_lf_deltas[i] = bool_signed(&d, 6);
+			for (i = 0; i < 4; i++)
+				if (bool_read(&d, 128))
+					h->mode_lf_deltas[i] = bool_signed(&d, 6);
+		}
+	}
+
+	h->log2_nbr_of_dct_partitions = bool_literal(&d, 2);
+
+	h->y_ac_qi = bool_literal(&d, 7);
+	h->y_dc_delta = read_delta(&d, 4);
+	h->y2_dc_delta = read_delta(&d, 4);
+	h->y2_ac_delta = read_delta(&d, 4);
+	h->uv_dc_delta = read_delta(&d, 4);
+	h->uv_ac_delta = read_delta(&d, 4);
+
+	if (h->key_frame)
+	{
+		h->refresh_golden_frame = 1;
+		h->refresh_alternate_frame = 1;
+		h->copy_buffer_to_golden = 0;
+		h->copy_buffer_to_alternate = 0;
+		h->sign_bias_golden = 0;
+		h->sign_bias_alternate = 0;
+		h->refresh_entropy_probs = bool_read(&d, 128);
+		h->refresh_last = 1;
+	}
+	else
+	{
+		h->refresh_golden_frame = bool_read(&d, 128);
+		h->refresh_alternate_frame = bool_read(&d, 128);
+		h->copy_buffer_to_golden = 0;
+		if (!h->refresh_golden_frame)
+			h->copy_buffer_to_golden = bool_literal(&d, 2);
+		h->copy_buffer_to_alternate = 0;
+		if (!h->refresh_alternate_frame)
+			h->copy_buffer_to_alternate = bool_literal(&d, 2);
+		h->sign_bias_golden = bool_read(&d, 128);
+		h->sign_bias_alternate = bool_read(&d, 128);
+		h->refresh_entropy_probs = bool_read(&d, 128);
+		h->refresh_last = bool_read(&d, 128);
+	}
+
+	h->header_bits = d.reads;
+
+	return 1;
+}
+
+const uint8_t vp8_default_ymode_probs[4] = { 112, 86, 140, 37 };
+const uint8_t vp8_default_uvmode_probs[3] = { 162, 101, 204 };
+
+const uint8_t vp8_default_mv_probs[2][VP8_MV_PROB_CNT] =
+{
+	{ 162, 128, 225, 146, 172, 147, 214,  39, 156, 128, 129, 132,  75, 145, 178, 206, 239, 254, 254 },
+	{ 164, 128, 204, 170, 119, 235, 140, 230, 228, 128, 130, 130,  74, 148, 180, 203, 236, 254, 254 }
+};
+
+const uint8_t vp8_mv_update_probs[2][VP8_MV_PROB_CNT] =
+{
+	{ 237, 246, 253, 253, 254, 254, 254, 254, 254, 254, 254, 254, 254, 254, 250, 250, 252, 254, 254 },
+	{ 231, 243, 245, 253, 254, 254, 254, 254, 254, 254, 254, 254, 254, 254, 251, 251, 254, 254, 254 }
+};
+
+const uint8_t vp8_default_coeff_probs[4][8][3][VP8_COEFF_PROB_CNT] =
+{
+	{
+		{
+			{ 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128 },
+			{ 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128 },
+			{ 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128 }
+		},
+		{
+			{ 253, 136, 254, 255, 228, 219, 128, 128, 128, 128, 128 },
+			{ 189, 129, 242, 255, 227, 213, 255, 219, 128, 128, 128 },
+			{ 106, 126, 227, 252, 214, 209, 255, 255, 128, 128, 128 }
+		},
+		{
+			{   1,  98, 248, 255, 236, 226, 255, 255, 128, 128, 128 },
+			{ 181, 133, 238, 254, 221, 234, 255, 154, 128, 128, 128 },
+			{  78, 134, 202, 247, 198, 180, 255, 219, 128, 128, 128 }
+		},
+		{
+			{   1, 185, 249, 255, 243, 255, 128, 128, 128, 128, 128 },
+			{ 184, 150, 247, 255, 236, 224, 128, 128, 128, 128, 128 },
+			{  77, 110, 216, 255, 236, 230, 128, 128, 128, 128, 128 }
+		},
+		{
+			{   1, 101, 251, 255, 241, 255, 128, 128, 128, 128, 128 },
+			{ 170, 139, 241, 252, 236, 209, 255, 255, 128, 128, 128 },
+			{  37, 116, 196, 243, 228, 255, 255, 255, 128, 128, 128 }
+		},
+		{
+			{   1, 204, 254, 255, 245, 255, 128, 128, 128, 128, 128 },
+			{ 207, 160, 250, 255, 238, 128, 128, 128, 128, 128, 128 },
+			{ 102, 103, 231, 255, 211, 171, 128, 128, 128, 128, 128 }
+		},
+		{
+			{   1, 152, 252, 255, 240, 255, 128, 128, 128, 128, 128 },
+			{ 177, 135, 243, 255, 234, 225, 128, 128, 128, 128, 128 },
+			{  80, 129, 211, 255, 194, 224, 128, 128, 128, 128, 128 }
+		},
+		{
+			{   1,   1, 255, 128, 128, 128, 128, 128, 128, 128, 128 },
+			{ 246,   1, 255, 128, 128, 128, 128, 128, 128, 128, 128 },
+			{ 255, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128 }
+		}
+	},
+	{
+		{
+			{ 198,  35, 237, 223, 193, 187, 162, 160, 145, 155,  62 },
+			{ 131,  45, 198, 221, 172, 176, 220, 157, 252, 221,   1 },
+			{  68,  47, 146, 208, 149, 167, 221, 162, 255, 223, 128 }
+		},
+		{
+			{   1, 149, 241, 255, 221, 224, 255, 255, 128, 128, 128 },
+			{ 184, 141, 234, 253, 222, 220, 255, 199, 128, 128, 128 },
+			{  81,  99, 181, 242, 176, 190, 249, 202, 255, 255, 128 }
+		},
+		{
+			{   1, 129, 232, 253, 214, 197, 242, 196, 255, 255, 128 },
+			{  99, 121, 210, 250, 201, 198, 255, 202, 128, 128, 128 },
+			{  23,  91, 163, 242, 170, 187, 247, 210, 255, 255, 128 }
+		},
+		{
+			{   1, 200, 246, 255, 234, 255, 128, 128, 128, 128, 128 },
+			{ 109, 178, 241, 255, 231, 245, 255, 255, 128, 128, 128 },
+			{  44, 130, 201, 253, 205, 192, 255, 255, 128, 128, 128 }
+		},
+		{
+			{   1, 132, 239, 251, 219, 209, 255, 165, 128, 128, 128 },
+			{  94, 136, 225, 251, 218, 190, 255, 255, 128, 128, 128 },
+			{  22, 100, 174, 245, 186, 161, 255, 199, 128, 128, 128 }
+		},
+		{
+			{   1, 182, 249, 255, 232, 235, 128, 128, 128, 128, 128 },
+			{ 124, 143, 241, 255, 227, 234, 128, 128, 128, 128, 128 },
+			{  35,  77, 181, 251, 193, 211, 255, 205, 128, 128, 128 }
+		},
+		{
+			{   1, 157, 247, 255, 236, 231, 255, 255, 128, 128, 128 },
+			{ 121, 141, 235, 255, 225, 227, 255, 255, 128, 128, 128 },
+			{  45,  99, 188, 251, 195, 217, 255, 224, 128, 128, 128 }
+		},
+		{
+			{   1,   1, 251, 255, 213, 255, 128, 128, 128, 128, 128 },
+			{ 203,   1, 248, 255, 255, 128, 128, 128, 128, 128, 128 },
+			{ 137,   1, 177, 255, 224, 255, 128, 128, 128, 128, 128 }
+		}
+	},
+	{
+		{
+			{ 253,   9, 248, 251, 207, 208, 255, 192, 128, 128, 128 },
+			{ 175,  13, 224, 243, 193, 185, 249, 198, 255, 255, 128 },
+			{  73,  17, 171, 221, 161, 179, 236, 167, 255, 234, 128 }
+		},
+		{
+			{   1,  95, 247, 253, 212, 183, 255, 255, 128, 128, 128 },
+			{ 239,  90, 244, 250, 211, 209, 255, 255, 128, 128, 128 },
+			{ 155,  77, 195, 248, 188, 195, 255, 255, 128, 128, 128 }
+		},
+		{
+			{   1,  24, 239, 251, 218, 219, 255, 205, 128, 128, 128 },
+			{ 201,  51, 219, 255, 196, 186, 128, 128, 128, 128, 128 },
+			{  69,  46, 190, 239, 201, 218, 255, 228, 128, 128, 128 }
+		},
+		{
+			{   1, 191, 251, 255, 255, 128, 128, 128, 128, 128, 128 },
+			{ 223, 165, 249, 255, 213, 255, 128, 128, 128, 128, 128 },
+			{ 141, 124, 248, 255, 255, 128, 128, 128, 128, 128, 128 }
+		},
+		{
+			{   1,  16, 248, 255, 255, 128, 128, 128, 128, 128, 128 },
+			{ 190,  36, 230, 255, 236, 255, 128, 128, 128, 128, 128 },
+			{ 149,   1, 255, 128, 128, 128, 128, 128, 128, 128, 128 }
+		},
+		{
+			{   1, 226, 255, 128, 128, 128, 128, 128, 128, 128, 128 },
+			{ 247, 192, 255, 128, 128, 128, 128, 128, 128, 128, 128 },
+			{ 240, 128, 255, 128, 128, 128, 128, 128, 128, 128, 128 }
+		},
+		{
+			{   1, 134, 252, 255, 255, 128, 128, 128, 128, 128, 128 },
+			{ 213,  62, 250, 255, 255, 128, 128, 128, 128, 128, 128 },
+			{  55,  93, 255, 128, 128, 128, 128, 128, 128, 128, 128 }
+		},
+		{
+			{ 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128 },
+			{ 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128 },
+			{ 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128 }
+		}
+	},
+	{
+		{
+			{ 202,  24, 213, 235, 186, 191, 220, 160, 240, 118, 255 },
+			{ 126,  38, 182, 232, 169, 184, 228, 174, 255, 187, 128 },
+			{  61,  46, 138, 219, 151, 178, 240, 170, 255, 216, 128 }
+		},
+		{
+			{   1, 112, 230, 250, 199, 191, 247, 159, 255, 255, 128 },
+			{ 166, 109, 228, 252, 211, 215, 255, 174, 128, 128, 128 },
+			{  39,  77, 162, 232, 172, 180, 245, 178, 255, 255, 128 }
+		},
+		{
+			{   1,  52, 220, 246, 198, 199, 249, 220, 255, 255, 128 },
+			{ 124,  74, 191, 243, 183, 193, 250, 221, 255, 255, 128 },
+			{  24,  71, 130, 219, 154, 170, 243, 182, 255, 255, 128 }
+		},
+		{
+			{   1, 182, 225, 249, 219, 240, 255, 224, 128, 128, 128 },
+			{ 149, 150, 226, 252, 216, 205, 255, 171, 128, 128, 128 },
+			{  28, 108, 170, 242, 183, 194, 254, 223, 255, 255, 128 }
+		},
+		{
+			{   1,  81, 230, 252, 204, 203, 255, 192, 128, 128, 128 },
+			{ 123, 102, 209, 247, 188, 196, 255, 233, 128, 128, 128 },
+			{  20,  95, 153, 243, 164, 173, 255, 203, 128, 128, 128 }
+		},
+		{
+			{   1, 222, 248, 255, 216, 213, 128, 128, 128, 128, 128 },
+			{ 168, 175, 246, 252, 235, 205, 255, 255, 128, 128, 128 },
+			{  47, 116, 215, 255, 211, 212, 255, 255, 128, 128, 128 }
+		},
+		{
+			{   1, 121, 236, 253, 212, 214, 255, 255, 128, 128, 128 },
+			{ 141,  84, 213, 252, 201, 202, 255, 219, 128, 128, 128 },
+			{  42,  80, 160, 240, 162, 185, 255, 205, 128, 128, 128 }
+		},
+		{
+			{   1,   1, 255, 128, 128, 128, 128, 128, 128, 128, 128 },
+			{ 244,   1, 255, 128, 128, 128, 128, 128, 128, 128, 128 },
+			{ 238,   1, 255, 128, 128, 128, 128, 128, 128, 128, 128 }
+		}
+	}
+};
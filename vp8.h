@@ -0,0 +1,75 @@
+#ifndef _VP8_H_
+#define _VP8_H_
+
+#include <stdint.h>
+
+#define VP8_MV_PROB_CNT		19
+#define VP8_COEFF_PROB_CNT	11
+
+typedef struct
+{
+	// frame tag / key frame start code
+	uint8_t key_frame;
+	uint8_t version;
+	uint8_t show_frame;
+	uint32_t first_part_size;
+	uint8_t header_size;
+	uint16_t width;
+	uint16_t height;
+	uint8_t horiz_scale;
+	uint8_t vert_scale;
+
+	uint8_t color_space;
+	uint8_t clamping_type;
+
+	// segmentation, persists until updated or next key frame
+	uint8_t segmentation_enabled;
+	uint8_t update_mb_segmentation_map;
+	uint8_t update_segment_feature_data;
+	uint8_t segment_feature_mode;
+	int8_t segment_quant[4];
+	int8_t segment_lf[4];
+	uint8_t segment_probs[3];
+
+	// loop filter
+	uint8_t filter_type;
+	uint8_t loop_filter_level;
+	uint8_t sharpness_level;
+	uint8_t loop_filter_adj_enable;
+	uint8_t mode_ref_lf_delta_update;
+	int8_t ref_lf_deltas[4];
+	int8_t mode_lf_deltas[4];
+
+	uint8_t log2_nbr_of_dct_partitions;
+
+	// quantizer indices
+	uint8_t y_ac_qi;
+	int8_t y_dc_delta;
+	int8_t y2_dc_delta;
+	int8_t y2_ac_delta;
+	int8_t uv_dc_delta;
+	int8_t uv_ac_delta;
+
+	// reference handling
+	uint8_t refresh_golden_frame;
+	uint8_t refresh_alternate_frame;
+	uint8_t copy_buffer_to_golden;
+	uint8_t copy_buffer_to_alternate;
+	uint8_t sign_bias_golden;
+	uint8_t sign_bias_alternate;
+	uint8_t refresh_entropy_probs;
+	uint8_t refresh_last;
+
+	// number of bools read from the first partition, all at probability 128
+	int header_bits;
+} vp8_header_t;
+
+int vp8_parse_frame_header(vp8_header_t *h, const uint8_t *data, int len);
+
+extern const uint8_t vp8_default_coeff_probs[4][8][3][VP8_COEFF_PROB_CNT];
+extern const uint8_t vp8_default_mv_probs[2][VP8_MV_PROB_CNT];
+extern const uint8_t vp8_mv_update_probs[2][VP8_MV_PROB_CNT];
+extern const uint8_t vp8_default_ymode_probs[4];
+extern const uint8_t vp8_default_uvmode_probs[3];
+
+#endif
@@ -0,0 +1,557 @@
+/*
+ * Copyright (c) 2013 Jens Kuske <jenskuske@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "vdpau_private.h"
+#include "ve.h"
+#include "vp8.h"
+
+/*
+ * VP8 runs on the H264 engine in VP8 mode. Complete frames are passed
+ * as bitstream, the picture info is not used. The start of the first
+ * partition is parsed in software (vp8.c) to get the frame parameters,
+ * the same bits are then skipped by the boolean decoder of the VE, which
+ * also applies the token probability updates to the entropy buffer.
+ */
+
+#define ENTROPY_PROBS_SIZE	0x2400
+
+// layout of the entropy probability buffer
+#define PROBS_COEFF(i, j, k)	((i) * 0x200 + (j) * 0x40 + (k) * 0x10)
+#define PROBS_YMODE		0x1008
+#define PROBS_UVMODE		0x1010
+#define PROBS_SEGMENT		0x1018
+#define PROBS_SKIP		0x1020
+#define PROBS_INTRA		0x1021
+#define PROBS_LAST		0x1022
+#define PROBS_GF		0x1023
+#define PROBS_MV(i)		(0x1024 + (i) * 0x1c)
+
+#define REF_LAST	0
+#define REF_GOLDEN	1
+#define REF_ALT		2
+
+typedef struct
+{
+	vp8_header_t header;
+	CEDARV_MEMORY entropy_probs;
+	uint8_t saved_coeff_probs[PROBS_YMODE];
+	uint8_t ymode_probs[4];
+	uint8_t uvmode_probs[3];
+	uint8_t mv_probs[2][VP8_MV_PROB_CNT];
+	uint8_t saved_ymode_probs[4];
+	uint8_t saved_uvmode_probs[3];
+	uint8_t saved_mv_probs[2][VP8_MV_PROB_CNT];
+	uint8_t last_sharpness_level;
+	uint8_t last_filter_type;
+	uint8_t last_p_frame;
+	uint8_t mb_no_coeff_skip;
+	video_surface_ctx_t *ref[3];
+	CEDARV_MEMORY deBlkDramBuf;
+	CEDARV_MEMORY intraPredDramBuf;
+} vp8_private_t;
+
+typedef struct
+{
+	vp8_private_t *decoder_p;
+} vp8_video_private_t;
+
+// a poll that never ends resets the engine
+static int wait_idle(void *regs, uint32_t busy, const char *where)
+{
+	uint32_t round = 0;
+
+	while (readl(regs + CEDARV_H264_STATUS) & busy)
+	{
+		if (++round >= 1000000)
+		{
+			cedarv_hang(where);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static uint32_t get_bits(void *regs, int num, int prob)
+{
+	// the rest of the frame is skipped once the engine was reset
+	if (cedarv_job_hung())
+		return 0;
+
+	writel(VP8_TRIG_GET_BITS | VP8_TRIG_BIN_LENGTH(num) | VP8_TRIG_PROBABILITY(prob), regs + CEDARV_H264_TRIGGER);
+	if (!wait_idle(regs, VLD_BUSY, "vp8 get_bits"))
+		return 0;
+
+	return readl(regs + CEDARV_H264_BASIC_BITS);
+}
+
+static void skip_bits(void *regs, int num)
+{
+	// at most 32 bits can be read back per trigger
+	while (num > 0)
+	{
+		int n = min(num, 32);
+		get_bits(regs, n, 128);
+		num -= n;
+	}
+}
+
+static int is_referenced(vp8_private_t *decoder_p, video_surface_ctx_t *surface)
+{
+	return decoder_p->ref[REF_LAST] == surface || decoder_p->ref[REF_GOLDEN] == surface ||
+		decoder_p->ref[REF_ALT] == surface;
+}
+
+static void vp8_video_private_free(video_surface_ctx_t *surface)
+{
+	vp8_video_private_t *surface_p = (vp8_video_private_t *)surface->decoder_private;
+	vp8_private_t *decoder_p = surface_p->decoder_p;
+	int i;
+
+	// drop references to destroyed surfaces, following frames will be broken
+	if (decoder_p)
+		for (i = 0; i < 3; i++)
+			if (decoder_p->ref[i] == surface)
+				decoder_p->ref[i] = NULL;
+
+	free(surface_p);
+	surface->decoder_private = NULL;
+	surface->decoder_private_free = NULL;
+}
+
+static void set_ref(vp8_private_t *decoder_p, int idx, video_surface_ctx_t *surface)
+{
+	video_surface_ctx_t *old = decoder_p->ref[idx];
+
+	decoder_p->ref[idx] = surface;
+
+	if (old && old != surface && !is_referenced(decoder_p, old))
+		((vp8_video_private_t *)old->decoder_private)->decoder_p = NULL;
+}
+
+static void update_references(vp8_private_t *decoder_p, video_surface_ctx_t *output)
+{
+	const vp8_header_t *h = &decoder_p->header;
+	video_surface_ctx_t *last = decoder_p->ref[REF_LAST];
+	video_surface_ctx_t *golden = decoder_p->ref[REF_GOLDEN];
+	video_surface_ctx_t *alt = decoder_p->ref[REF_ALT];
+
+	if (h->refresh_golden_frame)
+		golden = output;
+	else if (h->copy_buffer_to_golden == 1)
+		golden = last;
+	else if (h->copy_buffer_to_golden == 2)
+		golden = decoder_p->ref[REF_ALT];
+
+	if (h->refresh_alternate_frame)
+		alt = output;
+	else if (h->copy_buffer_to_alternate == 1)
+		alt = last;
+	else if (h->copy_buffer_to_alternate == 2)
+		alt = decoder_p->ref[REF_GOLDEN];
+
+	if (h->refresh_last)
+		last = output;
+
+	set_ref(decoder_p, REF_GOLDEN, golden);
+	set_ref(decoder_p, REF_ALT, alt);
+	set_ref(decoder_p, REF_LAST, last);
+}
+
+static void reset_probs(vp8_private_t *decoder_p)
+{
+	int i, j, k;
+
+	for (i = 0; i < 4; i++)
+		for (j = 0; j < 8; j++)
+			for (k = 0; k < 3; k++)
+				cedarv_memcpy(decoder_p->entropy_probs, PROBS_COEFF(i, j, k), (void *)vp8_default_coeff_probs[i][j][k], VP8_COEFF_PROB_CNT);
+
+	memcpy(decoder_p->ymode_probs, vp8_default_ymode_probs, sizeof(decoder_p->ymode_probs));
+	memcpy(decoder_p->uvmode_probs, vp8_default_uvmode_probs, sizeof(decoder_p->uvmode_probs));
+	memcpy(decoder_p->mv_probs, vp8_default_mv_probs, sizeof(decoder_p->mv_probs));
+}
+
+static void save_probs(vp8_private_t *decoder_p)
+{
+	memcpy(decoder_p->saved_coeff_probs, cedarv_getPointer(decoder_p->entropy_probs), PROBS_YMODE);
+	memcpy(decoder_p->saved_ymode_probs, decoder_p->ymode_probs, sizeof(decoder_p->ymode_probs));
+	memcpy(decoder_p->saved_uvmode_probs, decoder_p->uvmode_probs, sizeof(decoder_p->uvmode_probs));
+	memcpy(decoder_p->saved_mv_probs, decoder_p->mv_probs, sizeof(decoder_p->mv_probs));
+}
+
+static void restore_probs(vp8_private_t *decoder_p)
+{
+	cedarv_memcpy(decoder_p->entropy_probs, 0, decoder_p->saved_coeff_probs, PROBS_YMODE);
+	cedarv_flush_cache(decoder_p->entropy_probs, PROBS_YMODE);
+
+	memcpy(decoder_p->ymode_probs, decoder_p->saved_ymode_probs, sizeof(decoder_p->ymode_probs));
+	memcpy(decoder_p->uvmode_probs, decoder_p->saved_uvmode_probs, sizeof(decoder_p->uvmode_probs));
+	memcpy(decoder_p->mv_probs, decoder_p->saved_mv_probs, sizeof(decoder_p->mv_probs));
+}
+
+static void read_mode_probs(vp8_private_t *decoder_p, void *regs)
+{
+	const vp8_header_t *h = &decoder_p->header;
+	uint8_t probs[4];
+	int i, j;
+
+	probs[0] = 0;
+	decoder_p->mb_no_coeff_skip = get_bits(regs, 1, 128);
+	if (decoder_p->mb_no_coeff_skip)
+		probs[0] = get_bits(regs, 8, 128);
+	cedarv_memcpy(decoder_p->entropy_probs, PROBS_SKIP, probs, 1);
+
+	if (h->key_frame)
+		return;
+
+	for (i = 0; i < 3; i++)
+		probs[i] = get_bits(regs, 8, 128);
+	cedarv_memcpy(decoder_p->entropy_probs, PROBS_INTRA, probs, 3);
+
+	if (get_bits(regs, 1, 128))
+		for (i = 0; i < 4; i++)
+			decoder_p->ymode_probs[i] = get_bits(regs, 8, 128);
+
+	if (get_bits(regs, 1, 128))
+		for (i = 0; i < 3; i++)
+			decoder_p->uvmode_probs[i] = get_bits(regs, 8, 128);
+
+	for (i = 0; i < 2; i++)
+		for (j = 0; j < VP8_MV_PROB_CNT; j++)
+			if (get_bits(regs, 1, vp8_mv_update_probs[i][j]))
+			{
+				uint8_t p = get_bits(regs, 7, 128);
+				decoder_p->mv_probs[i][j] = p ? p << 1 : 1;
+			}
+}
+
+static void write_refs(vp8_private_t *decoder_p, video_surface_ctx_t *output, void *regs)
+{
+	video_surface_ctx_t *last = decoder_p->ref[REF_LAST] ? decoder_p->ref[REF_LAST] : output;
+	video_surface_ctx_t *golden = decoder_p->ref[REF_GOLDEN] ? decoder_p->ref[REF_GOLDEN] : output;
+	video_surface_ctx_t *alt = decoder_p->ref[REF_ALT] ? decoder_p->ref[REF_ALT] : output;
+
+	writel(cedarv_virt2phys(output->dataY), regs + CEDARV_VP8_REC_LUMA);
+	writel(cedarv_virt2phys(output->dataU), regs + CEDARV_VP8_REC_CHROMA);
+	writel(cedarv_virt2phys(last->dataY), regs + CEDARV_VP8_FWD_LUMA);
+	writel(cedarv_virt2phys(last->dataU), regs + CEDARV_VP8_FWD_CHROMA);
+	writel(cedarv_virt2phys(golden->dataY), regs + CEDARV_VP8_BWD_LUMA);
+	writel(cedarv_virt2phys(golden->dataU), regs + CEDARV_VP8_BWD_CHROMA);
+	writel(cedarv_virt2phys(alt->dataY), regs + CEDARV_VP8_ALT_LUMA);
+	writel(cedarv_virt2phys(alt->dataU), regs + CEDARV_VP8_ALT_CHROMA);
+}
+
+static void write_header_regs(vp8_private_t *decoder_p, void *regs)
+{
+	const vp8_header_t *h = &decoder_p->header;
+	uint32_t pps = 0;
+	int i;
+
+	// reconstruction filter and loop filter type by version, RFC 6386 9.1
+	switch (h->version)
+	{
+	case 1:
+		pps |= VP8_PPS_FILTER_TYPE_SIMPLE | VP8_PPS_BILINEAR_MC_FILTER;
+		break;
+	case 2:
+		pps |= VP8_PPS_LPF_DISABLE | VP8_PPS_BILINEAR_MC_FILTER;
+		break;
+	case 3:
+		pps |= VP8_PPS_LPF_DISABLE | VP8_PPS_FULL_PIXEL;
+		break;
+	}
+
+	if (h->filter_type)
+		pps |= VP8_PPS_LOOP_FILTER_SIMPLE;
+	if (h->loop_filter_level == 0)
+		pps |= VP8_PPS_LPF_DISABLE;
+	if (h->mode_ref_lf_delta_update)
+		pps |= VP8_PPS_MODE_REF_LF_DELTA_UPDATE;
+	if (h->loop_filter_adj_enable)
+		pps |= VP8_PPS_MODE_REF_LF_DELTA_ENABLE;
+	if (decoder_p->last_filter_type)
+		pps |= VP8_PPS_LAST_LOOP_FILTER_SIMPLE;
+	if (h->segment_feature_mode)
+		pps |= VP8_PPS_MB_SEGMENT_ABS_DELTA;
+	if (h->update_mb_segmentation_map)
+		pps |= VP8_PPS_UPDATE_MB_SEGMENTATION_MAP;
+	if (h->segmentation_enabled)
+		pps |= VP8_PPS_SEGMENTATION_ENABLE;
+	if (h->sign_bias_alternate)
+		pps |= VP8_PPS_ALTREF_SIGN_BIAS;
+	if (h->sign_bias_golden)
+		pps |= VP8_PPS_GOLDEN_SIGN_BIAS;
+	if (decoder_p->last_p_frame)
+		pps |= VP8_PPS_LAST_PIC_TYPE_P_FRAME;
+	if (!h->key_frame)
+		pps |= VP8_PPS_PIC_TYPE_P_FRAME;
+
+	pps |= VP8_PPS_SHARPNESS_LEVEL(h->sharpness_level);
+	pps |= VP8_PPS_LOOP_FILTER_LEVEL(h->loop_filter_level);
+	pps |= VP8_PPS_LAST_SHARPNESS_LEVEL(decoder_p->last_sharpness_level);
+	pps |= VP8_PPS_TOKEN_PARTITION(h->log2_nbr_of_dct_partitions);
+	if (decoder_p->mb_no_coeff_skip)
+		pps |= VP8_PPS_MB_NO_COEFF_SKIP;
+	pps |= VP8_PPS_RELOAD_ENTROPY_PROBS;
+	writel(pps, regs + CEDARV_VP8_PPS);
+
+	// quantizer index and deltas
+	writel((h->y_ac_qi & 0x7f) << 24 | (h->y_dc_delta & 0x1f) << 20 | (h->y2_dc_delta & 0x1f) << 15
+		| (h->y2_ac_delta & 0x1f) << 10 | (h->uv_dc_delta & 0x1f) << 5 | (h->uv_ac_delta & 0x1f),
+		regs + CEDARV_VP8_QP_INDEX_DELTA);
+
+	// segment features and loop filter deltas, one byte per entry
+	uint32_t quant = 0, lf = 0, ref_lf = 0, mode_lf = 0;
+	for (i = 0; i < 4; i++)
+	{
+		quant |= (h->segment_quant[i] & 0x7f) << (i * 8);
+		lf |= (h->segment_lf[i] & 0x7f) << (i * 8);
+		ref_lf |= (h->ref_lf_deltas[i] & 0x7f) << (i * 8);
+		mode_lf |= (h->mode_lf_deltas[i] & 0x7f) << (i * 8);
+	}
+	writel(quant, regs + CEDARV_VP8_SEGMENT_FEAT_MB_LV0);
+	writel(lf, regs + CEDARV_VP8_SEGMENT_FEAT_MB_LV1);
+	writel(ref_lf, regs + CEDARV_VP8_REF_LF_DELTA);
+	writel(mode_lf, regs + CEDARV_VP8_MODE_LF_DELTA);
+
+	writel((h->width << 16) | h->height, regs + CEDARV_VP8_PICSIZE);
+}
+
+static VdpStatus vp8_decode(decoder_ctx_t *decoder, VdpPictureInfo const *_info, const int len, video_surface_ctx_t *output)
+{
+	vp8_private_t *decoder_p = (vp8_private_t *)decoder->private;
+	vp8_header_t *h = &decoder_p->header;
+	vp8_video_private_t *output_p;
+	int i;
+
+	if (!vp8_parse_frame_header(h, cedarv_getPointer(decoder->data), len))
+		return VDP_STATUS_ERROR;
+
+	if (!h->key_frame && !decoder_p->ref[REF_LAST])
+		return VDP_STATUS_ERROR;
+
+	// the engine writes a picture of the key frame's size into the output and references
+	if (h->width > decoder->width || h->height > decoder->height ||
+	    h->width > output->stride_width || h->height > output->stride_height)
+		return VDP_STATUS_INVALID_SIZE;
+
+	output->source_format = INTERNAL_YCBCR_FORMAT;
+
+	if (!output->decoder_private)
+	{
+		output_p = calloc(1, sizeof(vp8_video_private_t));
+		if (!output_p)
+			return VDP_STATUS_RESOURCES;
+
+		output->decoder_private = output_p;
+		output->decoder_private_free = vp8_video_private_free;
+	}
+	else
+		output_p = output->decoder_private;
+
+	// a frame that fails leaves the probabilities as they were before it
+	save_probs(decoder_p);
+	if (h->key_frame)
+		reset_probs(decoder_p);
+
+	void *cedarv_regs = cedarv_get(CEDARV_ENGINE_H264, 0);
+
+	writel(CEDARV_H264_CTRL_VP8, cedarv_regs + CEDARV_H264_CTRL);
+
+	if (cedarv_get_version() == 0x1625 || decoder->width >= 2048)
+	{
+		writel(decoder->width >= 2048 ? 0x5 : 0xa, cedarv_regs + CEDARV_IPD_DBLK_BUF_CTRL);
+		writel(cedarv_virt2phys(decoder_p->deBlkDramBuf), cedarv_regs + CEDARV_IPD_BUF);
+		writel(cedarv_virt2phys(decoder_p->intraPredDramBuf), cedarv_regs + CEDARV_DBLK_BUF);
+	}
+
+	// sdctrl
+	writel(0x00000000, cedarv_regs + CEDARV_H264_SDROT_CTRL);
+	if (cedarv_get_version() >= 0x1680)
+	{
+		writel(OUTPUT_FORMAT_NV12, cedarv_regs + CEDARV_OUTPUT_FORMAT);
+		output->source_format = VDP_YCBCR_FORMAT_NV12;
+	}
+
+	// set input
+	uint32_t input_addr = cedarv_virt2phys(decoder->data);
+	writel((len - h->header_size) * 8, cedarv_regs + CEDARV_H264_VLD_LEN);
+	writel(h->header_size * 8, cedarv_regs + CEDARV_H264_VLD_OFFSET);
+	writel(input_addr + VBV_SIZE - 1, cedarv_regs + CEDARV_H264_VLD_END);
+	writel((input_addr & 0x0ffffff0) | (input_addr >> 28) | (0x7 << 28), cedarv_regs + CEDARV_H264_VLD_ADDR);
+
+	writel(h->first_part_size * 8, cedarv_regs + CEDARV_VP8_FIRST_DATA_PART_LEN);
+	writel((h->header_size + h->first_part_size) * 8, cedarv_regs + CEDARV_VP8_PART_SIZE_OFFSET);
+
+	writel(VP8_TRIG_INIT_SWDEC, cedarv_regs + CEDARV_H264_TRIGGER);
+	writel(cedarv_virt2phys(decoder_p->entropy_probs), cedarv_regs + CEDARV_VP8_ENTROPY_PROBS_ADDR);
+
+	// skip the already parsed header
+	skip_bits(cedarv_regs, h->header_bits);
+	if (cedarv_job_hung())
+		goto hung;
+
+	// let the VE apply the token probability updates
+	writel(VP8_TRIG_UPDATE_COEF, cedarv_regs + CEDARV_H264_TRIGGER);
+	if (!wait_idle(cedarv_regs, VP8_STATUS_UPPROB_BUSY, "vp8 probability update"))
+		goto hung;
+
+	read_mode_probs(decoder_p, cedarv_regs);
+	if (cedarv_job_hung())
+		goto hung;
+
+	cedarv_memcpy(decoder_p->entropy_probs, PROBS_YMODE, decoder_p->ymode_probs, 4);
+	cedarv_memcpy(decoder_p->entropy_probs, PROBS_UVMODE, decoder_p->uvmode_probs, 3);
+	cedarv_memcpy(decoder_p->entropy_probs, PROBS_SEGMENT, h->segment_probs, 3);
+	for (i = 0; i < 2; i++)
+		cedarv_memcpy(decoder_p->entropy_probs, PROBS_MV(i), decoder_p->mv_probs[i], VP8_MV_PROB_CNT);
+	cedarv_flush_cache(decoder_p->entropy_probs, ENTROPY_PROBS_SIZE);
+
+	write_header_regs(decoder_p, cedarv_regs);
+	write_refs(decoder_p, output, cedarv_regs);
+
+	// clear status flags
+	writel(readl(cedarv_regs + CEDARV_H264_STATUS), cedarv_regs + CEDARV_H264_STATUS);
+
+	// enable int
+	writel(readl(cedarv_regs + CEDARV_H264_CTRL) | 0x7, cedarv_regs + CEDARV_H264_CTRL);
+
+	// SHOWTIME
+	writel(VP8_TRIG_SLICE_DECODE, cedarv_regs + CEDARV_H264_TRIGGER);
+
+	cedarv_wait(1);
+	if (cedarv_job_hung())
+		goto hung;
+
+	// clear status flags
+	uint32_t status = readl(cedarv_regs + CEDARV_H264_STATUS);
+	if (status & 0x2)
+		log_warning("vp8 status=0x%X", status);
+	writel(status, cedarv_regs + CEDARV_H264_STATUS);
+
+	cedarv_put();
+
+	// probabilities are only valid for this frame if refresh_entropy_probs is not set,
+	// a key frame's fall back to the defaults
+	if (!h->refresh_entropy_probs)
+	{
+		if (h->key_frame)
+		{
+			reset_probs(decoder_p);
+			cedarv_flush_cache(decoder_p->entropy_probs, PROBS_YMODE);
+		}
+		else
+			restore_probs(decoder_p);
+	}
+
+	decoder_p->last_sharpness_level = h->sharpness_level;
+	decoder_p->last_filter_type = h->filter_type;
+	decoder_p->last_p_frame = !h->key_frame;
+
+	output_p->decoder_p = decoder_p;
+	update_references(decoder_p, output);
+	if (!is_referenced(decoder_p, output))
+		output_p->decoder_p = NULL;
+
+	output->frame_decoded = 1;
+	return VDP_STATUS_OK;
+
+hung:
+	// the engine was reset, the references and probabilities stay as before this frame
+	cedarv_put();
+	restore_probs(decoder_p);
+	return VDP_STATUS_ERROR;
+}
+
+static void vp8_private_free(decoder_ctx_t *decoder)
+{
+	vp8_private_t *decoder_p = (vp8_private_t *)decoder->private;
+	int i;
+
+	for (i = 0; i < 3; i++)
+		if (decoder_p->ref[i])
+			((vp8_video_private_t *)decoder_p->ref[i]->decoder_private)->decoder_p = NULL;
+
+	cedarv_free(decoder_p->entropy_probs);
+	if (cedarv_isValid(decoder_p->deBlkDramBuf))
+		cedarv_free(decoder_p->deBlkDramBuf);
+	if (cedarv_isValid(decoder_p->intraPredDramBuf))
+		cedarv_free(decoder_p->intraPredDramBuf);
+	free(decoder_p);
+}
+
+static void vp8_private_flush(decoder_ctx_t *decoder)
+{
+	vp8_private_t *decoder_p = (vp8_private_t *)decoder->private;
+	int i;
+
+	// a seek starts over at a key frame, which refreshes all references
+	for (i = 0; i < 3; i++)
+		set_ref(decoder_p, i, NULL);
+}
+
+VdpStatus new_decoder_vp8(decoder_ctx_t *decoder)
+{
+	vp8_private_t *decoder_p = calloc(1, sizeof(vp8_private_t));
+	if (!decoder_p)
+		return VDP_STATUS_RESOURCES;
+
+	decoder_p->entropy_probs = cedarv_malloc_type(ENTROPY_PROBS_SIZE, CEDARV_MEM_SCRATCH);
+	if (!cedarv_isValid(decoder_p->entropy_probs))
+		goto err_probs;
+	cedarv_memset(decoder_p->entropy_probs, 0, ENTROPY_PROBS_SIZE);
+
+	if (cedarv_get_version() == 0x1625 || decoder->width >= 2048)
+	{
+		size_t len = ((decoder->width + 15) / 16 + 31) * 16 * 12;
+		decoder_p->deBlkDramBuf = cedarv_malloc_type(len, CEDARV_MEM_SCRATCH);
+		if (!cedarv_isValid(decoder_p->deBlkDramBuf))
+			goto err_deblk;
+		cedarv_memset(decoder_p->deBlkDramBuf, 0, len);
+		cedarv_flush_cache(decoder_p->deBlkDramBuf, len);
+
+		len = ((decoder->width + 15) / 16 + 63) * 16 * 5;
+		decoder_p->intraPredDramBuf = cedarv_malloc_type(len, CEDARV_MEM_SCRATCH);
+		if (!cedarv_isValid(decoder_p->intraPredDramBuf))
+			goto err_intra;
+		cedarv_memset(decoder_p->intraPredDramBuf, 0, len);
+		cedarv_flush_cache(decoder_p->intraPredDramBuf, len);
+	}
+
+	reset_probs(decoder_p);
+	cedarv_flush_cache(decoder_p->entropy_probs, ENTROPY_PROBS_SIZE);
+
+	decoder->decode = vp8_decode;
+	decoder->private = decoder_p;
+	decoder->private_free = vp8_private_free;
+	decoder->private_flush = vp8_private_flush;
+	return VDP_STATUS_OK;
+
+err_intra:
+	cedarv_free(decoder_p->deBlkDramBuf);
+err_deblk:
+	cedarv_free(decoder_p->entropy_probs);
+err_probs:
+	free(decoder_p);
+	return VDP_STATUS_RESOURCES;
+}